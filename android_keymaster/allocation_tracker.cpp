@@ -0,0 +1,164 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <keymaster/allocation_tracker.h>
+
+#include <keymaster/android_keymaster_messages.h>
+#include <keymaster/keymaster_tags.h>
+#include <keymaster/logger.h>
+
+namespace keymaster {
+
+namespace {
+
+const size_t kCommandCount = OPEN_RECORD + 1;
+const size_t kPurposeCount = KM_PURPOSE_AGREE_KEY + 1;
+
+// Plain zero-initialized data, so that it's usable by allocations made before static constructors
+// run.
+AllocationStats command_totals[kCommandCount];
+AllocationStats purpose_totals[kPurposeCount];
+
+#ifdef KEYMASTER_TRACK_ALLOCATIONS
+// Each thread has its own innermost scope, so that commands running concurrently are charged only
+// for their own allocations.
+thread_local AllocationScope* current_scope = nullptr;
+#else
+AllocationScope* const current_scope = nullptr;
+#endif
+
+// The totals are updated atomically, since outermost scopes on different threads may close at
+// once.
+void add_call(uint64_t allocations, uint64_t bytes, int64_t peak_live_bytes,
+              AllocationStats* stats) {
+    __atomic_fetch_add(&stats->calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->allocations, allocations, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->bytes, bytes, __ATOMIC_RELAXED);
+    if (peak_live_bytes <= 0)
+        return;
+    uint64_t peak = __atomic_load_n(&stats->peak_live_bytes, __ATOMIC_RELAXED);
+    while (static_cast<uint64_t>(peak_live_bytes) > peak &&
+           !__atomic_compare_exchange_n(&stats->peak_live_bytes, &peak, peak_live_bytes,
+                                        true /* weak */, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+AllocationStats load(const AllocationStats& stats) {
+    AllocationStats result;
+    result.calls = __atomic_load_n(&stats.calls, __ATOMIC_RELAXED);
+    result.allocations = __atomic_load_n(&stats.allocations, __ATOMIC_RELAXED);
+    result.bytes = __atomic_load_n(&stats.bytes, __ATOMIC_RELAXED);
+    result.peak_live_bytes = __atomic_load_n(&stats.peak_live_bytes, __ATOMIC_RELAXED);
+    return result;
+}
+
+void clear(AllocationStats* stats) {
+    __atomic_store_n(&stats->calls, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->allocations, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->bytes, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->peak_live_bytes, 0, __ATOMIC_RELAXED);
+}
+
+void log_stats(const char* kind, uint32_t value, const AllocationStats& totals) {
+    AllocationStats stats = load(totals);
+    if (!stats.calls)
+        return;
+    LOG_I("%s %u: %llu calls, %llu allocations, %llu bytes, %llu peak live bytes", kind, value,
+          static_cast<unsigned long long>(stats.calls),
+          static_cast<unsigned long long>(stats.allocations),
+          static_cast<unsigned long long>(stats.bytes),
+          static_cast<unsigned long long>(stats.peak_live_bytes));
+}
+
+}  // anonymous namespace
+
+/* static */
+AllocationStats AllocationTracker::command_stats(AndroidKeymasterCommand command) {
+    if (command >= kCommandCount)
+        return AllocationStats();
+    return load(command_totals[command]);
+}
+
+/* static */
+AllocationStats AllocationTracker::purpose_stats(keymaster_purpose_t purpose) {
+    if (static_cast<uint32_t>(purpose) >= kPurposeCount)
+        return AllocationStats();
+    return load(purpose_totals[purpose]);
+}
+
+/* static */
+void AllocationTracker::Reset() {
+    for (size_t i = 0; i < kCommandCount; ++i)
+        clear(&command_totals[i]);
+    for (size_t i = 0; i < kPurposeCount; ++i)
+        clear(&purpose_totals[i]);
+}
+
+/* static */
+void AllocationTracker::LogStats() {
+    for (uint32_t i = 0; i < kCommandCount; ++i)
+        log_stats("Command", i, command_totals[i]);
+    for (uint32_t i = 0; i < kPurposeCount; ++i)
+        log_stats("Purpose", i, purpose_totals[i]);
+}
+
+/* static */
+void AllocationTracker::RecordAllocation(size_t size) {
+    AllocationScope* scope = current_scope;
+    if (!scope)
+        return;
+    ++scope->allocations_;
+    scope->bytes_ += size;
+    scope->live_bytes_ += size;
+    if (scope->live_bytes_ > scope->peak_live_bytes_)
+        scope->peak_live_bytes_ = scope->live_bytes_;
+}
+
+/* static */
+void AllocationTracker::RecordFree(size_t size) {
+    if (current_scope)
+        current_scope->live_bytes_ -= size;
+}
+
+AllocationScope::AllocationScope(AndroidKeymasterCommand command)
+    : command_(command), purpose_(KM_PURPOSE_ENCRYPT), has_purpose_(false), allocations_(0),
+      bytes_(0), live_bytes_(0), peak_live_bytes_(0), parent_(current_scope) {
+#ifdef KEYMASTER_TRACK_ALLOCATIONS
+    current_scope = this;
+#endif
+}
+
+AllocationScope::~AllocationScope() {
+#ifdef KEYMASTER_TRACK_ALLOCATIONS
+    current_scope = parent_;
+    if (parent_) {
+        // The parent's live bytes can't have changed while this scope was open.
+        parent_->allocations_ += allocations_;
+        parent_->bytes_ += bytes_;
+        if (parent_->live_bytes_ + peak_live_bytes_ > parent_->peak_live_bytes_)
+            parent_->peak_live_bytes_ = parent_->live_bytes_ + peak_live_bytes_;
+        parent_->live_bytes_ += live_bytes_;
+        return;
+    }
+
+    if (command_ < kCommandCount)
+        add_call(allocations_, bytes_, peak_live_bytes_, &command_totals[command_]);
+    if (has_purpose_ && static_cast<uint32_t>(purpose_) < kPurposeCount)
+        add_call(allocations_, bytes_, peak_live_bytes_, &purpose_totals[purpose_]);
+#endif  // KEYMASTER_TRACK_ALLOCATIONS
+}
+
+}  // namespace keymaster
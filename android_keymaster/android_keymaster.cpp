@@ -22,7 +22,9 @@
 #include <stddef.h>
 
 #include <keymaster/UniquePtr.h>
+#include <keymaster/allocation_tracker.h>
 #include <keymaster/android_keymaster_utils.h>
+#include <keymaster/exported_key_cache.h>
 #include <keymaster/key.h>
 #include <keymaster/key_blob_utils/ae.h>
 #include <keymaster/key_factory.h>
@@ -39,6 +41,8 @@ const uint8_t MAJOR_VER = 2;
 const uint8_t MINOR_VER = 0;
 const uint8_t SUBMINOR_VER = 0;
 
+const size_t kExportedKeyCacheSize = 4;
+
 keymaster_error_t CheckVersionInfo(const AuthorizationSet& tee_enforced,
                                    const AuthorizationSet& sw_enforced,
                                    const KeymasterContext& context) {
@@ -61,12 +65,14 @@ keymaster_error_t CheckVersionInfo(const AuthorizationSet& tee_enforced,
 }  // anonymous namespace
 
 AndroidKeymaster::AndroidKeymaster(KeymasterContext* context, size_t operation_table_size)
-    : context_(context), operation_table_(new(std::nothrow) OperationTable(operation_table_size)) {}
+    : context_(context), operation_table_(new(std::nothrow) OperationTable(operation_table_size)),
+      exported_key_cache_(new (std::nothrow) ExportedKeyCache(kExportedKeyCacheSize)) {}
 
 AndroidKeymaster::~AndroidKeymaster() {}
 
 AndroidKeymaster::AndroidKeymaster(AndroidKeymaster&& other)
-    : context_(move(other.context_)), operation_table_(move(other.operation_table_)) {}
+    : context_(move(other.context_)), operation_table_(move(other.operation_table_)),
+      exported_key_cache_(move(other.exported_key_cache_)) {}
 
 // TODO(swillden): Unify support analysis.  Right now, we have per-keytype methods that determine if
 // specific modes, padding, etc. are supported for that key type, and AndroidKeymaster also has
@@ -85,6 +91,7 @@ bool check_supported(const KeymasterContext& context, keymaster_algorithm_t algo
 }
 
 void AndroidKeymaster::GetVersion(const GetVersionRequest&, GetVersionResponse* rsp) {
+    AllocationScope scope(GET_VERSION);
     if (rsp == nullptr)
         return;
 
@@ -96,6 +103,7 @@ void AndroidKeymaster::GetVersion(const GetVersionRequest&, GetVersionResponse*
 
 void AndroidKeymaster::SupportedAlgorithms(const SupportedAlgorithmsRequest& /* request */,
                                            SupportedAlgorithmsResponse* response) {
+    AllocationScope scope(GET_SUPPORTED_ALGORITHMS);
     if (response == nullptr)
         return;
 
@@ -132,24 +140,28 @@ void GetSupported(const KeymasterContext& context, keymaster_algorithm_t algorit
 
 void AndroidKeymaster::SupportedBlockModes(const SupportedBlockModesRequest& request,
                                            SupportedBlockModesResponse* response) {
+    AllocationScope scope(GET_SUPPORTED_BLOCK_MODES);
     GetSupported(*context_, request.algorithm, request.purpose,
                  &OperationFactory::SupportedBlockModes, response);
 }
 
 void AndroidKeymaster::SupportedPaddingModes(const SupportedPaddingModesRequest& request,
                                              SupportedPaddingModesResponse* response) {
+    AllocationScope scope(GET_SUPPORTED_PADDING_MODES);
     GetSupported(*context_, request.algorithm, request.purpose,
                  &OperationFactory::SupportedPaddingModes, response);
 }
 
 void AndroidKeymaster::SupportedDigests(const SupportedDigestsRequest& request,
                                         SupportedDigestsResponse* response) {
+    AllocationScope scope(GET_SUPPORTED_DIGESTS);
     GetSupported(*context_, request.algorithm, request.purpose, &OperationFactory::SupportedDigests,
                  response);
 }
 
 void AndroidKeymaster::SupportedImportFormats(const SupportedImportFormatsRequest& request,
                                               SupportedImportFormatsResponse* response) {
+    AllocationScope scope(GET_SUPPORTED_IMPORT_FORMATS);
     if (response == nullptr || !check_supported(*context_, request.algorithm, response))
         return;
 
@@ -161,6 +173,7 @@ void AndroidKeymaster::SupportedImportFormats(const SupportedImportFormatsReques
 
 void AndroidKeymaster::SupportedExportFormats(const SupportedExportFormatsRequest& request,
                                               SupportedExportFormatsResponse* response) {
+    AllocationScope scope(GET_SUPPORTED_EXPORT_FORMATS);
     if (response == nullptr || !check_supported(*context_, request.algorithm, response))
         return;
 
@@ -171,6 +184,7 @@ void AndroidKeymaster::SupportedExportFormats(const SupportedExportFormatsReques
 }
 
 GetHmacSharingParametersResponse AndroidKeymaster::GetHmacSharingParameters() {
+    AllocationScope scope(GET_HMAC_SHARING_PARAMETERS);
     GetHmacSharingParametersResponse response;
     KeymasterEnforcement* policy = context_->enforcement_policy();
     if (!policy) {
@@ -184,6 +198,7 @@ GetHmacSharingParametersResponse AndroidKeymaster::GetHmacSharingParameters() {
 
 ComputeSharedHmacResponse
 AndroidKeymaster::ComputeSharedHmac(const ComputeSharedHmacRequest& request) {
+    AllocationScope scope(COMPUTE_SHARED_HMAC);
     ComputeSharedHmacResponse response;
     KeymasterEnforcement* policy = context_->enforcement_policy();
     if (!policy) {
@@ -197,6 +212,7 @@ AndroidKeymaster::ComputeSharedHmac(const ComputeSharedHmacRequest& request) {
 
 VerifyAuthorizationResponse
 AndroidKeymaster::VerifyAuthorization(const VerifyAuthorizationRequest& request) {
+    AllocationScope scope(VERIFY_AUTHORIZATION);
     KeymasterEnforcement* policy = context_->enforcement_policy();
     if (!policy) {
         VerifyAuthorizationResponse response;
@@ -209,12 +225,14 @@ AndroidKeymaster::VerifyAuthorization(const VerifyAuthorizationRequest& request)
 
 void AndroidKeymaster::AddRngEntropy(const AddEntropyRequest& request,
                                      AddEntropyResponse* response) {
+    AllocationScope scope(ADD_RNG_ENTROPY);
     response->error = context_->AddRngEntropy(request.random_data.peek_read(),
                                               request.random_data.available_read());
 }
 
 void AndroidKeymaster::GenerateKey(const GenerateKeyRequest& request,
                                    GenerateKeyResponse* response) {
+    AllocationScope scope(GENERATE_KEY);
     if (response == nullptr)
         return;
 
@@ -237,6 +255,7 @@ void AndroidKeymaster::GenerateKey(const GenerateKeyRequest& request,
 
 void AndroidKeymaster::GetKeyCharacteristics(const GetKeyCharacteristicsRequest& request,
                                              GetKeyCharacteristicsResponse* response) {
+    AllocationScope scope(GET_KEY_CHARACTERISTICS);
     if (response == nullptr)
         return;
 
@@ -256,6 +275,8 @@ void AndroidKeymaster::GetKeyCharacteristics(const GetKeyCharacteristicsRequest&
 
 void AndroidKeymaster::BeginOperation(const BeginOperationRequest& request,
                                       BeginOperationResponse* response) {
+    AllocationScope scope(BEGIN_OPERATION);
+    scope.set_purpose(request.purpose);
     if (response == nullptr)
         return;
     response->op_handle = 0;
@@ -301,6 +322,7 @@ void AndroidKeymaster::BeginOperation(const BeginOperationRequest& request,
 
 void AndroidKeymaster::UpdateOperation(const UpdateOperationRequest& request,
                                        UpdateOperationResponse* response) {
+    AllocationScope scope(UPDATE_OPERATION);
     if (response == nullptr)
         return;
 
@@ -308,6 +330,7 @@ void AndroidKeymaster::UpdateOperation(const UpdateOperationRequest& request,
     Operation* operation = operation_table_->Find(request.op_handle);
     if (operation == nullptr)
         return;
+    scope.set_purpose(operation->purpose());
 
     if (context_->enforcement_policy()) {
         response->error = context_->enforcement_policy()->AuthorizeOperation(
@@ -330,6 +353,7 @@ void AndroidKeymaster::UpdateOperation(const UpdateOperationRequest& request,
 
 void AndroidKeymaster::FinishOperation(const FinishOperationRequest& request,
                                        FinishOperationResponse* response) {
+    AllocationScope scope(FINISH_OPERATION);
     if (response == nullptr)
         return;
 
@@ -337,6 +361,7 @@ void AndroidKeymaster::FinishOperation(const FinishOperationRequest& request,
     Operation* operation = operation_table_->Find(request.op_handle);
     if (operation == nullptr)
         return;
+    scope.set_purpose(operation->purpose());
 
     if (context_->enforcement_policy()) {
         response->error = context_->enforcement_policy()->AuthorizeOperation(
@@ -355,6 +380,7 @@ void AndroidKeymaster::FinishOperation(const FinishOperationRequest& request,
 
 void AndroidKeymaster::AbortOperation(const AbortOperationRequest& request,
                                       AbortOperationResponse* response) {
+    AllocationScope scope(ABORT_OPERATION);
     if (!response)
         return;
 
@@ -363,31 +389,194 @@ void AndroidKeymaster::AbortOperation(const AbortOperationRequest& request,
         response->error = KM_ERROR_INVALID_OPERATION_HANDLE;
         return;
     }
+    scope.set_purpose(operation->purpose());
 
     response->error = operation->Abort();
     operation_table_->Delete(request.op_handle);
 }
 
+void AndroidKeymaster::CloneOperation(const CloneOperationRequest& request,
+                                      CloneOperationResponse* response) {
+    AllocationScope scope(CLONE_OPERATION);
+    if (!response)
+        return;
+    response->op_handle = 0;
+
+    response->error = KM_ERROR_INVALID_OPERATION_HANDLE;
+    const Operation* operation = operation_table_->Find(request.op_handle);
+    if (!operation)
+        return;
+    scope.set_purpose(operation->purpose());
+
+    OperationPtr clone = operation->Clone(&response->error);
+    if (!clone)
+        return;
+    clone->set_key_id(operation->key_id());
+
+    // The clone is authorized like a new operation on the key, so it's a use of the key.
+    if (context_->enforcement_policy()) {
+        response->error = context_->enforcement_policy()->AuthorizeOperation(
+            clone->purpose(), clone->key_id(), clone->authorizations(), request.additional_params,
+            0 /* op_handle */, true /* is_begin_operation */);
+        if (response->error != KM_ERROR_OK)
+            return;
+    }
+
+    response->op_handle = clone->operation_handle();
+    response->error = operation_table_->Add(move(clone));
+    if (response->error != KM_ERROR_OK)
+        response->op_handle = 0;
+}
+
+void AndroidKeymaster::BatchAeadOperation(const BatchAeadOperationRequest& request,
+                                          BatchAeadOperationResponse* response) {
+    AllocationScope scope(BATCH_AEAD_OPERATION);
+    scope.set_purpose(request.purpose);
+    if (!response)
+        return;
+
+    const KeyFactory* key_factory;
+    UniquePtr<Key> key;
+    response->error = LoadKey(request.key_blob, request.additional_params, &key_factory, &key);
+    if (response->error != KM_ERROR_OK)
+        return;
+
+    response->error = KM_ERROR_UNSUPPORTED_PURPOSE;
+    OperationFactory* factory = key_factory->GetOperationFactory(request.purpose);
+    if (!factory)
+        return;
+
+    OperationPtr operation(
+        factory->CreateOperation(move(*key), request.additional_params, &response->error));
+    if (!operation)
+        return;
+
+    if (context_->enforcement_policy()) {
+        // A batch has no operation handle for a per-operation auth token to name.
+        response->error = KM_ERROR_KEY_USER_NOT_AUTHENTICATED;
+        if (operation->authorizations().Contains(TAG_USER_SECURE_ID) &&
+            !operation->authorizations().Contains(TAG_AUTH_TIMEOUT))
+            return;
+
+        km_id_t key_id;
+        response->error = KM_ERROR_UNKNOWN_ERROR;
+        if (!context_->enforcement_policy()->CreateKeyId(request.key_blob, &key_id))
+            return;
+        operation->set_key_id(key_id);
+        response->error = context_->enforcement_policy()->AuthorizeOperation(
+            request.purpose, key_id, operation->authorizations(), request.additional_params,
+            0 /* op_handle */, true /* is_begin_operation */);
+        if (response->error != KM_ERROR_OK)
+            return;
+    }
+
+    response->error = operation->BeginAeadBatch();
+    if (response->error != KM_ERROR_OK)
+        return;
+
+    response->error = KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    if (!response->SetResultCount(request.record_count))
+        return;
+    for (size_t i = 0; i < request.record_count; ++i) {
+        const AeadRecord& record = request.records[i];
+        AeadRecordResult& result = response->results[i];
+        result.error = KM_ERROR_MEMORY_ALLOCATION_FAILED;
+        if (!result.nonce.Reset(record.nonce.data_length))
+            continue;
+        if (record.nonce.data_length)
+            memcpy(result.nonce.writable_data(), record.nonce.data, record.nonce.data_length);
+        result.error = operation->ProcessAeadRecord(&result.nonce, record.associated_data,
+                                                    record.input, &result.output);
+    }
+    response->error = KM_ERROR_OK;
+}
+
+void AndroidKeymaster::SealRecord(const ProcessRecordRequest& request,
+                                  ProcessRecordResponse* response) {
+    AllocationScope scope(SEAL_RECORD);
+    scope.set_purpose(KM_PURPOSE_ENCRYPT);
+    ProcessRecord(KM_PURPOSE_ENCRYPT, request, response);
+}
+
+void AndroidKeymaster::OpenRecord(const ProcessRecordRequest& request,
+                                  ProcessRecordResponse* response) {
+    AllocationScope scope(OPEN_RECORD);
+    scope.set_purpose(KM_PURPOSE_DECRYPT);
+    ProcessRecord(KM_PURPOSE_DECRYPT, request, response);
+}
+
+void AndroidKeymaster::ProcessRecord(keymaster_purpose_t purpose,
+                                     const ProcessRecordRequest& request,
+                                     ProcessRecordResponse* response) {
+    if (response == nullptr)
+        return;
+
+    response->error = KM_ERROR_INVALID_OPERATION_HANDLE;
+    Operation* operation = operation_table_->Find(request.op_handle);
+    if (operation == nullptr)
+        return;
+
+    if (operation->purpose() != purpose) {
+        response->error = KM_ERROR_INCOMPATIBLE_PURPOSE;
+        operation_table_->Delete(request.op_handle);
+        return;
+    }
+
+    if (context_->enforcement_policy()) {
+        response->error = context_->enforcement_policy()->AuthorizeOperation(
+            operation->purpose(), operation->key_id(), operation->authorizations(),
+            request.additional_params, request.op_handle, false /* is_begin_operation */);
+        if (response->error != KM_ERROR_OK) {
+            operation_table_->Delete(request.op_handle);
+            return;
+        }
+    }
+
+    response->error = operation->ProcessRecord(request.additional_params, request.input,
+                                               &response->sequence_number, &response->output);
+    if (response->error != KM_ERROR_OK) {
+        // Any error invalidates the operation, so a record that failed to open can't be retried
+        // under the same nonce.
+        operation_table_->Delete(request.op_handle);
+    }
+}
+
 void AndroidKeymaster::ExportKey(const ExportKeyRequest& request, ExportKeyResponse* response) {
+    AllocationScope scope(EXPORT_KEY);
     if (response == nullptr)
         return;
 
+    uint32_t os_version;
+    uint32_t os_patchlevel;
+    context_->GetSystemVersion(&os_version, &os_patchlevel);
+
+    UniquePtr<uint8_t[]> out_key;
+    size_t size;
+    if (exported_key_cache_.get() &&
+        exported_key_cache_->Find(request, os_version, os_patchlevel, &out_key, &size)) {
+        response->error = KM_ERROR_OK;
+        response->key_data = out_key.release();
+        response->key_data_length = size;
+        return;
+    }
+
     UniquePtr<Key> key;
     response->error =
         context_->ParseKeyBlob(KeymasterKeyBlob(request.key_blob), request.additional_params, &key);
     if (response->error != KM_ERROR_OK)
         return;
 
-    UniquePtr<uint8_t[]> out_key;
-    size_t size;
     response->error = key->formatted_key_material(request.key_format, &out_key, &size);
     if (response->error == KM_ERROR_OK) {
+        if (exported_key_cache_.get())
+            exported_key_cache_->Add(request, os_version, os_patchlevel, out_key.get(), size);
         response->key_data = out_key.release();
         response->key_data_length = size;
     }
 }
 
 void AndroidKeymaster::AttestKey(const AttestKeyRequest& request, AttestKeyResponse* response) {
+    AllocationScope scope(ATTEST_KEY);
     if (!response)
         return;
 
@@ -416,6 +605,7 @@ void AndroidKeymaster::AttestKey(const AttestKeyRequest& request, AttestKeyRespo
 }
 
 void AndroidKeymaster::UpgradeKey(const UpgradeKeyRequest& request, UpgradeKeyResponse* response) {
+    AllocationScope scope(UPGRADE_KEY);
     if (!response)
         return;
 
@@ -428,6 +618,7 @@ void AndroidKeymaster::UpgradeKey(const UpgradeKeyRequest& request, UpgradeKeyRe
 }
 
 void AndroidKeymaster::ImportKey(const ImportKeyRequest& request, ImportKeyResponse* response) {
+    AllocationScope scope(IMPORT_KEY);
     if (response == nullptr)
         return;
 
@@ -449,18 +640,25 @@ void AndroidKeymaster::ImportKey(const ImportKeyRequest& request, ImportKeyRespo
 }
 
 void AndroidKeymaster::DeleteKey(const DeleteKeyRequest& request, DeleteKeyResponse* response) {
+    AllocationScope scope(DELETE_KEY);
     if (!response)
         return;
+    if (exported_key_cache_.get())
+        exported_key_cache_->Clear();
     response->error = context_->DeleteKey(KeymasterKeyBlob(request.key_blob));
 }
 
 void AndroidKeymaster::DeleteAllKeys(const DeleteAllKeysRequest&, DeleteAllKeysResponse* response) {
+    AllocationScope scope(DELETE_ALL_KEYS);
     if (!response)
         return;
+    if (exported_key_cache_.get())
+        exported_key_cache_->Clear();
     response->error = context_->DeleteAllKeys();
 }
 
 void AndroidKeymaster::Configure(const ConfigureRequest& request, ConfigureResponse* response) {
+    AllocationScope scope(CONFIGURE);
     if (!response)
         return;
     response->error = context_->SetSystemVersion(request.os_version, request.os_patchlevel);
@@ -484,6 +682,7 @@ keymaster_error_t AndroidKeymaster::LoadKey(const keymaster_key_blob_t& key_blob
 
 void AndroidKeymaster::ImportWrappedKey(const ImportWrappedKeyRequest& request,
                                         ImportWrappedKeyResponse* response) {
+    AllocationScope scope(IMPORT_WRAPPED_KEY);
     if (!response) return;
 
     KeymasterKeyBlob secret_key;
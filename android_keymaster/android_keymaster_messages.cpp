@@ -310,6 +310,160 @@ bool FinishOperationResponse::NonErrorDeserialize(const uint8_t** buf_ptr, const
     return retval;
 }
 
+size_t CloneOperationRequest::SerializedSize() const {
+    return sizeof(op_handle) + additional_params.SerializedSize();
+}
+
+uint8_t* CloneOperationRequest::Serialize(uint8_t* buf, const uint8_t* end) const {
+    buf = append_uint64_to_buf(buf, end, op_handle);
+    return additional_params.Serialize(buf, end);
+}
+
+bool CloneOperationRequest::Deserialize(const uint8_t** buf_ptr, const uint8_t* end) {
+    return copy_uint64_from_buf(buf_ptr, end, &op_handle) &&
+           additional_params.Deserialize(buf_ptr, end);
+}
+
+// Record arrays are serialized as a count followed by the records.  Every record or result holds at
+// least three 32-bit length or error fields, which bounds the count a buffer can hold.
+static const size_t kMinAeadRecordSize = 3 * sizeof(uint32_t);
+
+template <typename T> static size_t record_array_size(const T* records, size_t count) {
+    size_t size = sizeof(uint32_t);
+    for (size_t i = 0; i < count; ++i)
+        size += records[i].SerializedSize();
+    return size;
+}
+
+template <typename T>
+static uint8_t* serialize_record_array(const T* records, size_t count, uint8_t* buf,
+                                       const uint8_t* end) {
+    buf = append_uint32_to_buf(buf, end, count);
+    for (size_t i = 0; i < count; ++i)
+        buf = records[i].Serialize(buf, end);
+    return buf;
+}
+
+template <typename T>
+static bool deserialize_record_array(const uint8_t** buf_ptr, const uint8_t* end,
+                                     UniquePtr<T[]>* records, size_t* count) {
+    records->reset();
+    *count = 0;
+    size_t new_count;
+    if (!copy_uint32_from_buf(buf_ptr, end, &new_count) ||
+        new_count > static_cast<size_t>(end - *buf_ptr) / kMinAeadRecordSize)
+        return false;
+
+    records->reset(new (std::nothrow) T[new_count]);
+    if (!records->get())
+        return false;
+    *count = new_count;
+    for (size_t i = 0; i < new_count; ++i)
+        if (!(*records)[i].Deserialize(buf_ptr, end))
+            return false;
+    return true;
+}
+
+size_t AeadRecord::SerializedSize() const {
+    return nonce.SerializedSize() + associated_data.SerializedSize() + input.SerializedSize();
+}
+
+uint8_t* AeadRecord::Serialize(uint8_t* buf, const uint8_t* end) const {
+    buf = nonce.Serialize(buf, end);
+    buf = associated_data.Serialize(buf, end);
+    return input.Serialize(buf, end);
+}
+
+bool AeadRecord::Deserialize(const uint8_t** buf_ptr, const uint8_t* end) {
+    return nonce.Deserialize(buf_ptr, end) && associated_data.Deserialize(buf_ptr, end) &&
+           input.Deserialize(buf_ptr, end);
+}
+
+size_t AeadRecordResult::SerializedSize() const {
+    return sizeof(uint32_t) + nonce.SerializedSize() + output.SerializedSize();
+}
+
+uint8_t* AeadRecordResult::Serialize(uint8_t* buf, const uint8_t* end) const {
+    buf = append_uint32_to_buf(buf, end, error);
+    buf = nonce.Serialize(buf, end);
+    return output.Serialize(buf, end);
+}
+
+bool AeadRecordResult::Deserialize(const uint8_t** buf_ptr, const uint8_t* end) {
+    return copy_uint32_from_buf(buf_ptr, end, &error) && nonce.Deserialize(buf_ptr, end) &&
+           output.Deserialize(buf_ptr, end);
+}
+
+bool BatchAeadOperationRequest::SetRecordCount(size_t count) {
+    records.reset(new (std::nothrow) AeadRecord[count]);
+    record_count = records.get() ? count : 0;
+    return records.get() != nullptr;
+}
+
+size_t BatchAeadOperationRequest::SerializedSize() const {
+    return sizeof(uint32_t) /* purpose */ + key_blob.SerializedSize() +
+           additional_params.SerializedSize() + record_array_size(records.get(), record_count);
+}
+
+uint8_t* BatchAeadOperationRequest::Serialize(uint8_t* buf, const uint8_t* end) const {
+    buf = append_uint32_to_buf(buf, end, purpose);
+    buf = key_blob.Serialize(buf, end);
+    buf = additional_params.Serialize(buf, end);
+    return serialize_record_array(records.get(), record_count, buf, end);
+}
+
+bool BatchAeadOperationRequest::Deserialize(const uint8_t** buf_ptr, const uint8_t* end) {
+    return copy_uint32_from_buf(buf_ptr, end, &purpose) && key_blob.Deserialize(buf_ptr, end) &&
+           additional_params.Deserialize(buf_ptr, end) &&
+           deserialize_record_array(buf_ptr, end, &records, &record_count);
+}
+
+bool BatchAeadOperationResponse::SetResultCount(size_t count) {
+    results.reset(new (std::nothrow) AeadRecordResult[count]);
+    result_count = results.get() ? count : 0;
+    return results.get() != nullptr;
+}
+
+size_t BatchAeadOperationResponse::NonErrorSerializedSize() const {
+    return record_array_size(results.get(), result_count);
+}
+
+uint8_t* BatchAeadOperationResponse::NonErrorSerialize(uint8_t* buf, const uint8_t* end) const {
+    return serialize_record_array(results.get(), result_count, buf, end);
+}
+
+bool BatchAeadOperationResponse::NonErrorDeserialize(const uint8_t** buf_ptr, const uint8_t* end) {
+    return deserialize_record_array(buf_ptr, end, &results, &result_count);
+}
+
+size_t ProcessRecordRequest::SerializedSize() const {
+    return sizeof(op_handle) + input.SerializedSize() + additional_params.SerializedSize();
+}
+
+uint8_t* ProcessRecordRequest::Serialize(uint8_t* buf, const uint8_t* end) const {
+    buf = append_uint64_to_buf(buf, end, op_handle);
+    buf = input.Serialize(buf, end);
+    return additional_params.Serialize(buf, end);
+}
+
+bool ProcessRecordRequest::Deserialize(const uint8_t** buf_ptr, const uint8_t* end) {
+    return copy_uint64_from_buf(buf_ptr, end, &op_handle) && input.Deserialize(buf_ptr, end) &&
+           additional_params.Deserialize(buf_ptr, end);
+}
+
+size_t ProcessRecordResponse::NonErrorSerializedSize() const {
+    return sizeof(sequence_number) + output.SerializedSize();
+}
+
+uint8_t* ProcessRecordResponse::NonErrorSerialize(uint8_t* buf, const uint8_t* end) const {
+    buf = append_uint64_to_buf(buf, end, sequence_number);
+    return output.Serialize(buf, end);
+}
+
+bool ProcessRecordResponse::NonErrorDeserialize(const uint8_t** buf_ptr, const uint8_t* end) {
+    return copy_uint64_from_buf(buf_ptr, end, &sequence_number) && output.Deserialize(buf_ptr, end);
+}
+
 size_t AddEntropyRequest::SerializedSize() const {
     return random_data.SerializedSize();
 }
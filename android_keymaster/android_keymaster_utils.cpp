@@ -15,6 +15,7 @@
  */
 
 #include <keymaster/android_keymaster_utils.h>
+#include <keymaster/keymaster_tags.h>
 
 #include <keymaster/new>
 
@@ -68,6 +69,11 @@ keymaster_error_t EcKeySizeToCurve(uint32_t key_size_bits, keymaster_ec_curve_t*
 }
 
 keymaster_error_t EcCurveToKeySize(keymaster_ec_curve_t curve, uint32_t* key_size_bits) {
+    if (curve == KM_EC_CURVE_CURVE_25519) {
+        *key_size_bits = 256;
+        return KM_ERROR_OK;
+    }
+
     switch (curve) {
     default:
         return KM_ERROR_UNSUPPORTED_EC_CURVE;
@@ -33,6 +33,90 @@ static inline bool is_blob_tag(keymaster_tag_t tag) {
 }
 
 const size_t STARTING_ELEMS_CAPACITY = 8;
+const size_t STARTING_INTERNER_BUCKETS = 16;
+
+/**
+ * The storage behind shared AuthorizationSets.  \p set owns the elements and is never modified;
+ * the sets sharing it are borrowed views of it.
+ */
+struct SharedAuthorizationSet {
+    AuthorizationSet set;
+    uint32_t hash;
+    uint32_t refcount;
+    SharedAuthorizationSet* next;  // The next entry in the interner's bucket.
+};
+
+// keymaster_param_compare is inline, so these sort without a call per comparison, unlike qsort.
+static bool is_sorted(const keymaster_key_param_t* elems, size_t count) {
+    for (size_t i = 1; i < count; ++i) {
+        if (keymaster_param_compare(elems + i - 1, elems + i) > 0)
+            return false;
+    }
+    return true;
+}
+
+static void sift_down(keymaster_key_param_t* elems, size_t root, size_t count) {
+    for (;;) {
+        size_t child = 2 * root + 1;
+        if (child >= count)
+            return;
+        if (child + 1 < count && keymaster_param_compare(elems + child, elems + child + 1) < 0)
+            ++child;
+        if (keymaster_param_compare(elems + root, elems + child) >= 0)
+            return;
+        keymaster_key_param_t tmp = elems[root];
+        elems[root] = elems[child];
+        elems[child] = tmp;
+        root = child;
+    }
+}
+
+// Heapsort, which needs no extra memory.
+static void sort_params(keymaster_key_param_t* elems, size_t count) {
+    if (count < 2)
+        return;
+    for (size_t i = count / 2; i-- > 0;)
+        sift_down(elems, i, count);
+    for (size_t last = count - 1; last > 0; --last) {
+        keymaster_key_param_t tmp = elems[0];
+        elems[0] = elems[last];
+        elems[last] = tmp;
+        sift_down(elems, 0, last);
+    }
+}
+
+/**
+ * The elements of a caller's set in sorted order: the caller's own array if it is already sorted,
+ * otherwise a sorted copy of it.  get() returns null if the copy couldn't be allocated.
+ */
+class SortedParams {
+  public:
+    explicit SortedParams(const keymaster_key_param_set_t& set) : params_(set.params) {
+        if (is_sorted(set.params, set.length))
+            return;
+        copy_.reset(new (std::nothrow) keymaster_key_param_t[set.length]);
+        params_ = copy_.get();
+        if (!params_)
+            return;
+        memcpy(copy_.get(), set.params, sizeof(*set.params) * set.length);
+        sort_params(copy_.get(), set.length);
+    }
+
+    const keymaster_key_param_t* get() const { return params_; }
+
+  private:
+    const keymaster_key_param_t* params_;
+    UniquePtr<keymaster_key_param_t[]> copy_;
+};
+
+static void add_ref(SharedAuthorizationSet* shared) {
+    __atomic_fetch_add(&shared->refcount, 1, __ATOMIC_RELAXED);
+}
+
+static void release(SharedAuthorizationSet* shared) {
+    if (__atomic_sub_fetch(&shared->refcount, 1, __ATOMIC_ACQ_REL) == 0)
+        delete shared;
+}
 
 AuthorizationSet::AuthorizationSet(AuthorizationSetBuilder& builder) {
     elems_ = builder.set.elems_;
@@ -55,6 +139,9 @@ AuthorizationSet::AuthorizationSet(AuthorizationSetBuilder& builder) {
 
     error_ = builder.set.error_;
     builder.set.error_ = OK;
+
+    elems_exposed_ = builder.set.elems_exposed_;
+    builder.set.elems_exposed_ = false;
 }
 
 AuthorizationSet::~AuthorizationSet() {
@@ -62,7 +149,7 @@ AuthorizationSet::~AuthorizationSet() {
 }
 
 bool AuthorizationSet::reserve_elems(size_t count) {
-    if (is_valid() != OK)
+    if (is_valid() != OK || !CopyBorrowedData())
         return false;
 
     if (count > elems_capacity_) {
@@ -75,12 +162,14 @@ bool AuthorizationSet::reserve_elems(size_t count) {
         delete[] elems_;
         elems_ = new_elems;
         elems_capacity_ = count;
+        // References into the old array are no longer valid, so nothing can be written through them.
+        elems_exposed_ = false;
     }
     return true;
 }
 
 bool AuthorizationSet::reserve_indirect(size_t length) {
-    if (is_valid() != OK)
+    if (is_valid() != OK || !CopyBorrowedData())
         return false;
 
     if (length > indirect_data_capacity_) {
@@ -111,6 +200,12 @@ void AuthorizationSet::MoveFrom(AuthorizationSet& set) {
     indirect_data_size_ = set.indirect_data_size_;
     indirect_data_capacity_ = set.indirect_data_capacity_;
     error_ = set.error_;
+    borrowed_ = set.borrowed_;
+    shared_ = set.shared_;
+    elems_serialized_size_ = set.elems_serialized_size_;
+    elems_serialized_size_valid_ = set.elems_serialized_size_valid_;
+    deduplicated_ = set.deduplicated_;
+    elems_exposed_ = set.elems_exposed_;
     set.elems_ = nullptr;
     set.elems_size_ = 0;
     set.elems_capacity_ = 0;
@@ -118,6 +213,11 @@ void AuthorizationSet::MoveFrom(AuthorizationSet& set) {
     set.indirect_data_size_ = 0;
     set.indirect_data_capacity_ = 0;
     set.error_ = OK;
+    set.borrowed_ = false;
+    set.shared_ = nullptr;
+    set.elems_serialized_size_valid_ = false;
+    set.deduplicated_ = false;
+    set.elems_exposed_ = false;
 }
 
 bool AuthorizationSet::Reinitialize(const keymaster_key_param_t* elems, const size_t count) {
@@ -141,50 +241,129 @@ bool AuthorizationSet::Reinitialize(const keymaster_key_param_t* elems, const si
     return true;
 }
 
+void AuthorizationSet::ReinitializeBorrowed(const keymaster_key_param_t* elems, size_t count) {
+    FreeData();
+
+    if (elems == nullptr || count == 0)
+        return;
+
+    elems_ = const_cast<keymaster_key_param_t*>(elems);
+    elems_size_ = count;
+    indirect_data_size_ = ComputeIndirectDataSize(elems, count);
+    borrowed_ = true;
+}
+
+void AuthorizationSet::ShareFrom(const AuthorizationSet& set) {
+    ShareFrom(set.shared_);
+}
+
+void AuthorizationSet::ShareFrom(SharedAuthorizationSet* shared) {
+    // Take the new reference first, in case FreeData drops the last one to the same storage.
+    add_ref(shared);
+    FreeData();
+
+    elems_ = shared->set.elems_;
+    elems_size_ = shared->set.elems_size_;
+    indirect_data_size_ = shared->set.indirect_data_size_;
+    borrowed_ = true;
+    shared_ = shared;
+}
+
+bool AuthorizationSet::CopyBorrowedData() {
+    if (!borrowed_)
+        return true;
+
+    const keymaster_key_param_t* borrowed_elems = elems_;
+    size_t borrowed_count = elems_size_;
+    SharedAuthorizationSet* shared = shared_;
+    elems_ = nullptr;
+    elems_size_ = 0;
+    indirect_data_size_ = 0;
+    borrowed_ = false;
+    shared_ = nullptr;
+    bool result = Reinitialize(borrowed_elems, borrowed_count);
+    if (shared)
+        release(shared);
+    return result;
+}
+
 void AuthorizationSet::set_invalid(Error error) {
     FreeData();
     error_ = error;
 }
 
 void AuthorizationSet::Sort() {
-    qsort(elems_, elems_size_, sizeof(*elems_),
-          reinterpret_cast<int (*)(const void*, const void*)>(keymaster_param_compare));
+    if (!CopyBorrowedData())
+        return;
+    if (!is_sorted(elems_, elems_size_))
+        sort_params(elems_, elems_size_);
 }
 
 void AuthorizationSet::Deduplicate() {
-    Sort();
-
-    size_t invalid_count = 0;
-    for (size_t i = 1; i < size(); ++i) {
-        if (elems_[i - 1].tag == KM_TAG_INVALID)
-            ++invalid_count;
-        else if (keymaster_param_compare(elems_ + i - 1, elems_ + i) == 0) {
-            // Mark dups as invalid.  Note that this "leaks" the data referenced by KM_BYTES and
-            // KM_BIGNUM entries, but those are just pointers into indirect_data_, so it will all
-            // get cleaned up.
-            elems_[i - 1].tag = KM_TAG_INVALID;
-            ++invalid_count;
-        }
-    }
-    if (size() > 0 && elems_[size() - 1].tag == KM_TAG_INVALID)
-        ++invalid_count;
-
-    if (invalid_count == 0)
+    if (deduplicated_ && !elems_exposed_)
         return;
 
     Sort();
+    if (is_valid() != OK)
+        return;
 
-    // Since KM_TAG_INVALID == 0, all of the invalid entries are first.
-    elems_size_ -= invalid_count;
-    memmove(elems_, elems_ + invalid_count, size() * sizeof(*elems_));
+    // Since KM_TAG_INVALID == 0, any invalid entries are first.  Drop them along with the dups.
+    size_t kept = 0;
+    for (size_t i = 0; i < elems_size_; ++i) {
+        if (elems_[i].tag == KM_TAG_INVALID ||
+            (kept > 0 && keymaster_param_compare(elems_ + kept - 1, elems_ + i) == 0))
+            continue;
+        elems_[kept++] = elems_[i];
+    }
+    elems_size_ = kept;
+    elems_serialized_size_valid_ = false;
+    deduplicated_ = true;
 }
 
 void AuthorizationSet::Union(const keymaster_key_param_set_t& set) {
     if (set.length == 0)
         return;
 
-    push_back(set);
     Deduplicate();
+    SortedParams other(set);
+    if (is_valid() != OK)
+        return;
+    if (!other.get()) {
+        set_invalid(ALLOCATION_FAILURE);
+        return;
+    }
+
+    // Merge the two sorted lists into a new set, skipping dups as they come.
+    AuthorizationSet result;
+    if (!result.reserve_elems(elems_size_ + set.length) ||
+        !result.reserve_indirect(indirect_data_size_ +
+                                 ComputeIndirectDataSize(set.params, set.length))) {
+        set_invalid(ALLOCATION_FAILURE);
+        return;
+    }
+    result.deduplicated_ = true;
+
+    const keymaster_key_param_t* mine = elems_;
+    const keymaster_key_param_t* mine_end = elems_ + elems_size_;
+    const keymaster_key_param_t* theirs = other.get();
+    const keymaster_key_param_t* theirs_end = theirs + set.length;
+    while (mine != mine_end || theirs != theirs_end) {
+        const keymaster_key_param_t* next;
+        if (theirs == theirs_end ||
+            (mine != mine_end && keymaster_param_compare(mine, theirs) <= 0))
+            next = mine++;
+        else
+            next = theirs++;
+
+        if (next->tag == KM_TAG_INVALID ||
+            (result.elems_size_ > 0 &&
+             keymaster_param_compare(result.elems_ + result.elems_size_ - 1, next) == 0))
+            continue;
+        result.push_back(*next);
+    }
+
+    FreeData();
+    MoveFrom(result);
 }
 
 void AuthorizationSet::Difference(const keymaster_key_param_set_t& set) {
@@ -192,16 +371,29 @@ void AuthorizationSet::Difference(const keymaster_key_param_set_t& set) {
         return;
 
     Deduplicate();
+    SortedParams other(set);
+    if (is_valid() != OK || !CopyBorrowedData())
+        return;
+    if (!other.get()) {
+        set_invalid(ALLOCATION_FAILURE);
+        return;
+    }
 
-    for (size_t i = 0; i < set.length; i++) {
-        int index = -1;
-        do {
-            index = find(set.params[i].tag, index);
-            if (index != -1 && keymaster_param_compare(&elems_[index], &set.params[i]) == 0) {
-                erase(index);
-                break;
-            }
-        } while (index != -1);
+    // Walk the two sorted lists together.  As with erase(), the data of removed blobs stays in
+    // indirect_data_ until the set is freed.
+    const keymaster_key_param_t* theirs = other.get();
+    const keymaster_key_param_t* theirs_end = theirs + set.length;
+    size_t kept = 0;
+    for (size_t i = 0; i < elems_size_; ++i) {
+        while (theirs != theirs_end && keymaster_param_compare(theirs, elems_ + i) < 0)
+            ++theirs;
+        if (theirs != theirs_end && keymaster_param_compare(theirs, elems_ + i) == 0)
+            continue;
+        elems_[kept++] = elems_[i];
+    }
+    if (kept != elems_size_) {
+        elems_size_ = kept;
+        elems_serialized_size_valid_ = false;
     }
 }
 
@@ -240,8 +432,9 @@ int AuthorizationSet::find(keymaster_tag_t tag, int begin) const {
 }
 
 bool AuthorizationSet::erase(int index) {
-    if (index < 0 || index >= static_cast<int>(size()))
+    if (index < 0 || index >= static_cast<int>(size()) || !CopyBorrowedData())
         return false;
+    elems_serialized_size_valid_ = false;
 
     --elems_size_;
     for (size_t i = index; i < elems_size_; ++i)
@@ -251,7 +444,12 @@ bool AuthorizationSet::erase(int index) {
 
 keymaster_key_param_t empty_param = {KM_TAG_INVALID, {}};
 keymaster_key_param_t& AuthorizationSet::operator[](int at) {
-    if (is_valid() == OK && at < (int)elems_size_) {
+    if (CopyBorrowedData() && is_valid() == OK && at < (int)elems_size_) {
+        // The caller may change the element, now or at any time until the elements are freed or
+        // moved, so nothing about them can be cached until then.
+        elems_exposed_ = true;
+        elems_serialized_size_valid_ = false;
+        deduplicated_ = false;
         return elems_[at];
     }
     empty_param = {KM_TAG_INVALID, {}};
@@ -284,7 +482,7 @@ bool AuthorizationSet::push_back(const keymaster_key_param_set_t& set) {
 }
 
 bool AuthorizationSet::push_back(keymaster_key_param_t elem) {
-    if (is_valid() != OK)
+    if (is_valid() != OK || !CopyBorrowedData())
         return false;
 
     if (elems_size_ >= elems_capacity_)
@@ -301,7 +499,11 @@ bool AuthorizationSet::push_back(keymaster_key_param_t elem) {
         indirect_data_size_ += elem.blob.data_length;
     }
 
+    if (deduplicated_ && elems_size_ > 0 &&
+        keymaster_param_compare(elems_ + elems_size_ - 1, &elem) >= 0)
+        deduplicated_ = false;
     elems_[elems_size_++] = elem;
+    elems_serialized_size_valid_ = false;
     return true;
 }
 
@@ -329,7 +531,7 @@ static size_t serialized_size(const keymaster_key_param_t& param) {
 }
 
 static uint8_t* serialize(const keymaster_key_param_t& param, uint8_t* buf, const uint8_t* end,
-                          const uint8_t* indirect_base) {
+                          uint32_t indirect_offset) {
     buf = append_uint32_to_buf(buf, end, param.tag);
     switch (keymaster_tag_get_type(param.tag)) {
     case KM_INVALID:
@@ -357,7 +559,7 @@ static uint8_t* serialize(const keymaster_key_param_t& param, uint8_t* buf, cons
     case KM_BIGNUM:
     case KM_BYTES:
         buf = append_uint32_to_buf(buf, end, param.blob.data_length);
-        buf = append_uint32_to_buf(buf, end, param.blob.data - indirect_base);
+        buf = append_uint32_to_buf(buf, end, indirect_offset);
         break;
     }
     return buf;
@@ -415,10 +617,15 @@ static bool deserialize(keymaster_key_param_t* param, const uint8_t** buf_ptr, c
 }
 
 size_t AuthorizationSet::SerializedSizeOfElements() const {
+    if (elems_serialized_size_valid_ && !elems_exposed_)
+        return elems_serialized_size_;
+
     size_t size = 0;
     for (size_t i = 0; i < elems_size_; ++i) {
         size += serialized_size(elems_[i]);
     }
+    elems_serialized_size_ = size;
+    elems_serialized_size_valid_ = true;
     return size;
 }
 
@@ -431,11 +638,37 @@ size_t AuthorizationSet::SerializedSize() const {
 }
 
 uint8_t* AuthorizationSet::Serialize(uint8_t* buf, const uint8_t* end) const {
+    if (borrowed_)
+        return SerializeBorrowed(buf, end);
+
     buf = append_size_and_data_to_buf(buf, end, indirect_data_, indirect_data_size_);
     buf = append_uint32_to_buf(buf, end, elems_size_);
     buf = append_uint32_to_buf(buf, end, SerializedSizeOfElements());
     for (size_t i = 0; i < elems_size_; ++i) {
-        buf = serialize(elems_[i], buf, end, indirect_data_);
+        uint32_t offset = 0;
+        if (is_blob_tag(elems_[i].tag))
+            offset = elems_[i].blob.data - indirect_data_;
+        buf = serialize(elems_[i], buf, end, offset);
+    }
+    return buf;
+}
+
+uint8_t* AuthorizationSet::SerializeBorrowed(uint8_t* buf, const uint8_t* end) const {
+    // A borrowed set's blobs are scattered through the caller's memory, so emit them back to back
+    // in element order, producing the same encoding a copy of the set would.
+    buf = append_uint32_to_buf(buf, end, indirect_data_size_);
+    for (size_t i = 0; i < elems_size_; ++i) {
+        if (is_blob_tag(elems_[i].tag))
+            buf = append_to_buf(buf, end, elems_[i].blob.data, elems_[i].blob.data_length);
+    }
+
+    buf = append_uint32_to_buf(buf, end, elems_size_);
+    buf = append_uint32_to_buf(buf, end, SerializedSizeOfElements());
+    uint32_t offset = 0;
+    for (size_t i = 0; i < elems_size_; ++i) {
+        buf = serialize(elems_[i], buf, end, offset);
+        if (is_blob_tag(elems_[i].tag))
+            offset += elems_[i].blob.data_length;
     }
     return buf;
 }
@@ -493,6 +726,9 @@ bool AuthorizationSet::DeserializeElementsData(const uint8_t** buf_ptr, const ui
     }
 
     elems_size_ = elements_count;
+    // The size of the elements has just been checked, so it needn't be worked out again.
+    elems_serialized_size_ = elements_size;
+    elems_serialized_size_valid_ = true;
     return true;
 }
 
@@ -511,6 +747,21 @@ bool AuthorizationSet::Deserialize(const uint8_t** buf_ptr, const uint8_t* end)
 }
 
 void AuthorizationSet::Clear() {
+    elems_serialized_size_valid_ = false;
+    deduplicated_ = false;
+    if (borrowed_) {
+        // The elements and their data belong to the caller or to the shared storage; just drop
+        // the view.
+        if (shared_)
+            release(shared_);
+        elems_ = nullptr;
+        elems_size_ = 0;
+        indirect_data_size_ = 0;
+        borrowed_ = false;
+        shared_ = nullptr;
+        error_ = OK;
+        return;
+    }
     memset_s(elems_, 0, elems_size_ * sizeof(keymaster_key_param_t));
     memset_s(indirect_data_, 0, indirect_data_size_);
     elems_size_ = 0;
@@ -528,6 +779,7 @@ void AuthorizationSet::FreeData() {
     indirect_data_ = nullptr;
     elems_capacity_ = 0;
     indirect_data_capacity_ = 0;
+    elems_exposed_ = false;
     error_ = OK;
 }
 
@@ -678,4 +930,146 @@ bool AuthorizationSet::ContainsIntValue(keymaster_tag_t tag, uint32_t value) con
     return false;
 }
 
+// FNV-1a, which is plenty for spreading sets across the interner's buckets.
+static uint32_t hash_bytes(uint32_t hash, const void* data, size_t length) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < length; ++i)
+        hash = (hash ^ bytes[i]) * 16777619U;
+    return hash;
+}
+
+static uint32_t hash_params(const keymaster_key_param_t* elems, size_t count) {
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < count; ++i) {
+        const keymaster_key_param_t& param = elems[i];
+        hash = hash_bytes(hash, &param.tag, sizeof(param.tag));
+        switch (keymaster_tag_get_type(param.tag)) {
+        case KM_INVALID:
+            break;
+        case KM_ENUM:
+        case KM_ENUM_REP:
+        case KM_UINT:
+        case KM_UINT_REP:
+            hash = hash_bytes(hash, &param.integer, sizeof(param.integer));
+            break;
+        case KM_ULONG:
+        case KM_ULONG_REP:
+        case KM_DATE:
+            hash = hash_bytes(hash, &param.long_integer, sizeof(param.long_integer));
+            break;
+        case KM_BOOL:
+            hash = hash_bytes(hash, &param.boolean, sizeof(param.boolean));
+            break;
+        case KM_BIGNUM:
+        case KM_BYTES:
+            hash = hash_bytes(hash, &param.blob.data_length, sizeof(param.blob.data_length));
+            hash = hash_bytes(hash, param.blob.data, param.blob.data_length);
+            break;
+        }
+    }
+    return hash;
+}
+
+static bool params_equal(const AuthorizationSet& a, const AuthorizationSet& b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        // keymaster_param_compare ignores the values of bools.
+        if (keymaster_param_compare(a.data() + i, b.data() + i) != 0 ||
+            (keymaster_tag_get_type(a[i].tag) == KM_BOOL && a[i].boolean != b[i].boolean))
+            return false;
+    }
+    return true;
+}
+
+AuthorizationSetInterner::~AuthorizationSetInterner() {
+    for (size_t i = 0; i < bucket_count_; ++i) {
+        SharedAuthorizationSet* entry = buckets_[i];
+        while (entry) {
+            SharedAuthorizationSet* next = entry->next;
+            release(entry);
+            entry = next;
+        }
+    }
+    delete[] buckets_;
+}
+
+bool AuthorizationSetInterner::Intern(AuthorizationSet* set) {
+    if (!set || set->is_valid() != AuthorizationSet::OK)
+        return false;
+
+    uint32_t hash = hash_params(set->data(), set->size());
+    SharedAuthorizationSet* entry = bucket_count_ ? buckets_[hash & (bucket_count_ - 1)] : nullptr;
+    for (; entry; entry = entry->next) {
+        if (entry->hash == hash && params_equal(entry->set, *set)) {
+            if (set->shared_ != entry)
+                set->ShareFrom(entry);
+            return true;
+        }
+    }
+
+    if (size_ >= bucket_count_ && !Grow())
+        return false;
+
+    UniquePtr<SharedAuthorizationSet> shared(new (std::nothrow) SharedAuthorizationSet);
+    if (!shared.get() || !shared->set.Reinitialize(*set))
+        return false;
+    shared->hash = hash;
+    shared->refcount = 1;  // The interner's reference.
+
+    size_t bucket = hash & (bucket_count_ - 1);
+    shared->next = buckets_[bucket];
+    buckets_[bucket] = shared.release();
+    ++size_;
+    set->ShareFrom(buckets_[bucket]);
+    return true;
+}
+
+void AuthorizationSetInterner::Purge() {
+    for (size_t i = 0; i < bucket_count_; ++i) {
+        SharedAuthorizationSet** link = &buckets_[i];
+        while (*link) {
+            SharedAuthorizationSet* entry = *link;
+            // If only the interner refers to the entry, no other thread can take a reference to it
+            // while it's released.
+            if (__atomic_load_n(&entry->refcount, __ATOMIC_ACQUIRE) == 1) {
+                *link = entry->next;
+                release(entry);
+                --size_;
+            } else {
+                link = &entry->next;
+            }
+        }
+    }
+}
+
+bool AuthorizationSetInterner::Grow() {
+    // Growing is a good time to see whether the table needs to be any bigger at all.
+    Purge();
+    if (size_ < bucket_count_)
+        return true;
+
+    size_t new_count = bucket_count_ ? bucket_count_ * 2 : STARTING_INTERNER_BUCKETS;
+    SharedAuthorizationSet** new_buckets = new (std::nothrow) SharedAuthorizationSet*[new_count];
+    if (new_buckets == nullptr)
+        return false;
+    for (size_t i = 0; i < new_count; ++i)
+        new_buckets[i] = nullptr;
+
+    for (size_t i = 0; i < bucket_count_; ++i) {
+        SharedAuthorizationSet* entry = buckets_[i];
+        while (entry) {
+            SharedAuthorizationSet* next = entry->next;
+            size_t bucket = entry->hash & (new_count - 1);
+            entry->next = new_buckets[bucket];
+            new_buckets[bucket] = entry;
+            entry = next;
+        }
+    }
+    delete[] buckets_;
+    buckets_ = new_buckets;
+    bucket_count_ = new_count;
+    return true;
+}
+
 }  // namespace keymaster
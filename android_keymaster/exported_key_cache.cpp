@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <keymaster/exported_key_cache.h>
+
+#include <keymaster/android_keymaster_messages.h>
+
+#include <keymaster/new>
+
+namespace keymaster {
+
+bool ExportedKeyCache::Matches(const Entry& entry, const ExportKeyRequest& request,
+                               uint32_t os_version, uint32_t os_patchlevel) const {
+    if (!entry.key_blob.key_material || entry.key_format != request.key_format ||
+        entry.os_version != os_version || entry.os_patchlevel != os_patchlevel ||
+        entry.key_blob.key_material_size != request.key_blob.key_material_size ||
+        entry.additional_params.size() != request.additional_params.size())
+        return false;
+
+    if (memcmp(entry.key_blob.key_material, request.key_blob.key_material,
+               request.key_blob.key_material_size) != 0)
+        return false;
+
+    for (size_t i = 0; i < request.additional_params.size(); ++i)
+        if (keymaster_param_compare(&entry.additional_params[i],
+                                    &request.additional_params[i]) != 0)
+            return false;
+    return true;
+}
+
+bool ExportedKeyCache::Find(const ExportKeyRequest& request, uint32_t os_version,
+                            uint32_t os_patchlevel, UniquePtr<uint8_t[]>* material,
+                            size_t* size) const {
+    if (!entries_.get())
+        return false;
+
+    for (size_t i = 0; i < cache_size_; ++i) {
+        const Entry& entry = entries_[i];
+        if (!Matches(entry, request, os_version, os_patchlevel))
+            continue;
+
+        material->reset(dup_buffer(entry.material.data, entry.material.data_length));
+        if (!material->get())
+            return false;
+        *size = entry.material.data_length;
+        return true;
+    }
+    return false;
+}
+
+void ExportedKeyCache::Add(const ExportKeyRequest& request, uint32_t os_version,
+                           uint32_t os_patchlevel, const uint8_t* material, size_t size) {
+    if (cache_size_ == 0)
+        return;
+
+    if (!entries_.get()) {
+        entries_.reset(new (std::nothrow) Entry[cache_size_]);
+        if (!entries_.get())
+            return;
+    }
+
+    Entry& entry = entries_[next_entry_];
+    next_entry_ = (next_entry_ + 1) % cache_size_;
+
+    entry.key_blob = KeymasterKeyBlob(request.key_blob);
+    entry.additional_params.Reinitialize(request.additional_params);
+    entry.material = KeymasterBlob(material, size);
+    if (!entry.key_blob.key_material || !entry.material.data ||
+        entry.additional_params.is_valid() != AuthorizationSet::OK) {
+        // Leave the slot empty rather than holding a partial entry.
+        entry.key_blob.Clear();
+        return;
+    }
+    entry.key_format = request.key_format;
+    entry.os_version = os_version;
+    entry.os_patchlevel = os_patchlevel;
+}
+
+void ExportedKeyCache::Clear() {
+    if (!entries_.get())
+        return;
+
+    for (size_t i = 0; i < cache_size_; ++i) {
+        entries_[i].key_blob.Clear();
+        entries_[i].additional_params.Clear();
+        entries_[i].material.Clear();
+    }
+    next_entry_ = 0;
+}
+
+}  // namespace keymaster
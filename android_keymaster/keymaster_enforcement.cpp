@@ -80,6 +80,11 @@ bool is_public_key_algorithm(const AuthProxy& auth_set) {
 
 static keymaster_error_t authorized_purpose(const keymaster_purpose_t purpose,
                                             const AuthProxy& auth_set) {
+    // Not a member of keymaster_purpose_t, so it can't be a case label below.
+    if (purpose == KM_PURPOSE_AGREE_KEY)
+        return auth_set.Contains(TAG_PURPOSE, purpose) ? KM_ERROR_OK
+                                                       : KM_ERROR_INCOMPATIBLE_PURPOSE;
+
     switch (purpose) {
     case KM_PURPOSE_VERIFY:
     case KM_PURPOSE_ENCRYPT:
@@ -18,12 +18,86 @@
 #include <keymaster/new>
 #include <stdlib.h>
 
+#ifdef KEYMASTER_TRACK_ALLOCATIONS
+#include <string.h>
+
+#include <keymaster/allocation_tracker.h>
+#endif
+
 namespace std {
 struct nothrow_t {};
 }
 
 extern const std::nothrow_t __attribute__((weak)) std::nothrow = {};
 
+#ifdef KEYMASTER_TRACK_ALLOCATIONS
+
+/*
+ * Allocations are reported to keymaster::AllocationTracker.  Each block is preceded by its size, so
+ * that frees can be reported too, which means that every block that reaches operator delete must
+ * have come from these operators: the throwing forms of operator new are replaced as well, and
+ * none of them are weak.
+ */
+
+namespace {
+
+// Big enough for the size, and keeps the blocks maximally aligned.
+const size_t kBlockHeaderSize = 16;
+
+void* tracked_malloc(size_t size) {
+    if (size > static_cast<size_t>(-1) - kBlockHeaderSize)
+        return nullptr;
+    uint8_t* block = static_cast<uint8_t*>(malloc(size + kBlockHeaderSize));
+    if (!block)
+        return nullptr;
+    memcpy(block, &size, sizeof(size));
+    keymaster::AllocationTracker::RecordAllocation(size);
+    return block + kBlockHeaderSize;
+}
+
+void tracked_free(void* ptr) {
+    if (!ptr)
+        return;
+    uint8_t* block = static_cast<uint8_t*>(ptr) - kBlockHeaderSize;
+    size_t size;
+    memcpy(&size, block, sizeof(size));
+    keymaster::AllocationTracker::RecordFree(size);
+    free(block);
+}
+
+}  // anonymous namespace
+
+void* operator new(size_t __sz, const std::nothrow_t&) {
+    return tracked_malloc(__sz);
+}
+void* operator new[](size_t __sz, const std::nothrow_t&) {
+    return tracked_malloc(__sz);
+}
+
+// Keymaster is built without exceptions, so there's nothing to throw.
+void* operator new(size_t __sz) {
+    void* ptr = tracked_malloc(__sz);
+    if (!ptr)
+        abort();
+    return ptr;
+}
+void* operator new[](size_t __sz) {
+    void* ptr = tracked_malloc(__sz);
+    if (!ptr)
+        abort();
+    return ptr;
+}
+
+void operator delete(void* ptr) {
+    tracked_free(ptr);
+}
+
+void operator delete[](void* ptr) {
+    tracked_free(ptr);
+}
+
+#else  // KEYMASTER_TRACK_ALLOCATIONS
+
 void* __attribute__((weak)) operator new(size_t __sz, const std::nothrow_t&) {
     return malloc(__sz);
 }
@@ -41,6 +115,8 @@ void __attribute__((weak)) operator delete[](void* ptr) {
         free(ptr);
 }
 
+#endif  // KEYMASTER_TRACK_ALLOCATIONS
+
 extern "C" {
 void __attribute__((weak)) __cxa_pure_virtual() {
     abort();
@@ -49,6 +49,8 @@ bool OperationFactory::supported(keymaster_digest_t digest) const {
 }
 
 inline bool is_public_key_algorithm(keymaster_algorithm_t algorithm) {
+    if (algorithm == KM_ALGORITHM_CHACHA20_POLY1305) return false;
+
     switch (algorithm) {
     case KM_ALGORITHM_HMAC:
     case KM_ALGORITHM_AES:
@@ -70,6 +72,10 @@ bool OperationFactory::is_public_key_operation() const {
     if (!is_public_key_algorithm(key_type.algorithm))
         return false;
 
+    // Key agreement uses the private key.
+    if (key_type.purpose == KM_PURPOSE_AGREE_KEY)
+        return false;
+
     switch (key_type.purpose) {
     case KM_PURPOSE_VERIFY:
     case KM_PURPOSE_ENCRYPT:
@@ -68,18 +68,42 @@ bool copy_size_and_data_from_buf(const uint8_t** buf_ptr, const uint8_t* end, si
 }
 
 bool Buffer::reserve(size_t size) {
-    if (available_write() < size) {
-        size_t new_size = buffer_size_ + size - available_write();
-        uint8_t* new_buffer = new (std::nothrow) uint8_t[new_size];
-        if (!new_buffer)
-            return false;
-        memcpy(new_buffer, buffer_.get() + read_position_, available_read());
-        memset_s(buffer_.get(), 0, buffer_size_);
-        buffer_.reset(new_buffer);
-        buffer_size_ = new_size;
-        write_position_ -= read_position_;
+    if (available_write() >= size)
+        return true;
+
+    size_t data_length = available_read();
+    size_t required_size = data_length + size;
+    if (required_size < data_length)  // Overflow check
+        return false;
+
+    if (required_size <= buffer_size_ && !borrowed_) {
+        // Reclaiming the space already consumed by reads is sufficient; compact in place.
+        memmove(buffer_.get(), buffer_.get() + read_position_, data_length);
+        memset_s(buffer_.get() + data_length, 0, write_position_ - data_length);
         read_position_ = 0;
+        write_position_ = data_length;
+        return true;
+    }
+
+    size_t new_size = required_size;
+    if (data_length > 0 && buffer_size_ <= SIZE_MAX / 2 && new_size < buffer_size_ * 2)
+        new_size = buffer_size_ * 2;
+
+    uint8_t* new_buffer = new (std::nothrow) uint8_t[new_size];
+    if (!new_buffer)
+        return false;
+    memcpy(new_buffer, buffer_.get() + read_position_, data_length);
+    if (borrowed_) {
+        // Copy-on-write: the borrowed memory belongs to the caller and must be left untouched.
+        buffer_.release();
+        borrowed_ = false;
+    } else {
+        memset_s(buffer_.get(), 0, buffer_size_);
     }
+    buffer_.reset(new_buffer);
+    buffer_size_ = new_size;
+    read_position_ = 0;
+    write_position_ = data_length;
     return true;
 }
 
@@ -108,6 +132,20 @@ bool Buffer::Reinitialize(const void* data, size_t data_len) {
     return true;
 }
 
+bool Buffer::ReinitializeBorrowed(const void* data, size_t data_len) {
+    Clear();
+    if (__pval(data) + data_len < __pval(data))  // Pointer wrap check
+        return false;
+    // The view is read-only: write_position_ == buffer_size_, so there is never write space in
+    // the borrowed memory, and Clear() releases rather than wipes and deletes it.
+    buffer_.reset(const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(data)));
+    borrowed_ = true;
+    buffer_size_ = data_len;
+    read_position_ = 0;
+    write_position_ = buffer_size_;
+    return true;
+}
+
 size_t Buffer::available_write() const {
     assert(buffer_size_ >= write_position_);
     return buffer_size_ - write_position_;
@@ -127,6 +165,25 @@ bool Buffer::write(const uint8_t* src, size_t write_length) {
     return true;
 }
 
+bool Buffer::write(const BufferSegment* segments, size_t segment_count) {
+    size_t total_length = 0;
+    for (size_t i = 0; i < segment_count; ++i) {
+        if (total_length + segments[i].data_length < total_length)  // Overflow check
+            return false;
+        total_length += segments[i].data_length;
+    }
+
+    if (!reserve(total_length))
+        return false;
+    for (size_t i = 0; i < segment_count; ++i) {
+        if (segments[i].data_length == 0)
+            continue;
+        memcpy(buffer_.get() + write_position_, segments[i].data, segments[i].data_length);
+        write_position_ += segments[i].data_length;
+    }
+    return true;
+}
+
 bool Buffer::read(uint8_t* dest, size_t read_length) {
     if (available_read() < read_length)
         return false;
@@ -155,7 +212,12 @@ bool Buffer::Deserialize(const uint8_t** buf_ptr, const uint8_t* end) {
 }
 
 void Buffer::Clear() {
-    memset_s(buffer_.get(), 0, buffer_size_);
+    if (borrowed_) {
+        buffer_.release();
+        borrowed_ = false;
+    } else {
+        memset_s(buffer_.get(), 0, buffer_size_);
+    }
     buffer_.reset();
     read_position_ = 0;
     write_position_ = 0;
@@ -0,0 +1,232 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <keymaster/contexts/key_revocation_registry.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <keymaster/logger.h>
+#include <keymaster/new>
+
+namespace keymaster {
+
+namespace {
+
+// With six probes, 16 filter bits per entry gives a false positive rate of about 0.1%.
+const size_t kFilterBitsPerEntry = 16;
+const size_t kFilterProbes = 6;
+const size_t kMinFilterBits = 1024;
+
+// The IDs are SHA-256 digests, so their bytes are already uniformly distributed and can be used
+// directly as the filter's hash values.
+uint32_t probe(const uint8_t* id, size_t i) {
+    uint32_t value;
+    memcpy(&value, id + i * sizeof(value), sizeof(value));
+    return value;
+}
+
+bool write_all(int fd, const uint8_t* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+}  // anonymous namespace
+
+KeyRevocationRegistry::KeyRevocationRegistry()
+    : entries_(nullptr), entry_count_(0), mapped_size_(0), filter_bits_(0) {}
+
+KeyRevocationRegistry::~KeyRevocationRegistry() {
+    UnmapFile();
+}
+
+keymaster_error_t KeyRevocationRegistry::Init(const char* path) {
+    if (!path) return KM_ERROR_UNEXPECTED_NULL_POINTER;
+    UnmapFile();
+    path_ = path;
+
+    keymaster_error_t error = MapFile();
+    if (error != KM_ERROR_OK) return error;
+
+    // Binary search depends on the order, so don't trust a file that isn't sorted.
+    for (size_t i = 1; i < entry_count_; ++i) {
+        if (memcmp(entry(i - 1), entry(i), kIdSize) >= 0) {
+            LOG_E("Key revocation registry %s is not sorted", path_.c_str());
+            UnmapFile();
+            return KM_ERROR_UNKNOWN_ERROR;
+        }
+    }
+
+    if (!BuildFilter(entry_count_)) return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    return KM_ERROR_OK;
+}
+
+bool KeyRevocationRegistry::IsRevoked(const keymaster_key_blob_t& blob) const {
+    uint8_t id[kIdSize];
+    SHA256(blob.key_material, blob.key_material_size, id);
+    if (!FilterMayContain(id)) return false;
+
+    size_t i = LowerBound(id);
+    return i < entry_count_ && memcmp(entry(i), id, kIdSize) == 0;
+}
+
+keymaster_error_t KeyRevocationRegistry::Revoke(const keymaster_key_blob_t& blob) {
+    if (!filter_) return KM_ERROR_UNKNOWN_ERROR;
+
+    uint8_t id[kIdSize];
+    SHA256(blob.key_material, blob.key_material_size, id);
+    size_t position = LowerBound(id);
+    if (position < entry_count_ && memcmp(entry(position), id, kIdSize) == 0) return KM_ERROR_OK;
+
+    size_t new_count = entry_count_ + 1;
+    UniquePtr<uint8_t[]> new_entries(new (std::nothrow) uint8_t[new_count * kIdSize]);
+    if (!new_entries.get()) return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    if (position > 0) memcpy(new_entries.get(), entries_, position * kIdSize);
+    memcpy(new_entries.get() + position * kIdSize, id, kIdSize);
+    if (position < entry_count_)
+        memcpy(new_entries.get() + (position + 1) * kIdSize, entry(position),
+               (entry_count_ - position) * kIdSize);
+
+    keymaster_error_t error = WriteFile(new_entries.get(), new_count);
+    if (error != KM_ERROR_OK) return error;
+
+    UnmapFile();
+    error = MapFile();
+    if (error != KM_ERROR_OK) return error;
+
+    if (entry_count_ * kFilterBitsPerEntry > filter_bits_) {
+        // Rebuild at twice the size, rather than let the false positive rate climb.
+        if (!BuildFilter(entry_count_ * 2)) return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    } else {
+        AddToFilter(id);
+    }
+    return KM_ERROR_OK;
+}
+
+keymaster_error_t KeyRevocationRegistry::MapFile() {
+    int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) return KM_ERROR_OK;
+        LOG_E("Couldn't open key revocation registry %s: %d", path_.c_str(), errno);
+        return KM_ERROR_UNKNOWN_ERROR;
+    }
+
+    keymaster_error_t error = KM_ERROR_OK;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        error = KM_ERROR_UNKNOWN_ERROR;
+    } else if (st.st_size % kIdSize != 0) {
+        LOG_E("Key revocation registry %s has a partial entry", path_.c_str());
+        error = KM_ERROR_UNKNOWN_ERROR;
+    } else if (st.st_size > 0) {
+        void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 /* offset */);
+        if (mapping == MAP_FAILED) {
+            LOG_E("Couldn't map key revocation registry %s: %d", path_.c_str(), errno);
+            error = KM_ERROR_UNKNOWN_ERROR;
+        } else {
+            entries_ = static_cast<const uint8_t*>(mapping);
+            mapped_size_ = st.st_size;
+            entry_count_ = mapped_size_ / kIdSize;
+        }
+    }
+    close(fd);
+    return error;
+}
+
+void KeyRevocationRegistry::UnmapFile() {
+    if (entries_) munmap(const_cast<uint8_t*>(entries_), mapped_size_);
+    entries_ = nullptr;
+    entry_count_ = 0;
+    mapped_size_ = 0;
+}
+
+keymaster_error_t KeyRevocationRegistry::WriteFile(const uint8_t* entries,
+                                                   size_t entry_count) const {
+    // Write a new file and rename it into place, so that a crash leaves either the old registry or
+    // the new one, never a mixture.
+    std::string temp_path = path_ + ".tmp";
+    int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        LOG_E("Couldn't create %s: %d", temp_path.c_str(), errno);
+        return KM_ERROR_UNKNOWN_ERROR;
+    }
+    bool written = write_all(fd, entries, entry_count * kIdSize) && fsync(fd) == 0;
+    if (close(fd) != 0) written = false;
+    if (!written || rename(temp_path.c_str(), path_.c_str()) != 0) {
+        LOG_E("Couldn't write key revocation registry %s: %d", path_.c_str(), errno);
+        unlink(temp_path.c_str());
+        return KM_ERROR_UNKNOWN_ERROR;
+    }
+    return KM_ERROR_OK;
+}
+
+bool KeyRevocationRegistry::BuildFilter(size_t capacity) {
+    size_t bits = kMinFilterBits;
+    while (bits < capacity * kFilterBitsPerEntry)
+        bits *= 2;
+
+    filter_.reset(new (std::nothrow) uint64_t[bits / 64]);
+    if (!filter_.get()) {
+        filter_bits_ = 0;
+        return false;
+    }
+    memset(filter_.get(), 0, bits / 8);
+    filter_bits_ = bits;
+
+    for (size_t i = 0; i < entry_count_; ++i)
+        AddToFilter(entry(i));
+    return true;
+}
+
+void KeyRevocationRegistry::AddToFilter(const uint8_t* id) {
+    for (size_t i = 0; i < kFilterProbes; ++i) {
+        size_t bit = probe(id, i) & (filter_bits_ - 1);
+        filter_[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+}
+
+bool KeyRevocationRegistry::FilterMayContain(const uint8_t* id) const {
+    if (!filter_) return false;
+    for (size_t i = 0; i < kFilterProbes; ++i) {
+        size_t bit = probe(id, i) & (filter_bits_ - 1);
+        if (!(filter_[bit / 64] & (uint64_t(1) << (bit % 64)))) return false;
+    }
+    return true;
+}
+
+size_t KeyRevocationRegistry::LowerBound(const uint8_t* id) const {
+    size_t low = 0;
+    size_t high = entry_count_;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (memcmp(entry(mid), id, kIdSize) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+}  // namespace keymaster
@@ -33,9 +33,11 @@
 
 namespace keymaster {
 
-Keymaster1PassthroughContext::Keymaster1PassthroughContext(keymaster1_device_t* dev)
+Keymaster1PassthroughContext::Keymaster1PassthroughContext(keymaster1_device_t* dev,
+                                                           size_t max_concurrent_device_calls)
         : device_(dev), pt_engine_(KeymasterPassthroughEngine::createInstance(dev)),
-          km1_engine_(new Keymaster1Engine(dev)) {
+          km1_engine_(new Keymaster1Engine(dev, max_concurrent_device_calls)),
+          characteristics_cache_(kKeyCharacteristicsCacheSize) {
 
 }
 
@@ -43,6 +45,8 @@ keymaster_error_t Keymaster1PassthroughContext::SetSystemVersion(uint32_t os_ver
         uint32_t os_patchlevel) {
     os_version_ = os_version;
     os_patchlevel_ = os_patchlevel;
+    // A version change can make cached blobs require upgrade.
+    characteristics_cache_.Clear();
     return KM_ERROR_OK;
 }
 
@@ -99,6 +103,9 @@ keymaster_error_t Keymaster1PassthroughContext::UpgradeKeyBlob(
     if (error != KM_ERROR_OK)
         return error;
 
+    // The caller replaces the old blob with the upgraded one, so stop serving its characteristics.
+    characteristics_cache_.Invalidate(key_to_upgrade);
+
     if (key->hw_enforced().Contains(TAG_PURPOSE) &&
             !key->hw_enforced().Contains(TAG_OS_PATCHLEVEL)) {
         return KM_ERROR_INVALID_ARGUMENT;
@@ -108,11 +115,18 @@ keymaster_error_t Keymaster1PassthroughContext::UpgradeKeyBlob(
 }
 
 static keymaster_error_t parseKeymaster1HwBlob(const keymaster1_device_t* device,
+                                               KeyCharacteristicsCache* cache,
                                                const KeymasterKeyBlob& blob,
                                                const AuthorizationSet& additional_params,
                                                KeymasterKeyBlob* key_material,
                                                AuthorizationSet* hw_enforced,
                                                AuthorizationSet* sw_enforced) {
+    // The HW recognized the blob when its characteristics were cached.
+    if (cache->Find(blob, additional_params, hw_enforced, sw_enforced)) {
+        *key_material = blob;
+        return KM_ERROR_OK;
+    }
+
     keymaster_blob_t client_id = {nullptr, 0};
     keymaster_blob_t app_data = {nullptr, 0};
     keymaster_blob_t* client_id_ptr = nullptr;
@@ -134,6 +148,7 @@ static keymaster_error_t parseKeymaster1HwBlob(const keymaster1_device_t* device
 
     hw_enforced->Reinitialize(characteristics->hw_enforced);
     sw_enforced->Reinitialize(characteristics->sw_enforced);
+    cache->Add(blob, additional_params, *characteristics);
     *key_material = blob;
     return KM_ERROR_OK;
 }
@@ -156,8 +171,9 @@ keymaster_error_t Keymaster1PassthroughContext::ParseKeyBlob(const KeymasterKeyB
         return error;
 
     if (error == KM_ERROR_INVALID_KEY_BLOB) {
-        error = parseKeymaster1HwBlob(km1_engine_->device(), blob, additional_params,
-                                      &key_material, &hw_enforced, &sw_enforced);
+        error = parseKeymaster1HwBlob(km1_engine_->device(), &characteristics_cache_, blob,
+                                      additional_params, &key_material, &hw_enforced,
+                                      &sw_enforced);
         if (error != KM_ERROR_OK) return error;
     }
 
@@ -174,6 +190,10 @@ keymaster_error_t Keymaster1PassthroughContext::ParseKeyBlob(const KeymasterKeyB
 }
 
 keymaster_error_t Keymaster1PassthroughContext::DeleteKey(const KeymasterKeyBlob& blob) const {
+     // A blob can look like a software key and still have been loaded from the HW, so drop its
+     // characteristics before deciding.
+     characteristics_cache_.Invalidate(blob);
+
      // HACK. Due to a bug with Qualcomm's Keymaster implementation, which causes the device to
      // reboot if we pass it a key blob it doesn't understand, we need to check for software
      // keys.  If it looks like a software key there's nothing to do so we just return.
@@ -197,6 +217,7 @@ keymaster_error_t Keymaster1PassthroughContext::DeleteKey(const KeymasterKeyBlob
 }
 
 keymaster_error_t Keymaster1PassthroughContext::DeleteAllKeys() const {
+    characteristics_cache_.Clear();
     return km1_engine_->DeleteAllKeys();
 }
 
@@ -23,7 +23,8 @@
 namespace keymaster {
 
 Keymaster2PassthroughContext::Keymaster2PassthroughContext(keymaster2_device_t* dev)
-        : device_(dev), engine_(KeymasterPassthroughEngine::createInstance(dev)) {
+        : device_(dev), engine_(KeymasterPassthroughEngine::createInstance(dev)),
+          characteristics_cache_(kKeyCharacteristicsCacheSize) {
 
 }
 
@@ -31,6 +32,8 @@ keymaster_error_t Keymaster2PassthroughContext::SetSystemVersion(uint32_t os_ver
         uint32_t os_patchlevel) {
     os_version_ = os_version;
     os_patchlevel_ = os_patchlevel;
+    // A version change can make cached blobs require upgrade.
+    characteristics_cache_.Clear();
     return KM_ERROR_OK;
 }
 
@@ -63,11 +66,36 @@ keymaster_error_t Keymaster2PassthroughContext::UpgradeKeyBlob(
         KeymasterKeyBlob* upgraded_key) const {
     if (!upgraded_key) return KM_ERROR_UNEXPECTED_NULL_POINTER;
     *upgraded_key = {};
+    characteristics_cache_.Invalidate(key_to_upgrade);
     return device_->upgrade_key(device_, &key_to_upgrade, &upgrade_params, upgraded_key);
 }
 
 keymaster_error_t Keymaster2PassthroughContext::ParseKeyBlob(const KeymasterKeyBlob& blob,
         const AuthorizationSet& additional_params, UniquePtr<Key>* key) const {
+    AuthorizationSet hw_enforced;
+    AuthorizationSet sw_enforced;
+    if (!characteristics_cache_.Find(blob, additional_params, &hw_enforced, &sw_enforced)) {
+        keymaster_error_t error =
+            GetKeyCharacteristics(blob, additional_params, &hw_enforced, &sw_enforced);
+        if (error != KM_ERROR_OK) return error;
+    }
+
+    // GetKeyFactory
+    keymaster_algorithm_t algorithm;
+    if (!hw_enforced.GetTagValue(TAG_ALGORITHM, &algorithm) &&
+        !sw_enforced.GetTagValue(TAG_ALGORITHM, &algorithm)) {
+        return KM_ERROR_INVALID_ARGUMENT;
+    }
+
+    KeymasterKeyBlob key_material = blob;
+    auto factory = GetKeyFactory(algorithm);
+    return factory->LoadKey(move(key_material), additional_params, move(hw_enforced),
+                            move(sw_enforced), key);
+}
+
+keymaster_error_t Keymaster2PassthroughContext::GetKeyCharacteristics(
+        const KeymasterKeyBlob& blob, const AuthorizationSet& additional_params,
+        AuthorizationSet* hw_enforced, AuthorizationSet* sw_enforced) const {
     keymaster_key_characteristics_t characteristics = {};
     keymaster_blob_t clientId;
     keymaster_blob_t applicationData;
@@ -85,32 +113,21 @@ keymaster_error_t Keymaster2PassthroughContext::ParseKeyBlob(const KeymasterKeyB
 
     if (rc != KM_ERROR_OK) return rc;
 
-    AuthorizationSet hw_enforced;
-    AuthorizationSet sw_enforced;
-
-    hw_enforced.Reinitialize(characteristics.hw_enforced);
-    sw_enforced.Reinitialize(characteristics.sw_enforced);
+    hw_enforced->Reinitialize(characteristics.hw_enforced);
+    sw_enforced->Reinitialize(characteristics.sw_enforced);
+    characteristics_cache_.Add(blob, additional_params, characteristics);
 
     keymaster_free_characteristics(&characteristics);
-
-    // GetKeyFactory
-    keymaster_algorithm_t algorithm;
-    if (!hw_enforced.GetTagValue(TAG_ALGORITHM, &algorithm) &&
-        !sw_enforced.GetTagValue(TAG_ALGORITHM, &algorithm)) {
-        return KM_ERROR_INVALID_ARGUMENT;
-    }
-
-    KeymasterKeyBlob key_material = blob;
-    auto factory = GetKeyFactory(algorithm);
-    return factory->LoadKey(move(key_material), additional_params, move(hw_enforced),
-                            move(sw_enforced), key);
+    return KM_ERROR_OK;
 }
 
 keymaster_error_t Keymaster2PassthroughContext::DeleteKey(const KeymasterKeyBlob& blob) const {
+    characteristics_cache_.Invalidate(blob);
     return device_->delete_key(device_, &blob);
 }
 
 keymaster_error_t Keymaster2PassthroughContext::DeleteAllKeys() const {
+    characteristics_cache_.Clear();
     return device_->delete_all_keys(device_);
 }
 
@@ -33,6 +33,7 @@
 #include <keymaster/km_openssl/aes_key.h>
 #include <keymaster/km_openssl/asymmetric_key.h>
 #include <keymaster/km_openssl/attestation_utils.h>
+#include <keymaster/km_openssl/chacha20_poly1305_key.h>
 #include <keymaster/km_openssl/ec_key_factory.h>
 #include <keymaster/km_openssl/hmac_key.h>
 #include <keymaster/km_openssl/openssl_err.h>
@@ -54,6 +55,7 @@ PureSoftKeymasterContext::PureSoftKeymasterContext()
     : rsa_factory_(new RsaKeyFactory(this)), ec_factory_(new EcKeyFactory(this)),
       aes_factory_(new AesKeyFactory(this, this)),
       tdes_factory_(new TripleDesKeyFactory(this, this)),
+      chacha20_poly1305_factory_(new ChaCha20Poly1305KeyFactory(this, this)),
       hmac_factory_(new HmacKeyFactory(this, this)), os_version_(0), os_patchlevel_(0),
       soft_keymaster_enforcement_(64, 64) {}
 
@@ -72,6 +74,9 @@ void PureSoftKeymasterContext::GetSystemVersion(uint32_t* os_version, uint32_t*
 }
 
 KeyFactory* PureSoftKeymasterContext::GetKeyFactory(keymaster_algorithm_t algorithm) const {
+    // Not a member of keymaster_algorithm_t, so it can't be a case label below.
+    if (algorithm == KM_ALGORITHM_CHACHA20_POLY1305) return chacha20_poly1305_factory_.get();
+
     switch (algorithm) {
     case KM_ALGORITHM_RSA:
         return rsa_factory_.get();
@@ -160,6 +165,9 @@ keymaster_error_t PureSoftKeymasterContext::ParseKeyBlob(const KeymasterKeyBlob&
     // integrity-assured nor OCB-encrypted and lacks the old software key header is assumed to be
     // keymaster0 hardware.
 
+    if (revoked_keys_ && revoked_keys_->IsRevoked(blob))
+        return KM_ERROR_INVALID_KEY_BLOB;
+
     AuthorizationSet hw_enforced;
     AuthorizationSet sw_enforced;
     KeymasterKeyBlob key_material;
@@ -204,12 +212,31 @@ keymaster_error_t PureSoftKeymasterContext::ParseKeyBlob(const KeymasterKeyBlob&
     return constructKey();
 }
 
-keymaster_error_t PureSoftKeymasterContext::DeleteKey(const KeymasterKeyBlob& /* blob */) const {
-    // Nothing to do for software-only contexts.
+keymaster_error_t PureSoftKeymasterContext::InitKeyRevocationRegistry(const char* path) {
+    unique_ptr<KeyRevocationRegistry> registry(new (std::nothrow) KeyRevocationRegistry);
+    keymaster_error_t error =
+        registry ? registry->Init(path) : KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    if (error != KM_ERROR_OK) {
+        LOG_E("Failed to load key revocation registry %s: %d; keys can't be deleted", path, error);
+        revoked_keys_.reset();
+        revocation_error_ = error;
+        return error;
+    }
+    SetKeyRevocationRegistry(std::move(registry));
     return KM_ERROR_OK;
 }
 
+keymaster_error_t PureSoftKeymasterContext::DeleteKey(const KeymasterKeyBlob& blob) const {
+    if (revoked_keys_)
+        return revoked_keys_->Revoke(blob);
+    // Otherwise there's nothing to do for software-only contexts, unless the registry that should
+    // have recorded the deletion failed to load.
+    return revocation_error_;
+}
+
 keymaster_error_t PureSoftKeymasterContext::DeleteAllKeys() const {
+    // The revocation registry can only revoke blobs it's given, and this context keeps no list of
+    // the blobs it has made.
     return KM_ERROR_OK;
 }
 
@@ -28,6 +28,7 @@
 #include <keymaster/km_openssl/aes_key.h>
 #include <keymaster/km_openssl/asymmetric_key.h>
 #include <keymaster/km_openssl/attestation_utils.h>
+#include <keymaster/km_openssl/chacha20_poly1305_key.h>
 #include <keymaster/km_openssl/hmac_key.h>
 #include <keymaster/km_openssl/openssl_err.h>
 #include <keymaster/km_openssl/triple_des_key.h>
@@ -56,6 +57,7 @@ SoftKeymasterContext::SoftKeymasterContext(const std::string& root_of_trust)
     : rsa_factory_(new RsaKeyFactory(this)), ec_factory_(new EcKeyFactory(this)),
       aes_factory_(new AesKeyFactory(this, this)),
       tdes_factory_(new TripleDesKeyFactory(this, this)),
+      chacha20_poly1305_factory_(new ChaCha20Poly1305KeyFactory(this, this)),
       hmac_factory_(new HmacKeyFactory(this, this)), km1_dev_(nullptr),
       root_of_trust_(string2Blob(root_of_trust)), os_version_(0), os_patchlevel_(0) {}
 
@@ -78,13 +80,14 @@ keymaster_error_t SoftKeymasterContext::SetHardwareDevice(keymaster0_device_t* k
     return KM_ERROR_OK;
 }
 
-keymaster_error_t SoftKeymasterContext::SetHardwareDevice(keymaster1_device_t* keymaster1_device) {
+keymaster_error_t SoftKeymasterContext::SetHardwareDevice(keymaster1_device_t* keymaster1_device,
+                                                          size_t max_concurrent_device_calls) {
     if (!keymaster1_device)
         return KM_ERROR_UNEXPECTED_NULL_POINTER;
 
     km1_dev_ = keymaster1_device;
 
-    km1_engine_.reset(new Keymaster1Engine(keymaster1_device));
+    km1_engine_.reset(new Keymaster1Engine(keymaster1_device, max_concurrent_device_calls));
     rsa_factory_.reset(new RsaKeymaster1KeyFactory(this, km1_engine_.get()));
     ec_factory_.reset(new EcdsaKeymaster1KeyFactory(this, km1_engine_.get()));
 
@@ -107,6 +110,9 @@ void SoftKeymasterContext::GetSystemVersion(uint32_t* os_version, uint32_t* os_p
 }
 
 KeyFactory* SoftKeymasterContext::GetKeyFactory(keymaster_algorithm_t algorithm) const {
+    // Not a member of keymaster_algorithm_t, so it can't be a case label below.
+    if (algorithm == KM_ALGORITHM_CHACHA20_POLY1305) return chacha20_poly1305_factory_.get();
+
     switch (algorithm) {
     case KM_ALGORITHM_RSA:
         return rsa_factory_.get();
@@ -38,6 +38,7 @@
 #include <keymaster/android_keymaster_messages.h>
 #include <keymaster/android_keymaster_utils.h>
 #include <keymaster/authorization_set.h>
+#include <keymaster/km_openssl/ec_key_factory.h>
 #include <keymaster/km_openssl/openssl_utils.h>
 #include <keymaster/contexts/soft_keymaster_context.h>
 #include <keymaster/soft_keymaster_logger.h>
@@ -160,6 +161,42 @@ static keymaster_error_t map_digests(keymaster1_device_t* dev, SoftKeymasterDevi
     return KM_ERROR_OK;
 }
 
+// Digests are recorded in the support table as bit (1 << digest).  Anything too large for that
+// shares the top bit, which is never set for a device's reported digests.
+static const uint32_t kUnknownDigestBit = 1u << 31;
+
+// Table entry for algorithm/purpose pairs the wrapped device wasn't asked about.  Such operations
+// are passed through, and any error is left to the hardware module.
+static const uint32_t kAllDigestsSupported = UINT32_MAX;
+
+static uint32_t digest_bit(uint32_t digest) {
+    return digest < 31 ? (1u << digest) : kUnknownDigestBit;
+}
+
+static uint32_t requested_digests(const AuthorizationSet& params) {
+    uint32_t digests = 0;
+    for (auto& entry : params)
+        if (entry.tag == TAG_DIGEST)
+            digests |= digest_bit(entry.enumerated);
+    return digests;
+}
+
+static bool digest_table_index(keymaster_algorithm_t algorithm, size_t* index) {
+    switch (algorithm) {
+    case KM_ALGORITHM_RSA:
+        *index = 0;
+        return true;
+    case KM_ALGORITHM_EC:
+        *index = 1;
+        return true;
+    case KM_ALGORITHM_HMAC:
+        *index = 2;
+        return true;
+    default:
+        return false;
+    }
+}
+
 SoftKeymasterDevice::SoftKeymasterDevice()
     : wrapped_km1_device_(nullptr),
       context_(new SoftKeymasterContext),
@@ -209,7 +246,8 @@ keymaster_error_t SoftKeymasterDevice::SetHardwareDevice(keymaster0_device_t* ke
     return KM_ERROR_OK;
 }
 
-keymaster_error_t SoftKeymasterDevice::SetHardwareDevice(keymaster1_device_t* keymaster1_device) {
+keymaster_error_t SoftKeymasterDevice::SetHardwareDevice(keymaster1_device_t* keymaster1_device,
+                                                         size_t max_concurrent_device_calls) {
     assert(keymaster1_device);
     LOG_D("Reinitializing SoftKeymasterDevice to use HW keymaster1", 0);
 
@@ -220,8 +258,9 @@ keymaster_error_t SoftKeymasterDevice::SetHardwareDevice(keymaster1_device_t* ke
         map_digests(keymaster1_device, &km1_device_digests_, &supports_all_digests_);
     if (error != KM_ERROR_OK)
         return error;
+    BuildDigestSupportTable();
 
-    error = context_->SetHardwareDevice(keymaster1_device);
+    error = context_->SetHardwareDevice(keymaster1_device, max_concurrent_device_calls);
     if (error != KM_ERROR_OK)
         return error;
 
@@ -241,6 +280,25 @@ keymaster_error_t SoftKeymasterDevice::SetHardwareDevice(keymaster1_device_t* ke
     return KM_ERROR_OK;
 }
 
+void SoftKeymasterDevice::BuildDigestSupportTable() {
+    for (auto& row : km1_device_digest_support_)
+        for (auto& entry : row)
+            entry = kAllDigestsSupported;
+
+    for (auto& entry : km1_device_digests_) {
+        size_t algorithm_index;
+        size_t purpose = entry.first.second;
+        if (!digest_table_index(entry.first.first, &algorithm_index) ||
+            purpose >= kDigestTablePurposes)
+            continue;
+
+        uint32_t supported = 0;
+        for (auto digest : entry.second)
+            supported |= digest_bit(digest);
+        km1_device_digest_support_[algorithm_index][purpose] = supported & ~kUnknownDigestBit;
+    }
+}
+
 bool SoftKeymasterDevice::Keymaster1DeviceIsGood() {
     std::vector<keymaster_digest_t> expected_rsa_digests = {
         KM_DIGEST_NONE,      KM_DIGEST_MD5,       KM_DIGEST_SHA1,     KM_DIGEST_SHA_2_224,
@@ -660,30 +718,25 @@ keymaster_error_t SoftKeymasterDevice::add_rng_entropy(const keymaster2_device_t
     return add_rng_entropy(&sk_dev->km1_device_, data, data_length);
 }
 
-template <typename Collection, typename Value> bool contains(const Collection& c, const Value& v) {
-    return std::find(c.begin(), c.end(), v) != c.end();
-}
-
-bool SoftKeymasterDevice::FindUnsupportedDigest(keymaster_algorithm_t algorithm,
-                                                keymaster_purpose_t purpose,
-                                                const AuthorizationSet& params,
-                                                keymaster_digest_t* unsupported) const {
+bool SoftKeymasterDevice::Km1DeviceSupportsDigests(keymaster_algorithm_t algorithm,
+                                                   keymaster_purpose_t purpose,
+                                                   uint32_t requested_digests) const {
     assert(wrapped_km1_device_);
 
-    auto supported_digests = km1_device_digests_.find(std::make_pair(algorithm, purpose));
-    if (supported_digests == km1_device_digests_.end())
+    size_t algorithm_index;
+    if (!digest_table_index(algorithm, &algorithm_index) ||
+        static_cast<size_t>(purpose) >= kDigestTablePurposes)
         // Invalid algorith/purpose pair (e.g. EC encrypt).  Let the error be handled by HW module.
-        return false;
+        return true;
 
-    for (auto& entry : params)
-        if (entry.tag == TAG_DIGEST)
-            if (!contains(supported_digests->second, entry.enumerated)) {
-                LOG_I("Digest %d requested but not supported by module %s", entry.enumerated,
-                      wrapped_km1_device_->common.module->name);
-                *unsupported = static_cast<keymaster_digest_t>(entry.enumerated);
-                return true;
-            }
-    return false;
+    uint32_t unsupported =
+        requested_digests & ~km1_device_digest_support_[algorithm_index][purpose];
+    if (unsupported) {
+        LOG_I("Digests 0x%x requested but not supported by module %s", unsupported,
+              wrapped_km1_device_->common.module->name);
+        return false;
+    }
+    return true;
 }
 
 bool SoftKeymasterDevice::RequiresSoftwareDigesting(keymaster_algorithm_t algorithm,
@@ -693,6 +746,10 @@ bool SoftKeymasterDevice::RequiresSoftwareDigesting(keymaster_algorithm_t algori
     if (!wrapped_km1_device_)
         return true;
 
+    // Keymaster1 hardware has no ChaCha20-Poly1305 support; keys of that type are software keys.
+    if (algorithm == KM_ALGORITHM_CHACHA20_POLY1305)
+        return true;
+
     switch (algorithm) {
     case KM_ALGORITHM_AES:
     case KM_ALGORITHM_TRIPLE_DES:
@@ -704,8 +761,7 @@ bool SoftKeymasterDevice::RequiresSoftwareDigesting(keymaster_algorithm_t algori
         break;
     }
 
-    keymaster_digest_t unsupported;
-    if (!FindUnsupportedDigest(algorithm, purpose, params, &unsupported)) {
+    if (Km1DeviceSupportsDigests(algorithm, purpose, requested_digests(params))) {
         LOG_D("Requested digest(s) supported for algorithm %d and purpose %d", algorithm, purpose);
         return false;
     }
@@ -725,10 +781,28 @@ bool SoftKeymasterDevice::KeyRequiresSoftwareDigesting(
         return false;
     }
 
+    if (algorithm == KM_ALGORITHM_CHACHA20_POLY1305)
+        return true;
+
+    // Nor does it support curve 25519 or key agreement; those keys are software keys.
+    if (algorithm == KM_ALGORITHM_EC && EcKeyFactory::IsSoftwareOnlyKey(key_description))
+        return true;
+
+    switch (algorithm) {
+    case KM_ALGORITHM_AES:
+    case KM_ALGORITHM_TRIPLE_DES:
+        return false;
+    case KM_ALGORITHM_HMAC:
+    case KM_ALGORITHM_RSA:
+    case KM_ALGORITHM_EC:
+        break;
+    }
+
+    uint32_t digests = requested_digests(key_description);
     for (auto& entry : key_description)
         if (entry.tag == TAG_PURPOSE) {
             keymaster_purpose_t purpose = static_cast<keymaster_purpose_t>(entry.enumerated);
-            if (RequiresSoftwareDigesting(algorithm, purpose, key_description))
+            if (!Km1DeviceSupportsDigests(algorithm, purpose, digests))
                 return true;
         }
 
@@ -1021,9 +1095,14 @@ keymaster_error_t SoftKeymasterDevice::export_key(const keymaster1_device_t* dev
         return KM_ERROR_OUTPUT_PARAMETER_NULL;
 
     const keymaster1_device_t* km1_dev = convert_device(dev)->wrapped_km1_device_;
-    if (km1_dev)
-        return km1_dev->export_key(km1_dev, export_format, key_to_export, client_id, app_data,
-                                   export_data);
+    if (km1_dev) {
+        keymaster_error_t error = km1_dev->export_key(km1_dev, export_format, key_to_export,
+                                                      client_id, app_data, export_data);
+        if (error != KM_ERROR_INVALID_KEY_BLOB)
+            return error;
+        // As in get_key_characteristics, "invalid blob" may mean a software key blob, such as an
+        // Ed25519 key.
+    }
 
     export_data->data = nullptr;
     export_data->data_length = 0;
@@ -1160,8 +1239,11 @@ keymaster_error_t SoftKeymasterDevice::delete_key(const keymaster1_device_t* dev
     if (!dev || !key || !key->key_material)
         return KM_ERROR_UNEXPECTED_NULL_POINTER;
 
-    KeymasterKeyBlob blob(*key);
-    return convert_device(dev)->context_->DeleteKey(blob);
+    DeleteKeyRequest request;
+    request.SetKeyMaterial(*key);
+    DeleteKeyResponse response;
+    convert_device(dev)->impl_->DeleteKey(request, &response);
+    return response.error;
 }
 
 /* static */
@@ -1173,8 +1255,11 @@ keymaster_error_t SoftKeymasterDevice::delete_key(const keymaster2_device_t* dev
     if (!convert_device(dev)->configured())
         return KM_ERROR_KEYMASTER_NOT_CONFIGURED;
 
-    KeymasterKeyBlob blob(*key);
-    return convert_device(dev)->context_->DeleteKey(blob);
+    DeleteKeyRequest request;
+    request.SetKeyMaterial(*key);
+    DeleteKeyResponse response;
+    convert_device(dev)->impl_->DeleteKey(request, &response);
+    return response.error;
 }
 
 /* static */
@@ -1182,7 +1267,10 @@ keymaster_error_t SoftKeymasterDevice::delete_all_keys(const keymaster1_device_t
     if (!dev)
         return KM_ERROR_UNEXPECTED_NULL_POINTER;
 
-    return convert_device(dev)->context_->DeleteAllKeys();
+    DeleteAllKeysRequest request;
+    DeleteAllKeysResponse response;
+    convert_device(dev)->impl_->DeleteAllKeys(request, &response);
+    return response.error;
 }
 
 /* static */
@@ -1193,7 +1281,10 @@ keymaster_error_t SoftKeymasterDevice::delete_all_keys(const keymaster2_device_t
     if (!convert_device(dev)->configured())
         return KM_ERROR_KEYMASTER_NOT_CONFIGURED;
 
-    return convert_device(dev)->context_->DeleteAllKeys();
+    DeleteAllKeysRequest request;
+    DeleteAllKeysResponse response;
+    convert_device(dev)->impl_->DeleteAllKeys(request, &response);
+    return response.error;
 }
 
 /* static */
@@ -1235,7 +1326,12 @@ keymaster_error_t SoftKeymasterDevice::begin(const keymaster1_device_t* dev,
             in_params_set.push_back(TAG_DIGEST, digest);
         }
 
-        if (!skdev->RequiresSoftwareDigesting(algorithm, purpose, in_params_set)) {
+        // Curve 25519 and key agreement keys are software keys even with keymaster1 hardware
+        // present.
+        bool software_key = algorithm == KM_ALGORITHM_EC &&
+                            (EcKeyFactory::IsSoftwareOnlyKey(akmKey->hw_enforced()) ||
+                             EcKeyFactory::IsSoftwareOnlyKey(akmKey->sw_enforced()));
+        if (!software_key && !skdev->RequiresSoftwareDigesting(algorithm, purpose, in_params_set)) {
             LOG_D("Operation supported by %s, passing through to keymaster1 module",
                   km1_dev->common.module->name);
             return km1_dev->begin(km1_dev, purpose, key, in_params, out_params, operation_handle);
@@ -1251,7 +1347,7 @@ keymaster_error_t SoftKeymasterDevice::begin(const keymaster1_device_t* dev,
     BeginOperationRequest request;
     request.purpose = purpose;
     request.SetKeyMaterial(*key);
-    request.additional_params.Reinitialize(*in_params);
+    request.additional_params.ReinitializeBorrowed(*in_params);
 
     BeginOperationResponse response;
     skdev->impl_->BeginOperation(request, &response);
@@ -1317,12 +1413,15 @@ keymaster_error_t SoftKeymasterDevice::update(const keymaster1_device_t* dev,
         output->data_length = 0;
     }
 
+    // The request borrows the caller's input and params rather than copying them; both outlive
+    // the synchronous UpdateOperation call.  The output must still be copied, because the HAL
+    // contract hands the caller malloc'ed memory to free.
     UpdateOperationRequest request;
     request.op_handle = operation_handle;
     if (input)
-        request.input.Reinitialize(input->data, input->data_length);
+        request.input.ReinitializeBorrowed(input->data, input->data_length);
     if (in_params)
-        request.additional_params.Reinitialize(*in_params);
+        request.additional_params.ReinitializeBorrowed(*in_params);
 
     UpdateOperationResponse response;
     convert_device(dev)->impl_->UpdateOperation(request, &response);
@@ -1399,8 +1498,8 @@ keymaster_error_t SoftKeymasterDevice::finish(const keymaster1_device_t* dev,
     FinishOperationRequest request;
     request.op_handle = operation_handle;
     if (signature && signature->data_length > 0)
-        request.signature.Reinitialize(signature->data, signature->data_length);
-    request.additional_params.Reinitialize(*params);
+        request.signature.ReinitializeBorrowed(signature->data, signature->data_length);
+    request.additional_params.ReinitializeBorrowed(*params);
 
     FinishOperationResponse response;
     convert_device(dev)->impl_->FinishOperation(request, &response);
@@ -1555,10 +1654,10 @@ keymaster_error_t SoftKeymasterDevice::finish(const keymaster2_device_t* dev,
     FinishOperationRequest request;
     request.op_handle = operation_handle;
     if (signature && signature->data_length > 0)
-        request.signature.Reinitialize(signature->data, signature->data_length);
+        request.signature.ReinitializeBorrowed(signature->data, signature->data_length);
     if (input && input->data_length > 0)
-        request.input.Reinitialize(input->data, input->data_length);
-    request.additional_params.Reinitialize(*params);
+        request.input.ReinitializeBorrowed(input->data, input->data_length);
+    request.additional_params.ReinitializeBorrowed(*params);
 
     FinishOperationResponse response;
     convert_device(dev)->impl_->FinishOperation(request, &response);
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYSTEM_KEYMASTER_ALLOCATION_TRACKER_H_
+#define SYSTEM_KEYMASTER_ALLOCATION_TRACKER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <hardware/keymaster_defs.h>
+
+namespace keymaster {
+
+enum AndroidKeymasterCommand : uint32_t;
+
+struct AllocationStats {
+    uint64_t calls;        // The number of commands counted.
+    uint64_t allocations;  // Summed over all calls, as is bytes.
+    uint64_t bytes;
+    // The most bytes that any one call had allocated and not yet freed.  Frees of memory allocated
+    // before the call, e.g. by deleting an operation, are netted against its own allocations.
+    uint64_t peak_live_bytes;
+};
+
+/**
+ * Counts allocations and attributes them to AndroidKeymasterCommands and, for commands that work on
+ * an operation, to the operation's purpose.
+ *
+ * AndroidKeymaster opens an AllocationScope for each command.  When built with
+ * KEYMASTER_TRACK_ALLOCATIONS, keymaster_stl.cpp's operator new and operator delete report each
+ * allocation and free to the calling thread's innermost open scope, and closing a scope adds its
+ * counts to the stats below.  Commands may run on several threads at once; each is charged only
+ * for the allocations made on its own thread.  In other builds nothing is reported, scopes do
+ * nothing and the stats stay zero.
+ */
+class AllocationTracker {
+  public:
+    static AllocationStats command_stats(AndroidKeymasterCommand command);
+    static AllocationStats purpose_stats(keymaster_purpose_t purpose);
+    static void Reset();
+
+    /**
+     * Logs, at info level, the stats of each command and purpose that has been counted.
+     */
+    static void LogStats();
+
+    // Called by the allocator.
+    static void RecordAllocation(size_t size);
+    static void RecordFree(size_t size);
+};
+
+/**
+ * Charges allocations to \p command while it's in scope.  Scopes nest, e.g. when a software device
+ * wraps another AndroidKeymaster, and only the outermost one is counted: inner scopes' counts are
+ * charged to it.
+ */
+class AllocationScope {
+  public:
+    explicit AllocationScope(AndroidKeymasterCommand command);
+    ~AllocationScope();
+    AllocationScope(const AllocationScope&) = delete;
+    void operator=(const AllocationScope&) = delete;
+
+    /**
+     * Charges the scope's allocations to operations with \p purpose, as well as to its command.
+     */
+    void set_purpose(keymaster_purpose_t purpose) {
+        purpose_ = purpose;
+        has_purpose_ = true;
+    }
+
+  private:
+    friend class AllocationTracker;
+
+    AndroidKeymasterCommand command_;
+    keymaster_purpose_t purpose_;
+    bool has_purpose_;
+    uint64_t allocations_;
+    uint64_t bytes_;
+    int64_t live_bytes_;
+    int64_t peak_live_bytes_;
+    AllocationScope* parent_;
+};
+
+}  // namespace keymaster
+
+#endif  // SYSTEM_KEYMASTER_ALLOCATION_TRACKER_H_
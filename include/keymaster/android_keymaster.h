@@ -22,6 +22,7 @@
 
 namespace keymaster {
 
+class ExportedKeyCache;
 class Key;
 class KeyFactory;
 class KeymasterContext;
@@ -86,6 +87,11 @@ class AndroidKeymaster {
     void UpdateOperation(const UpdateOperationRequest& request, UpdateOperationResponse* response);
     void FinishOperation(const FinishOperationRequest& request, FinishOperationResponse* response);
     void AbortOperation(const AbortOperationRequest& request, AbortOperationResponse* response);
+    void CloneOperation(const CloneOperationRequest& request, CloneOperationResponse* response);
+    void BatchAeadOperation(const BatchAeadOperationRequest& request,
+                            BatchAeadOperationResponse* response);
+    void SealRecord(const ProcessRecordRequest& request, ProcessRecordResponse* response);
+    void OpenRecord(const ProcessRecordRequest& request, ProcessRecordResponse* response);
 
     bool has_operation(keymaster_operation_handle_t op_handle) const;
 
@@ -93,9 +99,12 @@ class AndroidKeymaster {
     keymaster_error_t LoadKey(const keymaster_key_blob_t& key_blob,
                               const AuthorizationSet& additional_params,
                               const KeyFactory** factory, UniquePtr<Key>* key);
+    void ProcessRecord(keymaster_purpose_t purpose, const ProcessRecordRequest& request,
+                       ProcessRecordResponse* response);
 
     UniquePtr<KeymasterContext> context_;
     UniquePtr<OperationTable> operation_table_;
+    UniquePtr<ExportedKeyCache> exported_key_cache_;
 };
 
 }  // namespace keymaster
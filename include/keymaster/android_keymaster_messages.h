@@ -55,6 +55,10 @@ enum AndroidKeymasterCommand : uint32_t {
     DELETE_ALL_KEYS = 23,
     DESTROY_ATTESTATION_IDS = 24,
     IMPORT_WRAPPED_KEY = 25,
+    CLONE_OPERATION = 26,
+    BATCH_AEAD_OPERATION = 27,
+    SEAL_RECORD = 28,
+    OPEN_RECORD = 29,
 };
 
 /**
@@ -429,6 +433,146 @@ struct AbortOperationResponse : public KeymasterResponse {
     bool NonErrorDeserialize(const uint8_t**, const uint8_t*) override { return true; }
 };
 
+/**
+ * Duplicates an in-progress operation, so that messages sharing a prefix can be signed or MACed
+ * without feeding the prefix in again for each of them.  The clone gets a new handle and is
+ * authorized as if it were a new operation on the same key, with \p additional_params as its begin
+ * params: it counts as a use of a key with KM_TAG_MAX_USES_PER_BOOT, is subject to
+ * KM_TAG_MIN_SECONDS_BETWEEN_OPS, and an operation that needs a per-operation auth token needs one
+ * for the clone's handle.  The source operation is unaffected.
+ */
+struct CloneOperationRequest : public KeymasterMessage {
+    explicit CloneOperationRequest(int32_t ver = MAX_MESSAGE_VERSION) : KeymasterMessage(ver) {}
+
+    size_t SerializedSize() const override;
+    uint8_t* Serialize(uint8_t* buf, const uint8_t* end) const override;
+    bool Deserialize(const uint8_t** buf_ptr, const uint8_t* end) override;
+
+    keymaster_operation_handle_t op_handle;
+    AuthorizationSet additional_params;
+};
+
+struct CloneOperationResponse : public KeymasterResponse {
+    explicit CloneOperationResponse(int32_t ver = MAX_MESSAGE_VERSION)
+        : KeymasterResponse(ver), op_handle(0) {}
+
+    size_t NonErrorSerializedSize() const override { return sizeof(op_handle); }
+    uint8_t* NonErrorSerialize(uint8_t* buf, const uint8_t* end) const override {
+        return append_uint64_to_buf(buf, end, op_handle);
+    }
+    bool NonErrorDeserialize(const uint8_t** buf_ptr, const uint8_t* end) override {
+        return copy_uint64_from_buf(buf_ptr, end, &op_handle);
+    }
+
+    keymaster_operation_handle_t op_handle;
+};
+
+/**
+ * One record of a BatchAeadOperationRequest: a complete message, encrypted or decrypted on its own
+ * with its own nonce and associated data.  As with a single AES-GCM operation, the tag follows the
+ * ciphertext, in the output when encrypting and in the input when decrypting.  An empty nonce asks
+ * for a random one when encrypting.
+ */
+struct AeadRecord : public Serializable {
+    size_t SerializedSize() const override;
+    uint8_t* Serialize(uint8_t* buf, const uint8_t* end) const override;
+    bool Deserialize(const uint8_t** buf_ptr, const uint8_t* end) override;
+
+    KeymasterBlob nonce;
+    KeymasterBlob associated_data;
+    Buffer input;
+};
+
+/**
+ * The outcome of one AeadRecord.  \p nonce is the nonce that was used.  \p output is empty unless
+ * \p error is KM_ERROR_OK.
+ */
+struct AeadRecordResult : public Serializable {
+    size_t SerializedSize() const override;
+    uint8_t* Serialize(uint8_t* buf, const uint8_t* end) const override;
+    bool Deserialize(const uint8_t** buf_ptr, const uint8_t* end) override;
+
+    keymaster_error_t error = KM_ERROR_OK;
+    KeymasterBlob nonce;
+    Buffer output;
+};
+
+/**
+ * Encrypts or decrypts many independent records with one AES-GCM key, setting the key up once
+ * rather than once per record.  \p additional_params are those of a begin: block mode, MAC length,
+ * padding and application ID and data.  The batch is authorized once, as a single operation, so
+ * keys that need a per-operation auth token can't be used.  Each record succeeds or fails on its own.
+ */
+struct BatchAeadOperationRequest : public KeymasterMessage {
+    explicit BatchAeadOperationRequest(int32_t ver = MAX_MESSAGE_VERSION)
+        : KeymasterMessage(ver), record_count(0) {}
+
+    // Replaces the records with \p count empty ones.
+    bool SetRecordCount(size_t count);
+
+    size_t SerializedSize() const override;
+    uint8_t* Serialize(uint8_t* buf, const uint8_t* end) const override;
+    bool Deserialize(const uint8_t** buf_ptr, const uint8_t* end) override;
+
+    keymaster_purpose_t purpose;
+    KeymasterKeyBlob key_blob;
+    AuthorizationSet additional_params;
+    UniquePtr<AeadRecord[]> records;
+    size_t record_count;
+};
+
+struct BatchAeadOperationResponse : public KeymasterResponse {
+    explicit BatchAeadOperationResponse(int32_t ver = MAX_MESSAGE_VERSION)
+        : KeymasterResponse(ver), result_count(0) {}
+
+    // Replaces the results with \p count empty ones.
+    bool SetResultCount(size_t count);
+
+    size_t NonErrorSerializedSize() const override;
+    uint8_t* NonErrorSerialize(uint8_t* buf, const uint8_t* end) const override;
+    bool NonErrorDeserialize(const uint8_t** buf_ptr, const uint8_t* end) override;
+
+    UniquePtr<AeadRecordResult[]> results;
+    size_t result_count;
+};
+
+/**
+ * Seals (SEAL_RECORD) or opens (OPEN_RECORD) the next record of an AES-GCM encrypt or decrypt
+ * operation, treating the operation as a stream of records rather than one message.  The nonce
+ * given to or returned from begin is the base for the stream; each record's nonce is the base XORed
+ * with the record's sequence number, which starts at zero and goes up by one with every record, as
+ * in TLS 1.3.  Each record is complete: sealed records end in their tag, and records to be opened
+ * must too.  The record's associated data is passed as KM_TAG_ASSOCIATED_DATA in
+ * \p additional_params.
+ *
+ * An operation that has been updated can't be used as a stream, and one that has been used as a
+ * stream can't be updated; finish ends the stream.  As with update, any error ends the operation.
+ */
+struct ProcessRecordRequest : public KeymasterMessage {
+    explicit ProcessRecordRequest(int32_t ver = MAX_MESSAGE_VERSION)
+        : KeymasterMessage(ver), op_handle(0) {}
+
+    size_t SerializedSize() const override;
+    uint8_t* Serialize(uint8_t* buf, const uint8_t* end) const override;
+    bool Deserialize(const uint8_t** buf_ptr, const uint8_t* end) override;
+
+    keymaster_operation_handle_t op_handle;
+    Buffer input;
+    AuthorizationSet additional_params;
+};
+
+struct ProcessRecordResponse : public KeymasterResponse {
+    explicit ProcessRecordResponse(int32_t ver = MAX_MESSAGE_VERSION)
+        : KeymasterResponse(ver), sequence_number(0) {}
+
+    size_t NonErrorSerializedSize() const override;
+    uint8_t* NonErrorSerialize(uint8_t* buf, const uint8_t* end) const override;
+    bool NonErrorDeserialize(const uint8_t** buf_ptr, const uint8_t* end) override;
+
+    uint64_t sequence_number;
+    Buffer output;
+};
+
 struct AddEntropyRequest : public KeymasterMessage {
     explicit AddEntropyRequest(int32_t ver = MAX_MESSAGE_VERSION) : KeymasterMessage(ver) {}
 
@@ -27,6 +27,7 @@
 namespace keymaster {
 
 class AuthorizationSetBuilder;
+struct SharedAuthorizationSet;
 
 /**
  * An extension of the keymaster_key_param_set_t struct, which provides serialization memory
@@ -76,12 +77,15 @@ class AuthorizationSet : public Serializable, public keymaster_key_param_set_t {
      */
     explicit AuthorizationSet(/* NOT const */ AuthorizationSetBuilder& builder);
 
-    // Copy constructor.
+    // Copy constructor.  Copies of a shared set (see \p is_shared) share its storage.
     AuthorizationSet(const AuthorizationSet& set) : Serializable(), indirect_data_(nullptr) {
         elems_ = nullptr;
         error_ = set.error_;
         if (error_ != OK) return;
-        Reinitialize(set.elems_, set.elems_size_);
+        if (set.shared_)
+            ShareFrom(set);
+        else
+            Reinitialize(set.elems_, set.elems_size_);
     }
 
     // Move constructor.
@@ -89,9 +93,13 @@ class AuthorizationSet : public Serializable, public keymaster_key_param_set_t {
         MoveFrom(set);
     }
 
-    // Copy assignment.
+    // Copy assignment.  Copies of a shared set (see \p is_shared) share its storage.
     AuthorizationSet& operator=(const AuthorizationSet& set) {
-        Reinitialize(set.elems_, set.elems_size_);
+        if (&set == this) return *this;
+        if (set.shared_)
+            ShareFrom(set);
+        else
+            Reinitialize(set.elems_, set.elems_size_);
         error_ = set.error_;
         return *this;
     }
@@ -124,6 +132,32 @@ class AuthorizationSet : public Serializable, public keymaster_key_param_set_t {
         return Reinitialize(set.params, set.length);
     }
 
+    /**
+     * Reinitialize an AuthorizationSet as a read-only view of the provided array, without copying
+     * the elements or the data referenced by their embedded pointers.  The caller retains
+     * ownership of all of it, and it must outlive the AuthorizationSet or its next
+     * Reinitialize/Clear.  Any modification first copies the data into dynamically-allocated
+     * storage, so the caller's memory is never written.
+     */
+    void ReinitializeBorrowed(const keymaster_key_param_t* elems, size_t count);
+
+    void ReinitializeBorrowed(const keymaster_key_param_set_t& set) {
+        ReinitializeBorrowed(set.params, set.length);
+    }
+
+    /**
+     * Returns true if the set is a view of caller-owned data (see \p ReinitializeBorrowed).
+     */
+    bool is_borrowed() const { return borrowed_; }
+
+    /**
+     * Returns true if the set is a read-only view of storage shared with other sets, which it got
+     * from an AuthorizationSetInterner or by being copied from such a set.  Copying a shared set
+     * just takes another reference to the storage; any modification first gives the set its own
+     * copy, leaving the others as they were.
+     */
+    bool is_shared() const { return shared_ != nullptr; }
+
     ~AuthorizationSet();
 
     enum Error {
@@ -161,18 +195,23 @@ class AuthorizationSet : public Serializable, public keymaster_key_param_set_t {
 
     /**
      * Sorts the set and removes duplicates (inadvertently duplicating tags is easy to do with the
-     * AuthorizationSetBuilder).
+     * AuthorizationSetBuilder).  The set remembers that it is deduplicated until an element is
+     * added out of order, so doing it again is free.  After the non-const operator[] has been used
+     * it's done in full every time, until the elements are freed or reallocated.
      */
     void Deduplicate();
 
     /**
      * Adds all elements from \p set that are not already present in this AuthorizationSet.  As a
-     * side-effect, if \p set is not null this AuthorizationSet will end up sorted.
+     * side-effect, if \p set is not null this AuthorizationSet will end up sorted and
+     * deduplicated.  Takes linear time, plus the time to sort either set if it isn't already.
      */
     void Union(const keymaster_key_param_set_t& set);
 
     /**
-     * Removes all elements in \p set from this AuthorizationSet.
+     * Removes all elements in \p set from this AuthorizationSet.  As a side-effect, if \p set is
+     * not null this AuthorizationSet will end up sorted and deduplicated.  Takes linear time, plus
+     * the time to sort either set if it isn't already.
      */
     void Difference(const keymaster_key_param_set_t& set);
 
@@ -437,11 +476,23 @@ class AuthorizationSet : public Serializable, public keymaster_key_param_set_t {
     uint8_t* Serialize(uint8_t* serialized_set, const uint8_t* end) const;
     bool Deserialize(const uint8_t** buf_ptr, const uint8_t* end);
 
+    /**
+     * Returns the serialized size of the elements.  It is computed at most once between
+     * modifications of the set, so it is cheap to call before Serialize, which needs it too.  Once
+     * the non-const operator[] has handed out a reference, the size is recomputed on every call
+     * until the elements are freed or reallocated, since writes through the reference can't be
+     * seen.
+     */
     size_t SerializedSizeOfElements() const;
 
   private:
+    friend class AuthorizationSetInterner;
+
     void FreeData();
     void MoveFrom(AuthorizationSet& set);
+    bool CopyBorrowedData();
+    void ShareFrom(const AuthorizationSet& set);
+    void ShareFrom(SharedAuthorizationSet* shared);
 
     void set_invalid(Error err);
 
@@ -449,6 +500,7 @@ class AuthorizationSet : public Serializable, public keymaster_key_param_set_t {
     void CopyIndirectData();
     bool CheckIndirectData();
 
+    uint8_t* SerializeBorrowed(uint8_t* buf, const uint8_t* end) const;
     bool DeserializeIndirectData(const uint8_t** buf_ptr, const uint8_t* end);
     bool DeserializeElementsData(const uint8_t** buf_ptr, const uint8_t* end);
 
@@ -475,6 +527,58 @@ class AuthorizationSet : public Serializable, public keymaster_key_param_set_t {
     size_t indirect_data_size_;
     size_t indirect_data_capacity_;
     Error error_;
+    bool borrowed_ = false;
+    SharedAuthorizationSet* shared_ = nullptr;  // Set only if borrowed_ is.
+    mutable size_t elems_serialized_size_ = 0;
+    mutable bool elems_serialized_size_valid_ = false;
+    // True if the elements are known to be sorted, with no duplicates or invalid entries.
+    bool deduplicated_ = false;
+    // True if the non-const operator[] has returned a reference into elems_, through which the
+    // elements may change unseen.  The two caches above aren't trusted while it's set.
+    bool elems_exposed_ = false;
+};
+
+/**
+ * Interns AuthorizationSets by content, so that sets with the same elements in the same order share
+ * one copy of them.  Only KeyCharacteristicsCache interns sets; the sets the software contexts
+ * parse from key blobs are private copies.
+ *
+ * The interner holds a reference to each set it has interned.  Sets that nothing else refers to any
+ * more are released by \p Purge, which the interner also does before growing its table.  Interned
+ * storage is reference counted and outlives the interner if it is still in use.
+ *
+ * Not thread-safe, though the shared sets it produces may be copied and released on any thread.
+ */
+class AuthorizationSetInterner {
+  public:
+    AuthorizationSetInterner() : buckets_(nullptr), bucket_count_(0), size_(0) {}
+    ~AuthorizationSetInterner();
+    AuthorizationSetInterner(const AuthorizationSetInterner&) = delete;
+    void operator=(const AuthorizationSetInterner&) = delete;
+
+    /**
+     * Replaces the contents of \p set with a shared reference to an interned set with the same
+     * elements, interning a copy of \p set if there isn't one yet.  Returns false, leaving \p set
+     * as it was, if \p set is invalid or allocation fails.
+     */
+    bool Intern(AuthorizationSet* set);
+
+    /**
+     * Releases the interned sets that are no longer referred to outside the interner.
+     */
+    void Purge();
+
+    /**
+     * Returns the number of distinct sets held.
+     */
+    size_t size() const { return size_; }
+
+  private:
+    bool Grow();
+
+    SharedAuthorizationSet** buckets_;
+    size_t bucket_count_;  // Zero or a power of two.
+    size_t size_;
 };
 
 class AuthorizationSetBuilder {
@@ -516,16 +620,22 @@ class AuthorizationSetBuilder {
     AuthorizationSetBuilder& EcdsaKey(uint32_t key_size);
     AuthorizationSetBuilder& AesKey(uint32_t key_size);
     AuthorizationSetBuilder& TripleDesKey(uint32_t key_size);
+    AuthorizationSetBuilder& ChaCha20Poly1305Key();
     AuthorizationSetBuilder& HmacKey(uint32_t key_size);
 
     AuthorizationSetBuilder& RsaSigningKey(uint32_t key_size, uint64_t public_exponent);
     AuthorizationSetBuilder& RsaEncryptionKey(uint32_t key_size, uint64_t public_exponent);
     AuthorizationSetBuilder& EcdsaSigningKey(uint32_t key_size);
+    AuthorizationSetBuilder& Ed25519SigningKey();
+    AuthorizationSetBuilder& EcdhKey(uint32_t key_size);
+    AuthorizationSetBuilder& X25519Key();
     AuthorizationSetBuilder& AesEncryptionKey(uint32_t key_size);
     AuthorizationSetBuilder& TripleDesEncryptionKey(uint32_t key_size);
+    AuthorizationSetBuilder& ChaCha20Poly1305EncryptionKey(uint32_t min_mac_length);
 
     AuthorizationSetBuilder& SigningKey();
     AuthorizationSetBuilder& EncryptionKey();
+    AuthorizationSetBuilder& AgreementKey();
     AuthorizationSetBuilder& NoDigestOrPadding();
     AuthorizationSetBuilder& EcbMode();
 
@@ -577,6 +687,11 @@ inline AuthorizationSetBuilder& AuthorizationSetBuilder::TripleDesKey(uint32_t k
     return Authorization(TAG_KEY_SIZE, key_size);
 }
 
+inline AuthorizationSetBuilder& AuthorizationSetBuilder::ChaCha20Poly1305Key() {
+    Authorization(TAG_ALGORITHM, KM_ALGORITHM_CHACHA20_POLY1305);
+    return Authorization(TAG_KEY_SIZE, 256);
+}
+
 inline AuthorizationSetBuilder& AuthorizationSetBuilder::HmacKey(uint32_t key_size) {
     Authorization(TAG_ALGORITHM, KM_ALGORITHM_HMAC);
     Authorization(TAG_KEY_SIZE, key_size);
@@ -600,6 +715,23 @@ inline AuthorizationSetBuilder& AuthorizationSetBuilder::EcdsaSigningKey(uint32_
     return SigningKey();
 }
 
+inline AuthorizationSetBuilder& AuthorizationSetBuilder::Ed25519SigningKey() {
+    Authorization(TAG_ALGORITHM, KM_ALGORITHM_EC);
+    Authorization(TAG_EC_CURVE, KM_EC_CURVE_CURVE_25519);
+    return SigningKey();
+}
+
+inline AuthorizationSetBuilder& AuthorizationSetBuilder::EcdhKey(uint32_t key_size) {
+    EcdsaKey(key_size);
+    return AgreementKey();
+}
+
+inline AuthorizationSetBuilder& AuthorizationSetBuilder::X25519Key() {
+    Authorization(TAG_ALGORITHM, KM_ALGORITHM_EC);
+    Authorization(TAG_EC_CURVE, KM_EC_CURVE_CURVE_25519);
+    return AgreementKey();
+}
+
 inline AuthorizationSetBuilder& AuthorizationSetBuilder::AesEncryptionKey(uint32_t key_size) {
     AesKey(key_size);
     return EncryptionKey();
@@ -610,6 +742,13 @@ inline AuthorizationSetBuilder& AuthorizationSetBuilder::TripleDesEncryptionKey(
     return EncryptionKey();
 }
 
+inline AuthorizationSetBuilder&
+AuthorizationSetBuilder::ChaCha20Poly1305EncryptionKey(uint32_t min_mac_length) {
+    ChaCha20Poly1305Key();
+    Authorization(TAG_MIN_MAC_LENGTH, min_mac_length);
+    return EncryptionKey();
+}
+
 inline AuthorizationSetBuilder& AuthorizationSetBuilder::SigningKey() {
     Authorization(TAG_PURPOSE, KM_PURPOSE_SIGN);
     return Authorization(TAG_PURPOSE, KM_PURPOSE_VERIFY);
@@ -620,6 +759,10 @@ inline AuthorizationSetBuilder& AuthorizationSetBuilder::EncryptionKey() {
     return Authorization(TAG_PURPOSE, KM_PURPOSE_DECRYPT);
 }
 
+inline AuthorizationSetBuilder& AuthorizationSetBuilder::AgreementKey() {
+    return Authorization(TAG_PURPOSE, KM_PURPOSE_AGREE_KEY);
+}
+
 inline AuthorizationSetBuilder& AuthorizationSetBuilder::NoDigestOrPadding() {
     Authorization(TAG_DIGEST, KM_DIGEST_NONE);
     return Authorization(TAG_PADDING, KM_PAD_NONE);
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYSTEM_KEYMASTER_KEY_REVOCATION_REGISTRY_H_
+#define SYSTEM_KEYMASTER_KEY_REVOCATION_REGISTRY_H_
+
+#include <string>
+
+#include <openssl/sha.h>
+
+#include <hardware/keymaster_defs.h>
+
+#include <keymaster/UniquePtr.h>
+
+namespace keymaster {
+
+/**
+ * Records which key blobs have been deleted, for contexts whose blobs carry everything needed to
+ * use them and so would otherwise keep working after DeleteKey.
+ *
+ * A blob is identified by its SHA-256 digest.  The digests are kept in a file, sorted, which is
+ * mapped into memory rather than read.  In front of it is an in-memory Bloom filter, so checking a
+ * blob that hasn't been revoked, which is by far the common case, costs a few bit probes; only
+ * filter hits go on to a binary search of the file.  Revoking a blob rewrites the file, which is
+ * fine for something that happens as rarely as deleting a key.
+ *
+ * Not thread-safe.
+ */
+class KeyRevocationRegistry {
+  public:
+    KeyRevocationRegistry();
+    ~KeyRevocationRegistry();
+    KeyRevocationRegistry(const KeyRevocationRegistry&) = delete;
+    void operator=(const KeyRevocationRegistry&) = delete;
+
+    /**
+     * Loads the registry kept in the file at \p path.  If there's no file yet, the registry starts
+     * out empty and the file is created by the first Revoke().
+     */
+    keymaster_error_t Init(const char* path);
+
+    bool IsRevoked(const keymaster_key_blob_t& blob) const;
+
+    /**
+     * Adds \p blob to the registry and writes it out.  Revoking a blob that is already revoked
+     * does nothing.
+     */
+    keymaster_error_t Revoke(const keymaster_key_blob_t& blob);
+
+    size_t size() const { return entry_count_; }
+
+  private:
+    static const size_t kIdSize = SHA256_DIGEST_LENGTH;
+
+    keymaster_error_t MapFile();
+    void UnmapFile();
+    keymaster_error_t WriteFile(const uint8_t* entries, size_t entry_count) const;
+    bool BuildFilter(size_t capacity);
+    void AddToFilter(const uint8_t* id);
+    bool FilterMayContain(const uint8_t* id) const;
+    // Returns the index of the first entry not less than \p id.
+    size_t LowerBound(const uint8_t* id) const;
+    const uint8_t* entry(size_t i) const { return entries_ + i * kIdSize; }
+
+    std::string path_;
+    const uint8_t* entries_;
+    size_t entry_count_;
+    size_t mapped_size_;
+    UniquePtr<uint64_t[]> filter_;
+    size_t filter_bits_;  // Always a power of two.
+};
+
+}  // namespace keymaster
+
+#endif  // SYSTEM_KEYMASTER_KEY_REVOCATION_REGISTRY_H_
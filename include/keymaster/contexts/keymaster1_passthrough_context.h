@@ -26,6 +26,7 @@
 #include <keymaster/attestation_record.h>
 #include <keymaster/keymaster_context.h>
 #include <keymaster/km_openssl/software_random_source.h>
+#include <keymaster/legacy_support/key_characteristics_cache.h>
 #include <keymaster/legacy_support/keymaster1_engine.h>
 #include <keymaster/legacy_support/keymaster_passthrough_engine.h>
 #include <keymaster/legacy_support/keymaster_passthrough_key.h>
@@ -38,7 +39,12 @@ class Keymaster1PassthroughContext : public KeymasterContext,
                                      public SoftwareRandomSource,
                                      public SoftwareKeyBlobMaker {
   public:
-    explicit Keymaster1PassthroughContext(keymaster1_device_t* dev);
+    /**
+     * Wraps \p dev.  \p max_concurrent_device_calls limits the calls that the Keymaster1Engine
+     * for keys needing software digesting makes into it at once; see Keymaster1Engine.
+     */
+    explicit Keymaster1PassthroughContext(keymaster1_device_t* dev,
+                                          size_t max_concurrent_device_calls = 1);
 
     /**
      * Sets the system version as reported by the system *itself*.  This is used to verify that the
@@ -126,6 +132,7 @@ class Keymaster1PassthroughContext : public KeymasterContext,
     mutable std::unordered_map<keymaster_algorithm_t, UniquePtr<KeyFactory>> factories_;
     UniquePtr<KeymasterPassthroughEngine> pt_engine_;
     UniquePtr<Keymaster1Engine> km1_engine_;
+    mutable KeyCharacteristicsCache characteristics_cache_;
 
     uint32_t os_version_;
     uint32_t os_patchlevel_;
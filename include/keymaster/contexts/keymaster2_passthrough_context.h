@@ -24,6 +24,7 @@
 #include <hardware/keymaster_defs.h>
 
 #include <keymaster/keymaster_context.h>
+#include <keymaster/legacy_support/key_characteristics_cache.h>
 #include <keymaster/legacy_support/keymaster_passthrough_engine.h>
 #include <keymaster/legacy_support/keymaster_passthrough_key.h>
 
@@ -109,10 +110,19 @@ class Keymaster2PassthroughContext : public KeymasterContext {
               KeymasterKeyBlob* wrapped_key_material) const override;
 
   private:
+    /**
+     * Fetches the characteristics of \p blob from the device and caches them.
+     */
+    keymaster_error_t GetKeyCharacteristics(const KeymasterKeyBlob& blob,
+                                            const AuthorizationSet& additional_params,
+                                            AuthorizationSet* hw_enforced,
+                                            AuthorizationSet* sw_enforced) const;
+
     keymaster2_device_t* device_;
     mutable std::unordered_map<keymaster_algorithm_t, UniquePtr<KeymasterPassthroughKeyFactory>>
         factories_;
     UniquePtr<KeymasterPassthroughEngine> engine_;
+    mutable KeyCharacteristicsCache characteristics_cache_;
     uint32_t os_version_;
     uint32_t os_patchlevel_;
 };
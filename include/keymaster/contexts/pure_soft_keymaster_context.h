@@ -23,6 +23,7 @@
 
 #include <keymaster/keymaster_context.h>
 #include <keymaster/attestation_record.h>
+#include <keymaster/contexts/key_revocation_registry.h>
 #include <keymaster/km_openssl/software_random_source.h>
 #include <keymaster/km_openssl/soft_keymaster_enforcement.h>
 #include <keymaster/soft_key_factory.h>
@@ -30,6 +31,11 @@
 
 namespace keymaster {
 
+/**
+ * Where the software keymaster HALs keep the registry of the blobs deleted through them.
+ */
+const char kSoftKeyRevocationRegistryPath[] = "/data/vendor/keymaster/revoked_keys";
+
 class SoftKeymasterKeyRegistrations;
 class Keymaster0Engine;
 class Keymaster1Engine;
@@ -46,6 +52,23 @@ class PureSoftKeymasterContext: public KeymasterContext,
     explicit PureSoftKeymasterContext();
     ~PureSoftKeymasterContext() override;
 
+    /**
+     * Makes DeleteKey() revoke blobs by recording them in \p registry, after which they no longer
+     * parse.  Without a registry DeleteKey() does nothing, and a deleted blob keeps working, since
+     * software blobs carry everything needed to use them.
+     */
+    void SetKeyRevocationRegistry(std::unique_ptr<KeyRevocationRegistry> registry) {
+        revoked_keys_ = std::move(registry);
+        revocation_error_ = KM_ERROR_OK;
+    }
+
+    /**
+     * Loads the registry kept in the file at \p path and installs it as SetKeyRevocationRegistry
+     * does.  If it can't be loaded, no registry is installed and DeleteKey() fails with the
+     * returned error, rather than reporting success for blobs that would keep working.
+     */
+    keymaster_error_t InitKeyRevocationRegistry(const char* path);
+
     /*********************************************************************************************
      * Implement KeymasterContext
      */
@@ -95,10 +118,13 @@ class PureSoftKeymasterContext: public KeymasterContext,
     std::unique_ptr<KeyFactory> ec_factory_;
     std::unique_ptr<KeyFactory> aes_factory_;
     std::unique_ptr<KeyFactory> tdes_factory_;
+    std::unique_ptr<KeyFactory> chacha20_poly1305_factory_;
     std::unique_ptr<KeyFactory> hmac_factory_;
     uint32_t os_version_;
     uint32_t os_patchlevel_;
     SoftKeymasterEnforcement soft_keymaster_enforcement_;
+    std::unique_ptr<KeyRevocationRegistry> revoked_keys_;
+    keymaster_error_t revocation_error_ = KM_ERROR_OK;
 };
 
 }  // namespace keymaster
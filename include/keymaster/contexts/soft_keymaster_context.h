@@ -57,8 +57,12 @@ class SoftKeymasterContext: public KeymasterContext, SoftwareKeyBlobMaker, Softw
      * Use the specified HW keymaster1 device for performing undigested RSA and EC operations after
      * digesting has been done in software.  Takes ownership of the specified device (will call
      * keymaster1_device->common.close());
+     *
+     * \p max_concurrent_device_calls limits the calls that the Keymaster1Engine makes into the
+     * device at once; see Keymaster1Engine.
      */
-    keymaster_error_t SetHardwareDevice(keymaster1_device_t* keymaster1_device);
+    keymaster_error_t SetHardwareDevice(keymaster1_device_t* keymaster1_device,
+                                        size_t max_concurrent_device_calls = 1);
 
     /*********************************************************************************************
      * Implement KeymasterContext
@@ -121,6 +125,7 @@ class SoftKeymasterContext: public KeymasterContext, SoftwareKeyBlobMaker, Softw
     std::unique_ptr<KeyFactory> ec_factory_;
     std::unique_ptr<KeyFactory> aes_factory_;
     std::unique_ptr<KeyFactory> tdes_factory_;
+    std::unique_ptr<KeyFactory> chacha20_poly1305_factory_;
     std::unique_ptr<KeyFactory> hmac_factory_;
     keymaster1_device* km1_dev_;
     const KeymasterBlob root_of_trust_;
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SYSTEM_KEYMASTER_EXPORTED_KEY_CACHE_H
+#define SYSTEM_KEYMASTER_EXPORTED_KEY_CACHE_H
+
+#include <keymaster/UniquePtr.h>
+
+#include <hardware/keymaster_defs.h>
+#include <keymaster/android_keymaster_utils.h>
+#include <keymaster/authorization_set.h>
+
+namespace keymaster {
+
+struct ExportKeyRequest;
+
+/**
+ * A small, fixed-size cache of recent ExportKey results.  Exporting a key means parsing (and
+ * authenticating or decrypting) its blob and re-encoding the public key, but the result for a
+ * given blob never changes, and clients tend to export the same keys over and over.
+ *
+ * An entry only matches a request with identical key blob bytes, format and additional parameters,
+ * so APPLICATION_ID and APPLICATION_DATA are still enforced, made under the same OS version and
+ * patchlevel, because a version change can make a blob require upgrade.  Deleting keys must clear
+ * the cache.
+ */
+class ExportedKeyCache {
+  public:
+    explicit ExportedKeyCache(size_t cache_size) : cache_size_(cache_size), next_entry_(0) {}
+
+    /**
+     * If the result of exporting the key in \p request under the specified system version is
+     * cached, copies it to \p material and \p size and returns true.
+     */
+    bool Find(const ExportKeyRequest& request, uint32_t os_version, uint32_t os_patchlevel,
+              UniquePtr<uint8_t[]>* material, size_t* size) const;
+
+    /**
+     * Caches \p material as the result of exporting the key in \p request, replacing the oldest
+     * entry if the cache is full.  If allocation fails the result just isn't cached.
+     */
+    void Add(const ExportKeyRequest& request, uint32_t os_version, uint32_t os_patchlevel,
+             const uint8_t* material, size_t size);
+
+    void Clear();
+
+  private:
+    struct Entry {
+        KeymasterKeyBlob key_blob;
+        keymaster_key_format_t key_format;
+        AuthorizationSet additional_params;
+        uint32_t os_version;
+        uint32_t os_patchlevel;
+        KeymasterBlob material;
+    };
+
+    bool Matches(const Entry& entry, const ExportKeyRequest& request, uint32_t os_version,
+                 uint32_t os_patchlevel) const;
+
+    UniquePtr<Entry[]> entries_;
+    size_t cache_size_;
+    size_t next_entry_;
+};
+
+}  // namespace keymaster
+
+#endif  // SYSTEM_KEYMASTER_EXPORTED_KEY_CACHE_H
@@ -60,6 +60,19 @@ namespace keymaster {
 static const keymaster_tag_t KM_TAG_DIGEST_OLD = static_cast<keymaster_tag_t>(KM_ENUM | 5);
 static const keymaster_tag_t KM_TAG_PADDING_OLD = static_cast<keymaster_tag_t>(KM_ENUM | 7);
 
+// ChaCha20-Poly1305 is implemented only by the software keymaster, so the HAL doesn't define an
+// algorithm value for it.  This one is chosen well clear of the values the HAL does define.
+static const keymaster_algorithm_t KM_ALGORITHM_CHACHA20_POLY1305 =
+    static_cast<keymaster_algorithm_t>(64);
+
+// Ed25519 signing keys and X25519 key agreement keys are EC keys on this curve.  The value is the
+// one later HAL versions assign to curve 25519, so blobs created now will keep their meaning.
+static const keymaster_ec_curve_t KM_EC_CURVE_CURVE_25519 = static_cast<keymaster_ec_curve_t>(4);
+
+// Key agreement (ECDH and X25519) with EC keys.  As with curve 25519, the value is the one later HAL
+// versions assign.
+static const keymaster_purpose_t KM_PURPOSE_AGREE_KEY = static_cast<keymaster_purpose_t>(6);
+
 // Until we have C++11, fake std::static_assert.
 template <bool b> struct StaticAssert {};
 template <> struct StaticAssert<true> {
@@ -131,6 +144,174 @@ class TypedEnumTag {
 const char* StringifyTag(keymaster_tag_t tag);
 #endif
 
+/**
+ * What is known about each keymaster tag.  The type and repeatability are encoded in the tag
+ * itself, and read with keymaster_tag_get_type and keymaster_tag_repeatable; the table adds the
+ * name, and whether the tag is one this implementation knows at all.
+ */
+struct TagInfo {
+    keymaster_tag_t tag;
+    const char* name;  // Null unless built with KEYMASTER_NAME_TAGS.
+};
+
+#ifdef KEYMASTER_NAME_TAGS
+#define KEYMASTER_TAG_INFO(tag) {tag, #tag}
+#else
+#define KEYMASTER_TAG_INFO(tag) {tag, nullptr}
+#endif
+
+constexpr TagInfo kTagInfo[] = {
+    KEYMASTER_TAG_INFO(KM_TAG_INVALID),
+    KEYMASTER_TAG_INFO(KM_TAG_PURPOSE),
+    KEYMASTER_TAG_INFO(KM_TAG_ALGORITHM),
+    KEYMASTER_TAG_INFO(KM_TAG_KEY_SIZE),
+    KEYMASTER_TAG_INFO(KM_TAG_BLOCK_MODE),
+    KEYMASTER_TAG_INFO(KM_TAG_DIGEST),
+    KEYMASTER_TAG_INFO(KM_TAG_PADDING),
+    KEYMASTER_TAG_INFO(KM_TAG_CALLER_NONCE),
+    KEYMASTER_TAG_INFO(KM_TAG_MIN_MAC_LENGTH),
+    KEYMASTER_TAG_INFO(KM_TAG_RSA_PUBLIC_EXPONENT),
+    KEYMASTER_TAG_INFO(KM_TAG_BLOB_USAGE_REQUIREMENTS),
+    KEYMASTER_TAG_INFO(KM_TAG_BOOTLOADER_ONLY),
+    KEYMASTER_TAG_INFO(KM_TAG_ACTIVE_DATETIME),
+    KEYMASTER_TAG_INFO(KM_TAG_ORIGINATION_EXPIRE_DATETIME),
+    KEYMASTER_TAG_INFO(KM_TAG_USAGE_EXPIRE_DATETIME),
+    KEYMASTER_TAG_INFO(KM_TAG_MIN_SECONDS_BETWEEN_OPS),
+    KEYMASTER_TAG_INFO(KM_TAG_MAX_USES_PER_BOOT),
+    KEYMASTER_TAG_INFO(KM_TAG_ALL_USERS),
+    KEYMASTER_TAG_INFO(KM_TAG_USER_ID),
+    KEYMASTER_TAG_INFO(KM_TAG_USER_SECURE_ID),
+    KEYMASTER_TAG_INFO(KM_TAG_NO_AUTH_REQUIRED),
+    KEYMASTER_TAG_INFO(KM_TAG_USER_AUTH_TYPE),
+    KEYMASTER_TAG_INFO(KM_TAG_AUTH_TIMEOUT),
+    KEYMASTER_TAG_INFO(KM_TAG_ALL_APPLICATIONS),
+    KEYMASTER_TAG_INFO(KM_TAG_APPLICATION_ID),
+    KEYMASTER_TAG_INFO(KM_TAG_APPLICATION_DATA),
+    KEYMASTER_TAG_INFO(KM_TAG_CREATION_DATETIME),
+    KEYMASTER_TAG_INFO(KM_TAG_ORIGIN),
+    KEYMASTER_TAG_INFO(KM_TAG_ROLLBACK_RESISTANT),
+    KEYMASTER_TAG_INFO(KM_TAG_ROOT_OF_TRUST),
+    KEYMASTER_TAG_INFO(KM_TAG_ASSOCIATED_DATA),
+    KEYMASTER_TAG_INFO(KM_TAG_NONCE),
+    KEYMASTER_TAG_INFO(KM_TAG_AUTH_TOKEN),
+    KEYMASTER_TAG_INFO(KM_TAG_MAC_LENGTH),
+    KEYMASTER_TAG_INFO(KM_TAG_KDF),
+    KEYMASTER_TAG_INFO(KM_TAG_EC_CURVE),
+    KEYMASTER_TAG_INFO(KM_TAG_ECIES_SINGLE_HASH_MODE),
+    KEYMASTER_TAG_INFO(KM_TAG_OS_VERSION),
+    KEYMASTER_TAG_INFO(KM_TAG_OS_PATCHLEVEL),
+    KEYMASTER_TAG_INFO(KM_TAG_EXPORTABLE),
+    KEYMASTER_TAG_INFO(KM_TAG_UNIQUE_ID),
+    KEYMASTER_TAG_INFO(KM_TAG_INCLUDE_UNIQUE_ID),
+    KEYMASTER_TAG_INFO(KM_TAG_RESET_SINCE_ID_ROTATION),
+    KEYMASTER_TAG_INFO(KM_TAG_ALLOW_WHILE_ON_BODY),
+    KEYMASTER_TAG_INFO(KM_TAG_TRUSTED_CONFIRMATION_REQUIRED),
+    KEYMASTER_TAG_INFO(KM_TAG_UNLOCKED_DEVICE_REQUIRED),
+    KEYMASTER_TAG_INFO(KM_TAG_ATTESTATION_CHALLENGE),
+    KEYMASTER_TAG_INFO(KM_TAG_ATTESTATION_APPLICATION_ID),
+    KEYMASTER_TAG_INFO(KM_TAG_ATTESTATION_ID_BRAND),
+    KEYMASTER_TAG_INFO(KM_TAG_ATTESTATION_ID_DEVICE),
+    KEYMASTER_TAG_INFO(KM_TAG_ATTESTATION_ID_PRODUCT),
+    KEYMASTER_TAG_INFO(KM_TAG_ATTESTATION_ID_SERIAL),
+    KEYMASTER_TAG_INFO(KM_TAG_ATTESTATION_ID_IMEI),
+    KEYMASTER_TAG_INFO(KM_TAG_ATTESTATION_ID_MEID),
+    KEYMASTER_TAG_INFO(KM_TAG_ATTESTATION_ID_MANUFACTURER),
+    KEYMASTER_TAG_INFO(KM_TAG_ATTESTATION_ID_MODEL),
+};
+
+#undef KEYMASTER_TAG_INFO
+
+constexpr size_t kTagCount = sizeof(kTagInfo) / sizeof(kTagInfo[0]);
+
+/*
+ * Tags are looked up in kTagInfo through a perfect hash, found at compile time: a multiplicative
+ * hash into kTagSlotCount slots, with the first multiplier that sends no two known tags to the
+ * same slot.  With about 10% of the slots in use only a few multipliers need to be tried.  If
+ * adding tags ever makes the search too long for the compiler, raise kTagSlotBits.
+ */
+constexpr uint32_t kTagSlotBits = 9;
+constexpr uint32_t kTagSlotCount = 1 << kTagSlotBits;
+constexpr uint8_t kNoTagIndex = 0xFF;
+static_assert(kTagCount < kNoTagIndex, "Tag indices must fit in a uint8_t");
+
+constexpr uint32_t TagSlot(keymaster_tag_t tag, uint32_t multiplier) {
+    return (static_cast<uint32_t>(tag) * multiplier) >> (32 - kTagSlotBits);
+}
+
+constexpr bool IsPerfectTagMultiplier(uint32_t multiplier) {
+    bool used[kTagSlotCount] = {};
+    for (size_t i = 0; i < kTagCount; ++i) {
+        uint32_t slot = TagSlot(kTagInfo[i].tag, multiplier);
+        if (used[slot])
+            return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t FindTagMultiplier() {
+    uint32_t multiplier = 0x9E3779B1;  // 2^32 divided by the golden ratio, made odd.
+    while (!IsPerfectTagMultiplier(multiplier))
+        multiplier += 2;
+    return multiplier;
+}
+
+constexpr uint32_t kTagMultiplier = FindTagMultiplier();
+
+struct TagIndexTable {
+    uint8_t index[kTagSlotCount];
+};
+
+constexpr TagIndexTable MakeTagIndexTable() {
+    TagIndexTable table = {};
+    for (size_t i = 0; i < kTagSlotCount; ++i)
+        table.index[i] = kNoTagIndex;
+    for (size_t i = 0; i < kTagCount; ++i)
+        table.index[TagSlot(kTagInfo[i].tag, kTagMultiplier)] = static_cast<uint8_t>(i);
+    return table;
+}
+
+constexpr TagIndexTable kTagIndexTable = MakeTagIndexTable();
+
+/**
+ * Returns the position of \p tag in kTagInfo, or kTagCount if it isn't a known tag.  For use in
+ * constant expressions; at run time, call LookupTagIndex, which doesn't need a copy of the tables
+ * in every object file.
+ */
+constexpr size_t TagIndex(keymaster_tag_t tag) {
+    uint8_t index = kTagIndexTable.index[TagSlot(tag, kTagMultiplier)];
+    return index != kNoTagIndex && kTagInfo[index].tag == tag ? index : kTagCount;
+}
+
+size_t LookupTagIndex(keymaster_tag_t tag);
+
+/**
+ * Returns the metadata for \p tag, or null if it isn't a known tag.
+ */
+const TagInfo* GetTagInfo(keymaster_tag_t tag);
+
+/**
+ * A table with an Entry for each known tag, indexed by tag index (see TagIndex), for code that
+ * needs its own information about each tag.  Build it at compile time with MakeTagTable, from a
+ * list of entries for just the tags that matter; the rest are value-initialized.
+ */
+template <typename Entry> struct TagTable {
+    Entry entries[kTagCount];
+
+    const Entry& operator[](size_t index) const { return entries[index]; }
+};
+
+/**
+ * Builds a TagTable from \p list, whose elements must have a \p tag member.  Listing a tag that
+ * isn't in kTagInfo is a compile error when the table is constexpr.
+ */
+template <typename Entry, size_t N> constexpr TagTable<Entry> MakeTagTable(const Entry (&list)[N]) {
+    TagTable<Entry> table = {};
+    for (size_t i = 0; i < N; ++i)
+        table.entries[TagIndex(list[i].tag)] = list[i];
+    return table;
+}
+
 // DECLARE_KEYMASTER_TAG is used to declare TypedTag instances for each non-enum keymaster tag.
 #define DECLARE_KEYMASTER_TAG(type, name) extern TypedTag<type, KM_##name> name
 
@@ -36,6 +36,26 @@ class AsymmetricKey : public Key {
 
     virtual bool InternalToEvp(EVP_PKEY* pkey) const = 0;
     virtual bool EvpToInternal(const EVP_PKEY* pkey) = 0;
+
+    /**
+     * Returns a new EVP_PKEY holding the key, or nullptr on failure.  The default fills an empty
+     * EVP_PKEY with InternalToEvp().  Key types that can't be assigned into an existing EVP_PKEY,
+     * such as Ed25519, override this instead.
+     */
+    virtual EVP_PKEY* CreateEvpKey() const;
+
+    /**
+     * Keys loaded from decoded key material start out with only their public components, which is
+     * all that verification, encryption and key export need.  Operations that use the private key
+     * call LoadPrivateKey() first, to decode the rest.  It does nothing if the private key is
+     * already loaded.
+     */
+    keymaster_error_t LoadPrivateKey();
+    bool public_key_only() const { return public_key_only_; }
+    void set_public_key_only(bool public_key_only) { public_key_only_ = public_key_only; }
+
+  private:
+    bool public_key_only_ = false;
 };
 
 }  // namespace keymaster
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYSTEM_KEYMASTER_CHACHA20_POLY1305_KEY_H_
+#define SYSTEM_KEYMASTER_CHACHA20_POLY1305_KEY_H_
+
+#include "symmetric_key.h"
+
+namespace keymaster {
+
+const size_t kChaCha20Poly1305KeySize = 256;
+const size_t kMinChaCha20Poly1305TagLength = 12 * 8;
+const size_t kMaxChaCha20Poly1305TagLength = 16 * 8;
+
+/**
+ * Factory for ChaCha20-Poly1305 (RFC 8439) AEAD keys.  These follow the AES-GCM conventions: keys
+ * must carry KM_TAG_MIN_MAC_LENGTH, operations take KM_TAG_MAC_LENGTH, a 12-byte nonce and
+ * associated data.  There is no block mode or padding.  Unlike AES, ChaCha20 needs no hardware
+ * support to run quickly and in constant time.
+ */
+class ChaCha20Poly1305KeyFactory : public SymmetricKeyFactory {
+  public:
+    explicit ChaCha20Poly1305KeyFactory(const SoftwareKeyBlobMaker* blob_maker,
+                                        const RandomSource* random_source)
+        : SymmetricKeyFactory(blob_maker, random_source) {}
+
+    keymaster_algorithm_t registry_key() const { return KM_ALGORITHM_CHACHA20_POLY1305; }
+
+    keymaster_error_t LoadKey(KeymasterKeyBlob&& key_material,
+                              const AuthorizationSet& additional_params,
+                              AuthorizationSet&& hw_enforced, AuthorizationSet&& sw_enforced,
+                              UniquePtr<Key>* key) const override;
+
+    OperationFactory* GetOperationFactory(keymaster_purpose_t purpose) const override;
+
+  private:
+    bool key_size_supported(size_t key_size_bits) const override {
+        return key_size_bits == kChaCha20Poly1305KeySize;
+    }
+
+    keymaster_error_t validate_algorithm_specific_new_key_params(
+        const AuthorizationSet& key_description) const override;
+};
+
+class ChaCha20Poly1305Key : public SymmetricKey {
+  public:
+    ChaCha20Poly1305Key(KeymasterKeyBlob&& key_material, AuthorizationSet&& hw_enforced,
+                        AuthorizationSet&& sw_enforced, const KeyFactory* key_factory)
+        : SymmetricKey(move(key_material), move(hw_enforced), move(sw_enforced), key_factory) {}
+};
+
+}  // namespace keymaster
+
+#endif  // SYSTEM_KEYMASTER_CHACHA20_POLY1305_KEY_H_
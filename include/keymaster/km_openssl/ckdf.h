@@ -17,10 +17,43 @@
 #ifndef SYSTEM_KEYMASTER_CKDF_H_
 #define SYSTEM_KEYMASTER_CKDF_H_
 
+#include <openssl/cmac.h>
+
 #include <keymaster/android_keymaster_utils.h>
+#include <keymaster/km_openssl/openssl_utils.h>
 
 namespace keymaster {
 
+DEFINE_OPENSSL_OBJECT_POINTER(CMAC_CTX)
+
+/**
+ * CKDF with the key already prepared.  Init() expands the AES key schedule and derives the CMAC
+ * subkeys once; each derivation afterwards only runs the CMAC over its input, so many keys can be
+ * derived cheaply from one key with different labels and contexts.
+ */
+class Ckdf {
+  public:
+    /**
+     * One derivation for the batch form of Derive().  The output length is the size of \p output.
+     */
+    struct Derivation {
+        keymaster_blob_t label;
+        const keymaster_blob_t* context_chunks;
+        size_t num_chunks;
+        KeymasterKeyBlob* output;
+    };
+
+    keymaster_error_t Init(const KeymasterKeyBlob& key);
+    bool is_initialized() const { return ctx_.get() != nullptr; }
+
+    keymaster_error_t Derive(const keymaster_blob_t& label, const keymaster_blob_t* context_chunks,
+                             size_t num_chunks, KeymasterKeyBlob* output);
+    keymaster_error_t Derive(const Derivation* derivations, size_t num_derivations);
+
+  private:
+    CMAC_CTX_Ptr ctx_;
+};
+
 /**
  * Implementation of CKDF, aka AES-CMAC KDF, from NIST SP 800-108.  Uses 32-bit i and L, and
  * prefixes with i.  This version takes the context in an array of keymaster_blob_ts.
@@ -23,6 +23,7 @@
 #include <keymaster/asymmetric_key_factory.h>
 #include <keymaster/soft_key_factory.h>
 #include <keymaster/attestation_record.h>
+#include <keymaster/km_openssl/openssl_utils.h>
 
 namespace keymaster {
 
@@ -55,12 +56,26 @@ class EcKeyFactory : public AsymmetricKeyFactory, public SoftKeyFactoryMixin {
 
     OperationFactory* GetOperationFactory(keymaster_purpose_t purpose) const override;
 
+    /**
+     * Returns true if keys with |authorizations| must be software keys, even when keymaster0 or
+     * keymaster1 hardware backs the other EC keys: neither HAL version supports curve 25519 or key
+     * agreement.
+     */
+    static bool IsSoftwareOnlyKey(const AuthorizationSet& authorizations);
+
   protected:
     static EC_GROUP* ChooseGroup(size_t key_size_bits);
     static EC_GROUP* ChooseGroup(keymaster_ec_curve_t ec_curve);
 
     static keymaster_error_t GetCurveAndSize(const AuthorizationSet& key_description,
                                              keymaster_ec_curve_t* curve, uint32_t* key_size_bits);
+
+  private:
+    keymaster_error_t CreateKeyBlobFromEvpKey(const AuthorizationSet& authorizations,
+                                              keymaster_key_origin_t origin, const EVP_PKEY* pkey,
+                                              KeymasterKeyBlob* key_blob,
+                                              AuthorizationSet* hw_enforced,
+                                              AuthorizationSet* sw_enforced) const;
 };
 
 }  // namespace keymaster
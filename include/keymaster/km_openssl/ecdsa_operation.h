@@ -43,6 +43,13 @@ class EcdsaOperation : public Operation {
     keymaster_error_t StoreData(const Buffer& input, size_t* input_consumed);
     keymaster_error_t InitDigest();
 
+    /**
+     * Finishes cloning this operation into \p clone, a new operation of the same type, key and
+     * digest, by copying the digest state and buffered data and giving it an operation handle.
+     * Takes ownership of \p clone, which may be null if its allocation failed.
+     */
+    OperationPtr CloneInto(EcdsaOperation* clone, keymaster_error_t* error) const;
+
     keymaster_digest_t digest_;
     const EVP_MD* digest_algorithm_;
     EVP_PKEY* ecdsa_key_;
@@ -63,6 +70,7 @@ class EcdsaSignOperation : public EcdsaOperation {
     keymaster_error_t Finish(const AuthorizationSet& additional_params, const Buffer& input,
                              const Buffer& signature, AuthorizationSet* output_params,
                              Buffer* output) override;
+    OperationPtr Clone(keymaster_error_t* error) const override;
 };
 
 class EcdsaVerifyOperation : public EcdsaOperation {
@@ -78,6 +86,7 @@ class EcdsaVerifyOperation : public EcdsaOperation {
     keymaster_error_t Finish(const AuthorizationSet& additional_params, const Buffer& input,
                              const Buffer& signature, AuthorizationSet* output_params,
                              Buffer* output) override;
+    OperationPtr Clone(keymaster_error_t* error) const override;
 };
 
 class EcdsaOperationFactory : public OperationFactory {
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYSTEM_KEYMASTER_ED25519_KEY_H_
+#define SYSTEM_KEYMASTER_ED25519_KEY_H_
+
+#include <openssl/curve25519.h>
+
+#include <keymaster/km_openssl/asymmetric_key.h>
+
+namespace keymaster {
+
+/**
+ * An Ed25519 (RFC 8032) signing key.  Keymaster treats these as KM_ALGORITHM_EC keys on
+ * KM_EC_CURVE_CURVE_25519, so they are generated, imported, stored and attested by EcKeyFactory.
+ * The key is held in BoringSSL's 64-byte form, the seed followed by the public key, which is what
+ * ED25519_sign() and ED25519_verify() take.
+ */
+class Ed25519Key : public AsymmetricKey {
+  public:
+    Ed25519Key(AuthorizationSet&& hw_enforced, AuthorizationSet&& sw_enforced,
+               const KeyFactory* key_factory)
+        : AsymmetricKey(move(hw_enforced), move(sw_enforced), key_factory) {}
+    ~Ed25519Key();
+
+    // Ed25519 EVP_PKEYs can only be created from raw keys, never assigned into an empty one.
+    bool InternalToEvp(EVP_PKEY* /* pkey */) const override { return false; }
+    bool EvpToInternal(const EVP_PKEY* pkey) override;
+    EVP_PKEY* CreateEvpKey() const override;
+
+    const uint8_t* private_key() const { return private_key_; }
+    const uint8_t* public_key() const { return private_key_ + ED25519_PUBLIC_KEY_LEN; }
+
+  private:
+    uint8_t private_key_[ED25519_PRIVATE_KEY_LEN];
+};
+
+}  // namespace keymaster
+
+#endif  // SYSTEM_KEYMASTER_ED25519_KEY_H_
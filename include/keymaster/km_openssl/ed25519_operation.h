@@ -0,0 +1,107 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYSTEM_KEYMASTER_ED25519_OPERATION_H_
+#define SYSTEM_KEYMASTER_ED25519_OPERATION_H_
+
+#include <openssl/curve25519.h>
+
+#include <keymaster/operation.h>
+
+namespace keymaster {
+
+/**
+ * Ed25519 hashes the message twice while signing, so the whole message must be buffered until
+ * Finish.  Messages are limited to this size to bound that buffer.
+ */
+static const size_t kMaxEd25519MessageSize = 16 * 1024;
+
+class Ed25519Operation : public Operation {
+  public:
+    Ed25519Operation(keymaster_purpose_t purpose, Key&& key);
+
+    keymaster_error_t Begin(const AuthorizationSet& input_params,
+                            AuthorizationSet* output_params) override;
+    keymaster_error_t Update(const AuthorizationSet& additional_params, const Buffer& input,
+                             AuthorizationSet* output_params, Buffer* output,
+                             size_t* input_consumed) override;
+    keymaster_error_t Abort() override { return KM_ERROR_OK; }
+
+  protected:
+    keymaster_error_t StoreData(const Buffer& input);
+
+    Buffer data_;
+};
+
+class Ed25519SignOperation : public Ed25519Operation {
+  public:
+    explicit Ed25519SignOperation(Key&& key);
+    ~Ed25519SignOperation();
+
+    keymaster_error_t Finish(const AuthorizationSet& additional_params, const Buffer& input,
+                             const Buffer& signature, AuthorizationSet* output_params,
+                             Buffer* output) override;
+
+  private:
+    uint8_t private_key_[ED25519_PRIVATE_KEY_LEN];
+};
+
+/**
+ * Verification needs only the public half of the key, so that is all this operation copies.
+ */
+class Ed25519VerifyOperation : public Ed25519Operation {
+  public:
+    explicit Ed25519VerifyOperation(Key&& key);
+
+    keymaster_error_t Finish(const AuthorizationSet& additional_params, const Buffer& input,
+                             const Buffer& signature, AuthorizationSet* output_params,
+                             Buffer* output) override;
+
+  private:
+    uint8_t public_key_[ED25519_PUBLIC_KEY_LEN];
+};
+
+/**
+ * Creates Ed25519 operations.  Ed25519 keys are EC keys, so the EC operation factories hand
+ * Ed25519 keys on to these rather than being looked up through the registry.
+ */
+class Ed25519OperationFactory : public OperationFactory {
+  public:
+    explicit Ed25519OperationFactory(keymaster_purpose_t purpose) : purpose_(purpose) {}
+
+    KeyType registry_key() const override { return KeyType(KM_ALGORITHM_EC, purpose_); }
+    OperationPtr CreateOperation(Key&& key, const AuthorizationSet& begin_params,
+                                 keymaster_error_t* error) const override;
+    const keymaster_digest_t* SupportedDigests(size_t* digest_count) const override;
+
+  private:
+    const keymaster_purpose_t purpose_;
+};
+
+/**
+ * Returns true if |key| is an EC key on curve 25519.  Ed25519OperationFactory rejects the X25519
+ * keys among them.
+ */
+bool IsEd25519Key(const Key& key);
+
+/**
+ * Returns the Ed25519 operation factory for |purpose|, or nullptr if Ed25519 doesn't support it.
+ */
+const OperationFactory* GetEd25519OperationFactory(keymaster_purpose_t purpose);
+
+}  // namespace keymaster
+
+#endif  // SYSTEM_KEYMASTER_ED25519_OPERATION_H_
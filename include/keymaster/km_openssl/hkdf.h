@@ -17,6 +17,8 @@
 #ifndef SYSTEM_KEYMASTER_HKDF_H_
 #define SYSTEM_KEYMASTER_HKDF_H_
 
+#include <openssl/hmac.h>
+
 #include "kdf.h"
 
 #include <keymaster/serializable.h>
@@ -28,23 +30,38 @@ namespace keymaster {
 /**
  * Rfc5869Sha256Kdf implements the key derivation function specified in RFC 5869 (using SHA256) and
  * outputs key material, as needed by ECIES. See https://tools.ietf.org/html/rfc5869 for details.
+ *
+ * The extract step runs once, in Init(); every GenerateKey() call after that only expands, so
+ * deriving several keys from one secret with different info values doesn't repeat the extraction.
  */
 class Rfc5869Sha256Kdf : public Kdf {
   public:
-    ~Rfc5869Sha256Kdf() {}
+    Rfc5869Sha256Kdf();
+    ~Rfc5869Sha256Kdf();
+
     bool Init(Buffer& secret, Buffer& salt) {
         return Init(secret.peek_read(), secret.available_read(), salt.peek_read(),
                     salt.available_read());
     }
 
-    bool Init(const uint8_t* secret, size_t secret_len, const uint8_t* salt, size_t salt_len) {
-        return Kdf::Init(KM_DIGEST_SHA_2_256, secret, secret_len, salt, salt_len);
-    }
+    bool Init(const uint8_t* secret, size_t secret_len, const uint8_t* salt, size_t salt_len);
 
     bool GenerateKey(const uint8_t* info, size_t info_len, uint8_t* output,
                      size_t output_len) override;
-};
 
+    /**
+     * Derives \p info_count keys of \p output_len bytes each, one per entry in \p infos, writing
+     * the key for infos[i] at output + i * output_len.  The result is the same as calling
+     * GenerateKey() once per info value.
+     */
+    bool GenerateKeys(const keymaster_blob_t* infos, size_t info_count, uint8_t* output,
+                      size_t output_len);
+
+  private:
+    // HMAC keyed with the pseudo-random key produced by the extract step.  Expansion re-initializes
+    // it without a key for each block, which reuses the already-processed key.
+    HMAC_CTX prk_hmac_;
+};
 }  // namespace keymaster
 
 #endif  // SYSTEM_KEYMASTER_HKDF_H_
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYSTEM_KEYMASTER_KEY_AGREEMENT_OPERATION_H_
+#define SYSTEM_KEYMASTER_KEY_AGREEMENT_OPERATION_H_
+
+#include <openssl/curve25519.h>
+
+#include <keymaster/UniquePtr.h>
+
+#include <keymaster/km_openssl/nist_curve_key_exchange.h>
+#include <keymaster/km_openssl/openssl_utils.h>
+#include <keymaster/operation.h>
+
+namespace keymaster {
+
+/**
+ * KeyAgreementOperation computes the shared secrets between the operation's private key and any
+ * number of peer public values.  Peer public values are raw and fixed-length: uncompressed X9.62
+ * points for NIST curves and 32-byte u-coordinates for X25519.  The input is the concatenation of
+ * the peer values, which may be split across Update calls at any point.  Each call outputs the
+ * shared secrets of the peer values it completes, in order, so a batch of N peer values yields N
+ * concatenated shared secrets.  Finish fails if the input ends partway through a peer value or if
+ * there were no peer values at all.
+ */
+class KeyAgreementOperation : public Operation {
+  public:
+    KeyAgreementOperation(AuthorizationSet&& hw_enforced, AuthorizationSet&& sw_enforced,
+                          size_t peer_value_len, size_t shared_secret_len)
+        : Operation(KM_PURPOSE_AGREE_KEY, move(hw_enforced), move(sw_enforced)),
+          peer_value_len_(peer_value_len), shared_secret_len_(shared_secret_len),
+          agreement_count_(0) {}
+
+    keymaster_error_t Begin(const AuthorizationSet& input_params,
+                            AuthorizationSet* output_params) override;
+    keymaster_error_t Update(const AuthorizationSet& additional_params, const Buffer& input,
+                             AuthorizationSet* output_params, Buffer* output,
+                             size_t* input_consumed) override;
+    keymaster_error_t Finish(const AuthorizationSet& additional_params, const Buffer& input,
+                             const Buffer& signature, AuthorizationSet* output_params,
+                             Buffer* output) override;
+    keymaster_error_t Abort() override { return KM_ERROR_OK; }
+
+  protected:
+    /**
+     * Writes the shared secret with one peer value, which is peer_value_len_ bytes long, to
+     * |output|.  Space for it has already been reserved.
+     */
+    virtual keymaster_error_t Agree(const uint8_t* peer_value, Buffer* output) = 0;
+
+    const size_t peer_value_len_;
+    const size_t shared_secret_len_;
+
+  private:
+    keymaster_error_t ProcessInput(const Buffer& input, Buffer* output);
+
+    Buffer partial_peer_value_;
+    size_t agreement_count_;
+};
+
+/**
+ * ECDH on a NIST curve.  Decoding a peer point includes an on-curve check, so the most recently
+ * used peer points are kept decoded, for batches and streams that repeat peers.
+ */
+class EcdhOperation : public KeyAgreementOperation {
+  public:
+    EcdhOperation(AuthorizationSet&& hw_enforced, AuthorizationSet&& sw_enforced,
+                  NistCurveKeyExchange* key_exchange);
+
+  protected:
+    keymaster_error_t Agree(const uint8_t* peer_value, Buffer* output) override;
+
+  private:
+    keymaster_error_t GetPeerPoint(const uint8_t* peer_value, const EC_POINT** peer_point);
+
+    static const size_t kPeerPointCacheSize = 4;
+    struct CachedPeerPoint {
+        UniquePtr<uint8_t[]> peer_value;
+        UniquePtr<EC_POINT, EC_POINT_Delete> point;
+    };
+
+    UniquePtr<NistCurveKeyExchange> key_exchange_;
+    CachedPeerPoint peer_points_[kPeerPointCacheSize];
+    size_t next_peer_point_;  // The entry to replace on the next miss.
+};
+
+/**
+ * X25519 (RFC 7748).  Any 32 bytes are a valid X25519 public value, so there is nothing to decode.
+ */
+class X25519Operation : public KeyAgreementOperation {
+  public:
+    X25519Operation(AuthorizationSet&& hw_enforced, AuthorizationSet&& sw_enforced,
+                    const uint8_t* private_key);
+    ~X25519Operation();
+
+  protected:
+    keymaster_error_t Agree(const uint8_t* peer_value, Buffer* output) override;
+
+  private:
+    uint8_t private_key_[X25519_PRIVATE_KEY_LEN];
+};
+
+class KeyAgreementOperationFactory : public OperationFactory {
+  public:
+    KeyType registry_key() const override {
+        return KeyType(KM_ALGORITHM_EC, KM_PURPOSE_AGREE_KEY);
+    }
+    OperationPtr CreateOperation(Key&& key, const AuthorizationSet& begin_params,
+                                 keymaster_error_t* error) const override;
+};
+
+/**
+ * Returns true if |key| is an X25519 key, i.e. a curve 25519 key for key agreement.
+ */
+bool IsX25519Key(const Key& key);
+
+}  // namespace keymaster
+
+#endif  // SYSTEM_KEYMASTER_KEY_AGREEMENT_OPERATION_H_
@@ -55,6 +55,23 @@ class NistCurveKeyExchange : public KeyExchange {
     bool CalculateSharedKey(const Buffer& peer_public_value, Buffer* shared_key) const override;
     bool public_value(Buffer* public_value) const override;
 
+    /**
+     * DecodePeerPoint parses an uncompressed peer public value and checks that it is on the curve.
+     * Returns nullptr if it is not a valid point.  The caller takes ownership of the result, which
+     * may be passed to CalculateSharedKey any number of times.
+     */
+    EC_POINT* DecodePeerPoint(const uint8_t* peer_public_value,
+                              size_t peer_public_value_len) const;
+
+    /**
+     * CalculateSharedKey computes the shared key with a peer point from DecodePeerPoint.
+     */
+    bool CalculateSharedKey(const EC_POINT* peer_point, Buffer* shared_key) const;
+
+    /* Length of an uncompressed public value on this curve. */
+    size_t public_value_len() const { return public_key_len_; }
+    size_t shared_secret_len() const { return shared_secret_len_; }
+
     /* Caller takes ownership of \p private_key. */
     EC_KEY* private_key() { return private_key_.release(); }
 
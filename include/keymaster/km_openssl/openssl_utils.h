@@ -61,6 +61,7 @@ DEFINE_OPENSSL_OBJECT_POINTER(EC_KEY)
 DEFINE_OPENSSL_OBJECT_POINTER(EC_POINT)
 DEFINE_OPENSSL_OBJECT_POINTER(ENGINE)
 DEFINE_OPENSSL_OBJECT_POINTER(EVP_PKEY)
+DEFINE_OPENSSL_OBJECT_POINTER(EVP_PKEY_CTX)
 DEFINE_OPENSSL_OBJECT_POINTER(PKCS8_PRIV_KEY_INFO)
 DEFINE_OPENSSL_OBJECT_POINTER(RSA)
 DEFINE_OPENSSL_OBJECT_POINTER(X509)
@@ -94,6 +95,32 @@ keymaster_error_t KeyMaterialToEvpKey(keymaster_key_format_t key_format,
 
 keymaster_error_t EvpKeyToKeyMaterial(const EVP_PKEY* evp_pkey, KeymasterKeyBlob* key_blob);
 
+/**
+ * RSA and EC key material is stored in key blobs either as DER (the original format, still accepted
+ * on load) or in a fixed layout holding the already-decoded key components, public values
+ * included.  Loading decoded key material needs no ASN.1 parsing and no recomputation or
+ * revalidation of the public key; the integrity protection on the enclosing blob vouches for it.
+ * Decoded key material starts with a marker that cannot begin a DER encoding.
+ */
+bool IsDecodedKeyMaterial(const KeymasterKeyBlob& key_material);
+
+keymaster_error_t EvpKeyToDecodedKeyMaterial(const EVP_PKEY* evp_pkey,
+                                             KeymasterKeyBlob* key_material);
+
+keymaster_error_t DecodedKeyMaterialToEvpKey(const KeymasterKeyBlob& key_material,
+                                             keymaster_algorithm_t expected_algorithm,
+                                             UniquePtr<EVP_PKEY, EVP_PKEY_Delete>* evp_pkey);
+
+/**
+ * Like DecodedKeyMaterialToEvpKey(), but leaves the private components of RSA and NIST curve EC keys
+ * undecoded, so the EVP_PKEY can only be used for public key operations.  Curve 25519 keys are
+ * decoded in full.  \p public_key_only is set to whether the private key was left out.
+ */
+keymaster_error_t DecodedKeyMaterialToEvpPublicKey(const KeymasterKeyBlob& key_material,
+                                                   keymaster_algorithm_t expected_algorithm,
+                                                   UniquePtr<EVP_PKEY, EVP_PKEY_Delete>* evp_pkey,
+                                                   bool* public_key_only);
+
 size_t ec_group_size_bits(EC_KEY* ec_key);
 
 keymaster_error_t GenerateRandom(uint8_t* buf, size_t length);
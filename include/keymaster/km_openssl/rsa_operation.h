@@ -81,6 +81,14 @@ class RsaDigestingOperation : public RsaOperation {
   protected:
     int GetOpensslPadding(keymaster_error_t* error) override;
     bool require_digest() const override { return padding_ == KM_PAD_RSA_PSS; }
+
+    /**
+     * Finishes cloning this operation into \p clone, a new operation of the same type, key, digest
+     * and padding, by copying the digest state and buffered data and giving it an operation handle.
+     * Takes ownership of \p clone, which may be null if its allocation failed.
+     */
+    OperationPtr CloneInto(RsaDigestingOperation* clone, keymaster_error_t* error) const;
+
     EVP_MD_CTX digest_ctx_;
 };
 
@@ -102,6 +110,7 @@ class RsaSignOperation : public RsaDigestingOperation {
     keymaster_error_t Finish(const AuthorizationSet& additional_params, const Buffer& input,
                              const Buffer& signature, AuthorizationSet* output_params,
                              Buffer* output) override;
+    OperationPtr Clone(keymaster_error_t* error) const override;
 
   private:
     keymaster_error_t SignUndigested(Buffer* output);
@@ -126,6 +135,7 @@ class RsaVerifyOperation : public RsaDigestingOperation {
     keymaster_error_t Finish(const AuthorizationSet& additional_params, const Buffer& input,
                              const Buffer& signature, AuthorizationSet* output_params,
                              Buffer* output) override;
+    OperationPtr Clone(keymaster_error_t* error) const override;
 
   private:
     keymaster_error_t VerifyUndigested(const Buffer& signature);
@@ -18,16 +18,21 @@
 #ifndef INCLUDE_KEYMASTER_SOFT_KEYMASTER_ENFORCEMENT_H_
 #define INCLUDE_KEYMASTER_SOFT_KEYMASTER_ENFORCEMENT_H_
 
+#include <openssl/hmac.h>
+
 #include <keymaster/android_keymaster_messages.h>
 #include <keymaster/keymaster_enforcement.h>
+#include <keymaster/km_openssl/ckdf.h>
 
 namespace keymaster {
 
 class SoftKeymasterEnforcement : public KeymasterEnforcement {
   public:
     SoftKeymasterEnforcement(uint32_t max_access_time_map_size, uint32_t max_access_count_map_size)
-        : KeymasterEnforcement(max_access_time_map_size, max_access_count_map_size) {}
-    virtual ~SoftKeymasterEnforcement() {}
+        : KeymasterEnforcement(max_access_time_map_size, max_access_count_map_size) {
+        HMAC_CTX_init(&keyed_hmac_ctx_);
+    }
+    virtual ~SoftKeymasterEnforcement() { HMAC_CTX_cleanup(&keyed_hmac_ctx_); }
     bool activation_date_valid(uint64_t /*activation_date*/) const override { return true; }
     bool expiration_date_passed(uint64_t /*expiration_date*/) const override { return false; }
     bool auth_token_timed_out(const hw_auth_token_t& /*token*/,
@@ -46,9 +51,18 @@ class SoftKeymasterEnforcement : public KeymasterEnforcement {
     VerifyAuthorization(const VerifyAuthorizationRequest& request) override;
 
   private:
+    keymaster_error_t KeyHmac();
+    keymaster_error_t ComputeHmac(const keymaster_blob_t data_chunks[], size_t data_chunk_count,
+                                  KeymasterBlob* output);
+
     bool have_saved_params_ = false;
     HmacSharingParameters saved_params_;
     KeymasterKeyBlob hmac_key_;
+    // HMAC keyed with hmac_key_, so that the key is hashed into the pads only when it changes.  Each
+    // MAC starts from a copy of it.
+    HMAC_CTX keyed_hmac_ctx_;
+    bool hmac_ctx_keyed_ = false;
+    Ckdf shared_hmac_ckdf_;  // Keyed with the key agreement key on first use.
 };
 
 }  // namespace keymaster
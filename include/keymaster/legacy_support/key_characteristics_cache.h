@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYSTEM_KEYMASTER_KEY_CHARACTERISTICS_CACHE_H_
+#define SYSTEM_KEYMASTER_KEY_CHARACTERISTICS_CACHE_H_
+
+#include <openssl/sha.h>
+
+#include <hardware/keymaster_defs.h>
+
+#include <keymaster/UniquePtr.h>
+#include <keymaster/authorization_set.h>
+
+namespace keymaster {
+
+/**
+ * The number of entries the passthrough contexts' characteristics caches hold.
+ */
+const size_t kKeyCharacteristicsCacheSize = 8;
+
+/**
+ * A small, fixed-size cache of the characteristics the passthrough contexts get from the wrapped
+ * device's get_key_characteristics.  Every key load needs them, and fetching them is a round trip
+ * into the underlying implementation, but for a given blob they only change when the blob is
+ * deleted or upgraded.
+ *
+ * Entries are keyed by a SHA-256 digest of the blob and a digest of the APPLICATION_ID and
+ * APPLICATION_DATA passed with it, so a key bound to an application ID still has to be loaded
+ * with the right one.  Only successful lookups are cached; errors such as
+ * KM_ERROR_KEY_REQUIRES_UPGRADE always go back to the device.
+ *
+ * The cached sets are interned, so entries for keys with the same characteristics share one copy,
+ * and the sets handed out by Find, and the keys and operations they are moved into, share that
+ * storage rather than being copies.
+ */
+class KeyCharacteristicsCache {
+  public:
+    explicit KeyCharacteristicsCache(size_t cache_size) : cache_size_(cache_size), last_use_(0) {}
+
+    /**
+     * If the characteristics of \p blob, loaded with \p additional_params, are cached, places
+     * shared references to them in \p hw_enforced and \p sw_enforced and returns true.
+     */
+    bool Find(const keymaster_key_blob_t& blob, const AuthorizationSet& additional_params,
+              AuthorizationSet* hw_enforced, AuthorizationSet* sw_enforced);
+
+    /**
+     * Caches the characteristics of \p blob, replacing the least recently found or added entry if
+     * the cache is full.  If allocation fails they just aren't cached.
+     */
+    void Add(const keymaster_key_blob_t& blob, const AuthorizationSet& additional_params,
+             const keymaster_key_characteristics_t& characteristics);
+
+    /**
+     * Drops all entries for \p blob, whatever application ID and data they were loaded with.
+     */
+    void Invalidate(const keymaster_key_blob_t& blob);
+
+    void Clear();
+
+  private:
+    struct Entry {
+        bool valid = false;
+        uint64_t last_use = 0;
+        uint8_t blob_digest[SHA256_DIGEST_LENGTH];
+        uint8_t params_digest[SHA256_DIGEST_LENGTH];
+        AuthorizationSet hw_enforced;
+        AuthorizationSet sw_enforced;
+    };
+
+    static void DigestBlob(const keymaster_key_blob_t& blob, uint8_t* digest);
+    static void DigestParams(const AuthorizationSet& additional_params, uint8_t* digest);
+
+    UniquePtr<Entry[]> entries_;
+    AuthorizationSetInterner interner_;
+    size_t cache_size_;
+    uint64_t last_use_;  // Incremented on every use of an entry.
+};
+
+}  // namespace keymaster
+
+#endif  // SYSTEM_KEYMASTER_KEY_CHARACTERISTICS_CACHE_H_
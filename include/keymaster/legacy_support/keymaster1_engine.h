@@ -17,7 +17,9 @@
 #ifndef SYSTEM_KEYMASTER_KEYMASTER1_ENGINE_H_
 #define SYSTEM_KEYMASTER_KEYMASTER1_ENGINE_H_
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 
 #include <openssl/ec.h>
 #include <openssl/engine.h>
@@ -39,8 +41,19 @@ class Keymaster1Engine {
     /**
      * Create a Keymaster1Engine, wrapping the provided keymaster1_device.  The engine takes
      * ownership of the device, and will close it during destruction.
+     *
+     * The engine itself makes at most \p max_concurrent_device_calls calls into the device at
+     * once, and callers on other threads wait for one to return.  A higher limit lets operations
+     * on different threads keep several calls in flight, so that throughput against a slow device
+     * grows with the number of threads rather than being bounded by the latency of a single call.
+     * Zero means no limit.
+     *
+     * The limit covers only calls made through the engine.  The contexts and operations that also
+     * hold the device call it directly, so the limit doesn't serialize access to the device and
+     * doesn't make a device that isn't thread-safe safe to share.
      */
-    explicit Keymaster1Engine(const keymaster1_device_t* keymaster1_device);
+    explicit Keymaster1Engine(const keymaster1_device_t* keymaster1_device,
+                              size_t max_concurrent_device_calls = 1);
     ~Keymaster1Engine();
 
     keymaster_error_t GenerateKey(const AuthorizationSet& key_description,
@@ -79,11 +92,33 @@ class Keymaster1Engine {
 
     const keymaster1_device_t* device() const { return keymaster1_device_; }
 
+    /**
+     * Begins a device operation with \p key_data's key material, passing \p begin_params to the
+     * device unchanged.
+     */
+    keymaster_error_t BeginOperation(keymaster_purpose_t purpose, const KeyData& key_data,
+                                     const keymaster_key_param_set_t& begin_params,
+                                     keymaster_operation_handle_t* op_handle) const;
+    keymaster_error_t AbortOperation(keymaster_operation_handle_t op_handle) const;
+
     EVP_PKEY* GetKeymaster1PublicKey(const KeymasterKeyBlob& blob,
                                      const AuthorizationSet& additional_params,
                                      keymaster_error_t* error) const;
 
   private:
+    /**
+     * Holds one of the engine's device call slots for its lifetime.  Every call the engine makes
+     * into the device must be made while one is held.
+     */
+    class DeviceCall {
+      public:
+        explicit DeviceCall(const Keymaster1Engine* engine);
+        ~DeviceCall();
+
+      private:
+        const Keymaster1Engine* engine_;
+    };
+
     Keymaster1Engine(const Keymaster1Engine&);  // Uncopyable
     void operator=(const Keymaster1Engine&);    // Unassignable
 
@@ -92,7 +127,7 @@ class Keymaster1Engine {
     void ConfigureEngineForRsa();
     void ConfigureEngineForEcdsa();
 
-    keymaster_error_t Keymaster1Finish(const KeyData* key_data, const keymaster_blob_t& input,
+    keymaster_error_t Keymaster1Finish(KeyData* key_data, const keymaster_blob_t& input,
                                        keymaster_blob_t* output);
 
     static int duplicate_key_data(CRYPTO_EX_DATA* to, const CRYPTO_EX_DATA* from, void** from_d,
@@ -108,6 +143,10 @@ class Keymaster1Engine {
                           unsigned int* sig_len, EC_KEY* ec_key);
 
     const keymaster1_device_t* const keymaster1_device_;
+    const size_t max_concurrent_device_calls_;
+    mutable std::mutex device_calls_lock_;
+    mutable std::condition_variable device_call_returned_;
+    mutable size_t device_calls_in_flight_;
     const std::unique_ptr<ENGINE, ENGINE_Delete> engine_;
     const int rsa_index_;
     const int ec_key_index_;
@@ -118,6 +157,41 @@ class Keymaster1Engine {
     static Keymaster1Engine* instance_;
 };
 
+/**
+ * The begin params a wrapped operation passes to the device: the caller's params, with the digest,
+ * and possibly the padding, overridden so that the software operation can do them instead.
+ *
+ * Only the parameter array is copied.  Blobs and bignums still point into the caller's params,
+ * which must outlive this, so preparing the params for a begin costs one small allocation instead
+ * of a full AuthorizationSet copy.
+ */
+class Keymaster1BeginParams {
+  public:
+    explicit Keymaster1BeginParams(const AuthorizationSet& input_params);
+
+    /**
+     * Returns false if the parameter array couldn't be allocated.
+     */
+    bool is_valid() const { return params_.get() || param_set_.length == 0; }
+
+    /**
+     * Returns the first parameter with \p tag, or nullptr if there's none.
+     */
+    keymaster_key_param_t* find(keymaster_tag_t tag);
+
+    /**
+     * Appends \p param.  There's room for one appended parameter.
+     */
+    bool push_back(const keymaster_key_param_t& param);
+
+    const keymaster_key_param_set_t& param_set() const { return param_set_; }
+
+  private:
+    UniquePtr<keymaster_key_param_t[]> params_;
+    keymaster_key_param_set_t param_set_;
+    size_t capacity_;
+};
+
 }  // namespace keymaster
 
 #endif  // SYSTEM_KEYMASTER_KEYMASTER1_ENGINE_H_
@@ -114,7 +114,59 @@ class Operation {
                                      Buffer* output) = 0;
     virtual keymaster_error_t Abort() = 0;
 
+    /**
+     * Creates a copy of this operation, in its current state and with a new operation handle, which
+     * can be updated and finished independently of it.  Operations whose state can't be copied
+     * return nullptr and set \p error to KM_ERROR_UNIMPLEMENTED.
+     */
+    virtual OperationPtr Clone(keymaster_error_t* error) const {
+        *error = KM_ERROR_UNIMPLEMENTED;
+        return OperationPtr();
+    }
+
+    /**
+     * Prepares an AEAD operation to encrypt or decrypt a batch of independent records with
+     * ProcessAeadRecord(), in place of Begin(), Update() and Finish().  The key is set up once, for
+     * the whole batch.  Operations that can't do this return KM_ERROR_UNIMPLEMENTED.
+     */
+    virtual keymaster_error_t BeginAeadBatch() { return KM_ERROR_UNIMPLEMENTED; }
+
+    /**
+     * Encrypts or decrypts one complete record of a batch.  The tag follows the ciphertext, in
+     * \p output when encrypting and in \p input when decrypting.  When encrypting, an empty
+     * \p nonce is replaced with a random one.  On failure \p output is left empty, and the next
+     * record can still be processed.
+     */
+    virtual keymaster_error_t ProcessAeadRecord(KeymasterBlob* /* nonce */,
+                                                const KeymasterBlob& /* associated_data */,
+                                                const Buffer& /* input */, Buffer* /* output */) {
+        return KM_ERROR_UNIMPLEMENTED;
+    }
+
+    /**
+     * Encrypts or decrypts the next record of a stream of complete AEAD records, in place of
+     * Update() and Finish().  The record's nonce is derived from the one set by Begin() and the
+     * record's sequence number, which is returned in \p sequence_number, so no nonce is used
+     * twice.  Operations that can't do this return KM_ERROR_UNIMPLEMENTED.
+     */
+    virtual keymaster_error_t ProcessRecord(const AuthorizationSet& /* additional_params */,
+                                            const Buffer& /* input */,
+                                            uint64_t* /* sequence_number */,
+                                            Buffer* /* output */) {
+        return KM_ERROR_UNIMPLEMENTED;
+    }
+
   protected:
+    const AuthorizationSet& hw_enforced() const { return hw_enforced_; }
+    const AuthorizationSet& sw_enforced() const { return sw_enforced_; }
+
+    // False if the authorizations the operation was constructed with failed to copy.  Clone()
+    // implementations check it, since an operation missing authorizations would escape enforcement.
+    bool authorizations_valid() const {
+        return hw_enforced_.is_valid() == AuthorizationSet::OK &&
+               sw_enforced_.is_valid() == AuthorizationSet::OK;
+    }
+
     // Helper function for implementing Finish() methods that need to call Update() to process
     // input, but don't expect any output.
     keymaster_error_t UpdateForFinish(const AuthorizationSet& input_params, const Buffer& input);
@@ -199,16 +199,33 @@ inline bool copy_uint32_array_from_buf(const uint8_t** buf_ptr, const uint8_t* e
     return true;
 }
 
+/**
+ * A read-only, non-owning view of a range of bytes, in the manner of struct iovec.  Arrays of
+ * BufferSegments describe data that is scattered across several buffers.
+ */
+struct BufferSegment {
+    const uint8_t* data;
+    size_t data_length;
+};
+
 /**
  * A simple buffer that supports reading and writing.  Manages its own memory.
  */
 class Buffer : public Serializable {
   public:
-    Buffer() : buffer_(nullptr), buffer_size_(0), read_position_(0), write_position_(0) {}
-    explicit Buffer(size_t size) : buffer_(nullptr) { Reinitialize(size); }
-    Buffer(const void* buf, size_t size) : buffer_(nullptr) { Reinitialize(buf, size); }
+    Buffer()
+        : buffer_(nullptr), buffer_size_(0), read_position_(0), write_position_(0),
+          borrowed_(false) {}
+    explicit Buffer(size_t size) : buffer_(nullptr), borrowed_(false) { Reinitialize(size); }
+    Buffer(const void* buf, size_t size) : buffer_(nullptr), borrowed_(false) {
+        Reinitialize(buf, size);
+    }
+    ~Buffer() { Clear(); }
 
-    // Grow the buffer so that at least \p size bytes can be written.
+    // Grow the buffer so that at least \p size bytes can be written.  Space already consumed by
+    // reads is reclaimed first.  If the buffer must be reallocated while it holds data, its size
+    // is at least doubled so that repeated appends copy the accumulated data a bounded number of
+    // times.  Storage that is released or vacated is zeroed.
     bool reserve(size_t size);
 
     bool Reinitialize(size_t size);
@@ -219,6 +236,13 @@ class Buffer : public Serializable {
         return Reinitialize(buffer.peek_read(), buffer.available_read());
     }
 
+    // Reinitialize as a read-only view of \p data, without copying.  The caller retains ownership
+    // of \p data, which must outlive the Buffer or its next Reinitialize/Clear.  The view can be
+    // read and consumed but has no write space; reserve() copies the data into owned storage
+    // first, so writes after a successful reserve() never touch the borrowed memory.
+    bool ReinitializeBorrowed(const void* data, size_t data_len);
+    bool is_borrowed() const { return borrowed_; }
+
     const uint8_t* begin() const { return peek_read(); }
     const uint8_t* end() const { return peek_read() + available_read(); }
 
@@ -229,7 +253,11 @@ class Buffer : public Serializable {
     size_t buffer_size() const { return buffer_size_; }
 
     bool write(const uint8_t* src, size_t write_length);
+    // Gather-write: grows the buffer once, then appends each segment in order.
+    bool write(const BufferSegment* segments, size_t segment_count);
     bool read(uint8_t* dest, size_t read_length);
+    // Return a view of the readable data.  The view is invalidated by any non-const call.
+    BufferSegment read_segment() const { return {peek_read(), available_read()}; }
     const uint8_t* peek_read() const { return buffer_.get() + read_position_; }
     bool advance_read(int distance) {
         if (static_cast<size_t>(read_position_ + distance) <= write_position_) {
@@ -260,6 +288,7 @@ class Buffer : public Serializable {
     size_t buffer_size_;
     size_t read_position_;
     size_t write_position_;
+    bool borrowed_;
 };
 
 }  // namespace keymaster
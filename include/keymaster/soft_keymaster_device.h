@@ -59,8 +59,12 @@ class SoftKeymasterDevice {
     /**
      * Set SoftKeymasterDevice to wrap specified HW keymaster1 device.  Takes ownership of the
      * specified device (will call keymaster1_device->common.close());
+     *
+     * \p max_concurrent_device_calls limits the calls that the Keymaster1Engine behind operations
+     * needing software digesting makes into the device at once; see Keymaster1Engine.
      */
-    keymaster_error_t SetHardwareDevice(keymaster1_device_t* keymaster1_device);
+    keymaster_error_t SetHardwareDevice(keymaster1_device_t* keymaster1_device,
+                                        size_t max_concurrent_device_calls = 1);
 
     /**
      * Returns true if a keymaster1_device_t has been set as the hardware device, and if that
@@ -84,15 +88,22 @@ class SoftKeymasterDevice {
     typedef std::pair<keymaster_algorithm_t, keymaster_purpose_t> AlgPurposePair;
     typedef std::map<AlgPurposePair, std::vector<keymaster_digest_t>> DigestMap;
 
-  private:
-    void initialize_device_struct(uint32_t flags);
-    bool FindUnsupportedDigest(keymaster_algorithm_t algorithm, keymaster_purpose_t purpose,
-                               const AuthorizationSet& params,
-                               keymaster_digest_t* unsupported) const;
+    // Public only for testing
     bool RequiresSoftwareDigesting(keymaster_algorithm_t algorithm, keymaster_purpose_t purpose,
                                    const AuthorizationSet& params) const;
     bool KeyRequiresSoftwareDigesting(const AuthorizationSet& key_description) const;
 
+  private:
+    // Dimensions of km1_device_digest_support_.  Only RSA, EC and HMAC keys are ever digested in
+    // software, and only for the encrypt, decrypt, sign and verify purposes.
+    static const size_t kDigestTableAlgorithms = 3;
+    static const size_t kDigestTablePurposes = KM_PURPOSE_VERIFY + 1;
+
+    void initialize_device_struct(uint32_t flags);
+    void BuildDigestSupportTable();
+    bool Km1DeviceSupportsDigests(keymaster_algorithm_t algorithm, keymaster_purpose_t purpose,
+                                  uint32_t requested_digests) const;
+
     static void StoreDefaultNewKeyParams(keymaster_algorithm_t algorithm,
                                          AuthorizationSet* auth_set);
     static keymaster_error_t GetPkcs8KeyAlgorithm(const uint8_t* key, size_t key_length,
@@ -241,6 +252,10 @@ class SoftKeymasterDevice {
 
     keymaster1_device_t* wrapped_km1_device_;
     DigestMap km1_device_digests_;
+    // Bitmasks of the digests supported by wrapped_km1_device_, indexed by algorithm and purpose.
+    // Derived from km1_device_digests_ when the device is set, so that deciding whether an
+    // operation needs software digesting doesn't have to search the map.
+    uint32_t km1_device_digest_support_[kDigestTableAlgorithms][kDigestTablePurposes];
     SoftKeymasterContext* context_;
     UniquePtr<AndroidKeymaster> impl_;
     std::string module_name_;
@@ -33,6 +33,7 @@
 #include <keymaster/UniquePtr.h>
 
 #include <openssl/aes.h>
+#include <openssl/err.h>
 
 namespace keymaster {
 
@@ -301,6 +302,32 @@ keymaster_error_t SetKeyBlobAuthorizations(const AuthorizationSet& key_descripti
 }
 
 
+// RSA and EC software keys created before key material was stored decoded hold DER.  Re-encode it
+// so subsequent loads skip the ASN.1 parse.  Key material that isn't DER for the key's algorithm
+// (e.g. a hardware key blob) is left as it is.
+static keymaster_error_t UpgradeKeyMaterial(const Key& key, KeymasterKeyBlob* upgraded_material,
+                                            bool* material_changed) {
+    keymaster_algorithm_t algorithm;
+    if (!key.sw_enforced().GetTagValue(TAG_ALGORITHM, &algorithm) ||
+        (algorithm != KM_ALGORITHM_RSA && algorithm != KM_ALGORITHM_EC) ||
+        IsDecodedKeyMaterial(key.key_material()))
+        return KM_ERROR_OK;
+
+    int type = (algorithm == KM_ALGORITHM_RSA) ? EVP_PKEY_RSA : EVP_PKEY_EC;
+    const uint8_t* p = key.key_material().key_material;
+    EVP_PKEY_Ptr pkey(d2i_PrivateKey(type, nullptr, &p, key.key_material().key_material_size));
+    if (pkey.get() == nullptr) {
+        ERR_clear_error();
+        return KM_ERROR_OK;
+    }
+
+    keymaster_error_t error = EvpKeyToDecodedKeyMaterial(pkey.get(), upgraded_material);
+    if (error != KM_ERROR_OK)
+        return error;
+    *material_changed = true;
+    return KM_ERROR_OK;
+}
+
 keymaster_error_t UpgradeSoftKeyBlob(const UniquePtr<Key>& key,
                                  const uint32_t os_version, const uint32_t os_patchlevel,
                                  const AuthorizationSet& upgrade_params,
@@ -326,16 +353,23 @@ keymaster_error_t UpgradeSoftKeyBlob(const UniquePtr<Key>& key,
         // One of the version fields would have been a downgrade. Not allowed.
         return KM_ERROR_INVALID_ARGUMENT;
 
-    if (!set_changed)
+    KeymasterKeyBlob upgraded_material;
+    bool material_changed = false;
+    auto error = UpgradeKeyMaterial(*key, &upgraded_material, &material_changed);
+    if (error != KM_ERROR_OK)
+        return error;
+
+    if (!set_changed && !material_changed)
         // Dont' need an upgrade.
         return KM_ERROR_OK;
 
     AuthorizationSet hidden;
-    auto error = BuildHiddenAuthorizations(upgrade_params, &hidden, softwareRootOfTrust);
+    error = BuildHiddenAuthorizations(upgrade_params, &hidden, softwareRootOfTrust);
     if (error != KM_ERROR_OK)
         return error;
-    return SerializeIntegrityAssuredBlob(key->key_material(), hidden, key->hw_enforced(),
-                                         key->sw_enforced(), upgraded_key);
+    return SerializeIntegrityAssuredBlob(material_changed ? upgraded_material : key->key_material(),
+                                         hidden, key->hw_enforced(), key->sw_enforced(),
+                                         upgraded_key);
 }
 
 } // namespace keymaster
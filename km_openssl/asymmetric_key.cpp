@@ -32,6 +32,32 @@
 
 namespace keymaster {
 
+EVP_PKEY* AsymmetricKey::CreateEvpKey() const {
+    EVP_PKEY_Ptr pkey(EVP_PKEY_new());
+    if (!pkey.get() || !InternalToEvp(pkey.get()))
+        return nullptr;
+    return pkey.release();
+}
+
+keymaster_error_t AsymmetricKey::LoadPrivateKey() {
+    if (!public_key_only_)
+        return KM_ERROR_OK;
+
+    keymaster_algorithm_t algorithm;
+    if (!authorizations().GetTagValue(TAG_ALGORITHM, &algorithm))
+        return KM_ERROR_INVALID_KEY_BLOB;
+
+    EVP_PKEY_Ptr pkey;
+    keymaster_error_t error = DecodedKeyMaterialToEvpKey(key_material(), algorithm, &pkey);
+    if (error != KM_ERROR_OK)
+        return error;
+    if (!EvpToInternal(pkey.get()))
+        return TranslateLastOpenSslError();
+
+    public_key_only_ = false;
+    return KM_ERROR_OK;
+}
+
 keymaster_error_t AsymmetricKey::formatted_key_material(keymaster_key_format_t format,
                                                         UniquePtr<uint8_t[]>* material,
                                                         size_t* size) const {
@@ -41,8 +67,8 @@ keymaster_error_t AsymmetricKey::formatted_key_material(keymaster_key_format_t f
     if (material == nullptr || size == nullptr)
         return KM_ERROR_OUTPUT_PARAMETER_NULL;
 
-    EVP_PKEY_Ptr pkey(EVP_PKEY_new());
-    if (!InternalToEvp(pkey.get()))
+    EVP_PKEY_Ptr pkey(CreateEvpKey());
+    if (!pkey.get())
         return TranslateLastOpenSslError();
 
     int key_data_length = i2d_PUBKEY(pkey.get(), nullptr);
@@ -48,17 +48,28 @@ keymaster_error_t AsymmetricKeyFactory::LoadKey(KeymasterKeyBlob&& key_material,
     if (error != KM_ERROR_OK)
         return error;
 
-    const uint8_t* tmp = key_material.key_material;
     asym_key->key_material() = move(key_material);
 
-    EVP_PKEY* pkey =
-        d2i_PrivateKey(evp_key_type(), nullptr /* pkey */, &tmp,
-                       asym_key->key_material().key_material_size);
-    if (!pkey)
-        return TranslateLastOpenSslError();
-    UniquePtr<EVP_PKEY, EVP_PKEY_Delete> pkey_deleter(pkey);
+    UniquePtr<EVP_PKEY, EVP_PKEY_Delete> pkey;
+    if (IsDecodedKeyMaterial(asym_key->key_material())) {
+        // The private key is decoded later, only if an operation needs it.
+        bool public_key_only;
+        error = DecodedKeyMaterialToEvpPublicKey(asym_key->key_material(), keymaster_key_type(),
+                                                 &pkey, &public_key_only);
+        if (error != KM_ERROR_OK)
+            return error;
+        asym_key->set_public_key_only(public_key_only);
+    } else {
+        // DER key material, from a blob created before key material was stored decoded.
+        // UpgradeKeyBlob re-encodes it.
+        const uint8_t* tmp = asym_key->key_material().key_material;
+        pkey.reset(d2i_PrivateKey(evp_key_type(), nullptr /* pkey */, &tmp,
+                                  asym_key->key_material().key_material_size));
+        if (!pkey.get())
+            return TranslateLastOpenSslError();
+    }
 
-    if (!asym_key->EvpToInternal(pkey))
+    if (!asym_key->EvpToInternal(pkey.get()))
         error = TranslateLastOpenSslError();
     else
         key->reset(asym_key.release());
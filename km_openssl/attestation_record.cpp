@@ -67,6 +67,110 @@ static uint32_t get_uint32_value(const keymaster_key_param_t& param) {
     }
 }
 
+// Where each tag's values go in a KM_AUTH_LIST.  At most one member is set, and tags with none
+// are left out of attestation records.
+struct AuthListField {
+    keymaster_tag_t tag;
+    ASN1_INTEGER* KM_AUTH_LIST::*integer;
+    ASN1_INTEGER_SET* KM_AUTH_LIST::*integer_set;
+    ASN1_NULL* KM_AUTH_LIST::*boolean;
+    ASN1_OCTET_STRING* KM_AUTH_LIST::*string;
+};
+
+constexpr AuthListField Ignored(keymaster_tag_t tag) {
+    return {tag, nullptr, nullptr, nullptr, nullptr};
+}
+constexpr AuthListField IntegerField(keymaster_tag_t tag, ASN1_INTEGER* KM_AUTH_LIST::*field) {
+    return {tag, field, nullptr, nullptr, nullptr};
+}
+constexpr AuthListField IntegerSetField(keymaster_tag_t tag,
+                                        ASN1_INTEGER_SET* KM_AUTH_LIST::*field) {
+    return {tag, nullptr, field, nullptr, nullptr};
+}
+constexpr AuthListField BoolField(keymaster_tag_t tag, ASN1_NULL* KM_AUTH_LIST::*field) {
+    return {tag, nullptr, nullptr, field, nullptr};
+}
+constexpr AuthListField StringField(keymaster_tag_t tag, ASN1_OCTET_STRING* KM_AUTH_LIST::*field) {
+    return {tag, nullptr, nullptr, nullptr, field};
+}
+
+// The attested fields are listed in the order extract_auth_list adds them to an AuthorizationSet.
+// The order of the fields in the DER encoding is set by the ASN.1 template, not by this list.
+constexpr AuthListField kAuthListFields[] = {
+    IntegerSetField(KM_TAG_PURPOSE, &KM_AUTH_LIST::purpose),
+    IntegerField(KM_TAG_ALGORITHM, &KM_AUTH_LIST::algorithm),
+    IntegerField(KM_TAG_KEY_SIZE, &KM_AUTH_LIST::key_size),
+    IntegerSetField(KM_TAG_BLOCK_MODE, &KM_AUTH_LIST::block_mode),
+    IntegerSetField(KM_TAG_DIGEST, &KM_AUTH_LIST::digest),
+    IntegerSetField(KM_TAG_PADDING, &KM_AUTH_LIST::padding),
+    BoolField(KM_TAG_CALLER_NONCE, &KM_AUTH_LIST::caller_nonce),
+    IntegerField(KM_TAG_MIN_MAC_LENGTH, &KM_AUTH_LIST::min_mac_length),
+    IntegerSetField(KM_TAG_KDF, &KM_AUTH_LIST::kdf),
+    IntegerField(KM_TAG_EC_CURVE, &KM_AUTH_LIST::ec_curve),
+    IntegerField(KM_TAG_RSA_PUBLIC_EXPONENT, &KM_AUTH_LIST::rsa_public_exponent),
+    IntegerField(KM_TAG_ACTIVE_DATETIME, &KM_AUTH_LIST::active_date_time),
+    IntegerField(KM_TAG_ORIGINATION_EXPIRE_DATETIME, &KM_AUTH_LIST::origination_expire_date_time),
+    IntegerField(KM_TAG_USAGE_EXPIRE_DATETIME, &KM_AUTH_LIST::usage_expire_date_time),
+    BoolField(KM_TAG_NO_AUTH_REQUIRED, &KM_AUTH_LIST::no_auth_required),
+    IntegerField(KM_TAG_USER_AUTH_TYPE, &KM_AUTH_LIST::user_auth_type),
+    IntegerField(KM_TAG_AUTH_TIMEOUT, &KM_AUTH_LIST::auth_timeout),
+    BoolField(KM_TAG_ALLOW_WHILE_ON_BODY, &KM_AUTH_LIST::allow_while_on_body),
+    BoolField(KM_TAG_UNLOCKED_DEVICE_REQUIRED, &KM_AUTH_LIST::unlocked_device_required),
+    BoolField(KM_TAG_ALL_APPLICATIONS, &KM_AUTH_LIST::all_applications),
+    StringField(KM_TAG_APPLICATION_ID, &KM_AUTH_LIST::application_id),
+    StringField(KM_TAG_ATTESTATION_APPLICATION_ID, &KM_AUTH_LIST::attestation_application_id),
+    IntegerField(KM_TAG_CREATION_DATETIME, &KM_AUTH_LIST::creation_date_time),
+    IntegerField(KM_TAG_ORIGIN, &KM_AUTH_LIST::origin),
+    BoolField(KM_TAG_ROLLBACK_RESISTANT, &KM_AUTH_LIST::rollback_resistant),
+    IntegerField(KM_TAG_OS_VERSION, &KM_AUTH_LIST::os_version),
+    IntegerField(KM_TAG_OS_PATCHLEVEL, &KM_AUTH_LIST::os_patchlevel),
+    StringField(KM_TAG_ATTESTATION_ID_BRAND, &KM_AUTH_LIST::attestation_id_brand),
+    StringField(KM_TAG_ATTESTATION_ID_DEVICE, &KM_AUTH_LIST::attestation_id_device),
+    StringField(KM_TAG_ATTESTATION_ID_PRODUCT, &KM_AUTH_LIST::attestation_id_product),
+    StringField(KM_TAG_ATTESTATION_ID_SERIAL, &KM_AUTH_LIST::attestation_id_serial),
+    StringField(KM_TAG_ATTESTATION_ID_IMEI, &KM_AUTH_LIST::attestation_id_imei),
+    StringField(KM_TAG_ATTESTATION_ID_MEID, &KM_AUTH_LIST::attestation_id_meid),
+    StringField(KM_TAG_ATTESTATION_ID_MANUFACTURER, &KM_AUTH_LIST::attestation_id_manufacturer),
+    StringField(KM_TAG_ATTESTATION_ID_MODEL, &KM_AUTH_LIST::attestation_id_model),
+
+    /* Tags ignored because they should never exist */
+    Ignored(KM_TAG_INVALID),
+
+    /* Tags ignored because they're not used. */
+    Ignored(KM_TAG_ALL_USERS),
+    Ignored(KM_TAG_EXPORTABLE),
+    Ignored(KM_TAG_ECIES_SINGLE_HASH_MODE),
+
+    /* Tags ignored because they're used only to provide information to operations */
+    Ignored(KM_TAG_ASSOCIATED_DATA),
+    Ignored(KM_TAG_NONCE),
+    Ignored(KM_TAG_AUTH_TOKEN),
+    Ignored(KM_TAG_MAC_LENGTH),
+    Ignored(KM_TAG_ATTESTATION_CHALLENGE),
+    Ignored(KM_TAG_RESET_SINCE_ID_ROTATION),
+
+    /* Tags ignored because they have no meaning off-device */
+    Ignored(KM_TAG_USER_ID),
+    Ignored(KM_TAG_USER_SECURE_ID),
+    Ignored(KM_TAG_BLOB_USAGE_REQUIREMENTS),
+
+    /* Tags ignored because they're not usable by app keys */
+    Ignored(KM_TAG_BOOTLOADER_ONLY),
+    Ignored(KM_TAG_INCLUDE_UNIQUE_ID),
+    Ignored(KM_TAG_MAX_USES_PER_BOOT),
+    Ignored(KM_TAG_MIN_SECONDS_BETWEEN_OPS),
+    Ignored(KM_TAG_UNIQUE_ID),
+
+    /* Tags ignored because they contain data that should not be exported */
+    Ignored(KM_TAG_APPLICATION_DATA),
+    Ignored(KM_TAG_ROOT_OF_TRUST),
+
+    /* Tags ignored because the KM_AUTH_LIST ASN.1 template has no field for them */
+    Ignored(KM_TAG_TRUSTED_CONFIRMATION_REQUIRED),
+};
+
+constexpr TagTable<AuthListField> kAuthListFieldTable = MakeTagTable(kAuthListFields);
+
 // Insert value in either the dest_integer or the dest_integer_set, whichever is provided.
 static keymaster_error_t insert_integer(ASN1_INTEGER* value, ASN1_INTEGER** dest_integer,
                                         ASN1_INTEGER_SET** dest_integer_set) {
@@ -102,170 +206,19 @@ keymaster_error_t build_auth_list(const AuthorizationSet& auth_list, KM_AUTH_LIS
         return KM_ERROR_OK;
 
     for (auto entry : auth_list) {
-
-        ASN1_INTEGER_SET** integer_set = nullptr;
-        ASN1_INTEGER** integer_ptr = nullptr;
-        ASN1_OCTET_STRING** string_ptr = nullptr;
-        ASN1_NULL** bool_ptr = nullptr;
-
-        switch (entry.tag) {
-
-        /* Tags ignored because they should never exist */
-        case KM_TAG_INVALID:
-
-        /* Tags ignored because they're not used. */
-        case KM_TAG_ALL_USERS:
-        case KM_TAG_EXPORTABLE:
-        case KM_TAG_ECIES_SINGLE_HASH_MODE:
-
-        /* Tags ignored because they're used only to provide information to operations */
-        case KM_TAG_ASSOCIATED_DATA:
-        case KM_TAG_NONCE:
-        case KM_TAG_AUTH_TOKEN:
-        case KM_TAG_MAC_LENGTH:
-        case KM_TAG_ATTESTATION_CHALLENGE:
-        case KM_TAG_RESET_SINCE_ID_ROTATION:
-
-        /* Tags ignored because they have no meaning off-device */
-        case KM_TAG_USER_ID:
-        case KM_TAG_USER_SECURE_ID:
-        case KM_TAG_BLOB_USAGE_REQUIREMENTS:
-
-        /* Tags ignored because they're not usable by app keys */
-        case KM_TAG_BOOTLOADER_ONLY:
-        case KM_TAG_INCLUDE_UNIQUE_ID:
-        case KM_TAG_MAX_USES_PER_BOOT:
-        case KM_TAG_MIN_SECONDS_BETWEEN_OPS:
-        case KM_TAG_UNIQUE_ID:
-
-        /* Tags ignored because they contain data that should not be exported */
-        case KM_TAG_APPLICATION_DATA:
-        case KM_TAG_ROOT_OF_TRUST:
+        size_t index = LookupTagIndex(entry.tag);
+        if (index == kTagCount)
+            continue;  // Unknown tags aren't attested.
+        const AuthListField& field = kAuthListFieldTable[index];
+
+        ASN1_INTEGER_SET** integer_set =
+            field.integer_set ? &(record->*field.integer_set) : nullptr;
+        ASN1_INTEGER** integer_ptr = field.integer ? &(record->*field.integer) : nullptr;
+        ASN1_OCTET_STRING** string_ptr = field.string ? &(record->*field.string) : nullptr;
+        ASN1_NULL** bool_ptr = field.boolean ? &(record->*field.boolean) : nullptr;
+        if (!integer_set && !integer_ptr && !string_ptr && !bool_ptr)
             continue;
 
-        /* Non-repeating enumerations */
-        case KM_TAG_ALGORITHM:
-            integer_ptr = &record->algorithm;
-            break;
-        case KM_TAG_EC_CURVE:
-            integer_ptr = &record->ec_curve;
-            break;
-        case KM_TAG_USER_AUTH_TYPE:
-            integer_ptr = &record->user_auth_type;
-            break;
-        case KM_TAG_ORIGIN:
-            integer_ptr = &record->origin;
-            break;
-
-        /* Repeating enumerations */
-        case KM_TAG_PURPOSE:
-            integer_set = &record->purpose;
-            break;
-        case KM_TAG_PADDING:
-            integer_set = &record->padding;
-            break;
-        case KM_TAG_DIGEST:
-            integer_set = &record->digest;
-            break;
-        case KM_TAG_KDF:
-            integer_set = &record->kdf;
-            break;
-        case KM_TAG_BLOCK_MODE:
-            integer_set = &record->block_mode;
-            break;
-
-        /* Non-repeating unsigned integers */
-        case KM_TAG_KEY_SIZE:
-            integer_ptr = &record->key_size;
-            break;
-        case KM_TAG_AUTH_TIMEOUT:
-            integer_ptr = &record->auth_timeout;
-            break;
-        case KM_TAG_OS_VERSION:
-            integer_ptr = &record->os_version;
-            break;
-        case KM_TAG_OS_PATCHLEVEL:
-            integer_ptr = &record->os_patchlevel;
-            break;
-        case KM_TAG_MIN_MAC_LENGTH:
-            integer_ptr = &record->min_mac_length;
-            break;
-
-        /* Non-repeating long unsigned integers */
-        case KM_TAG_RSA_PUBLIC_EXPONENT:
-            integer_ptr = &record->rsa_public_exponent;
-            break;
-
-        /* Dates */
-        case KM_TAG_ACTIVE_DATETIME:
-            integer_ptr = &record->active_date_time;
-            break;
-        case KM_TAG_ORIGINATION_EXPIRE_DATETIME:
-            integer_ptr = &record->origination_expire_date_time;
-            break;
-        case KM_TAG_USAGE_EXPIRE_DATETIME:
-            integer_ptr = &record->usage_expire_date_time;
-            break;
-        case KM_TAG_CREATION_DATETIME:
-            integer_ptr = &record->creation_date_time;
-            break;
-
-        /* Booleans */
-        case KM_TAG_NO_AUTH_REQUIRED:
-            bool_ptr = &record->no_auth_required;
-            break;
-        case KM_TAG_ALL_APPLICATIONS:
-            bool_ptr = &record->all_applications;
-            break;
-        case KM_TAG_ROLLBACK_RESISTANT:
-            bool_ptr = &record->rollback_resistant;
-            break;
-        case KM_TAG_ALLOW_WHILE_ON_BODY:
-            bool_ptr = &record->allow_while_on_body;
-            break;
-        case KM_TAG_UNLOCKED_DEVICE_REQUIRED:
-            bool_ptr = &record->unlocked_device_required;
-            break;
-        case KM_TAG_CALLER_NONCE:
-            bool_ptr = &record->caller_nonce;
-            break;
-        case KM_TAG_TRUSTED_CONFIRMATION_REQUIRED:
-            bool_ptr = &record->trusted_confirmation_required;
-            break;
-
-        /* Byte arrays*/
-        case KM_TAG_APPLICATION_ID:
-            string_ptr = &record->application_id;
-            break;
-        case KM_TAG_ATTESTATION_APPLICATION_ID:
-            string_ptr = &record->attestation_application_id;
-            break;
-        case KM_TAG_ATTESTATION_ID_BRAND:
-            string_ptr = &record->attestation_id_brand;
-            break;
-        case KM_TAG_ATTESTATION_ID_DEVICE:
-            string_ptr = &record->attestation_id_device;
-            break;
-        case KM_TAG_ATTESTATION_ID_PRODUCT:
-            string_ptr = &record->attestation_id_product;
-            break;
-        case KM_TAG_ATTESTATION_ID_SERIAL:
-            string_ptr = &record->attestation_id_serial;
-            break;
-        case KM_TAG_ATTESTATION_ID_IMEI:
-            string_ptr = &record->attestation_id_imei;
-            break;
-        case KM_TAG_ATTESTATION_ID_MEID:
-            string_ptr = &record->attestation_id_meid;
-            break;
-        case KM_TAG_ATTESTATION_ID_MANUFACTURER:
-            string_ptr = &record->attestation_id_manufacturer;
-            break;
-        case KM_TAG_ATTESTATION_ID_MODEL:
-            string_ptr = &record->attestation_id_model;
-            break;
-        }
-
         keymaster_tag_type_t type = keymaster_tag_get_type(entry.tag);
         switch (type) {
         case KM_ENUM:
@@ -521,15 +474,6 @@ static bool get_repeated_enums(const ASN1_INTEGER_SET* stack, keymaster_tag_t ta
     return true;
 }
 
-// Add the specified integer tag/value pair to auth_list.
-template <keymaster_tag_type_t Type, keymaster_tag_t Tag, typename KeymasterEnum>
-static bool get_enum(const ASN1_INTEGER* asn1_int, TypedEnumTag<Type, Tag, KeymasterEnum> tag,
-                     AuthorizationSet* auth_list) {
-    if (!asn1_int)
-        return true;
-    return auth_list->push_back(tag, static_cast<KeymasterEnum>(ASN1_INTEGER_get(asn1_int)));
-}
-
 // Add the specified ulong tag/value pair to auth_list.
 static bool get_ulong(const ASN1_INTEGER* asn1_int, keymaster_tag_t tag,
                       AuthorizationSet* auth_list) {
@@ -542,105 +486,47 @@ static bool get_ulong(const ASN1_INTEGER* asn1_int, keymaster_tag_t tag,
     return auth_list->push_back(keymaster_param_long(tag, ulong));
 }
 
-// Extract the values from the specified ASN.1 record and place them in auth_list.
-keymaster_error_t extract_auth_list(const KM_AUTH_LIST* record, AuthorizationSet* auth_list) {
-    if (!record)
-        return KM_ERROR_OK;
-
-    // Purpose
-    if (!get_repeated_enums(record->purpose, TAG_PURPOSE, auth_list))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Algorithm
-    if (!get_enum(record->algorithm, TAG_ALGORITHM, auth_list))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Key size
-    if (record->key_size && !auth_list->push_back(TAG_KEY_SIZE, ASN1_INTEGER_get(record->key_size)))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Block mode
-    if (!get_repeated_enums(record->block_mode, TAG_BLOCK_MODE, auth_list))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Digest
-    if (!get_repeated_enums(record->digest, TAG_DIGEST, auth_list))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Padding
-    if (!get_repeated_enums(record->padding, TAG_PADDING, auth_list))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Caller nonce
-    if (record->caller_nonce && !auth_list->push_back(TAG_CALLER_NONCE))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Min mac length
-    if (!get_ulong(record->min_mac_length, TAG_MIN_MAC_LENGTH, auth_list))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // EC curve
-    if (!get_enum(record->ec_curve, TAG_EC_CURVE, auth_list))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // RSA public exponent
-    if (!get_ulong(record->rsa_public_exponent, TAG_RSA_PUBLIC_EXPONENT, auth_list))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Active date time
-    if (!get_ulong(record->active_date_time, TAG_ACTIVE_DATETIME, auth_list))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Origination expire date time
-    if (!get_ulong(record->origination_expire_date_time, TAG_ORIGINATION_EXPIRE_DATETIME,
-                   auth_list))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Usage Expire date time
-    if (!get_ulong(record->usage_expire_date_time, TAG_USAGE_EXPIRE_DATETIME, auth_list))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // No auth required
-    if (record->no_auth_required && !auth_list->push_back(TAG_NO_AUTH_REQUIRED))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // User auth type
-    if (!get_enum(record->user_auth_type, TAG_USER_AUTH_TYPE, auth_list))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Auth timeout
-    if (record->auth_timeout &&
-        !auth_list->push_back(TAG_AUTH_TIMEOUT, ASN1_INTEGER_get(record->auth_timeout)))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // All applications
-    if (record->all_applications && !auth_list->push_back(TAG_ALL_APPLICATIONS))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+// Add the value of field, if record has one, to auth_list.
+static bool extract_field(const KM_AUTH_LIST& record, const AuthListField& field,
+                          AuthorizationSet* auth_list) {
+    if (field.integer_set)
+        return get_repeated_enums(record.*field.integer_set, field.tag, auth_list);
+
+    if (field.integer) {
+        const ASN1_INTEGER* value = record.*field.integer;
+        if (!value)
+            return true;
+        switch (keymaster_tag_get_type(field.tag)) {
+        case KM_ENUM:
+            return auth_list->push_back(keymaster_param_enum(field.tag, ASN1_INTEGER_get(value)));
+        case KM_UINT:
+            return auth_list->push_back(keymaster_param_int(field.tag, ASN1_INTEGER_get(value)));
+        default:
+            return get_ulong(value, field.tag, auth_list);
+        }
+    }
 
-    // Application ID
-    if (record->application_id &&
-        !auth_list->push_back(TAG_APPLICATION_ID, record->application_id->data,
-                              record->application_id->length))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    if (field.boolean)
+        return !(record.*field.boolean) || auth_list->push_back(keymaster_param_bool(field.tag));
 
-    // Attestation application ID
-    if (record->attestation_application_id &&
-        !auth_list->push_back(TAG_ATTESTATION_APPLICATION_ID,
-                              record->attestation_application_id->data,
-                              record->attestation_application_id->length))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    if (field.string) {
+        const ASN1_OCTET_STRING* value = record.*field.string;
+        return !value || auth_list->push_back(keymaster_param_blob(field.tag, value->data,
+                                                                   value->length));
+    }
 
-    // Creation date time
-    if (!get_ulong(record->creation_date_time, TAG_CREATION_DATETIME, auth_list))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    return true;
+}
 
-    // Origin
-    if (!get_enum(record->origin, TAG_ORIGIN, auth_list))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+// Extract the values from the specified ASN.1 record and place them in auth_list.
+keymaster_error_t extract_auth_list(const KM_AUTH_LIST* record, AuthorizationSet* auth_list) {
+    if (!record)
+        return KM_ERROR_OK;
 
-    // Rollback resistant
-    if (record->rollback_resistant && !auth_list->push_back(TAG_ROLLBACK_RESISTANT))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    for (const AuthListField& field : kAuthListFields) {
+        if (!extract_field(*record, field, auth_list))
+            return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    }
 
     // Root of trust
     if (record->root_of_trust) {
@@ -651,72 +537,6 @@ keymaster_error_t extract_auth_list(const KM_AUTH_LIST* record, AuthorizationSet
         // Other root of trust fields are not mapped to auth set entries.
     }
 
-    // OS Version
-    if (record->os_version &&
-        !auth_list->push_back(TAG_OS_VERSION, ASN1_INTEGER_get(record->os_version)))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // OS Patch level
-    if (record->os_patchlevel &&
-        !auth_list->push_back(TAG_OS_PATCHLEVEL, ASN1_INTEGER_get(record->os_patchlevel)))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Brand name
-    if (record->attestation_id_brand &&
-        !auth_list->push_back(TAG_ATTESTATION_ID_BRAND, record->attestation_id_brand->data,
-                              record->attestation_id_brand->length))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Device name
-    if (record->attestation_id_device &&
-        !auth_list->push_back(TAG_ATTESTATION_ID_DEVICE, record->attestation_id_device->data,
-                              record->attestation_id_device->length))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Product name
-    if (record->attestation_id_product &&
-        !auth_list->push_back(TAG_ATTESTATION_ID_PRODUCT, record->attestation_id_product->data,
-                              record->attestation_id_product->length))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Serial number
-    if (record->attestation_id_serial &&
-        !auth_list->push_back(TAG_ATTESTATION_ID_SERIAL, record->attestation_id_serial->data,
-                              record->attestation_id_serial->length))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // IMEI
-    if (record->attestation_id_imei &&
-        !auth_list->push_back(TAG_ATTESTATION_ID_IMEI, record->attestation_id_imei->data,
-                              record->attestation_id_imei->length))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // MEID
-    if (record->attestation_id_meid &&
-        !auth_list->push_back(TAG_ATTESTATION_ID_MEID, record->attestation_id_meid->data,
-                              record->attestation_id_meid->length))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Manufacturer name
-    if (record->attestation_id_manufacturer &&
-        !auth_list->push_back(TAG_ATTESTATION_ID_MANUFACTURER,
-                              record->attestation_id_manufacturer->data,
-                              record->attestation_id_manufacturer->length))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Model name
-    if (record->attestation_id_model &&
-        !auth_list->push_back(TAG_ATTESTATION_ID_MODEL, record->attestation_id_model->data,
-                              record->attestation_id_model->length))
-        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    // Trusted confirmation required
-    if (record->trusted_confirmation_required) {
-        if (!auth_list->push_back(TAG_NO_AUTH_REQUIRED)) {
-            return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-        }
-    }
-
     return KM_ERROR_OK;
 }
 
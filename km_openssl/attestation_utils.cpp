@@ -310,8 +310,8 @@ keymaster_error_t generate_attestation(const AsymmetricKey& key,
          !key.hw_enforced().GetTagValue(TAG_ALGORITHM, &sign_algorithm)))
         return KM_ERROR_UNKNOWN_ERROR;
 
-    EVP_PKEY_Ptr pkey(EVP_PKEY_new());
-    if (!key.InternalToEvp(pkey.get()))
+    EVP_PKEY_Ptr pkey(key.CreateEvpKey());
+    if (!pkey.get())
         return TranslateLastOpenSslError();
 
     X509_Ptr certificate(X509_new());
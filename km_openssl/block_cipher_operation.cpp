@@ -147,7 +147,8 @@ BlockCipherEvpOperation::BlockCipherEvpOperation(keymaster_purpose_t purpose,
                                                  size_t tag_length, Key&& key,
                                                  const EvpCipherDescription& cipher_description)
     : Operation(purpose, key.hw_enforced_move(), key.sw_enforced_move()), block_mode_(block_mode),
-      caller_iv_(caller_iv), tag_length_(tag_length), data_started_(false), padding_(padding),
+      caller_iv_(caller_iv), tag_length_(tag_length), updated_(false), record_stream_(false),
+      next_sequence_number_(0), data_started_(false), padding_(padding),
       key_(key.key_material_move()), cipher_description_(cipher_description) {
     EVP_CIPHER_CTX_init(&ctx_);
 }
@@ -169,6 +170,9 @@ keymaster_error_t BlockCipherEvpOperation::Update(const AuthorizationSet& additi
                                                   const Buffer& input,
                                                   AuthorizationSet* /* output_params */,
                                                   Buffer* output, size_t* input_consumed) {
+    if (record_stream_) return KM_ERROR_INVALID_ARGUMENT;
+    updated_ = true;
+
     keymaster_error_t error;
     if (block_mode_ == KM_MODE_GCM && !HandleAad(additional_params, input, &error)) return error;
     if (!InternalUpdate(input.peek_read(), input.available_read(), output, &error)) return error;
@@ -418,6 +422,7 @@ keymaster_error_t BlockCipherEvpEncryptOperation::Finish(const AuthorizationSet&
                                                          const Buffer& signature,
                                                          AuthorizationSet* output_params,
                                                          Buffer* output) {
+    if (record_stream_) return FinishRecordStream(input);
     if (!output->reserve(input.available_read() + block_size_bytes() + tag_length_)) {
         return KM_ERROR_MEMORY_ALLOCATION_FAILED;
     }
@@ -465,6 +470,8 @@ keymaster_error_t BlockCipherEvpDecryptOperation::Update(const AuthorizationSet&
                                                          AuthorizationSet* /* output_params */,
                                                          Buffer* output, size_t* input_consumed) {
     if (!output || !input_consumed) return KM_ERROR_OUTPUT_PARAMETER_NULL;
+    if (record_stream_) return KM_ERROR_INVALID_ARGUMENT;
+    updated_ = true;
 
     // Barring error, we'll consume it all.
     *input_consumed = input.available_read();
@@ -529,6 +536,8 @@ keymaster_error_t BlockCipherEvpDecryptOperation::Finish(const AuthorizationSet&
                                                          const Buffer& signature,
                                                          AuthorizationSet* output_params,
                                                          Buffer* output) {
+    if (record_stream_) return FinishRecordStream(input);
+
     keymaster_error_t error;
     if (!UpdateForFinish(additional_params, input, output_params, output, &error)) return error;
 
@@ -549,4 +558,116 @@ keymaster_error_t BlockCipherEvpOperation::Abort() {
     return KM_ERROR_OK;
 }
 
+keymaster_error_t BlockCipherEvpOperation::BeginAeadBatch() {
+    if (block_mode_ != KM_MODE_GCM) return KM_ERROR_UNIMPLEMENTED;
+
+    // No IV yet; each record supplies its own.
+    return InitializeCipher(move(key_));
+}
+
+keymaster_error_t BlockCipherEvpOperation::ProcessAeadRecord(KeymasterBlob* nonce,
+                                                             const KeymasterBlob& associated_data,
+                                                             const Buffer& input, Buffer* output) {
+    if (block_mode_ != KM_MODE_GCM) return KM_ERROR_UNIMPLEMENTED;
+    if (!nonce || !output) return KM_ERROR_OUTPUT_PARAMETER_NULL;
+    output->Clear();
+
+    bool encrypting = evp_encrypt_mode() == 1;
+    if (nonce->data_length == 0) {
+        if (!encrypting) return KM_ERROR_INVALID_ARGUMENT;
+        if (!nonce->Reset(GCM_NONCE_SIZE)) return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+        keymaster_error_t error = GenerateRandom(nonce->writable_data(), nonce->data_length);
+        if (error != KM_ERROR_OK) return error;
+    } else if (encrypting && !caller_iv_) {
+        return KM_ERROR_CALLER_NONCE_PROHIBITED;
+    } else if (nonce->data_length != GCM_NONCE_SIZE) {
+        return KM_ERROR_INVALID_NONCE;
+    }
+
+    return SealOrOpenRecord(nonce->data, associated_data.data, associated_data.data_length, input,
+                            output);
+}
+
+keymaster_error_t BlockCipherEvpOperation::ProcessRecord(const AuthorizationSet& additional_params,
+                                                         const Buffer& input,
+                                                         uint64_t* sequence_number,
+                                                         Buffer* output) {
+    if (block_mode_ != KM_MODE_GCM) return KM_ERROR_UNIMPLEMENTED;
+    if (!sequence_number || !output) return KM_ERROR_OUTPUT_PARAMETER_NULL;
+    output->Clear();
+
+    // The cipher state of a message that has been updated can't be mixed with records.
+    if (updated_) return KM_ERROR_INVALID_ARGUMENT;
+    // The sequence number has wrapped, so every nonce the stream could use has been used.
+    if (record_stream_ && next_sequence_number_ == 0) return KM_ERROR_KEY_MAX_OPS_EXCEEDED;
+
+    keymaster_blob_t aad = {nullptr, 0};
+    additional_params.GetTagValue(TAG_ASSOCIATED_DATA, &aad);
+
+    // As in TLS 1.3, the record nonce is the nonce from Begin() XORed with the big-endian sequence
+    // number, left-padded to the nonce size.
+    assert(iv_.data_length == GCM_NONCE_SIZE);
+    uint8_t nonce[GCM_NONCE_SIZE];
+    memcpy(nonce, iv_.data, sizeof(nonce));
+    for (size_t i = 0; i < sizeof(next_sequence_number_); ++i)
+        nonce[sizeof(nonce) - 1 - i] ^= static_cast<uint8_t>(next_sequence_number_ >> (8 * i));
+
+    record_stream_ = true;
+    *sequence_number = next_sequence_number_++;
+    return SealOrOpenRecord(nonce, aad.data, aad.data_length, input, output);
+}
+
+keymaster_error_t BlockCipherEvpOperation::FinishRecordStream(const Buffer& input) {
+    // Every record was complete, so there's nothing left to finish.
+    return input.available_read() ? KM_ERROR_INVALID_ARGUMENT : KM_ERROR_OK;
+}
+
+keymaster_error_t BlockCipherEvpOperation::SealOrOpenRecord(const uint8_t* nonce,
+                                                            const uint8_t* associated_data,
+                                                            size_t associated_data_length,
+                                                            const Buffer& input, Buffer* output) {
+    bool encrypting = evp_encrypt_mode() == 1;
+    size_t data_length = input.available_read();
+    if (!encrypting) {
+        if (data_length < tag_length_) return KM_ERROR_INVALID_INPUT_LENGTH;
+        data_length -= tag_length_;
+    }
+    if (!output->reserve(data_length + tag_length_)) return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+
+    // Setting only the IV keeps the key schedule set up by Begin() or BeginAeadBatch().  All of the
+    // associated data is passed in one call, so there's no partial block to buffer as HandleAad()
+    // does.
+    int output_written;
+    if (!EVP_CipherInit_ex(&ctx_, nullptr /* cipher */, nullptr /* engine */, nullptr /* key */,
+                           nonce, -1 /* keep direction */) ||
+        (associated_data_length > 0 &&
+         !EVP_CipherUpdate(&ctx_, nullptr /* out */, &output_written, associated_data,
+                           associated_data_length)) ||
+        (data_length > 0 && !EVP_CipherUpdate(&ctx_, output->peek_write(), &output_written,
+                                              input.peek_read(), data_length)))
+        return TranslateLastOpenSslError();
+    if (data_length > 0 && !output->advance_write(output_written)) return KM_ERROR_UNKNOWN_ERROR;
+
+    if (!encrypting &&
+        !EVP_CIPHER_CTX_ctrl(&ctx_, EVP_CTRL_GCM_SET_TAG, tag_length_,
+                             const_cast<uint8_t*>(input.peek_read() + data_length))) {
+        output->Clear();
+        return TranslateLastOpenSslError();
+    }
+
+    if (!EVP_CipherFinal_ex(&ctx_, output->peek_write(), &output_written)) {
+        // Don't release plaintext that failed authentication.
+        output->Clear();
+        return encrypting ? TranslateLastOpenSslError() : KM_ERROR_VERIFICATION_FAILED;
+    }
+
+    if (encrypting &&
+        (!EVP_CIPHER_CTX_ctrl(&ctx_, EVP_CTRL_GCM_GET_TAG, tag_length_, output->peek_write()) ||
+         !output->advance_write(tag_length_))) {
+        output->Clear();
+        return TranslateLastOpenSslError();
+    }
+    return KM_ERROR_OK;
+}
+
 }  // namespace keymaster
@@ -83,6 +83,12 @@ class BlockCipherEvpOperation : public Operation {
                              Buffer* output) override;
     keymaster_error_t Abort() override;
 
+    keymaster_error_t BeginAeadBatch() override;
+    keymaster_error_t ProcessAeadRecord(KeymasterBlob* nonce, const KeymasterBlob& associated_data,
+                                        const Buffer& input, Buffer* output) override;
+    keymaster_error_t ProcessRecord(const AuthorizationSet& additional_params, const Buffer& input,
+                                    uint64_t* sequence_number, Buffer* output) override;
+
   protected:
     virtual int evp_encrypt_mode() = 0;
 
@@ -98,6 +104,10 @@ class BlockCipherEvpOperation : public Operation {
                         keymaster_error_t* error);
     bool UpdateForFinish(const AuthorizationSet& additional_params, const Buffer& input,
                          AuthorizationSet* output_params, Buffer* output, keymaster_error_t* error);
+    keymaster_error_t FinishRecordStream(const Buffer& input);
+    keymaster_error_t SealOrOpenRecord(const uint8_t* nonce, const uint8_t* associated_data,
+                                       size_t associated_data_length, const Buffer& input,
+                                       Buffer* output);
     size_t block_size_bytes() const { return cipher_description_.block_size_bytes(); }
 
     const keymaster_block_mode_t block_mode_;
@@ -105,6 +115,9 @@ class BlockCipherEvpOperation : public Operation {
     KeymasterBlob iv_;
     const bool caller_iv_;
     const size_t tag_length_;
+    bool updated_;
+    bool record_stream_;
+    uint64_t next_sequence_number_;
 
   private:
     UniquePtr<uint8_t[]> aad_block_buf_;
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <keymaster/km_openssl/chacha20_poly1305_key.h>
+
+#include <keymaster/logger.h>
+#include <keymaster/new>
+
+#include "chacha20_poly1305_operation.h"
+
+namespace keymaster {
+
+static ChaCha20Poly1305OperationFactory encrypt_factory(KM_PURPOSE_ENCRYPT);
+static ChaCha20Poly1305OperationFactory decrypt_factory(KM_PURPOSE_DECRYPT);
+
+OperationFactory*
+ChaCha20Poly1305KeyFactory::GetOperationFactory(keymaster_purpose_t purpose) const {
+    switch (purpose) {
+    case KM_PURPOSE_ENCRYPT:
+        return &encrypt_factory;
+    case KM_PURPOSE_DECRYPT:
+        return &decrypt_factory;
+    default:
+        return nullptr;
+    }
+}
+
+keymaster_error_t
+ChaCha20Poly1305KeyFactory::LoadKey(KeymasterKeyBlob&& key_material,
+                                    const AuthorizationSet& /* additional_params */,
+                                    AuthorizationSet&& hw_enforced, AuthorizationSet&& sw_enforced,
+                                    UniquePtr<Key>* key) const {
+    if (!key) return KM_ERROR_OUTPUT_PARAMETER_NULL;
+
+    uint32_t min_mac_length;
+    if (!hw_enforced.GetTagValue(TAG_MIN_MAC_LENGTH, &min_mac_length) &&
+        !sw_enforced.GetTagValue(TAG_MIN_MAC_LENGTH, &min_mac_length)) {
+        LOG_E("ChaCha20-Poly1305 key must have KM_TAG_MIN_MAC_LENGTH", 0);
+        return KM_ERROR_INVALID_KEY_BLOB;
+    }
+
+    keymaster_error_t error = KM_ERROR_OK;
+    key->reset(new (std::nothrow) ChaCha20Poly1305Key(move(key_material), move(hw_enforced),
+                                                      move(sw_enforced), this));
+    if (!key->get()) error = KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    return error;
+}
+
+keymaster_error_t ChaCha20Poly1305KeyFactory::validate_algorithm_specific_new_key_params(
+    const AuthorizationSet& key_description) const {
+    if (key_description.find(TAG_BLOCK_MODE) != -1) {
+        LOG_W("KM_TAG_BLOCK_MODE found for ChaCha20-Poly1305 key", 0);
+        return KM_ERROR_UNSUPPORTED_BLOCK_MODE;
+    }
+
+    uint32_t min_tag_length;
+    if (!key_description.GetTagValue(TAG_MIN_MAC_LENGTH, &min_tag_length))
+        return KM_ERROR_MISSING_MIN_MAC_LENGTH;
+
+    if (min_tag_length % 8 != 0 || min_tag_length < kMinChaCha20Poly1305TagLength ||
+        min_tag_length > kMaxChaCha20Poly1305TagLength)
+        return KM_ERROR_UNSUPPORTED_MIN_MAC_LENGTH;
+
+    return KM_ERROR_OK;
+}
+
+}  // namespace keymaster
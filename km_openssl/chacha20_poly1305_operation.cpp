@@ -0,0 +1,402 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "chacha20_poly1305_operation.h"
+
+#include <keymaster/new>
+
+#include <openssl/chacha.h>
+#include <openssl/mem.h>
+
+#include <keymaster/km_openssl/chacha20_poly1305_key.h>
+#include <keymaster/km_openssl/openssl_utils.h>
+#include <keymaster/logger.h>
+
+namespace keymaster {
+
+static const size_t kChaCha20Poly1305KeyBytes = kChaCha20Poly1305KeySize / 8;
+static const size_t kPoly1305KeySize = 32;
+
+// The block counter is 32 bits and block zero is used to derive the Poly1305 key, which bounds the
+// amount of data that can be processed under a single nonce.
+static const uint64_t kMaxChaCha20Poly1305DataLength =
+    ((static_cast<uint64_t>(1) << 32) - 1) * kChaCha20BlockSize;
+
+inline size_t min(size_t a, size_t b) {
+    return (a < b) ? a : b;
+}
+
+static keymaster_error_t GetAndValidateTagLength(const AuthorizationSet& begin_params,
+                                                 const AuthProxy& key_params, size_t* tag_length) {
+    uint32_t tag_length_bits;
+    if (!begin_params.GetTagValue(TAG_MAC_LENGTH, &tag_length_bits)) {
+        return KM_ERROR_MISSING_MAC_LENGTH;
+    }
+
+    uint32_t min_tag_length_bits;
+    if (!key_params.GetTagValue(TAG_MIN_MAC_LENGTH, &min_tag_length_bits)) {
+        LOG_E("ChaCha20-Poly1305 key must have KM_TAG_MIN_MAC_LENGTH", 0);
+        return KM_ERROR_INVALID_KEY_BLOB;
+    }
+
+    if (tag_length_bits % 8 != 0 || tag_length_bits > kMaxChaCha20Poly1305TagLength ||
+        tag_length_bits < kMinChaCha20Poly1305TagLength) {
+        return KM_ERROR_UNSUPPORTED_MAC_LENGTH;
+    }
+
+    if (tag_length_bits < min_tag_length_bits) {
+        return KM_ERROR_INVALID_MAC_LENGTH;
+    }
+
+    *tag_length = tag_length_bits / 8;
+    return KM_ERROR_OK;
+}
+
+OperationPtr ChaCha20Poly1305OperationFactory::CreateOperation(Key&& key,
+                                                               const AuthorizationSet& begin_params,
+                                                               keymaster_error_t* error) const {
+    *error = KM_ERROR_OK;
+    if (begin_params.find(TAG_BLOCK_MODE) != -1) {
+        LOG_E("Block mode specified for ChaCha20-Poly1305 operation", 0);
+        *error = KM_ERROR_UNSUPPORTED_BLOCK_MODE;
+        return nullptr;
+    }
+
+    keymaster_padding_t padding;
+    if (begin_params.GetTagValue(TAG_PADDING, &padding) && padding != KM_PAD_NONE) {
+        LOG_E("Padding mode %d not supported", padding);
+        *error = KM_ERROR_UNSUPPORTED_PADDING_MODE;
+        return nullptr;
+    }
+
+    size_t tag_length;
+    *error = GetAndValidateTagLength(begin_params, key.authorizations(), &tag_length);
+    if (*error != KM_ERROR_OK) return nullptr;
+
+    bool caller_nonce = key.authorizations().GetTagValue(TAG_CALLER_NONCE);
+
+    OperationPtr op;
+    switch (purpose_) {
+    case KM_PURPOSE_ENCRYPT:
+        op.reset(new (std::nothrow)
+                     ChaCha20Poly1305EncryptOperation(caller_nonce, tag_length, move(key)));
+        break;
+    case KM_PURPOSE_DECRYPT:
+        op.reset(new (std::nothrow) ChaCha20Poly1305DecryptOperation(tag_length, move(key)));
+        break;
+    default:
+        *error = KM_ERROR_UNSUPPORTED_PURPOSE;
+        return nullptr;
+    }
+
+    if (!op) *error = KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    return op;
+}
+
+static const keymaster_padding_t supported_padding_modes[] = {KM_PAD_NONE};
+const keymaster_padding_t*
+ChaCha20Poly1305OperationFactory::SupportedPaddingModes(size_t* padding_mode_count) const {
+    *padding_mode_count = array_length(supported_padding_modes);
+    return supported_padding_modes;
+}
+
+ChaCha20Poly1305Operation::ChaCha20Poly1305Operation(keymaster_purpose_t purpose,
+                                                     size_t tag_length, Key&& key)
+    : Operation(purpose, key.hw_enforced_move(), key.sw_enforced_move()), tag_length_(tag_length),
+      key_(key.key_material_move()), keystream_used_(kChaCha20BlockSize), counter_(1),
+      aad_length_(0), data_length_(0), data_started_(false) {}
+
+ChaCha20Poly1305Operation::~ChaCha20Poly1305Operation() {
+    memset_s(&poly1305_, 0, sizeof(poly1305_));
+    memset_s(keystream_, 0, sizeof(keystream_));
+}
+
+keymaster_error_t ChaCha20Poly1305Operation::Begin(const AuthorizationSet& /* input_params */,
+                                                   AuthorizationSet* /* output_params */) {
+    if (key_.key_material_size != kChaCha20Poly1305KeyBytes) {
+        LOG_E("ChaCha20-Poly1305 key material is %d bytes", key_.key_material_size);
+        return KM_ERROR_INVALID_KEY_BLOB;
+    }
+
+    auto rc = GenerateRandom(reinterpret_cast<uint8_t*>(&operation_handle_),
+                             (size_t)sizeof(operation_handle_));
+    if (rc != KM_ERROR_OK) return rc;
+
+    // The one-time Poly1305 key is the start of keystream block zero.
+    uint8_t poly1305_key[kPoly1305KeySize] = {};
+    CRYPTO_chacha_20(poly1305_key, poly1305_key, sizeof(poly1305_key), key_.key_material, nonce_,
+                     0 /* counter */);
+    CRYPTO_poly1305_init(&poly1305_, poly1305_key);
+    memset_s(poly1305_key, 0, sizeof(poly1305_key));
+    return KM_ERROR_OK;
+}
+
+keymaster_error_t ChaCha20Poly1305Operation::Update(const AuthorizationSet& additional_params,
+                                                    const Buffer& input,
+                                                    AuthorizationSet* /* output_params */,
+                                                    Buffer* output, size_t* input_consumed) {
+    if (!output || !input_consumed) return KM_ERROR_OUTPUT_PARAMETER_NULL;
+
+    keymaster_error_t error;
+    if (!HandleAad(additional_params, input, &error)) return error;
+    if (!ProcessData(input.peek_read(), input.available_read(), output, &error)) return error;
+    *input_consumed = input.available_read();
+    return KM_ERROR_OK;
+}
+
+keymaster_error_t ChaCha20Poly1305Operation::GetNonce(const AuthorizationSet& input_params) {
+    keymaster_blob_t nonce_blob;
+    if (!input_params.GetTagValue(TAG_NONCE, &nonce_blob)) {
+        LOG_E("No nonce provided", 0);
+        return KM_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (nonce_blob.data_length != kChaCha20Poly1305NonceSize) {
+        LOG_E("Expected %d-byte nonce for ChaCha20-Poly1305 operation, but got %d bytes",
+              kChaCha20Poly1305NonceSize, nonce_blob.data_length);
+        return KM_ERROR_INVALID_NONCE;
+    }
+
+    memcpy(nonce_, nonce_blob.data, kChaCha20Poly1305NonceSize);
+    return KM_ERROR_OK;
+}
+
+/*
+ * Associated data goes straight into the Poly1305 state; unlike the GCM case there are no block
+ * alignment restrictions on what can be passed in, so nothing needs to be buffered.
+ */
+bool ChaCha20Poly1305Operation::HandleAad(const AuthorizationSet& input_params,
+                                          const Buffer& input, keymaster_error_t* error) {
+    keymaster_blob_t aad;
+    if (input_params.GetTagValue(TAG_ASSOCIATED_DATA, &aad)) {
+        if (data_started_) {
+            *error = KM_ERROR_INVALID_TAG;
+            return false;
+        }
+        CRYPTO_poly1305_update(&poly1305_, aad.data, aad.data_length);
+        aad_length_ += aad.data_length;
+    }
+
+    // Data has begun, no more AAD is allowed.
+    if (input.available_read()) StartData();
+    return true;
+}
+
+void ChaCha20Poly1305Operation::StartData() {
+    if (data_started_) return;
+    PadPoly1305(aad_length_);
+    data_started_ = true;
+}
+
+void ChaCha20Poly1305Operation::PadPoly1305(uint64_t length) {
+    static const uint8_t zeros[16] = {};
+    size_t remainder = length % sizeof(zeros);
+    if (remainder) CRYPTO_poly1305_update(&poly1305_, zeros, sizeof(zeros) - remainder);
+}
+
+bool ChaCha20Poly1305Operation::ProcessData(const uint8_t* input, size_t input_length,
+                                            Buffer* output, keymaster_error_t* error) {
+    if (!input_length) return true;
+
+    if (input_length > kMaxChaCha20Poly1305DataLength - data_length_) {
+        *error = KM_ERROR_INVALID_INPUT_LENGTH;
+        return false;
+    }
+
+    if (!output->reserve(input_length)) {
+        *error = KM_ERROR_MEMORY_ALLOCATION_FAILED;
+        return false;
+    }
+
+    uint8_t* out = output->peek_write();
+    ApplyKeystream(input, input_length, out);
+    // The tag always covers the ciphertext.
+    CRYPTO_poly1305_update(&poly1305_, purpose() == KM_PURPOSE_ENCRYPT ? out : input,
+                           input_length);
+    data_length_ += input_length;
+    return output->advance_write(input_length);
+}
+
+/*
+ * Encrypt or decrypt the next input_length bytes of the stream.  Whole keystream blocks are
+ * generated directly into the output; only a trailing partial block is kept in keystream_, so
+ * that the next call can pick up where this one left off.
+ */
+void ChaCha20Poly1305Operation::ApplyKeystream(const uint8_t* input, size_t input_length,
+                                               uint8_t* output) {
+    size_t buffered = min(kChaCha20BlockSize - keystream_used_, input_length);
+    for (size_t i = 0; i < buffered; ++i)
+        output[i] = input[i] ^ keystream_[keystream_used_ + i];
+    keystream_used_ += buffered;
+    input += buffered;
+    output += buffered;
+    input_length -= buffered;
+
+    size_t whole_blocks = input_length / kChaCha20BlockSize;
+    if (whole_blocks) {
+        CRYPTO_chacha_20(output, input, whole_blocks * kChaCha20BlockSize, key_.key_material,
+                         nonce_, counter_);
+        counter_ += whole_blocks;
+        input += whole_blocks * kChaCha20BlockSize;
+        output += whole_blocks * kChaCha20BlockSize;
+        input_length -= whole_blocks * kChaCha20BlockSize;
+    }
+
+    if (input_length) {
+        memset(keystream_, 0, sizeof(keystream_));
+        CRYPTO_chacha_20(keystream_, keystream_, sizeof(keystream_), key_.key_material, nonce_,
+                         counter_++);
+        for (size_t i = 0; i < input_length; ++i)
+            output[i] = input[i] ^ keystream_[i];
+        keystream_used_ = input_length;
+    }
+}
+
+static void encode_le64(uint64_t value, uint8_t* out) {
+    for (size_t i = 0; i < sizeof(value); ++i)
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+void ChaCha20Poly1305Operation::ComputeTag(uint8_t tag[kPoly1305TagSize]) {
+    StartData();
+    PadPoly1305(data_length_);
+
+    uint8_t lengths[2 * sizeof(uint64_t)];
+    encode_le64(aad_length_, lengths);
+    encode_le64(data_length_, lengths + sizeof(uint64_t));
+    CRYPTO_poly1305_update(&poly1305_, lengths, sizeof(lengths));
+    CRYPTO_poly1305_finish(&poly1305_, tag);
+}
+
+bool ChaCha20Poly1305Operation::UpdateForFinish(const AuthorizationSet& additional_params,
+                                                const Buffer& input,
+                                                AuthorizationSet* output_params, Buffer* output,
+                                                keymaster_error_t* error) {
+    if (input.available_read() || !additional_params.empty()) {
+        size_t input_consumed;
+        *error = Update(additional_params, input, output_params, output, &input_consumed);
+        if (*error != KM_ERROR_OK) return false;
+        if (input_consumed != input.available_read()) {
+            *error = KM_ERROR_INVALID_INPUT_LENGTH;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+keymaster_error_t ChaCha20Poly1305EncryptOperation::Begin(const AuthorizationSet& input_params,
+                                                          AuthorizationSet* output_params) {
+    if (!output_params) return KM_ERROR_OUTPUT_PARAMETER_NULL;
+
+    keymaster_error_t error = KM_ERROR_OK;
+    if (input_params.find(TAG_NONCE) == -1) {
+        error = GenerateRandom(nonce_, sizeof(nonce_));
+    } else if (caller_nonce_) {
+        error = GetNonce(input_params);
+    } else {
+        error = KM_ERROR_CALLER_NONCE_PROHIBITED;
+    }
+
+    if (error != KM_ERROR_OK) return error;
+    output_params->push_back(TAG_NONCE, nonce_, sizeof(nonce_));
+
+    return ChaCha20Poly1305Operation::Begin(input_params, output_params);
+}
+
+keymaster_error_t ChaCha20Poly1305EncryptOperation::Finish(
+    const AuthorizationSet& additional_params, const Buffer& input, const Buffer& /* signature */,
+    AuthorizationSet* output_params, Buffer* output) {
+    if (!output) return KM_ERROR_OUTPUT_PARAMETER_NULL;
+    if (!output->reserve(input.available_read() + tag_length_)) {
+        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    keymaster_error_t error;
+    if (!UpdateForFinish(additional_params, input, output_params, output, &error)) return error;
+
+    uint8_t tag[kPoly1305TagSize];
+    ComputeTag(tag);
+    if (!output->reserve(tag_length_)) return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    if (!output->write(tag, tag_length_)) return KM_ERROR_UNKNOWN_ERROR;
+    return KM_ERROR_OK;
+}
+
+keymaster_error_t ChaCha20Poly1305DecryptOperation::Begin(const AuthorizationSet& input_params,
+                                                          AuthorizationSet* output_params) {
+    keymaster_error_t error = GetNonce(input_params);
+    if (error != KM_ERROR_OK) return error;
+
+    return ChaCha20Poly1305Operation::Begin(input_params, output_params);
+}
+
+/*
+ * The last tag_length_ bytes seen so far may turn out to be the tag, so they're held back in
+ * tag_buf_ and only processed as data once more input arrives.
+ */
+keymaster_error_t ChaCha20Poly1305DecryptOperation::Update(
+    const AuthorizationSet& additional_params, const Buffer& input,
+    AuthorizationSet* /* output_params */, Buffer* output, size_t* input_consumed) {
+    if (!output || !input_consumed) return KM_ERROR_OUTPUT_PARAMETER_NULL;
+
+    // Barring error, we'll consume it all.
+    *input_consumed = input.available_read();
+
+    keymaster_error_t error;
+    if (!HandleAad(additional_params, input, &error)) return error;
+
+    const uint8_t* data = input.peek_read();
+    const size_t data_length = input.available_read();
+    if (!data_length) return KM_ERROR_OK;
+
+    if (tag_buf_len_ + data_length <= tag_length_) {
+        memcpy(tag_buf_ + tag_buf_len_, data, data_length);
+        tag_buf_len_ += data_length;
+        return KM_ERROR_OK;
+    }
+
+    const size_t to_process = tag_buf_len_ + data_length - tag_length_;
+    const size_t to_process_from_tag_buf = min(to_process, tag_buf_len_);
+    const size_t to_process_from_input = to_process - to_process_from_tag_buf;
+
+    if (!ProcessData(tag_buf_, to_process_from_tag_buf, output, &error)) return error;
+    memmove(tag_buf_, tag_buf_ + to_process_from_tag_buf, tag_buf_len_ - to_process_from_tag_buf);
+    tag_buf_len_ -= to_process_from_tag_buf;
+
+    if (!ProcessData(data, to_process_from_input, output, &error)) return error;
+    memcpy(tag_buf_ + tag_buf_len_, data + to_process_from_input,
+           data_length - to_process_from_input);
+    tag_buf_len_ += data_length - to_process_from_input;
+    assert(tag_buf_len_ == tag_length_);
+
+    return KM_ERROR_OK;
+}
+
+keymaster_error_t ChaCha20Poly1305DecryptOperation::Finish(
+    const AuthorizationSet& additional_params, const Buffer& input, const Buffer& /* signature */,
+    AuthorizationSet* output_params, Buffer* output) {
+    keymaster_error_t error;
+    if (!UpdateForFinish(additional_params, input, output_params, output, &error)) return error;
+
+    if (tag_buf_len_ < tag_length_) return KM_ERROR_INVALID_INPUT_LENGTH;
+
+    uint8_t tag[kPoly1305TagSize];
+    ComputeTag(tag);
+    if (CRYPTO_memcmp(tag, tag_buf_, tag_length_) != 0) return KM_ERROR_VERIFICATION_FAILED;
+    return KM_ERROR_OK;
+}
+
+}  // namespace keymaster
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYSTEM_KEYMASTER_CHACHA20_POLY1305_OPERATION_H_
+#define SYSTEM_KEYMASTER_CHACHA20_POLY1305_OPERATION_H_
+
+#include <openssl/poly1305.h>
+
+#include <keymaster/operation.h>
+
+namespace keymaster {
+
+static const size_t kChaCha20BlockSize = 64;
+static const size_t kChaCha20Poly1305NonceSize = 12;
+static const size_t kPoly1305TagSize = 16;
+
+class ChaCha20Poly1305OperationFactory : public OperationFactory {
+  public:
+    explicit ChaCha20Poly1305OperationFactory(keymaster_purpose_t purpose) : purpose_(purpose) {}
+
+    KeyType registry_key() const override {
+        return KeyType(KM_ALGORITHM_CHACHA20_POLY1305, purpose_);
+    }
+
+    OperationPtr CreateOperation(Key&& key, const AuthorizationSet& begin_params,
+                                 keymaster_error_t* error) const override;
+
+    const keymaster_padding_t* SupportedPaddingModes(size_t* padding_count) const override;
+
+  private:
+    const keymaster_purpose_t purpose_;
+};
+
+/**
+ * Streaming ChaCha20-Poly1305 AEAD, as specified by RFC 8439.  The operation accepts associated
+ * data (KM_TAG_ASSOCIATED_DATA) in any number of Update calls before the first data byte, and
+ * data in chunks of any size.  The keystream and the Poly1305 state carry over between calls, so
+ * no input is buffered except, when decrypting, the trailing bytes that may be the tag.
+ */
+class ChaCha20Poly1305Operation : public Operation {
+  public:
+    ChaCha20Poly1305Operation(keymaster_purpose_t purpose, size_t tag_length, Key&& key);
+    ~ChaCha20Poly1305Operation();
+
+    keymaster_error_t Begin(const AuthorizationSet& input_params,
+                            AuthorizationSet* output_params) override;
+    keymaster_error_t Update(const AuthorizationSet& additional_params, const Buffer& input,
+                             AuthorizationSet* output_params, Buffer* output,
+                             size_t* input_consumed) override;
+    keymaster_error_t Abort() override { return KM_ERROR_OK; }
+
+  protected:
+    keymaster_error_t GetNonce(const AuthorizationSet& input_params);
+    bool HandleAad(const AuthorizationSet& input_params, const Buffer& input,
+                   keymaster_error_t* error);
+    bool ProcessData(const uint8_t* input, size_t input_length, Buffer* output,
+                     keymaster_error_t* error);
+    bool UpdateForFinish(const AuthorizationSet& additional_params, const Buffer& input,
+                         AuthorizationSet* output_params, Buffer* output, keymaster_error_t* error);
+    void ComputeTag(uint8_t tag[kPoly1305TagSize]);
+
+    const size_t tag_length_;
+    uint8_t nonce_[kChaCha20Poly1305NonceSize];
+
+  private:
+    void ApplyKeystream(const uint8_t* input, size_t input_length, uint8_t* output);
+    void PadPoly1305(uint64_t length);
+    void StartData();
+
+    KeymasterKeyBlob key_;
+    poly1305_state poly1305_;
+    uint8_t keystream_[kChaCha20BlockSize];
+    size_t keystream_used_;
+    uint32_t counter_;
+    uint64_t aad_length_;
+    uint64_t data_length_;
+    bool data_started_;
+};
+
+class ChaCha20Poly1305EncryptOperation : public ChaCha20Poly1305Operation {
+  public:
+    ChaCha20Poly1305EncryptOperation(bool caller_nonce, size_t tag_length, Key&& key)
+        : ChaCha20Poly1305Operation(KM_PURPOSE_ENCRYPT, tag_length, move(key)),
+          caller_nonce_(caller_nonce) {}
+
+    keymaster_error_t Begin(const AuthorizationSet& input_params,
+                            AuthorizationSet* output_params) override;
+    keymaster_error_t Finish(const AuthorizationSet& additional_params, const Buffer& input,
+                             const Buffer& signature, AuthorizationSet* output_params,
+                             Buffer* output) override;
+
+  private:
+    const bool caller_nonce_;
+};
+
+class ChaCha20Poly1305DecryptOperation : public ChaCha20Poly1305Operation {
+  public:
+    ChaCha20Poly1305DecryptOperation(size_t tag_length, Key&& key)
+        : ChaCha20Poly1305Operation(KM_PURPOSE_DECRYPT, tag_length, move(key)), tag_buf_len_(0) {}
+
+    keymaster_error_t Begin(const AuthorizationSet& input_params,
+                            AuthorizationSet* output_params) override;
+    keymaster_error_t Update(const AuthorizationSet& additional_params, const Buffer& input,
+                             AuthorizationSet* output_params, Buffer* output,
+                             size_t* input_consumed) override;
+    keymaster_error_t Finish(const AuthorizationSet& additional_params, const Buffer& input,
+                             const Buffer& signature, AuthorizationSet* output_params,
+                             Buffer* output) override;
+
+  private:
+    uint8_t tag_buf_[kPoly1305TagSize];
+    size_t tag_buf_len_;
+};
+
+}  // namespace keymaster
+
+#endif  // SYSTEM_KEYMASTER_CHACHA20_POLY1305_OPERATION_H_
@@ -35,20 +35,9 @@ size_t min(size_t a, size_t b) {
     return a < b ? a : b;
 }
 
-DEFINE_OPENSSL_OBJECT_POINTER(CMAC_CTX)
-
-keymaster_error_t ckdf(const KeymasterKeyBlob& key, const KeymasterBlob& label,
-                       const keymaster_blob_t* context_chunks, size_t num_chunks,
-                       KeymasterKeyBlob* output) {
-    // Note: the variables i and L correspond to i and L in the standard.  See page 12 of
-    // http://nvlpubs.nist.gov/nistpubs/Legacy/SP/nistspecialpublication800-108.pdf.
-
-    const uint32_t blocks = div_round_up(output->key_material_size, AES_BLOCK_SIZE);
-    const uint32_t L = output->key_material_size * 8;  // bits
-    const uint32_t net_order_L = hton(L);
-
-    CMAC_CTX_Ptr ctx(CMAC_CTX_new());
-    if (!ctx.get()) return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+keymaster_error_t Ckdf::Init(const KeymasterKeyBlob& key) {
+    ctx_.reset(CMAC_CTX_new());
+    if (!ctx_.get()) return KM_ERROR_MEMORY_ALLOCATION_FAILED;
 
     auto algo = EVP_aes_128_cbc();
     switch (key.key_material_size) {
@@ -59,39 +48,58 @@ keymaster_error_t ckdf(const KeymasterKeyBlob& key, const KeymasterBlob& label,
         algo = EVP_aes_256_cbc();
         break;
     default:
+        ctx_.reset();
         return KM_ERROR_UNSUPPORTED_KEY_SIZE;
     }
 
-    if (!CMAC_Init(ctx.get(), key.key_material, key.key_material_size, algo,
+    if (!CMAC_Init(ctx_.get(), key.key_material, key.key_material_size, algo,
                    nullptr /* engine */)) {
+        ctx_.reset();
         return TranslateLastOpenSslError();
     }
+    return KM_ERROR_OK;
+}
+
+keymaster_error_t Ckdf::Derive(const keymaster_blob_t& label,
+                               const keymaster_blob_t* context_chunks, size_t num_chunks,
+                               KeymasterKeyBlob* output) {
+    if (!is_initialized()) return KM_ERROR_UNKNOWN_ERROR;
+
+    // Note: the variables i and L correspond to i and L in the standard.  See page 12 of
+    // http://nvlpubs.nist.gov/nistpubs/Legacy/SP/nistspecialpublication800-108.pdf.
+
+    const uint32_t blocks = div_round_up(output->key_material_size, AES_BLOCK_SIZE);
+    const uint32_t L = output->key_material_size * 8;  // bits
+    const uint32_t net_order_L = hton(L);
 
     auto output_pos = const_cast<uint8_t*>(output->begin());
     memset(output_pos, 0, output->key_material_size);
     for (uint32_t i = 1; i <= blocks; ++i) {
+        // Restart the MAC, keeping the prepared key schedule and subkeys.
+        if (!CMAC_Reset(ctx_.get())) return TranslateLastOpenSslError();
+
         // Data to mac is i || label || 0x00 || context || L, with i and L represented in 32 bits,
         // in network order.
 
         // i
         uint32_t net_order_i = hton(i);
-        if (!CMAC_Update(ctx.get(), reinterpret_cast<uint8_t*>(&net_order_i),
+        if (!CMAC_Update(ctx_.get(), reinterpret_cast<uint8_t*>(&net_order_i),
                          sizeof(net_order_i))) {
             return TranslateLastOpenSslError();
         }
 
         // label
-        if (!CMAC_Update(ctx.get(), label.data, label.data_length)) {
+        if (!CMAC_Update(ctx_.get(), label.data, label.data_length)) {
             return TranslateLastOpenSslError();
         }
 
         // 0x00
         uint8_t zero = 0;
-        if (!CMAC_Update(ctx.get(), &zero, sizeof(zero))) return TranslateLastOpenSslError();
+        if (!CMAC_Update(ctx_.get(), &zero, sizeof(zero))) return TranslateLastOpenSslError();
 
         // context
         for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
-            if (!CMAC_Update(ctx.get(), context_chunks[chunk].data,
+            if (!CMAC_Update(ctx_.get(), context_chunks[chunk].data,
                              context_chunks[chunk].data_length)) {
                 return TranslateLastOpenSslError();
             }
@@ -100,25 +108,42 @@ keymaster_error_t ckdf(const KeymasterKeyBlob& key, const KeymasterBlob& label,
         // L
         uint8_t buf[4];
         memcpy(buf, &net_order_L, 4);
-        if (!CMAC_Update(ctx.get(), buf, sizeof(buf))) TranslateLastOpenSslError();
+        if (!CMAC_Update(ctx_.get(), buf, sizeof(buf))) return TranslateLastOpenSslError();
 
         size_t out_len;
         if (output_pos <= output->end() - AES_BLOCK_SIZE) {
-            if (!CMAC_Final(ctx.get(), output_pos, &out_len)) return TranslateLastOpenSslError();
+            if (!CMAC_Final(ctx_.get(), output_pos, &out_len)) return TranslateLastOpenSslError();
             output_pos += out_len;
         } else {
             uint8_t cmac[AES_BLOCK_SIZE];
-            if (!CMAC_Final(ctx.get(), cmac, &out_len)) return TranslateLastOpenSslError();
+            if (!CMAC_Final(ctx_.get(), cmac, &out_len)) return TranslateLastOpenSslError();
             size_t to_copy = output->end() - output_pos;
             memcpy(output_pos, cmac, to_copy);
+            memset_s(cmac, 0, sizeof(cmac));
             output_pos += to_copy;
         }
-
-        CMAC_Reset(ctx.get());
     }
     assert(output_pos == output->end());
 
     return KM_ERROR_OK;
 }
 
+keymaster_error_t Ckdf::Derive(const Derivation* derivations, size_t num_derivations) {
+    for (auto& derivation : array_range(derivations, num_derivations)) {
+        keymaster_error_t error = Derive(derivation.label, derivation.context_chunks,
+                                         derivation.num_chunks, derivation.output);
+        if (error != KM_ERROR_OK) return error;
+    }
+    return KM_ERROR_OK;
+}
+
+keymaster_error_t ckdf(const KeymasterKeyBlob& key, const KeymasterBlob& label,
+                       const keymaster_blob_t* context_chunks, size_t num_chunks,
+                       KeymasterKeyBlob* output) {
+    Ckdf prepared;
+    keymaster_error_t error = prepared.Init(key);
+    if (error != KM_ERROR_OK) return error;
+    return prepared.Derive(label, context_chunks, num_chunks, output);
+}
+
 }  // namespace keymaster
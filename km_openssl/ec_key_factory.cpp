@@ -20,7 +20,10 @@
 
 #include <keymaster/km_openssl/ec_key.h>
 #include <keymaster/km_openssl/ecdsa_operation.h>
+#include <keymaster/km_openssl/ed25519_key.h>
+#include <keymaster/km_openssl/key_agreement_operation.h>
 #include <keymaster/km_openssl/openssl_err.h>
+#include <keymaster/km_openssl/x25519_key.h>
 
 #include <keymaster/operation.h>
 
@@ -28,8 +31,12 @@ namespace keymaster {
 
 static EcdsaSignOperationFactory sign_factory;
 static EcdsaVerifyOperationFactory verify_factory;
+static KeyAgreementOperationFactory agree_factory;
 
 OperationFactory* EcKeyFactory::GetOperationFactory(keymaster_purpose_t purpose) const {
+    // Not a member of keymaster_purpose_t, so it can't be a case label below.
+    if (purpose == KM_PURPOSE_AGREE_KEY) return &agree_factory;
+
     switch (purpose) {
     case KM_PURPOSE_SIGN:
         return &sign_factory;
@@ -71,6 +78,37 @@ keymaster_error_t EcKeyFactory::GetCurveAndSize(const AuthorizationSet& key_desc
     return KM_ERROR_OK;
 }
 
+/* static */
+bool EcKeyFactory::IsSoftwareOnlyKey(const AuthorizationSet& authorizations) {
+    return authorizations.Contains(TAG_EC_CURVE, KM_EC_CURVE_CURVE_25519) ||
+           authorizations.Contains(TAG_PURPOSE, KM_PURPOSE_AGREE_KEY);
+}
+
+// A curve 25519 key is either an X25519 key agreement key or an Ed25519 signing key, never both.
+static keymaster_error_t CheckCurve25519Purposes(const AuthorizationSet& authorizations,
+                                                 bool x25519) {
+    bool signing = authorizations.Contains(TAG_PURPOSE, KM_PURPOSE_SIGN) ||
+                   authorizations.Contains(TAG_PURPOSE, KM_PURPOSE_VERIFY);
+    bool agreement = authorizations.Contains(TAG_PURPOSE, KM_PURPOSE_AGREE_KEY);
+    if (x25519 ? signing || !agreement : agreement) {
+        LOG_E("%s keys can't be used for %s", x25519 ? "X25519" : "Ed25519",
+              x25519 ? "signing" : "key agreement");
+        return KM_ERROR_INCOMPATIBLE_PURPOSE;
+    }
+    return KM_ERROR_OK;
+}
+
+static keymaster_error_t GenerateCurve25519Key(int evp_type,
+                                               UniquePtr<EVP_PKEY, EVP_PKEY_Delete>* pkey) {
+    EVP_PKEY_CTX_Ptr ctx(EVP_PKEY_CTX_new_id(evp_type, nullptr /* engine */));
+    EVP_PKEY* generated = nullptr;
+    if (!ctx.get() || EVP_PKEY_keygen_init(ctx.get()) != 1 ||
+        EVP_PKEY_keygen(ctx.get(), &generated) != 1)
+        return TranslateLastOpenSslError();
+    pkey->reset(generated);
+    return KM_ERROR_OK;
+}
+
 keymaster_error_t EcKeyFactory::GenerateKey(const AuthorizationSet& key_description,
                                             KeymasterKeyBlob* key_blob,
                                             AuthorizationSet* hw_enforced,
@@ -91,8 +129,20 @@ keymaster_error_t EcKeyFactory::GenerateKey(const AuthorizationSet& key_descript
         authorizations.push_back(TAG_EC_CURVE, ec_curve);
     }
 
+    UniquePtr<EVP_PKEY, EVP_PKEY_Delete> pkey;
+    if (ec_curve == KM_EC_CURVE_CURVE_25519) {
+        bool x25519 = authorizations.Contains(TAG_PURPOSE, KM_PURPOSE_AGREE_KEY);
+        error = CheckCurve25519Purposes(authorizations, x25519);
+        if (error == KM_ERROR_OK)
+            error = GenerateCurve25519Key(x25519 ? EVP_PKEY_X25519 : EVP_PKEY_ED25519, &pkey);
+        if (error != KM_ERROR_OK)
+            return error;
+        return CreateKeyBlobFromEvpKey(authorizations, KM_ORIGIN_GENERATED, pkey.get(), key_blob,
+                                       hw_enforced, sw_enforced);
+    }
+
     UniquePtr<EC_KEY, EC_KEY_Delete> ec_key(EC_KEY_new());
-    UniquePtr<EVP_PKEY, EVP_PKEY_Delete> pkey(EVP_PKEY_new());
+    pkey.reset(EVP_PKEY_new());
     if (ec_key.get() == nullptr || pkey.get() == nullptr)
         return KM_ERROR_MEMORY_ALLOCATION_FAILED;
 
@@ -115,13 +165,23 @@ keymaster_error_t EcKeyFactory::GenerateKey(const AuthorizationSet& key_descript
     if (EVP_PKEY_set1_EC_KEY(pkey.get(), ec_key.get()) != 1)
         return TranslateLastOpenSslError();
 
+    return CreateKeyBlobFromEvpKey(authorizations, KM_ORIGIN_GENERATED, pkey.get(), key_blob,
+                                   hw_enforced, sw_enforced);
+}
+
+keymaster_error_t EcKeyFactory::CreateKeyBlobFromEvpKey(const AuthorizationSet& authorizations,
+                                                        keymaster_key_origin_t origin,
+                                                        const EVP_PKEY* pkey,
+                                                        KeymasterKeyBlob* key_blob,
+                                                        AuthorizationSet* hw_enforced,
+                                                        AuthorizationSet* sw_enforced) const {
     KeymasterKeyBlob key_material;
-    error = EvpKeyToKeyMaterial(pkey.get(), &key_material);
+    keymaster_error_t error = EvpKeyToDecodedKeyMaterial(pkey, &key_material);
     if (error != KM_ERROR_OK)
         return error;
 
-    return blob_maker_.CreateKeyBlob(authorizations, KM_ORIGIN_GENERATED, key_material, key_blob,
-                                     hw_enforced, sw_enforced);
+    return blob_maker_.CreateKeyBlob(authorizations, origin, key_material, key_blob, hw_enforced,
+                                     sw_enforced);
 }
 
 keymaster_error_t EcKeyFactory::ImportKey(const AuthorizationSet& key_description,
@@ -140,8 +200,14 @@ keymaster_error_t EcKeyFactory::ImportKey(const AuthorizationSet& key_descriptio
     if (error != KM_ERROR_OK)
         return error;
 
-    return blob_maker_.CreateKeyBlob(authorizations, KM_ORIGIN_IMPORTED, input_key_material,
-                                     output_key_blob, hw_enforced, sw_enforced);
+    UniquePtr<EVP_PKEY, EVP_PKEY_Delete> pkey;
+    error = KeyMaterialToEvpKey(input_key_material_format, input_key_material, keymaster_key_type(),
+                                &pkey);
+    if (error != KM_ERROR_OK)
+        return error;
+
+    return CreateKeyBlobFromEvpKey(authorizations, KM_ORIGIN_IMPORTED, pkey.get(), output_key_blob,
+                                   hw_enforced, sw_enforced);
 }
 
 keymaster_error_t EcKeyFactory::UpdateImportKeyDescription(const AuthorizationSet& key_description,
@@ -158,16 +224,22 @@ keymaster_error_t EcKeyFactory::UpdateImportKeyDescription(const AuthorizationSe
     if (error != KM_ERROR_OK)
         return error;
 
-    UniquePtr<EC_KEY, EC_KEY_Delete> ec_key(EVP_PKEY_get1_EC_KEY(pkey.get()));
-    if (!ec_key.get())
-        return TranslateLastOpenSslError();
+    int evp_type = EVP_PKEY_type(pkey->type);
+    bool curve_25519 = evp_type == EVP_PKEY_ED25519 || evp_type == EVP_PKEY_X25519;
+    size_t extracted_key_size_bits;
+    if (curve_25519) {
+        extracted_key_size_bits = 256;
+    } else {
+        UniquePtr<EC_KEY, EC_KEY_Delete> ec_key(EVP_PKEY_get1_EC_KEY(pkey.get()));
+        if (!ec_key.get())
+            return TranslateLastOpenSslError();
 
-    updated_description->Reinitialize(key_description);
+        error = ec_get_group_size(EC_KEY_get0_group(ec_key.get()), &extracted_key_size_bits);
+        if (error != KM_ERROR_OK)
+            return error;
+    }
 
-    size_t extracted_key_size_bits;
-    error = ec_get_group_size(EC_KEY_get0_group(ec_key.get()), &extracted_key_size_bits);
-    if (error != KM_ERROR_OK)
-        return error;
+    updated_description->Reinitialize(key_description);
 
     *key_size_bits = extracted_key_size_bits;
     if (!updated_description->GetTagValue(TAG_KEY_SIZE, key_size_bits)) {
@@ -176,10 +248,13 @@ keymaster_error_t EcKeyFactory::UpdateImportKeyDescription(const AuthorizationSe
         return KM_ERROR_IMPORT_PARAMETER_MISMATCH;
     }
 
-    keymaster_ec_curve_t curve_from_size;
-    error = EcKeySizeToCurve(*key_size_bits, &curve_from_size);
-    if (error != KM_ERROR_OK)
-        return error;
+    // Curve 25519 and P-256 are both 256 bits, so the size alone only identifies NIST curves.
+    keymaster_ec_curve_t curve_from_size = KM_EC_CURVE_CURVE_25519;
+    if (!curve_25519) {
+        error = EcKeySizeToCurve(*key_size_bits, &curve_from_size);
+        if (error != KM_ERROR_OK)
+            return error;
+    }
     keymaster_ec_curve_t curve;
     if (!updated_description->GetTagValue(TAG_EC_CURVE, &curve)) {
         updated_description->push_back(TAG_EC_CURVE, curve_from_size);
@@ -194,6 +269,8 @@ keymaster_error_t EcKeyFactory::UpdateImportKeyDescription(const AuthorizationSe
         return KM_ERROR_IMPORT_PARAMETER_MISMATCH;
     }
 
+    if (curve_25519)
+        return CheckCurve25519Purposes(*updated_description, evp_type == EVP_PKEY_X25519);
     return KM_ERROR_OK;
 }
 
@@ -242,7 +319,14 @@ EC_GROUP* EcKeyFactory::ChooseGroup(keymaster_ec_curve_t ec_curve) {
 keymaster_error_t EcKeyFactory::CreateEmptyKey(AuthorizationSet&& hw_enforced,
                                                AuthorizationSet&& sw_enforced,
                                                UniquePtr<AsymmetricKey>* key) const {
-    key->reset(new (std::nothrow) EcKey(move(hw_enforced), move(sw_enforced), this));
+    AuthProxy authorizations(hw_enforced, sw_enforced);
+    if (authorizations.Contains(TAG_EC_CURVE, KM_EC_CURVE_CURVE_25519) &&
+        authorizations.Contains(TAG_PURPOSE, KM_PURPOSE_AGREE_KEY))
+        key->reset(new (std::nothrow) X25519Key(move(hw_enforced), move(sw_enforced), this));
+    else if (authorizations.Contains(TAG_EC_CURVE, KM_EC_CURVE_CURVE_25519))
+        key->reset(new (std::nothrow) Ed25519Key(move(hw_enforced), move(sw_enforced), this));
+    else
+        key->reset(new (std::nothrow) EcKey(move(hw_enforced), move(sw_enforced), this));
     if (!(*key)) return KM_ERROR_MEMORY_ALLOCATION_FAILED;
     return KM_ERROR_OK;
 }
@@ -19,6 +19,7 @@
 #include <openssl/ecdsa.h>
 
 #include <keymaster/km_openssl/ec_key.h>
+#include <keymaster/km_openssl/ed25519_operation.h>
 #include <keymaster/km_openssl/openssl_err.h>
 #include <keymaster/km_openssl/openssl_utils.h>
 
@@ -30,7 +31,15 @@ static const keymaster_digest_t supported_digests[] = {KM_DIGEST_NONE,      KM_D
 
 OperationPtr EcdsaOperationFactory::CreateOperation(Key&& key, const AuthorizationSet& begin_params,
                                                     keymaster_error_t* error) const {
-    const EcKey& ecdsa_key = static_cast<EcKey&>(key);
+    if (IsEd25519Key(key))
+        return GetEd25519OperationFactory(purpose())->CreateOperation(move(key), begin_params,
+                                                                      error);
+
+    EcKey& ecdsa_key = static_cast<EcKey&>(key);
+    if (purpose() == KM_PURPOSE_SIGN) {
+        *error = ecdsa_key.LoadPrivateKey();
+        if (*error != KM_ERROR_OK) return nullptr;
+    }
 
     UniquePtr<EVP_PKEY, EVP_PKEY_Delete> pkey(EVP_PKEY_new());
     if (!ecdsa_key.InternalToEvp(pkey.get())) {
@@ -100,6 +109,36 @@ keymaster_error_t EcdsaOperation::StoreData(const Buffer& input, size_t* input_c
     return KM_ERROR_OK;
 }
 
+OperationPtr EcdsaOperation::CloneInto(EcdsaOperation* clone_ptr, keymaster_error_t* error) const {
+    if (!clone_ptr) {
+        *error = KM_ERROR_MEMORY_ALLOCATION_FAILED;
+        return OperationPtr();
+    }
+    // The clone was constructed with a pointer to this operation's key, and frees it when done.
+    EVP_PKEY_up_ref(ecdsa_key_);
+    UniquePtr<EcdsaOperation> clone(clone_ptr);
+    if (!clone->authorizations_valid()) {
+        *error = KM_ERROR_MEMORY_ALLOCATION_FAILED;
+        return OperationPtr();
+    }
+
+    clone->digest_algorithm_ = digest_algorithm_;
+    if (data_.available_read() && !clone->data_.Reinitialize(data_)) {
+        *error = KM_ERROR_MEMORY_ALLOCATION_FAILED;
+        return OperationPtr();
+    }
+    if (digest_ != KM_DIGEST_NONE && !EVP_MD_CTX_copy_ex(&clone->digest_ctx_, &digest_ctx_)) {
+        *error = TranslateLastOpenSslError();
+        return OperationPtr();
+    }
+
+    *error = GenerateRandom(reinterpret_cast<uint8_t*>(&clone->operation_handle_),
+                            (size_t)sizeof(clone->operation_handle_));
+    if (*error != KM_ERROR_OK)
+        return OperationPtr();
+    return OperationPtr(clone.release());
+}
+
 keymaster_error_t EcdsaSignOperation::Begin(const AuthorizationSet& /* input_params */,
                                             AuthorizationSet* /* output_params */) {
     auto rc = GenerateRandom(reinterpret_cast<uint8_t*>(&operation_handle_),
@@ -169,6 +208,13 @@ keymaster_error_t EcdsaSignOperation::Finish(const AuthorizationSet& additional_
     return KM_ERROR_OK;
 }
 
+OperationPtr EcdsaSignOperation::Clone(keymaster_error_t* error) const {
+    return CloneInto(new (std::nothrow) EcdsaSignOperation(AuthorizationSet(hw_enforced()),
+                                                           AuthorizationSet(sw_enforced()),
+                                                           digest_, ecdsa_key_),
+                     error);
+}
+
 keymaster_error_t EcdsaVerifyOperation::Begin(const AuthorizationSet& /* input_params */,
                                               AuthorizationSet* /* output_params */) {
     auto rc = GenerateRandom(reinterpret_cast<uint8_t*>(&operation_handle_),
@@ -229,4 +275,11 @@ keymaster_error_t EcdsaVerifyOperation::Finish(const AuthorizationSet& additiona
     return KM_ERROR_OK;
 }
 
+OperationPtr EcdsaVerifyOperation::Clone(keymaster_error_t* error) const {
+    return CloneInto(new (std::nothrow) EcdsaVerifyOperation(AuthorizationSet(hw_enforced()),
+                                                             AuthorizationSet(sw_enforced()),
+                                                             digest_, ecdsa_key_),
+                     error);
+}
+
 }  // namespace keymaster
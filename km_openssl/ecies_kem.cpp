@@ -106,9 +106,12 @@ bool EciesKem::Encrypt(const uint8_t* peer_public_value, size_t peer_public_valu
         z.Reinitialize(output_encrypted_key->peek_read(), output_encrypted_key->available_read());
     }
 
-    Buffer actual_secret(z.available_read() + shared_secret.available_read());
-    actual_secret.write(z.peek_read(), z.available_read());
-    actual_secret.write(shared_secret.peek_read(), shared_secret.available_read());
+    Buffer actual_secret;
+    BufferSegment secret_segments[] = {z.read_segment(), shared_secret.read_segment()};
+    if (!actual_secret.write(secret_segments, array_length(secret_segments))) {
+        LOG_E("EciesKem: Can't allocate shared secret buffer", 0);
+        return false;
+    }
 
     if (!kdf_->Init(actual_secret.peek_read(), actual_secret.available_read(), nullptr /* salt */,
                     0 /* salt_len */)) {
@@ -161,9 +164,12 @@ bool EciesKem::Decrypt(EC_KEY* private_key, const uint8_t* encrypted_key, size_t
         z.Reinitialize(public_value.peek_read(), public_value.available_read());
     }
 
-    Buffer actual_secret(z.available_read() + shared_secret.available_read());
-    actual_secret.write(z.peek_read(), z.available_read());
-    actual_secret.write(shared_secret.peek_read(), shared_secret.available_read());
+    Buffer actual_secret;
+    BufferSegment secret_segments[] = {z.read_segment(), shared_secret.read_segment()};
+    if (!actual_secret.write(secret_segments, array_length(secret_segments))) {
+        LOG_E("EciesKem: Can't allocate shared secret buffer", 0);
+        return false;
+    }
 
     if (!kdf_->Init(actual_secret.peek_read(), actual_secret.available_read(), nullptr /* salt */,
                     0 /* salt_len */)) {
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <keymaster/km_openssl/ed25519_key.h>
+
+#include <keymaster/android_keymaster_utils.h>
+
+namespace keymaster {
+
+// The seed is the first half of the 64-byte private key.
+static const size_t kEd25519SeedLength = ED25519_PRIVATE_KEY_LEN - ED25519_PUBLIC_KEY_LEN;
+
+Ed25519Key::~Ed25519Key() {
+    memset_s(private_key_, 0, sizeof(private_key_));
+}
+
+bool Ed25519Key::EvpToInternal(const EVP_PKEY* pkey) {
+    if (EVP_PKEY_type(pkey->type) != EVP_PKEY_ED25519)
+        return false;
+
+    size_t seed_len = kEd25519SeedLength;
+    size_t public_len = ED25519_PUBLIC_KEY_LEN;
+    return EVP_PKEY_get_raw_private_key(pkey, private_key_, &seed_len) == 1 &&
+           seed_len == kEd25519SeedLength &&
+           EVP_PKEY_get_raw_public_key(pkey, private_key_ + kEd25519SeedLength, &public_len) == 1 &&
+           public_len == ED25519_PUBLIC_KEY_LEN;
+}
+
+EVP_PKEY* Ed25519Key::CreateEvpKey() const {
+    return EVP_PKEY_new_raw_private_key(EVP_PKEY_ED25519, nullptr /* engine */, private_key_,
+                                        kEd25519SeedLength);
+}
+
+}  // namespace keymaster
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <keymaster/km_openssl/ed25519_operation.h>
+
+#include <keymaster/android_keymaster_utils.h>
+#include <keymaster/km_openssl/ed25519_key.h>
+#include <keymaster/km_openssl/openssl_err.h>
+#include <keymaster/km_openssl/openssl_utils.h>
+#include <keymaster/logger.h>
+#include <keymaster/new>
+
+namespace keymaster {
+
+// Ed25519 does its own hashing, with SHA-512, so it takes the message as is.
+static const keymaster_digest_t supported_digests[] = {KM_DIGEST_NONE};
+
+static Ed25519OperationFactory sign_factory(KM_PURPOSE_SIGN);
+static Ed25519OperationFactory verify_factory(KM_PURPOSE_VERIFY);
+
+bool IsEd25519Key(const Key& key) {
+    return key.authorizations().Contains(TAG_EC_CURVE, KM_EC_CURVE_CURVE_25519);
+}
+
+const OperationFactory* GetEd25519OperationFactory(keymaster_purpose_t purpose) {
+    switch (purpose) {
+    case KM_PURPOSE_SIGN:
+        return &sign_factory;
+    case KM_PURPOSE_VERIFY:
+        return &verify_factory;
+    default:
+        return nullptr;
+    }
+}
+
+OperationPtr Ed25519OperationFactory::CreateOperation(Key&& key,
+                                                      const AuthorizationSet& begin_params,
+                                                      keymaster_error_t* error) const {
+    // Curve 25519 keys for key agreement are X25519 keys, which can't sign.
+    if (key.authorizations().Contains(TAG_PURPOSE, KM_PURPOSE_AGREE_KEY)) {
+        *error = KM_ERROR_INCOMPATIBLE_PURPOSE;
+        return nullptr;
+    }
+
+    keymaster_digest_t digest;
+    if (!GetAndValidateDigest(begin_params, key, &digest, error)) return nullptr;
+
+    *error = KM_ERROR_OK;
+    OperationPtr op;
+    switch (purpose_) {
+    case KM_PURPOSE_SIGN:
+        op.reset(new (std::nothrow) Ed25519SignOperation(move(key)));
+        break;
+    case KM_PURPOSE_VERIFY:
+        op.reset(new (std::nothrow) Ed25519VerifyOperation(move(key)));
+        break;
+    default:
+        *error = KM_ERROR_UNSUPPORTED_PURPOSE;
+        return nullptr;
+    }
+
+    if (!op) *error = KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    return op;
+}
+
+const keymaster_digest_t* Ed25519OperationFactory::SupportedDigests(size_t* digest_count) const {
+    *digest_count = array_length(supported_digests);
+    return supported_digests;
+}
+
+Ed25519Operation::Ed25519Operation(keymaster_purpose_t purpose, Key&& key)
+    : Operation(purpose, key.hw_enforced_move(), key.sw_enforced_move()) {}
+
+keymaster_error_t Ed25519Operation::Begin(const AuthorizationSet& /* input_params */,
+                                          AuthorizationSet* /* output_params */) {
+    return GenerateRandom(reinterpret_cast<uint8_t*>(&operation_handle_),
+                          (size_t)sizeof(operation_handle_));
+}
+
+keymaster_error_t Ed25519Operation::Update(const AuthorizationSet& /* additional_params */,
+                                           const Buffer& input,
+                                           AuthorizationSet* /* output_params */,
+                                           Buffer* /* output */, size_t* input_consumed) {
+    keymaster_error_t error = StoreData(input);
+    if (error != KM_ERROR_OK)
+        return error;
+    *input_consumed = input.available_read();
+    return KM_ERROR_OK;
+}
+
+keymaster_error_t Ed25519Operation::StoreData(const Buffer& input) {
+    if (input.available_read() > kMaxEd25519MessageSize - data_.available_read()) {
+        LOG_E("Ed25519 messages are limited to %zu bytes", kMaxEd25519MessageSize);
+        return KM_ERROR_INVALID_INPUT_LENGTH;
+    }
+    if (!data_.reserve(input.available_read()) ||
+        !data_.write(input.peek_read(), input.available_read()))
+        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    return KM_ERROR_OK;
+}
+
+Ed25519SignOperation::Ed25519SignOperation(Key&& key)
+    : Ed25519Operation(KM_PURPOSE_SIGN, move(key)) {
+    memcpy(private_key_, static_cast<const Ed25519Key&>(key).private_key(), sizeof(private_key_));
+}
+
+Ed25519SignOperation::~Ed25519SignOperation() {
+    memset_s(private_key_, 0, sizeof(private_key_));
+}
+
+keymaster_error_t Ed25519SignOperation::Finish(const AuthorizationSet& additional_params,
+                                               const Buffer& input, const Buffer& /* signature */,
+                                               AuthorizationSet* /* output_params */,
+                                               Buffer* output) {
+    if (!output)
+        return KM_ERROR_OUTPUT_PARAMETER_NULL;
+
+    keymaster_error_t error = UpdateForFinish(additional_params, input);
+    if (error != KM_ERROR_OK)
+        return error;
+
+    if (!output->Reinitialize(ED25519_SIGNATURE_LEN))
+        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    if (ED25519_sign(output->peek_write(), data_.peek_read(), data_.available_read(),
+                     private_key_) != 1)
+        return TranslateLastOpenSslError();
+    if (!output->advance_write(ED25519_SIGNATURE_LEN))
+        return KM_ERROR_UNKNOWN_ERROR;
+    return KM_ERROR_OK;
+}
+
+Ed25519VerifyOperation::Ed25519VerifyOperation(Key&& key)
+    : Ed25519Operation(KM_PURPOSE_VERIFY, move(key)) {
+    memcpy(public_key_, static_cast<const Ed25519Key&>(key).public_key(), sizeof(public_key_));
+}
+
+keymaster_error_t Ed25519VerifyOperation::Finish(const AuthorizationSet& additional_params,
+                                                 const Buffer& input, const Buffer& signature,
+                                                 AuthorizationSet* /* output_params */,
+                                                 Buffer* /* output */) {
+    keymaster_error_t error = UpdateForFinish(additional_params, input);
+    if (error != KM_ERROR_OK)
+        return error;
+
+    if (signature.available_read() != ED25519_SIGNATURE_LEN ||
+        ED25519_verify(data_.peek_read(), data_.available_read(), signature.peek_read(),
+                       public_key_) != 1)
+        return KM_ERROR_VERIFICATION_FAILED;
+    return KM_ERROR_OK;
+}
+
+}  // namespace keymaster
@@ -16,41 +16,56 @@
 
 #include <keymaster/km_openssl/hkdf.h>
 
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+
 #include <keymaster/android_keymaster_utils.h>
-#include <keymaster/km_openssl/hmac.h>
-#include <keymaster/new>
 
 namespace keymaster {
 
-bool Rfc5869Sha256Kdf::GenerateKey(const uint8_t* info, size_t info_len, uint8_t* output,
-                                   size_t output_len) {
-    if (!is_initialized_ || output == nullptr)
+Rfc5869Sha256Kdf::Rfc5869Sha256Kdf() {
+    HMAC_CTX_init(&prk_hmac_);
+}
+
+Rfc5869Sha256Kdf::~Rfc5869Sha256Kdf() {
+    HMAC_CTX_cleanup(&prk_hmac_);
+}
+
+bool Rfc5869Sha256Kdf::Init(const uint8_t* secret, size_t secret_len, const uint8_t* salt,
+                            size_t salt_len) {
+    if (!Kdf::Init(KM_DIGEST_SHA_2_256, secret, secret_len, salt, salt_len))
         return false;
+    is_initialized_ = false;
+
     /**
      * Step 1. Extract: PRK = HMAC-SHA256(actual_salt, secret)
      * https://tools.ietf.org/html/rfc5869#section-2.2
      */
-    HmacSha256 prk_hmac;
-    bool result;
+    /* If salt is not given, digest size of zeros are used. */
+    uint8_t zeros[SHA256_DIGEST_LENGTH] = {};
+    const uint8_t* actual_salt = zeros;
+    size_t actual_salt_len = sizeof(zeros);
     if (salt_.get() != nullptr && salt_len_ > 0) {
-        result = prk_hmac.Init(salt_.get(), salt_len_);
-    } else {
-        UniquePtr<uint8_t[]> zeros(new(std::nothrow) uint8_t[digest_size_]);
-        if (zeros.get() == nullptr)
-            return false;
-        /* If salt is not given, digest size of zeros are used. */
-        memset(zeros.get(), 0, digest_size_);
-        result = prk_hmac.Init(zeros.get(), digest_size_);
+        actual_salt = salt_.get();
+        actual_salt_len = salt_len_;
     }
-    if (!result)
-        return false;
 
-    UniquePtr<uint8_t[]> pseudo_random_key(new(std::nothrow) uint8_t[digest_size_]);
-    if (pseudo_random_key.get() == nullptr || digest_size_ != prk_hmac.DigestLength())
-        return false;
-    result =
-        prk_hmac.Sign(secret_key_.get(), secret_key_len_, pseudo_random_key.get(), digest_size_);
-    if (!result)
+    uint8_t pseudo_random_key[SHA256_DIGEST_LENGTH];
+    unsigned int pseudo_random_key_len;
+    bool result = HMAC(EVP_sha256(), actual_salt, actual_salt_len, secret_key_.get(),
+                       secret_key_len_, pseudo_random_key, &pseudo_random_key_len) != nullptr &&
+                  pseudo_random_key_len == digest_size_ &&
+                  HMAC_Init_ex(&prk_hmac_, pseudo_random_key, sizeof(pseudo_random_key),
+                               EVP_sha256(), nullptr /* engine */);
+    memset_s(pseudo_random_key, 0, sizeof(pseudo_random_key));
+
+    is_initialized_ = result;
+    return result;
+}
+
+bool Rfc5869Sha256Kdf::GenerateKey(const uint8_t* info, size_t info_len, uint8_t* output,
+                                   size_t output_len) {
+    if (!is_initialized_ || output == nullptr)
         return false;
 
     /**
@@ -61,33 +76,36 @@ bool Rfc5869Sha256Kdf::GenerateKey(const uint8_t* info, size_t info_len, uint8_t
     if (num_blocks >= 256u)
         return false;
 
-    UniquePtr<uint8_t[]> buf(new(std::nothrow) uint8_t[digest_size_ + info_len + 1]);
-    UniquePtr<uint8_t[]> digest(new(std::nothrow) uint8_t[digest_size_]);
-    if (buf.get() == nullptr || digest.get() == nullptr)
-        return false;
-    HmacSha256 hmac;
-    result = hmac.Init(pseudo_random_key.get(), digest_size_);
-    if (!result)
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    unsigned int digest_len;
+    bool result = true;
+    for (size_t i = 0; i < num_blocks && result; i++) {
+        const uint8_t counter = static_cast<uint8_t>(i + 1);
+        result = HMAC_Init_ex(&prk_hmac_, nullptr /* key */, 0 /* key_len */, nullptr /* md */,
+                              nullptr /* engine */) &&
+                 (i == 0 || HMAC_Update(&prk_hmac_, digest, digest_size_)) &&
+                 (info == nullptr || info_len == 0 || HMAC_Update(&prk_hmac_, info, info_len)) &&
+                 HMAC_Update(&prk_hmac_, &counter, sizeof(counter)) &&
+                 HMAC_Final(&prk_hmac_, digest, &digest_len) && digest_len == digest_size_;
+        if (result) {
+            size_t block_output_len = digest_size_ < output_len - i * digest_size_
+                                          ? digest_size_
+                                          : output_len - i * digest_size_;
+            memcpy(output + i * digest_size_, digest, block_output_len);
+        }
+    }
+    memset_s(digest, 0, sizeof(digest));
+    return result;
+}
+
+bool Rfc5869Sha256Kdf::GenerateKeys(const keymaster_blob_t* infos, size_t info_count,
+                                    uint8_t* output, size_t output_len) {
+    if (infos == nullptr && info_count > 0)
         return false;
 
-    for (size_t i = 0; i < num_blocks; i++) {
-        size_t block_input_len = 0;
-        if (i != 0) {
-            memcpy(buf.get(), digest.get(), digest_size_);
-            block_input_len = digest_size_;
-        }
-        if (info != nullptr && info_len > 0)
-            memcpy(buf.get() + block_input_len, info, info_len);
-        block_input_len += info_len;
-        *(buf.get() + block_input_len++) = static_cast<uint8_t>(i + 1);
-        result = hmac.Sign(buf.get(), block_input_len, digest.get(), digest_size_);
-        if (!result)
+    for (size_t i = 0; i < info_count; i++)
+        if (!GenerateKey(infos[i].data, infos[i].data_length, output + i * output_len, output_len))
             return false;
-        size_t block_output_len = digest_size_ < output_len - i * digest_size_
-                                      ? digest_size_
-                                      : output_len - i * digest_size_;
-        memcpy(output + i * digest_size_, digest.get(), block_output_len);
-    }
     return true;
 }
 
@@ -135,6 +135,14 @@ HmacOperation::HmacOperation(Key&& key, keymaster_purpose_t purpose, keymaster_d
     HMAC_Init_ex(&ctx_, blob.key_material, blob.key_material_size, md, nullptr /* engine */);
 }
 
+HmacOperation::HmacOperation(keymaster_purpose_t purpose, AuthorizationSet&& hw_enforced,
+                             AuthorizationSet&& sw_enforced, size_t mac_length,
+                             size_t min_mac_length)
+    : Operation(purpose, move(hw_enforced), move(sw_enforced)), error_(KM_ERROR_OK),
+      mac_length_(mac_length), min_mac_length_(min_mac_length) {
+    HMAC_CTX_init(&ctx_);
+}
+
 HmacOperation::~HmacOperation() {
     HMAC_CTX_cleanup(&ctx_);
 }
@@ -161,6 +169,28 @@ keymaster_error_t HmacOperation::Abort() {
     return KM_ERROR_OK;
 }
 
+OperationPtr HmacOperation::Clone(keymaster_error_t* error) const {
+    UniquePtr<HmacOperation> clone(new (std::nothrow) HmacOperation(
+        purpose(), AuthorizationSet(hw_enforced()), AuthorizationSet(sw_enforced()), mac_length_,
+        min_mac_length_));
+    if (!clone || !clone->authorizations_valid()) {
+        *error = KM_ERROR_MEMORY_ALLOCATION_FAILED;
+        return OperationPtr();
+    }
+
+    if (!HMAC_CTX_copy_ex(&clone->ctx_, &ctx_)) {
+        *error = TranslateLastOpenSslError();
+        return OperationPtr();
+    }
+    clone->error_ = error_;
+
+    *error = GenerateRandom(reinterpret_cast<uint8_t*>(&clone->operation_handle_),
+                            (size_t)sizeof(clone->operation_handle_));
+    if (*error != KM_ERROR_OK)
+        return OperationPtr();
+    return OperationPtr(clone.release());
+}
+
 keymaster_error_t HmacOperation::Finish(const AuthorizationSet& additional_params,
                                         const Buffer& input, const Buffer& signature,
                                         AuthorizationSet* /* output_params */, Buffer* output) {
@@ -37,10 +37,15 @@ class HmacOperation : public Operation {
     virtual keymaster_error_t Finish(const AuthorizationSet& additional_params, const Buffer& input,
                                      const Buffer& signature, AuthorizationSet* output_params,
                                      Buffer* output);
+    OperationPtr Clone(keymaster_error_t* error) const override;
 
     keymaster_error_t error() { return error_; }
 
   private:
+    // Used by Clone, which copies the MAC state in.
+    HmacOperation(keymaster_purpose_t purpose, AuthorizationSet&& hw_enforced,
+                  AuthorizationSet&& sw_enforced, size_t mac_length, size_t min_mac_length);
+
     HMAC_CTX ctx_;
     keymaster_error_t error_;
     const size_t mac_length_;
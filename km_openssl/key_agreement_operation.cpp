@@ -0,0 +1,227 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <keymaster/km_openssl/key_agreement_operation.h>
+
+#include <keymaster/android_keymaster_utils.h>
+#include <keymaster/km_openssl/ec_key.h>
+#include <keymaster/km_openssl/openssl_err.h>
+#include <keymaster/km_openssl/x25519_key.h>
+#include <keymaster/logger.h>
+#include <keymaster/new>
+
+namespace keymaster {
+
+bool IsX25519Key(const Key& key) {
+    return key.authorizations().Contains(TAG_EC_CURVE, KM_EC_CURVE_CURVE_25519) &&
+           key.authorizations().Contains(TAG_PURPOSE, KM_PURPOSE_AGREE_KEY);
+}
+
+OperationPtr
+KeyAgreementOperationFactory::CreateOperation(Key&& key, const AuthorizationSet& /* begin_params */,
+                                              keymaster_error_t* error) const {
+    // Checked here as well as by the enforcement policy, because what follows depends on it: a
+    // curve 25519 key with this purpose is an X25519 key rather than an Ed25519 key, and keys with
+    // it are always software keys.
+    if (!key.authorizations().Contains(TAG_PURPOSE, KM_PURPOSE_AGREE_KEY)) {
+        *error = KM_ERROR_INCOMPATIBLE_PURPOSE;
+        return nullptr;
+    }
+
+    OperationPtr op;
+    if (IsX25519Key(key)) {
+        const uint8_t* private_key = static_cast<const X25519Key&>(key).private_key();
+        op.reset(new (std::nothrow)
+                     X25519Operation(key.hw_enforced_move(), key.sw_enforced_move(), private_key));
+    } else {
+        *error = static_cast<EcKey&>(key).LoadPrivateKey();
+        if (*error != KM_ERROR_OK)
+            return nullptr;
+        EC_KEY* ec_key = static_cast<const EcKey&>(key).key();
+        if (!ec_key || !EC_KEY_up_ref(ec_key)) {
+            *error = KM_ERROR_UNKNOWN_ERROR;
+            return nullptr;
+        }
+        UniquePtr<NistCurveKeyExchange> key_exchange(new (std::nothrow)
+                                                         NistCurveKeyExchange(ec_key, error));
+        if (!key_exchange.get()) {
+            EC_KEY_free(ec_key);
+            *error = KM_ERROR_MEMORY_ALLOCATION_FAILED;
+            return nullptr;
+        }
+        if (*error != KM_ERROR_OK)
+            return nullptr;
+
+        op.reset(new (std::nothrow) EcdhOperation(key.hw_enforced_move(), key.sw_enforced_move(),
+                                                  key_exchange.get()));
+        if (op)
+            (void)key_exchange.release();
+    }
+
+    *error = op ? KM_ERROR_OK : KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    return op;
+}
+
+keymaster_error_t KeyAgreementOperation::Begin(const AuthorizationSet& /* input_params */,
+                                               AuthorizationSet* /* output_params */) {
+    return GenerateRandom(reinterpret_cast<uint8_t*>(&operation_handle_),
+                          (size_t)sizeof(operation_handle_));
+}
+
+keymaster_error_t KeyAgreementOperation::Update(const AuthorizationSet& /* additional_params */,
+                                                const Buffer& input,
+                                                AuthorizationSet* /* output_params */,
+                                                Buffer* output, size_t* input_consumed) {
+    if (!output || !input_consumed)
+        return KM_ERROR_OUTPUT_PARAMETER_NULL;
+
+    keymaster_error_t error = ProcessInput(input, output);
+    if (error != KM_ERROR_OK)
+        return error;
+    *input_consumed = input.available_read();
+    return KM_ERROR_OK;
+}
+
+keymaster_error_t KeyAgreementOperation::Finish(const AuthorizationSet& /* additional_params */,
+                                                const Buffer& input,
+                                                const Buffer& /* signature */,
+                                                AuthorizationSet* /* output_params */,
+                                                Buffer* output) {
+    if (!output)
+        return KM_ERROR_OUTPUT_PARAMETER_NULL;
+
+    keymaster_error_t error = ProcessInput(input, output);
+    if (error != KM_ERROR_OK)
+        return error;
+
+    if (partial_peer_value_.available_read() != 0 || agreement_count_ == 0) {
+        LOG_E("Key agreement input must be a non-zero multiple of %zu bytes", peer_value_len_);
+        return KM_ERROR_INVALID_INPUT_LENGTH;
+    }
+    return KM_ERROR_OK;
+}
+
+keymaster_error_t KeyAgreementOperation::ProcessInput(const Buffer& input, Buffer* output) {
+    const uint8_t* data = input.peek_read();
+    size_t data_len = input.available_read();
+    size_t partial_len = partial_peer_value_.available_read();
+
+    size_t agreements = (partial_len + data_len) / peer_value_len_;
+    if (!output->reserve(agreements * shared_secret_len_))
+        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+
+    keymaster_error_t error;
+    if (partial_len != 0) {
+        // Complete the peer value that the last call ended partway through.
+        size_t copy_len = peer_value_len_ - partial_len;
+        if (copy_len > data_len)
+            copy_len = data_len;
+        if (!partial_peer_value_.reserve(copy_len) || !partial_peer_value_.write(data, copy_len))
+            return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+        data += copy_len;
+        data_len -= copy_len;
+        if (partial_peer_value_.available_read() < peer_value_len_)
+            return KM_ERROR_OK;
+
+        error = Agree(partial_peer_value_.peek_read(), output);
+        if (error != KM_ERROR_OK)
+            return error;
+        ++agreement_count_;
+        partial_peer_value_.Clear();
+    }
+
+    for (; data_len >= peer_value_len_; data += peer_value_len_, data_len -= peer_value_len_) {
+        error = Agree(data, output);
+        if (error != KM_ERROR_OK)
+            return error;
+        ++agreement_count_;
+    }
+
+    if (data_len != 0 &&
+        (!partial_peer_value_.reserve(data_len) || !partial_peer_value_.write(data, data_len)))
+        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    return KM_ERROR_OK;
+}
+
+EcdhOperation::EcdhOperation(AuthorizationSet&& hw_enforced, AuthorizationSet&& sw_enforced,
+                             NistCurveKeyExchange* key_exchange)
+    : KeyAgreementOperation(move(hw_enforced), move(sw_enforced), key_exchange->public_value_len(),
+                            key_exchange->shared_secret_len()),
+      key_exchange_(key_exchange), next_peer_point_(0) {}
+
+keymaster_error_t EcdhOperation::Agree(const uint8_t* peer_value, Buffer* output) {
+    const EC_POINT* peer_point;
+    keymaster_error_t error = GetPeerPoint(peer_value, &peer_point);
+    if (error != KM_ERROR_OK)
+        return error;
+
+    Buffer shared_secret;
+    if (!key_exchange_->CalculateSharedKey(peer_point, &shared_secret) ||
+        !output->write(shared_secret.peek_read(), shared_secret.available_read()))
+        return KM_ERROR_UNKNOWN_ERROR;
+    return KM_ERROR_OK;
+}
+
+keymaster_error_t EcdhOperation::GetPeerPoint(const uint8_t* peer_value,
+                                              const EC_POINT** peer_point) {
+    for (const CachedPeerPoint& entry : peer_points_) {
+        if (entry.point.get() && memcmp(entry.peer_value.get(), peer_value, peer_value_len_) == 0) {
+            *peer_point = entry.point.get();
+            return KM_ERROR_OK;
+        }
+    }
+
+    UniquePtr<EC_POINT, EC_POINT_Delete> point(
+        key_exchange_->DecodePeerPoint(peer_value, peer_value_len_));
+    if (!point.get())
+        return KM_ERROR_INVALID_ARGUMENT;
+
+    CachedPeerPoint& entry = peer_points_[next_peer_point_];
+    if (!entry.peer_value.get())
+        entry.peer_value.reset(new (std::nothrow) uint8_t[peer_value_len_]);
+    if (!entry.peer_value.get())
+        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    next_peer_point_ = (next_peer_point_ + 1) % kPeerPointCacheSize;
+
+    memcpy(entry.peer_value.get(), peer_value, peer_value_len_);
+    entry.point.reset(point.release());
+    *peer_point = entry.point.get();
+    return KM_ERROR_OK;
+}
+
+X25519Operation::X25519Operation(AuthorizationSet&& hw_enforced, AuthorizationSet&& sw_enforced,
+                                 const uint8_t* private_key)
+    : KeyAgreementOperation(move(hw_enforced), move(sw_enforced), X25519_PUBLIC_VALUE_LEN,
+                            X25519_SHARED_KEY_LEN) {
+    memcpy(private_key_, private_key, sizeof(private_key_));
+}
+
+X25519Operation::~X25519Operation() {
+    memset_s(private_key_, 0, sizeof(private_key_));
+}
+
+keymaster_error_t X25519Operation::Agree(const uint8_t* peer_value, Buffer* output) {
+    // X25519() fails only if the result is all zeros, meaning the peer value is a low-order point.
+    if (!X25519(output->peek_write(), private_key_, peer_value)) {
+        LOG_E("X25519 peer value is a low-order point", 0);
+        return KM_ERROR_INVALID_ARGUMENT;
+    }
+    if (!output->advance_write(X25519_SHARED_KEY_LEN))
+        return KM_ERROR_UNKNOWN_ERROR;
+    return KM_ERROR_OK;
+}
+
+}  // namespace keymaster
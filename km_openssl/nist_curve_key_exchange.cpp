@@ -97,6 +97,15 @@ bool NistCurveKeyExchange::CalculateSharedKey(const Buffer& peer_public_value,
 bool NistCurveKeyExchange::CalculateSharedKey(const uint8_t* peer_public_value,
                                               size_t peer_public_value_len,
                                               Buffer* out_result) const {
+    UniquePtr<EC_POINT, EC_POINT_Delete> point(
+        DecodePeerPoint(peer_public_value, peer_public_value_len));
+    if (!point.get())
+        return false;
+    return CalculateSharedKey(point.get(), out_result);
+}
+
+EC_POINT* NistCurveKeyExchange::DecodePeerPoint(const uint8_t* peer_public_value,
+                                                size_t peer_public_value_len) const {
     const EC_GROUP* group = EC_KEY_get0_group(private_key_.get());
     UniquePtr<EC_POINT, EC_POINT_Delete> point(EC_POINT_new(group));
     if (!point.get() ||
@@ -105,12 +114,16 @@ bool NistCurveKeyExchange::CalculateSharedKey(const uint8_t* peer_public_value,
                             nullptr /* ctx */) ||
         !EC_POINT_is_on_curve(group, point.get(), nullptr /* ctx */)) {
         LOG_E("Can't convert peer public value to point: %d", TranslateLastOpenSslError());
-        return false;
+        return nullptr;
     }
+    return point.release();
+}
 
+bool NistCurveKeyExchange::CalculateSharedKey(const EC_POINT* peer_point,
+                                              Buffer* out_result) const {
     UniquePtr<uint8_t[]> result(new (std::nothrow) uint8_t[shared_secret_len_]);
     if (!result.get()) return false;
-    if (ECDH_compute_key(result.get(), shared_secret_len_, point.get(), private_key_.get(),
+    if (ECDH_compute_key(result.get(), shared_secret_len_, peer_point, private_key_.get(),
                          nullptr /* kdf */) != static_cast<int>(shared_secret_len_)) {
         LOG_E("Can't compute ECDH shared key: %d", TranslateLastOpenSslError());
         return false;
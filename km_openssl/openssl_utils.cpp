@@ -16,8 +16,10 @@
 
 #include <keymaster/km_openssl/openssl_utils.h>
 
+#include <openssl/curve25519.h>
 #include <openssl/rand.h>
 #include <keymaster/android_keymaster_utils.h>
+#include <keymaster/serializable.h>
 
 #include <keymaster/km_openssl/openssl_err.h>
 
@@ -74,6 +76,13 @@ static int convert_to_evp(keymaster_algorithm_t algorithm) {
     };
 }
 
+static bool evp_type_matches(int evp_type, keymaster_algorithm_t algorithm) {
+    // Ed25519 and X25519 keys are EC keys on curve 25519 as far as keymaster is concerned.
+    if (evp_type == EVP_PKEY_ED25519 || evp_type == EVP_PKEY_X25519)
+        return algorithm == KM_ALGORITHM_EC;
+    return evp_type == convert_to_evp(algorithm);
+}
+
 keymaster_error_t convert_pkcs8_blob_to_evp(const uint8_t* key_data, size_t key_length,
                                             keymaster_algorithm_t expected_algorithm,
                                             UniquePtr<EVP_PKEY, EVP_PKEY_Delete>* pkey) {
@@ -89,7 +98,7 @@ keymaster_error_t convert_pkcs8_blob_to_evp(const uint8_t* key_data, size_t key_
     if (!pkey->get())
         return TranslateLastOpenSslError(true /* log_message */);
 
-    if (EVP_PKEY_type((*pkey)->type) != convert_to_evp(expected_algorithm)) {
+    if (!evp_type_matches(EVP_PKEY_type((*pkey)->type), expected_algorithm)) {
         LOG_E("EVP key algorithm was %d, not the expected %d", EVP_PKEY_type((*pkey)->type),
               convert_to_evp(expected_algorithm));
         return KM_ERROR_INVALID_KEY_BLOB;
@@ -123,6 +132,301 @@ keymaster_error_t EvpKeyToKeyMaterial(const EVP_PKEY* pkey, KeymasterKeyBlob* ke
     return KM_ERROR_OK;
 }
 
+// Decoded key material layout.  After the marker, every field is either a uint32_t or a uint32_t
+// length followed by that many bytes, as written by append_uint32_to_buf() and
+// append_size_and_data_to_buf().  Big numbers are big-endian; absent ones have zero length.
+//
+//   RSA: marker, KM_ALGORITHM_RSA, n, e, d, p, q, dmp1, dmq1, iqmp
+//   EC:  marker, KM_ALGORITHM_EC, curve NID, private scalar, uncompressed public point
+//   Ed25519: marker, KM_ALGORITHM_EC, NID_ED25519, 32-byte private seed
+//   X25519:  marker, KM_ALGORITHM_EC, NID_X25519, 32-byte private key
+//
+// DER key material always starts with a SEQUENCE tag (0x30), so the marker can't be mistaken for
+// it.  The final byte is a format version.
+static const uint8_t kDecodedKeyMaterialMarker[] = {'K', 'M', 'D', 1};
+
+// Ed25519 and X25519 private keys are both 32 bytes.  (BoringSSL's 64-byte Ed25519 private key
+// form appends the public key to the 32-byte seed.)
+static const size_t kCurve25519PrivateKeyLength = 32;
+
+static size_t bignum_encoded_size(const BIGNUM* bn) {
+    return sizeof(uint32_t) + (bn ? BN_num_bytes(bn) : 0);
+}
+
+static uint8_t* append_bignum_to_buf(uint8_t* buf, const uint8_t* end, const BIGNUM* bn) {
+    size_t bn_len = bn ? BN_num_bytes(bn) : 0;
+    buf = append_uint32_to_buf(buf, end, bn_len);
+    if (bn_len > static_cast<size_t>(end - buf))
+        return buf;
+    return buf + BN_bn2bin(bn, buf);
+}
+
+static bool copy_bignum_from_buf(const uint8_t** buf_ptr, const uint8_t* end, BIGNUM_Ptr* bn) {
+    size_t bn_len;
+    if (!copy_uint32_from_buf(buf_ptr, end, &bn_len) ||
+        bn_len > static_cast<size_t>(end - *buf_ptr))
+        return false;
+    if (bn_len == 0) {
+        bn->reset();
+        return true;
+    }
+    bn->reset(BN_bin2bn(*buf_ptr, bn_len, nullptr /* ret */));
+    *buf_ptr += bn_len;
+    return bn->get() != nullptr;
+}
+
+static keymaster_error_t RsaKeyToDecodedKeyMaterial(const RSA* rsa,
+                                                    KeymasterKeyBlob* key_material) {
+    const BIGNUM* components[] = {rsa->n, rsa->e,    rsa->d,    rsa->p,
+                                  rsa->q, rsa->dmp1, rsa->dmq1, rsa->iqmp};
+
+    size_t size = sizeof(kDecodedKeyMaterialMarker) + sizeof(uint32_t);
+    for (const BIGNUM* bn : components)
+        size += bignum_encoded_size(bn);
+    if (!key_material->Reset(size))
+        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+
+    uint8_t* buf = key_material->writable_data();
+    const uint8_t* end = buf + size;
+    buf = append_to_buf(buf, end, kDecodedKeyMaterialMarker, sizeof(kDecodedKeyMaterialMarker));
+    buf = append_uint32_to_buf(buf, end, KM_ALGORITHM_RSA);
+    for (const BIGNUM* bn : components)
+        buf = append_bignum_to_buf(buf, end, bn);
+
+    return buf == end ? KM_ERROR_OK : KM_ERROR_UNKNOWN_ERROR;
+}
+
+static keymaster_error_t EcKeyToDecodedKeyMaterial(const EC_KEY* ec_key,
+                                                   KeymasterKeyBlob* key_material) {
+    const EC_GROUP* group = EC_KEY_get0_group(ec_key);
+    const EC_POINT* public_key = EC_KEY_get0_public_key(ec_key);
+    const BIGNUM* private_key = EC_KEY_get0_private_key(ec_key);
+    if (!group || !public_key || !private_key)
+        return KM_ERROR_INVALID_KEY_BLOB;
+
+    size_t point_len = EC_POINT_point2oct(group, public_key, POINT_CONVERSION_UNCOMPRESSED,
+                                          nullptr /* buf */, 0 /* len */, nullptr /* ctx */);
+    if (point_len == 0)
+        return TranslateLastOpenSslError();
+
+    size_t size = sizeof(kDecodedKeyMaterialMarker) + 2 * sizeof(uint32_t) +
+                  bignum_encoded_size(private_key) + sizeof(uint32_t) + point_len;
+    if (!key_material->Reset(size))
+        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+
+    uint8_t* buf = key_material->writable_data();
+    const uint8_t* end = buf + size;
+    buf = append_to_buf(buf, end, kDecodedKeyMaterialMarker, sizeof(kDecodedKeyMaterialMarker));
+    buf = append_uint32_to_buf(buf, end, KM_ALGORITHM_EC);
+    buf = append_uint32_to_buf(buf, end, EC_GROUP_get_curve_name(group));
+    buf = append_bignum_to_buf(buf, end, private_key);
+    buf = append_uint32_to_buf(buf, end, point_len);
+    if (static_cast<size_t>(end - buf) != point_len ||
+        EC_POINT_point2oct(group, public_key, POINT_CONVERSION_UNCOMPRESSED, buf, point_len,
+                           nullptr /* ctx */) != point_len)
+        return KM_ERROR_UNKNOWN_ERROR;
+
+    return KM_ERROR_OK;
+}
+
+// Writes an Ed25519 or X25519 key.  Their EVP key types are also their curve NIDs.
+static keymaster_error_t Curve25519KeyToDecodedKeyMaterial(const EVP_PKEY* pkey,
+                                                           KeymasterKeyBlob* key_material) {
+    uint8_t private_key[kCurve25519PrivateKeyLength];
+    Eraser private_key_eraser(private_key, sizeof(private_key));
+    size_t private_key_len = sizeof(private_key);
+    if (EVP_PKEY_get_raw_private_key(pkey, private_key, &private_key_len) != 1 ||
+        private_key_len != sizeof(private_key))
+        return TranslateLastOpenSslError();
+
+    size_t size = sizeof(kDecodedKeyMaterialMarker) + 3 * sizeof(uint32_t) + sizeof(private_key);
+    if (!key_material->Reset(size))
+        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+
+    uint8_t* buf = key_material->writable_data();
+    const uint8_t* end = buf + size;
+    buf = append_to_buf(buf, end, kDecodedKeyMaterialMarker, sizeof(kDecodedKeyMaterialMarker));
+    buf = append_uint32_to_buf(buf, end, KM_ALGORITHM_EC);
+    buf = append_uint32_to_buf(buf, end, EVP_PKEY_type(pkey->type));
+    buf = append_size_and_data_to_buf(buf, end, private_key, sizeof(private_key));
+
+    return buf == end ? KM_ERROR_OK : KM_ERROR_UNKNOWN_ERROR;
+}
+
+// With \p public_key_only, reads n and e and ignores the private components that follow them.
+static keymaster_error_t DecodedKeyMaterialToRsaKey(const uint8_t* buf, const uint8_t* end,
+                                                    bool public_key_only, EVP_PKEY* pkey) {
+    BIGNUM_Ptr n, e, d, p, q, dmp1, dmq1, iqmp;
+    if (!copy_bignum_from_buf(&buf, end, &n) || !copy_bignum_from_buf(&buf, end, &e) ||
+        !n.get() || !e.get())
+        return KM_ERROR_INVALID_KEY_BLOB;
+    if (!public_key_only &&
+        (!copy_bignum_from_buf(&buf, end, &d) || !copy_bignum_from_buf(&buf, end, &p) ||
+         !copy_bignum_from_buf(&buf, end, &q) || !copy_bignum_from_buf(&buf, end, &dmp1) ||
+         !copy_bignum_from_buf(&buf, end, &dmq1) || !copy_bignum_from_buf(&buf, end, &iqmp) ||
+         buf != end || !d.get()))
+        return KM_ERROR_INVALID_KEY_BLOB;
+
+    RSA_Ptr rsa(RSA_new());
+    if (!rsa.get())
+        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    rsa->n = n.release();
+    rsa->e = e.release();
+    rsa->d = d.release();
+    rsa->p = p.release();
+    rsa->q = q.release();
+    rsa->dmp1 = dmp1.release();
+    rsa->dmq1 = dmq1.release();
+    rsa->iqmp = iqmp.release();
+
+    if (EVP_PKEY_set1_RSA(pkey, rsa.get()) != 1)
+        return TranslateLastOpenSslError();
+    return KM_ERROR_OK;
+}
+
+static keymaster_error_t
+DecodedKeyMaterialToCurve25519Key(int curve_nid, const uint8_t* buf, const uint8_t* end,
+                                  UniquePtr<EVP_PKEY, EVP_PKEY_Delete>* pkey) {
+    size_t private_key_len;
+    if (!copy_uint32_from_buf(&buf, end, &private_key_len) ||
+        private_key_len != kCurve25519PrivateKeyLength ||
+        private_key_len != static_cast<size_t>(end - buf))
+        return KM_ERROR_INVALID_KEY_BLOB;
+
+    pkey->reset(EVP_PKEY_new_raw_private_key(curve_nid, nullptr /* engine */, buf,
+                                             private_key_len));
+    if (!pkey->get())
+        return TranslateLastOpenSslError();
+    return KM_ERROR_OK;
+}
+
+// With *\p public_key_only, skips the private scalar.  Curve 25519 keys are always decoded in
+// full, since only their private key is stored, and *\p public_key_only is cleared for them.
+static keymaster_error_t DecodedKeyMaterialToEcKey(const uint8_t* buf, const uint8_t* end,
+                                                   bool* public_key_only,
+                                                   UniquePtr<EVP_PKEY, EVP_PKEY_Delete>* pkey) {
+    int curve_nid;
+    if (!copy_uint32_from_buf(&buf, end, &curve_nid))
+        return KM_ERROR_INVALID_KEY_BLOB;
+    if (curve_nid == NID_ED25519 || curve_nid == NID_X25519) {
+        *public_key_only = false;
+        return DecodedKeyMaterialToCurve25519Key(curve_nid, buf, end, pkey);
+    }
+
+    BIGNUM_Ptr private_key;
+    if (*public_key_only) {
+        size_t private_key_len;
+        if (!copy_uint32_from_buf(&buf, end, &private_key_len) ||
+            private_key_len > static_cast<size_t>(end - buf))
+            return KM_ERROR_INVALID_KEY_BLOB;
+        buf += private_key_len;
+    } else if (!copy_bignum_from_buf(&buf, end, &private_key) || !private_key.get()) {
+        return KM_ERROR_INVALID_KEY_BLOB;
+    }
+
+    size_t point_len;
+    if (!copy_uint32_from_buf(&buf, end, &point_len) ||
+        point_len != static_cast<size_t>(end - buf))
+        return KM_ERROR_INVALID_KEY_BLOB;
+
+    EC_KEY_Ptr ec_key(EC_KEY_new_by_curve_name(curve_nid));
+    if (!ec_key.get())
+        return KM_ERROR_INVALID_KEY_BLOB;
+    const EC_GROUP* group = EC_KEY_get0_group(ec_key.get());
+
+    // EC_POINT_oct2point() only checks that the point is on the curve.  Unlike parsing DER, nothing
+    // here multiplies the private scalar out to confirm the pair matches.
+    EC_POINT_Ptr public_key(EC_POINT_new(group));
+    if (!public_key.get())
+        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    if (!EC_POINT_oct2point(group, public_key.get(), buf, point_len, nullptr /* ctx */) ||
+        (private_key.get() && !EC_KEY_set_private_key(ec_key.get(), private_key.get())) ||
+        !EC_KEY_set_public_key(ec_key.get(), public_key.get()))
+        return TranslateLastOpenSslError();
+
+    pkey->reset(EVP_PKEY_new());
+    if (!pkey->get())
+        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    if (EVP_PKEY_set1_EC_KEY(pkey->get(), ec_key.get()) != 1)
+        return TranslateLastOpenSslError();
+    return KM_ERROR_OK;
+}
+
+bool IsDecodedKeyMaterial(const KeymasterKeyBlob& key_material) {
+    return key_material.key_material_size >= sizeof(kDecodedKeyMaterialMarker) &&
+           memcmp(key_material.key_material, kDecodedKeyMaterialMarker,
+                  sizeof(kDecodedKeyMaterialMarker)) == 0;
+}
+
+keymaster_error_t EvpKeyToDecodedKeyMaterial(const EVP_PKEY* pkey,
+                                             KeymasterKeyBlob* key_material) {
+    EVP_PKEY* mutable_pkey = const_cast<EVP_PKEY*>(pkey);
+    switch (EVP_PKEY_type(pkey->type)) {
+    case EVP_PKEY_RSA: {
+        RSA_Ptr rsa(EVP_PKEY_get1_RSA(mutable_pkey));
+        if (!rsa.get())
+            return TranslateLastOpenSslError();
+        return RsaKeyToDecodedKeyMaterial(rsa.get(), key_material);
+    }
+    case EVP_PKEY_EC: {
+        EC_KEY_Ptr ec_key(EVP_PKEY_get1_EC_KEY(mutable_pkey));
+        if (!ec_key.get())
+            return TranslateLastOpenSslError();
+        return EcKeyToDecodedKeyMaterial(ec_key.get(), key_material);
+    }
+    case EVP_PKEY_ED25519:
+    case EVP_PKEY_X25519:
+        return Curve25519KeyToDecodedKeyMaterial(pkey, key_material);
+    default:
+        return KM_ERROR_UNSUPPORTED_ALGORITHM;
+    }
+}
+
+static keymaster_error_t DecodeKeyMaterial(const KeymasterKeyBlob& key_material,
+                                           keymaster_algorithm_t expected_algorithm,
+                                           bool* public_key_only,
+                                           UniquePtr<EVP_PKEY, EVP_PKEY_Delete>* pkey) {
+    if (!IsDecodedKeyMaterial(key_material))
+        return KM_ERROR_INVALID_KEY_BLOB;
+
+    const uint8_t* buf = key_material.key_material + sizeof(kDecodedKeyMaterialMarker);
+    const uint8_t* end = key_material.key_material + key_material.key_material_size;
+    keymaster_algorithm_t algorithm;
+    if (!copy_uint32_from_buf(&buf, end, &algorithm))
+        return KM_ERROR_INVALID_KEY_BLOB;
+    if (algorithm != expected_algorithm) {
+        LOG_E("Decoded key algorithm was %d, not the expected %d", algorithm, expected_algorithm);
+        return KM_ERROR_INVALID_KEY_BLOB;
+    }
+
+    switch (algorithm) {
+    case KM_ALGORITHM_RSA:
+        pkey->reset(EVP_PKEY_new());
+        if (!pkey->get())
+            return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+        return DecodedKeyMaterialToRsaKey(buf, end, *public_key_only, pkey->get());
+    case KM_ALGORITHM_EC:
+        return DecodedKeyMaterialToEcKey(buf, end, public_key_only, pkey);
+    default:
+        return KM_ERROR_UNSUPPORTED_ALGORITHM;
+    }
+}
+
+keymaster_error_t DecodedKeyMaterialToEvpKey(const KeymasterKeyBlob& key_material,
+                                             keymaster_algorithm_t expected_algorithm,
+                                             UniquePtr<EVP_PKEY, EVP_PKEY_Delete>* pkey) {
+    bool public_key_only = false;
+    return DecodeKeyMaterial(key_material, expected_algorithm, &public_key_only, pkey);
+}
+
+keymaster_error_t DecodedKeyMaterialToEvpPublicKey(const KeymasterKeyBlob& key_material,
+                                                   keymaster_algorithm_t expected_algorithm,
+                                                   UniquePtr<EVP_PKEY, EVP_PKEY_Delete>* pkey,
+                                                   bool* public_key_only) {
+    *public_key_only = true;
+    return DecodeKeyMaterial(key_material, expected_algorithm, public_key_only, pkey);
+}
+
 size_t ec_group_size_bits(EC_KEY* ec_key) {
     const EC_GROUP* group = EC_KEY_get0_group(ec_key);
     UniquePtr<BN_CTX, BN_CTX_Delete> bn_ctx(BN_CTX_new());
@@ -84,6 +84,8 @@ keymaster_error_t RsaKeyFactory::GenerateKey(const AuthorizationSet& key_descrip
     if (exponent.get() == nullptr || rsa_key.get() == nullptr || pkey.get() == nullptr)
         return KM_ERROR_MEMORY_ALLOCATION_FAILED;
 
+    // Keys are always two-prime.  BoringSSL no longer supports multi-prime RSA, and doing the CRT
+    // for extra primes here would give up its blinded, constant-time private key operations.
     if (!BN_set_word(exponent.get(), public_exponent) ||
         !RSA_generate_key_ex(rsa_key.get(), key_size, exponent.get(), nullptr /* callback */))
         return TranslateLastOpenSslError();
@@ -92,7 +94,7 @@ keymaster_error_t RsaKeyFactory::GenerateKey(const AuthorizationSet& key_descrip
         return TranslateLastOpenSslError();
 
     KeymasterKeyBlob key_material;
-    keymaster_error_t error = EvpKeyToKeyMaterial(pkey.get(), &key_material);
+    keymaster_error_t error = EvpKeyToDecodedKeyMaterial(pkey.get(), &key_material);
     if (error != KM_ERROR_OK)
         return error;
 
@@ -117,7 +119,19 @@ keymaster_error_t RsaKeyFactory::ImportKey(const AuthorizationSet& key_descripti
                                    &authorizations, &public_exponent, &key_size);
     if (error != KM_ERROR_OK)
         return error;
-    return blob_maker_.CreateKeyBlob(authorizations, KM_ORIGIN_IMPORTED, input_key_material,
+
+    UniquePtr<EVP_PKEY, EVP_PKEY_Delete> pkey;
+    error = KeyMaterialToEvpKey(input_key_material_format, input_key_material, keymaster_key_type(),
+                                &pkey);
+    if (error != KM_ERROR_OK)
+        return error;
+
+    KeymasterKeyBlob key_material;
+    error = EvpKeyToDecodedKeyMaterial(pkey.get(), &key_material);
+    if (error != KM_ERROR_OK)
+        return error;
+
+    return blob_maker_.CreateKeyBlob(authorizations, KM_ORIGIN_IMPORTED, key_material,
                                      output_key_blob, hw_enforced, sw_enforced);
 }
 
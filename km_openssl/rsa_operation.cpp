@@ -71,6 +71,12 @@ RsaOperation* RsaOperationFactory::CreateRsaOperation(Key&& key,
     keymaster_digest_t digest = KM_DIGEST_NONE;
     if (require_digest && !GetAndValidateDigest(begin_params, key, &digest, error)) return nullptr;
 
+    // Verification and encryption need only the public key.
+    if (purpose() == KM_PURPOSE_SIGN || purpose() == KM_PURPOSE_DECRYPT) {
+        *error = static_cast<RsaKey&>(key).LoadPrivateKey();
+        if (*error != KM_ERROR_OK) return nullptr;
+    }
+
     UniquePtr<EVP_PKEY, EVP_PKEY_Delete> rsa(GetRsaKey(move(key), error));
     if (!rsa.get()) return nullptr;
 
@@ -235,6 +241,38 @@ RsaDigestingOperation::~RsaDigestingOperation() {
     EVP_MD_CTX_cleanup(&digest_ctx_);
 }
 
+OperationPtr RsaDigestingOperation::CloneInto(RsaDigestingOperation* clone_ptr,
+                                              keymaster_error_t* error) const {
+    if (!clone_ptr) {
+        *error = KM_ERROR_MEMORY_ALLOCATION_FAILED;
+        return OperationPtr();
+    }
+    // The clone was constructed with a pointer to this operation's key, and frees it when done.
+    EVP_PKEY_up_ref(rsa_key_);
+    UniquePtr<RsaDigestingOperation> clone(clone_ptr);
+    if (!clone->authorizations_valid()) {
+        *error = KM_ERROR_MEMORY_ALLOCATION_FAILED;
+        return OperationPtr();
+    }
+
+    clone->digest_algorithm_ = digest_algorithm_;
+    if (data_.available_read() && !clone->data_.Reinitialize(data_)) {
+        *error = KM_ERROR_MEMORY_ALLOCATION_FAILED;
+        return OperationPtr();
+    }
+    // The copy includes the EVP_PKEY_CTX, and with it the padding configuration.
+    if (digest_ != KM_DIGEST_NONE && !EVP_MD_CTX_copy_ex(&clone->digest_ctx_, &digest_ctx_)) {
+        *error = TranslateLastOpenSslError();
+        return OperationPtr();
+    }
+
+    *error = GenerateRandom(reinterpret_cast<uint8_t*>(&clone->operation_handle_),
+                            (size_t)sizeof(clone->operation_handle_));
+    if (*error != KM_ERROR_OK)
+        return OperationPtr();
+    return OperationPtr(clone.release());
+}
+
 int RsaDigestingOperation::GetOpensslPadding(keymaster_error_t* error) {
     *error = KM_ERROR_OK;
     switch (padding_) {
@@ -320,6 +358,13 @@ static keymaster_error_t zero_pad_left(UniquePtr<uint8_t[]>* dest, size_t padded
     return KM_ERROR_OK;
 }
 
+OperationPtr RsaSignOperation::Clone(keymaster_error_t* error) const {
+    return CloneInto(new (std::nothrow) RsaSignOperation(AuthorizationSet(hw_enforced()),
+                                                         AuthorizationSet(sw_enforced()), digest_,
+                                                         padding_, rsa_key_),
+                     error);
+}
+
 keymaster_error_t RsaSignOperation::SignUndigested(Buffer* output) {
     UniquePtr<RSA, RSA_Delete> rsa(EVP_PKEY_get1_RSA(const_cast<EVP_PKEY*>(rsa_key_)));
     if (!rsa.get())
@@ -427,6 +472,13 @@ keymaster_error_t RsaVerifyOperation::Finish(const AuthorizationSet& additional_
         return VerifyDigested(signature);
 }
 
+OperationPtr RsaVerifyOperation::Clone(keymaster_error_t* error) const {
+    return CloneInto(new (std::nothrow) RsaVerifyOperation(AuthorizationSet(hw_enforced()),
+                                                           AuthorizationSet(sw_enforced()),
+                                                           digest_, padding_, rsa_key_),
+                     error);
+}
+
 keymaster_error_t RsaVerifyOperation::VerifyUndigested(const Buffer& signature) {
     UniquePtr<RSA, RSA_Delete> rsa(EVP_PKEY_get1_RSA(const_cast<EVP_PKEY*>(rsa_key_)));
     if (!rsa.get())
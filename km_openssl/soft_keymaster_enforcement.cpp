@@ -90,38 +90,7 @@ SoftKeymasterEnforcement::GetHmacSharingParameters(HmacSharingParameters* params
 
 namespace {
 
-DEFINE_OPENSSL_OBJECT_POINTER(HMAC_CTX);
-
-keymaster_error_t hmacSha256(const keymaster_key_blob_t& key, const keymaster_blob_t data_chunks[],
-                             size_t data_chunk_count, KeymasterBlob* output) {
-    if (!output) return KM_ERROR_UNEXPECTED_NULL_POINTER;
-
-    unsigned digest_len = SHA256_DIGEST_LENGTH;
-    if (!output->Reset(digest_len)) return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-
-    HMAC_CTX_Ptr ctx(HMAC_CTX_new());
-    if (!HMAC_Init_ex(ctx.get(), key.key_material, key.key_material_size, EVP_sha256(),
-                      nullptr /* engine*/)) {
-        return TranslateLastOpenSslError();
-    }
-
-    for (size_t i = 0; i < data_chunk_count; i++) {
-        auto& chunk = data_chunks[i];
-        if (!HMAC_Update(ctx.get(), chunk.data, chunk.data_length)) {
-            return TranslateLastOpenSslError();
-        }
-    }
-
-    if (!HMAC_Final(ctx.get(), output->writable_data(), &digest_len)) {
-        return TranslateLastOpenSslError();
-    }
-
-    if (digest_len != output->data_length) return KM_ERROR_UNKNOWN_ERROR;
-
-    return KM_ERROR_OK;
-}
-
-// Helpers for converting types to keymaster_blob_t, for easy feeding of hmacSha256.
+// Helpers for converting types to keymaster_blob_t, for easy feeding of ComputeHmac.
 template <typename T> inline keymaster_blob_t toBlob(const T& t) {
     return {reinterpret_cast<const uint8_t*>(&t), sizeof(t)};
 }
@@ -143,6 +112,45 @@ bool operator==(const HmacSharingParameters& a, const HmacSharingParameters& b)
 
 }  // namespace
 
+keymaster_error_t SoftKeymasterEnforcement::KeyHmac() {
+    hmac_ctx_keyed_ = HMAC_Init_ex(&keyed_hmac_ctx_, hmac_key_.key_material,
+                                   hmac_key_.key_material_size, EVP_sha256(), nullptr /* engine*/);
+    if (!hmac_ctx_keyed_) return TranslateLastOpenSslError();
+    return KM_ERROR_OK;
+}
+
+keymaster_error_t SoftKeymasterEnforcement::ComputeHmac(const keymaster_blob_t data_chunks[],
+                                                        size_t data_chunk_count,
+                                                        KeymasterBlob* output) {
+    if (!output) return KM_ERROR_UNEXPECTED_NULL_POINTER;
+
+    if (!hmac_ctx_keyed_) {
+        keymaster_error_t error = KeyHmac();
+        if (error != KM_ERROR_OK) return error;
+    }
+
+    unsigned digest_len = SHA256_DIGEST_LENGTH;
+    if (!output->Reset(digest_len)) return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+
+    HMAC_CTX ctx;
+    HMAC_CTX_init(&ctx);
+    keymaster_error_t error = KM_ERROR_OK;
+    if (!HMAC_CTX_copy_ex(&ctx, &keyed_hmac_ctx_)) error = TranslateLastOpenSslError();
+    for (size_t i = 0; error == KM_ERROR_OK && i < data_chunk_count; i++) {
+        auto& chunk = data_chunks[i];
+        if (!HMAC_Update(&ctx, chunk.data, chunk.data_length)) error = TranslateLastOpenSslError();
+    }
+    if (error == KM_ERROR_OK && !HMAC_Final(&ctx, output->writable_data(), &digest_len)) {
+        error = TranslateLastOpenSslError();
+    }
+    HMAC_CTX_cleanup(&ctx);
+    if (error != KM_ERROR_OK) return error;
+
+    if (digest_len != output->data_length) return KM_ERROR_UNKNOWN_ERROR;
+
+    return KM_ERROR_OK;
+}
+
 keymaster_error_t
 SoftKeymasterEnforcement::ComputeSharedHmac(const HmacSharingParametersArray& params_array,
                                             KeymasterBlob* sharingCheck) {
@@ -161,18 +169,28 @@ SoftKeymasterEnforcement::ComputeSharedHmac(const HmacSharingParametersArray& pa
 
     if (!found_mine) return KM_ERROR_INVALID_ARGUMENT;
 
+    keymaster_error_t error;
+    if (!shared_hmac_ckdf_.is_initialized()) {
+        error = shared_hmac_ckdf_.Init(
+            KeymasterKeyBlob(kFakeKeyAgreementKey, sizeof(kFakeKeyAgreementKey)));
+        if (error != KM_ERROR_OK) return error;
+    }
+
+    hmac_ctx_keyed_ = false;
     if (!hmac_key_.Reset(SHA256_DIGEST_LENGTH)) return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-    keymaster_error_t error = ckdf(
-        KeymasterKeyBlob(kFakeKeyAgreementKey, sizeof(kFakeKeyAgreementKey)),
+    error = shared_hmac_ckdf_.Derive(
         KeymasterBlob(reinterpret_cast<const uint8_t*>(kSharedHmacLabel), strlen(kSharedHmacLabel)),
         context_chunks.get(), num_chunks,  //
         &hmac_key_);
     if (error != KM_ERROR_OK) return error;
 
+    error = KeyHmac();
+    if (error != KM_ERROR_OK) return error;
+
     keymaster_blob_t data = {reinterpret_cast<const uint8_t*>(kMacVerificationString),
                              strlen(kMacVerificationString)};
     keymaster_blob_t data_chunks[] = {data};
-    return hmacSha256(hmac_key_, data_chunks, 1, sharingCheck);
+    return ComputeHmac(data_chunks, 1, sharingCheck);
 }
 
 VerifyAuthorizationResponse
@@ -192,7 +210,7 @@ SoftKeymasterEnforcement::VerifyAuthorization(const VerifyAuthorizationRequest&
         toBlob(response.token.security_level),
         {},  // parametersVerified
     };
-    response.error = hmacSha256(hmac_key_, data_chunks, 5, &response.token.mac);
+    response.error = ComputeHmac(data_chunks, 5, &response.token.mac);
 
     return response;
 }
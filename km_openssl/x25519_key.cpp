@@ -0,0 +1,41 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <keymaster/km_openssl/x25519_key.h>
+
+#include <keymaster/android_keymaster_utils.h>
+
+namespace keymaster {
+
+X25519Key::~X25519Key() {
+    memset_s(private_key_, 0, sizeof(private_key_));
+}
+
+bool X25519Key::EvpToInternal(const EVP_PKEY* pkey) {
+    if (EVP_PKEY_type(pkey->type) != EVP_PKEY_X25519)
+        return false;
+
+    size_t private_key_len = sizeof(private_key_);
+    return EVP_PKEY_get_raw_private_key(pkey, private_key_, &private_key_len) == 1 &&
+           private_key_len == sizeof(private_key_);
+}
+
+EVP_PKEY* X25519Key::CreateEvpKey() const {
+    return EVP_PKEY_new_raw_private_key(EVP_PKEY_X25519, nullptr /* engine */, private_key_,
+                                        sizeof(private_key_));
+}
+
+}  // namespace keymaster
@@ -40,7 +40,9 @@ keymaster_error_t EcdsaKeymaster0KeyFactory::GenerateKey(const AuthorizationSet&
     if (!key_blob || !hw_enforced || !sw_enforced)
         return KM_ERROR_OUTPUT_PARAMETER_NULL;
 
-    if (!engine_ || !engine_->supports_ec())
+    // Keymaster0 hardware has no curve 25519 or key agreement support, so those keys are made in
+    // software.
+    if (!engine_ || !engine_->supports_ec() || IsSoftwareOnlyKey(key_description))
         return super::GenerateKey(key_description, key_blob, hw_enforced, sw_enforced);
 
     keymaster_ec_curve_t ec_curve;
@@ -83,6 +85,10 @@ keymaster_error_t EcdsaKeymaster0KeyFactory::ImportKey(
     if (error != KM_ERROR_OK)
         return error;
 
+    if (IsSoftwareOnlyKey(authorizations))
+        return super::ImportKey(key_description, input_key_material_format, input_key_material,
+                                output_key_blob, hw_enforced, sw_enforced);
+
     KeymasterKeyBlob imported_hw_key;
     if (!engine_->ImportKey(input_key_material_format, input_key_material, &imported_hw_key))
         return KM_ERROR_UNKNOWN_ERROR;
@@ -65,6 +65,11 @@ keymaster_error_t EcdsaKeymaster1KeyFactory::GenerateKey(const AuthorizationSet&
                                                          KeymasterKeyBlob* key_blob,
                                                          AuthorizationSet* hw_enforced,
                                                          AuthorizationSet* sw_enforced) const {
+    // Keymaster1 hardware has no curve 25519 or key agreement support, so those keys are made in
+    // software.
+    if (IsSoftwareOnlyKey(key_description))
+        return EcKeyFactory::GenerateKey(key_description, key_blob, hw_enforced, sw_enforced);
+
     AuthorizationSet key_params_copy;
     UpdateToWorkAroundUnsupportedDigests(key_description, &key_params_copy);
 
@@ -83,6 +88,11 @@ keymaster_error_t EcdsaKeymaster1KeyFactory::ImportKey(
     const AuthorizationSet& key_description, keymaster_key_format_t input_key_material_format,
     const KeymasterKeyBlob& input_key_material, KeymasterKeyBlob* output_key_blob,
     AuthorizationSet* hw_enforced, AuthorizationSet* sw_enforced) const {
+    if (IsSoftwareOnlyKey(key_description))
+        return EcKeyFactory::ImportKey(key_description, input_key_material_format,
+                                       input_key_material, output_key_blob, hw_enforced,
+                                       sw_enforced);
+
     AuthorizationSet key_params_copy;
     UpdateToWorkAroundUnsupportedDigests(key_description, &key_params_copy);
     return engine_->ImportKey(key_params_copy, input_key_material_format, input_key_material,
@@ -97,6 +107,10 @@ keymaster_error_t EcdsaKeymaster1KeyFactory::LoadKey(KeymasterKeyBlob&& key_mate
     if (!key)
         return KM_ERROR_OUTPUT_PARAMETER_NULL;
 
+    if (IsSoftwareOnlyKey(hw_enforced) || IsSoftwareOnlyKey(sw_enforced))
+        return EcKeyFactory::LoadKey(move(key_material), additional_params, move(hw_enforced),
+                                     move(sw_enforced), key);
+
     keymaster_error_t error;
     unique_ptr<EC_KEY, EC_KEY_Delete> ecdsa(
         engine_->BuildEcKey(key_material, additional_params, &error));
@@ -114,6 +128,9 @@ keymaster_error_t EcdsaKeymaster1KeyFactory::LoadKey(KeymasterKeyBlob&& key_mate
 
 OperationFactory*
 EcdsaKeymaster1KeyFactory::GetOperationFactory(keymaster_purpose_t purpose) const {
+    // Key agreement keys are software keys, see LoadKey().
+    if (purpose == KM_PURPOSE_AGREE_KEY) return EcKeyFactory::GetOperationFactory(purpose);
+
     switch (purpose) {
     case KM_PURPOSE_SIGN:
         return sign_factory_.get();
@@ -19,6 +19,7 @@
 #include <memory>
 
 #include <keymaster/android_keymaster_utils.h>
+#include <keymaster/km_openssl/ed25519_operation.h>
 #include <keymaster/km_openssl/openssl_err.h>
 #include <keymaster/km_openssl/openssl_utils.h>
 #include <keymaster/legacy_support/ec_keymaster1_key.h>
@@ -46,14 +47,16 @@ keymaster_error_t EcdsaKeymaster1WrappedOperation::Begin(EVP_PKEY* ecdsa_key,
     // We also cache in the key the padding value that we expect to be passed to the engine crypto
     // operation.  This just allows us to double-check that the correct padding value is reaching
     // that layer.
-    AuthorizationSet begin_params(input_params);
-    int pos = begin_params.find(TAG_DIGEST);
-    if (pos == -1)
+    Keymaster1BeginParams begin_params(input_params);
+    if (!begin_params.is_valid())
+        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    keymaster_key_param_t* digest = begin_params.find(KM_TAG_DIGEST);
+    if (!digest)
         return KM_ERROR_UNSUPPORTED_DIGEST;
-    begin_params[pos].enumerated = KM_DIGEST_NONE;
+    digest->enumerated = KM_DIGEST_NONE;
 
-    return engine_->device()->begin(engine_->device(), purpose_, &key_data->key_material,
-                                    &begin_params, nullptr /* out_params */, &operation_handle_);
+    return engine_->BeginOperation(purpose_, *key_data, begin_params.param_set(),
+                                   &operation_handle_);
 }
 
 keymaster_error_t
@@ -71,7 +74,7 @@ EcdsaKeymaster1WrappedOperation::PrepareFinish(EVP_PKEY* ecdsa_key,
 }
 
 keymaster_error_t EcdsaKeymaster1WrappedOperation::Abort() {
-    return engine_->device()->abort(engine_->device(), operation_handle_);
+    return engine_->AbortOperation(operation_handle_);
 }
 
 keymaster_error_t EcdsaKeymaster1WrappedOperation::GetError(EVP_PKEY* ecdsa_key) {
@@ -81,6 +84,12 @@ keymaster_error_t EcdsaKeymaster1WrappedOperation::GetError(EVP_PKEY* ecdsa_key)
     return key_data->error;
 }
 
+void EcdsaKeymaster1WrappedOperation::CompleteFinish(EVP_PKEY* ecdsa_key) {
+    Keymaster1Engine::KeyData* key_data = engine_->GetData(ecdsa_key);
+    if (key_data && key_data->op_handle == 0)
+        device_finished_ = true;
+}
+
 static EVP_PKEY* GetEvpKey(const EcdsaKeymaster1Key& key, keymaster_error_t* error) {
     if (!key.key()) {
         *error = KM_ERROR_UNKNOWN_ERROR;
@@ -95,9 +104,22 @@ static EVP_PKEY* GetEvpKey(const EcdsaKeymaster1Key& key, keymaster_error_t* err
     return pkey.release();
 }
 
+static EcdsaSignOperationFactory software_sign_factory;
+
 OperationPtr EcdsaKeymaster1OperationFactory::CreateOperation(Key&& key,
                                                               const AuthorizationSet& begin_params,
                                                               keymaster_error_t* error) const {
+    // Curve 25519 and key agreement keys are software keys, see
+    // EcdsaKeymaster1KeyFactory::LoadKey().
+    if (IsEd25519Key(key))
+        return GetEd25519OperationFactory(purpose_)->CreateOperation(move(key), begin_params,
+                                                                     error);
+    if (EcKeyFactory::IsSoftwareOnlyKey(key.hw_enforced()) ||
+        EcKeyFactory::IsSoftwareOnlyKey(key.sw_enforced())) {
+        const OperationFactory& factory = software_sign_factory;
+        return factory.CreateOperation(move(key), begin_params, error);
+    }
+
     keymaster_digest_t digest;
     if (!GetAndValidateDigest(begin_params, key, &digest, error)) return nullptr;
 
@@ -30,9 +30,9 @@ namespace keymaster {
 class EcdsaKeymaster1WrappedOperation {
   public:
     EcdsaKeymaster1WrappedOperation(keymaster_purpose_t purpose, const Keymaster1Engine* engine)
-        : purpose_(purpose), operation_handle_(0), engine_(engine) {}
+        : purpose_(purpose), operation_handle_(0), engine_(engine), device_finished_(false) {}
     ~EcdsaKeymaster1WrappedOperation() {
-        if (operation_handle_)
+        if (operation_handle_ && !device_finished_)
             Abort();
     }
 
@@ -42,11 +42,18 @@ class EcdsaKeymaster1WrappedOperation {
 
     keymaster_error_t GetError(EVP_PKEY* ecdsa_key);
 
+    /**
+     * Notes whether the engine passed the operation to the device's update and finish, which end
+     * the device operation whatever they return, so that it isn't needlessly aborted.
+     */
+    void CompleteFinish(EVP_PKEY* ecdsa_key);
+
     keymaster_operation_handle_t GetOperationHandle() const { return operation_handle_; }
   protected:
     keymaster_purpose_t purpose_;
     keymaster_operation_handle_t operation_handle_;
     const Keymaster1Engine* engine_;
+    bool device_finished_;
 };
 
 template <typename BaseOperation> class EcdsaKeymaster1Operation : public BaseOperation {
@@ -78,6 +85,7 @@ template <typename BaseOperation> class EcdsaKeymaster1Operation : public BaseOp
         if (error != KM_ERROR_OK)
             return error;
         error = super::Finish(input_params, input, signature, output_params, output);
+        wrapped_operation_.CompleteFinish(super::ecdsa_key_);
         if (wrapped_operation_.GetError(super::ecdsa_key_) != KM_ERROR_OK)
             error = wrapped_operation_.GetError(super::ecdsa_key_);
         return error;
@@ -93,6 +101,13 @@ template <typename BaseOperation> class EcdsaKeymaster1Operation : public BaseOp
     keymaster_operation_handle_t operation_handle() const override {
         return wrapped_operation_.GetOperationHandle();
     }
+
+    // The software state could be copied, but not the device operation behind it.
+    OperationPtr Clone(keymaster_error_t* error) const override {
+        *error = KM_ERROR_UNIMPLEMENTED;
+        return OperationPtr();
+    }
+
   private:
     EcdsaKeymaster1WrappedOperation wrapped_operation_;
 };
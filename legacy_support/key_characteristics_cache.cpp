@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <keymaster/legacy_support/key_characteristics_cache.h>
+
+#include <keymaster/android_keymaster_utils.h>
+
+#include <keymaster/new>
+
+namespace keymaster {
+
+/* static */
+void KeyCharacteristicsCache::DigestBlob(const keymaster_key_blob_t& blob, uint8_t* digest) {
+    SHA256(blob.key_material, blob.key_material_size, digest);
+}
+
+// Each value is hashed with a presence flag and its length, so that no two different pairs of
+// APPLICATION_ID and APPLICATION_DATA produce the same input.
+template <keymaster_tag_t Tag>
+static void DigestBlobParam(SHA256_CTX* ctx, const AuthorizationSet& params,
+                            TypedTag<KM_BYTES, Tag> tag) {
+    keymaster_blob_t value = {nullptr, 0};
+    uint8_t present = params.GetTagValue(tag, &value);
+    uint64_t length = value.data_length;
+    SHA256_Update(ctx, &present, sizeof(present));
+    SHA256_Update(ctx, &length, sizeof(length));
+    SHA256_Update(ctx, value.data, value.data_length);
+}
+
+/* static */
+void KeyCharacteristicsCache::DigestParams(const AuthorizationSet& additional_params,
+                                           uint8_t* digest) {
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    DigestBlobParam(&ctx, additional_params, TAG_APPLICATION_ID);
+    DigestBlobParam(&ctx, additional_params, TAG_APPLICATION_DATA);
+    SHA256_Final(digest, &ctx);
+}
+
+bool KeyCharacteristicsCache::Find(const keymaster_key_blob_t& blob,
+                                   const AuthorizationSet& additional_params,
+                                   AuthorizationSet* hw_enforced,
+                                   AuthorizationSet* sw_enforced) {
+    if (!entries_.get())
+        return false;
+
+    uint8_t blob_digest[SHA256_DIGEST_LENGTH];
+    uint8_t params_digest[SHA256_DIGEST_LENGTH];
+    DigestBlob(blob, blob_digest);
+    DigestParams(additional_params, params_digest);
+
+    for (size_t i = 0; i < cache_size_; ++i) {
+        Entry& entry = entries_[i];
+        if (!entry.valid || memcmp_s(entry.blob_digest, blob_digest, sizeof(blob_digest)) != 0 ||
+            memcmp_s(entry.params_digest, params_digest, sizeof(params_digest)) != 0)
+            continue;
+
+        entry.last_use = ++last_use_;
+        *hw_enforced = entry.hw_enforced;
+        *sw_enforced = entry.sw_enforced;
+        return hw_enforced->is_valid() == AuthorizationSet::OK &&
+               sw_enforced->is_valid() == AuthorizationSet::OK;
+    }
+    return false;
+}
+
+void KeyCharacteristicsCache::Add(const keymaster_key_blob_t& blob,
+                                  const AuthorizationSet& additional_params,
+                                  const keymaster_key_characteristics_t& characteristics) {
+    if (cache_size_ == 0)
+        return;
+
+    if (!entries_.get()) {
+        entries_.reset(new (std::nothrow) Entry[cache_size_]);
+        if (!entries_.get())
+            return;
+    }
+
+    // Take an empty slot if there is one, otherwise the least recently used.
+    Entry* entry_ptr = &entries_[0];
+    for (size_t i = 0; i < cache_size_ && entry_ptr->valid; ++i) {
+        if (!entries_[i].valid || entries_[i].last_use < entry_ptr->last_use)
+            entry_ptr = &entries_[i];
+    }
+    Entry& entry = *entry_ptr;
+    entry.last_use = ++last_use_;
+
+    DigestBlob(blob, entry.blob_digest);
+    DigestParams(additional_params, entry.params_digest);
+    // Leave the slot empty rather than holding a partial entry.
+    entry.valid = entry.hw_enforced.Reinitialize(characteristics.hw_enforced) &&
+                  entry.sw_enforced.Reinitialize(characteristics.sw_enforced);
+    if (entry.valid) {
+        // If interning fails the entry just keeps its own copies.
+        interner_.Intern(&entry.hw_enforced);
+        interner_.Intern(&entry.sw_enforced);
+    }
+}
+
+void KeyCharacteristicsCache::Invalidate(const keymaster_key_blob_t& blob) {
+    if (!entries_.get())
+        return;
+
+    uint8_t blob_digest[SHA256_DIGEST_LENGTH];
+    DigestBlob(blob, blob_digest);
+    for (size_t i = 0; i < cache_size_; ++i) {
+        Entry& entry = entries_[i];
+        if (entry.valid && memcmp_s(entry.blob_digest, blob_digest, sizeof(blob_digest)) == 0) {
+            entry.valid = false;
+            entry.hw_enforced.Clear();
+            entry.sw_enforced.Clear();
+        }
+    }
+}
+
+void KeyCharacteristicsCache::Clear() {
+    if (!entries_.get())
+        return;
+
+    for (size_t i = 0; i < cache_size_; ++i) {
+        entries_[i].valid = false;
+        entries_[i].hw_enforced.Clear();
+        entries_[i].sw_enforced.Clear();
+    }
+    interner_.Purge();
+}
+
+}  // namespace keymaster
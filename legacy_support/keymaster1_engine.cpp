@@ -27,6 +27,7 @@
 #include <keymaster/android_keymaster_utils.h>
 #include <keymaster/km_openssl/openssl_err.h>
 #include <keymaster/km_openssl/openssl_utils.h>
+#include <keymaster/new>
 
 #include <openssl/bn.h>
 #include <openssl/ec_key.h>
@@ -39,8 +40,11 @@ namespace keymaster {
 
 Keymaster1Engine* Keymaster1Engine::instance_ = nullptr;
 
-Keymaster1Engine::Keymaster1Engine(const keymaster1_device_t* keymaster1_device)
-    : keymaster1_device_(keymaster1_device), engine_(ENGINE_new()),
+Keymaster1Engine::Keymaster1Engine(const keymaster1_device_t* keymaster1_device,
+                                   size_t max_concurrent_device_calls)
+    : keymaster1_device_(keymaster1_device),
+      max_concurrent_device_calls_(max_concurrent_device_calls), device_calls_in_flight_(0),
+      engine_(ENGINE_new()),
       rsa_index_(RSA_get_ex_new_index(0 /* argl */, nullptr /* argp */, nullptr /* new_func */,
                                       Keymaster1Engine::duplicate_key_data,
                                       Keymaster1Engine::free_key_data)),
@@ -65,6 +69,23 @@ Keymaster1Engine::~Keymaster1Engine() {
     instance_ = nullptr;
 }
 
+Keymaster1Engine::DeviceCall::DeviceCall(const Keymaster1Engine* engine) : engine_(engine) {
+    std::unique_lock<std::mutex> lock(engine_->device_calls_lock_);
+    if (engine_->max_concurrent_device_calls_)
+        engine_->device_call_returned_.wait(lock, [this] {
+            return engine_->device_calls_in_flight_ < engine_->max_concurrent_device_calls_;
+        });
+    ++engine_->device_calls_in_flight_;
+}
+
+Keymaster1Engine::DeviceCall::~DeviceCall() {
+    {
+        std::lock_guard<std::mutex> lock(engine_->device_calls_lock_);
+        --engine_->device_calls_in_flight_;
+    }
+    engine_->device_call_returned_.notify_one();
+}
+
 static void ConvertCharacteristics(keymaster_key_characteristics_t* characteristics,
                                    AuthorizationSet* hw_enforced, AuthorizationSet* sw_enforced) {
     unique_ptr<keymaster_key_characteristics_t, Characteristics_Delete> characteristics_deleter(
@@ -83,8 +104,12 @@ keymaster_error_t Keymaster1Engine::GenerateKey(const AuthorizationSet& key_desc
 
     keymaster_key_characteristics_t* characteristics;
     keymaster_key_blob_t blob;
-    keymaster_error_t error = keymaster1_device_->generate_key(keymaster1_device_, &key_description,
-                                                               &blob, &characteristics);
+    keymaster_error_t error;
+    {
+        DeviceCall call(this);
+        error = keymaster1_device_->generate_key(keymaster1_device_, &key_description, &blob,
+                                                 &characteristics);
+    }
     if (error != KM_ERROR_OK)
         return error;
     unique_ptr<uint8_t, Malloc_Delete> blob_deleter(const_cast<uint8_t*>(blob.key_material));
@@ -107,9 +132,13 @@ keymaster_error_t Keymaster1Engine::ImportKey(const AuthorizationSet& key_descri
     const keymaster_blob_t input_key = {input_key_material.key_material,
                                         input_key_material.key_material_size};
     keymaster_key_blob_t blob;
-    keymaster_error_t error = keymaster1_device_->import_key(keymaster1_device_, &key_description,
-                                                             input_key_material_format, &input_key,
-                                                             &blob, &characteristics);
+    keymaster_error_t error;
+    {
+        DeviceCall call(this);
+        error = keymaster1_device_->import_key(keymaster1_device_, &key_description,
+                                               input_key_material_format, &input_key, &blob,
+                                               &characteristics);
+    }
     if (error != KM_ERROR_OK)
         return error;
     unique_ptr<uint8_t, Malloc_Delete> blob_deleter(const_cast<uint8_t*>(blob.key_material));
@@ -123,15 +152,31 @@ keymaster_error_t Keymaster1Engine::ImportKey(const AuthorizationSet& key_descri
 keymaster_error_t Keymaster1Engine::DeleteKey(const KeymasterKeyBlob& blob) const {
     if (!keymaster1_device_->delete_key)
         return KM_ERROR_OK;
+    DeviceCall call(this);
     return keymaster1_device_->delete_key(keymaster1_device_, &blob);
 }
 
 keymaster_error_t Keymaster1Engine::DeleteAllKeys() const {
     if (!keymaster1_device_->delete_all_keys)
         return KM_ERROR_OK;
+    DeviceCall call(this);
     return keymaster1_device_->delete_all_keys(keymaster1_device_);
 }
 
+keymaster_error_t
+Keymaster1Engine::BeginOperation(keymaster_purpose_t purpose, const KeyData& key_data,
+                                 const keymaster_key_param_set_t& begin_params,
+                                 keymaster_operation_handle_t* op_handle) const {
+    DeviceCall call(this);
+    return keymaster1_device_->begin(keymaster1_device_, purpose, &key_data.key_material,
+                                     &begin_params, nullptr /* out_params */, op_handle);
+}
+
+keymaster_error_t Keymaster1Engine::AbortOperation(keymaster_operation_handle_t op_handle) const {
+    DeviceCall call(this);
+    return keymaster1_device_->abort(keymaster1_device_, op_handle);
+}
+
 RSA* Keymaster1Engine::BuildRsaKey(const KeymasterKeyBlob& blob,
                                    const AuthorizationSet& additional_params,
                                    keymaster_error_t* error) const {
@@ -261,22 +306,34 @@ void Keymaster1Engine::free_key_data(void* /* parent */, void* ptr, CRYPTO_EX_DA
     delete reinterpret_cast<KeyData*>(ptr);
 }
 
-keymaster_error_t Keymaster1Engine::Keymaster1Finish(const KeyData* key_data,
+keymaster_error_t Keymaster1Engine::Keymaster1Finish(KeyData* key_data,
                                                      const keymaster_blob_t& input,
                                                      keymaster_blob_t* output) {
     if (key_data->op_handle == 0)
         return KM_ERROR_UNKNOWN_ERROR;
 
+    // Whatever update and finish return, the device operation is over once they're called.
+    // Clearing the handle tells the wrapped operation that there's nothing left to abort.
+    keymaster_operation_handle_t op_handle = key_data->op_handle;
+    key_data->op_handle = 0;
+
     size_t input_consumed;
     // Note: devices are required to consume all input in a single update call for undigested
     // signing operations and encryption operations.  No need to loop here.
-    keymaster_error_t error =
-        device()->update(device(), key_data->op_handle, &key_data->finish_params, &input,
-                         &input_consumed, nullptr /* out_params */, nullptr /* output */);
+    //
+    // Each call takes its own slot, so that with a limit above one, other threads' calls can be
+    // serviced between this update and finish.
+    keymaster_error_t error;
+    {
+        DeviceCall call(this);
+        error = device()->update(device(), op_handle, &key_data->finish_params, &input,
+                                 &input_consumed, nullptr /* out_params */, nullptr /* output */);
+    }
     if (error != KM_ERROR_OK)
         return error;
 
-    return device()->finish(device(), key_data->op_handle, &key_data->finish_params,
+    DeviceCall call(this);
+    return device()->finish(device(), op_handle, &key_data->finish_params,
                             nullptr /* signature */, nullptr /* out_params */, output);
 }
 
@@ -367,8 +424,11 @@ EVP_PKEY* Keymaster1Engine::GetKeymaster1PublicKey(const KeymasterKeyBlob& blob,
         app_data_ptr = &app_data;
 
     keymaster_blob_t export_data = {nullptr, 0};
-    *error = keymaster1_device_->export_key(keymaster1_device_, KM_KEY_FORMAT_X509, &blob,
-                                            client_id_ptr, app_data_ptr, &export_data);
+    {
+        DeviceCall call(this);
+        *error = keymaster1_device_->export_key(keymaster1_device_, KM_KEY_FORMAT_X509, &blob,
+                                                client_id_ptr, app_data_ptr, &export_data);
+    }
     if (*error != KM_ERROR_OK)
         return nullptr;
 
@@ -403,4 +463,32 @@ ECDSA_METHOD Keymaster1Engine::BuildEcdsaMethod() {
     return method;
 }
 
+Keymaster1BeginParams::Keymaster1BeginParams(const AuthorizationSet& input_params)
+    : capacity_(input_params.size() + 1) {
+    param_set_.params = nullptr;
+    param_set_.length = 0;
+
+    params_.reset(new (std::nothrow) keymaster_key_param_t[capacity_]);
+    if (!params_.get())
+        return;
+    if (input_params.size())
+        memcpy(params_.get(), input_params.begin(), sizeof(*params_.get()) * input_params.size());
+    param_set_.params = params_.get();
+    param_set_.length = input_params.size();
+}
+
+keymaster_key_param_t* Keymaster1BeginParams::find(keymaster_tag_t tag) {
+    for (size_t i = 0; i < param_set_.length; ++i)
+        if (params_[i].tag == tag)
+            return &params_[i];
+    return nullptr;
+}
+
+bool Keymaster1BeginParams::push_back(const keymaster_key_param_t& param) {
+    if (!params_.get() || param_set_.length == capacity_)
+        return false;
+    params_[param_set_.length++] = param;
+    return true;
+}
+
 }  // namespace keymaster
@@ -17,13 +17,13 @@
 
 #include <keymaster/legacy_support/keymaster1_legacy_support.h>
 
-#include <android-base/logging.h>
-
 #include <assert.h>
 
 #include <algorithm>
 #include <vector>
 
+#include <keymaster/logger.h>
+
 namespace keymaster {
 
 template <typename T> std::vector<T> make_vector(const T* array, size_t len) {
@@ -64,7 +64,7 @@ static keymaster_error_t add_digests(const keymaster1_device_t* dev, keymaster_a
     keymaster_error_t error =
         dev->get_supported_digests(dev, algorithm, purpose, &digests, &digests_length);
     if (error != KM_ERROR_OK) {
-        LOG(ERROR) << "Error " << error << " getting supported digests from keymaster1 device";
+        LOG_E("Error %d getting supported digests from keymaster1 device", error);
         return error;
     }
     std::unique_ptr<keymaster_digest_t, Malloc_Delete> digests_deleter(digests);
@@ -128,14 +128,14 @@ static bool findUnsupportedDigest(keymaster_algorithm_t algorithm,
         return false;
 
     if (digest != KM_DIGEST_NONE && !contains(supported_digests->second, digest)) {
-        LOG(WARNING) << "Digest " << digest << " requested but not supported by KM1 hal";
+        LOG_W("Digest %d requested but not supported by KM1 hal", digest);
         return true;
     }
 
     for (auto& entry : params)
         if (entry.tag == TAG_DIGEST)
             if (!contains(supported_digests->second, entry.enumerated)) {
-                LOG(WARNING) << "Digest " << entry.enumerated << " requested but not supported by KM1 hal";
+                LOG_W("Digest %u requested but not supported by KM1 hal", entry.enumerated);
                 return true;
             }
     return false;
@@ -149,7 +149,7 @@ bool requiresSoftwareDigesting(keymaster_algorithm_t algorithm, keymaster_purpos
     switch (algorithm) {
     case KM_ALGORITHM_AES:
     case KM_ALGORITHM_TRIPLE_DES:
-        LOG(WARNING) << "Not performing software digesting for symmetric cipher keys";
+        LOG_W("Not performing software digesting for symmetric cipher keys", 0);
         return false;
     case KM_ALGORITHM_HMAC:
     case KM_ALGORITHM_RSA:
@@ -158,7 +158,7 @@ bool requiresSoftwareDigesting(keymaster_algorithm_t algorithm, keymaster_purpos
     }
 
     if (!findUnsupportedDigest(algorithm, purpose, digest, params, digest_map)) {
-        LOG(DEBUG) << "Requested digest(s) supported for algorithm " << algorithm << " and purpose " << purpose;
+        LOG_D("Requested digest(s) supported for algorithm %d and purpose %d", algorithm, purpose);
         return false;
     }
 
@@ -16,7 +16,6 @@
 */
 
 #include "keymaster_passthrough_operation.h"
-#include <vector>
 #include <keymaster/android_keymaster_utils.h>
 
 namespace keymaster {
@@ -31,20 +30,23 @@ KeymasterPassthroughOperation<keymaster1_device_t>::Finish(const AuthorizationSe
     keymaster_blob_t in{ input.peek_read(), input.available_read() };
     keymaster_blob_t out = {};
     keymaster_error_t rc;
-    std::vector<KeymasterBlob> accumulate_output;
-    size_t accumulated_output_size = 0;
+    // Device output is appended straight to the caller's buffer, which grows geometrically, rather
+    // than being staged in per-call copies.
+    Buffer discarded_output;
+    Buffer* accumulated_output = output ? output : &discarded_output;
     AuthorizationSet accumulated_out_params;
     AuthorizationSet mutable_input_params = input_params;
     while (in.data_length != 0) {
         size_t consumed = 0;
         rc = km_device_->update(km_device_, operation_handle_, &mutable_input_params, &in, &consumed, &out_params, &out);
         if (rc == KM_ERROR_OK) {
-            accumulate_output.push_back(KeymasterBlob(out));
-            accumulated_output_size += out.data_length;
+            bool written = accumulated_output->reserve(out.data_length) &&
+                           accumulated_output->write(out.data, out.data_length);
             free(const_cast<uint8_t*>(out.data));
             out = {};
             accumulated_out_params.push_back(out_params);
             keymaster_free_param_set(&out_params);
+            if (!written) return KM_ERROR_MEMORY_ALLOCATION_FAILED;
         } else {
             return rc;
         }
@@ -68,21 +70,13 @@ KeymasterPassthroughOperation<keymaster1_device_t>::Finish(const AuthorizationSe
 
     rc = km_device_->finish(km_device_, operation_handle_, &mutable_input_params, &sig, &out_params, &out);
     if (rc != KM_ERROR_OK) return rc;
-    accumulate_output.push_back(KeymasterBlob(out));
-    accumulated_output_size += out.data_length;
+    bool written = accumulated_output->reserve(out.data_length) &&
+                   accumulated_output->write(out.data, out.data_length);
     free(const_cast<uint8_t*>(out.data));
     out = {};
     accumulated_out_params.push_back(out_params);
     keymaster_free_param_set(&out_params);
-
-    if (output && accumulated_output_size) {
-        if (!output->reserve(accumulated_output_size)) {
-            return KM_ERROR_MEMORY_ALLOCATION_FAILED;
-        }
-        for (auto& outBlob: accumulate_output) {
-            output->write(outBlob.data, outBlob.data_length);
-        }
-    }
+    if (!written) return KM_ERROR_MEMORY_ALLOCATION_FAILED;
 
     accumulated_out_params.Deduplicate();
     if (output_params) *output_params = move(accumulated_out_params);
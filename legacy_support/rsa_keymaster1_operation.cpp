@@ -45,26 +45,29 @@ keymaster_error_t RsaKeymaster1WrappedOperation::Begin(EVP_PKEY* rsa_key,
     // We also cache in the key the padding value that we expect to be passed to the engine crypto
     // operation.  This just allows us to double-check that the correct padding value is reaching
     // that layer.
-    AuthorizationSet begin_params(input_params);
-    int pos = begin_params.find(TAG_DIGEST);
-    if (pos == -1) {
+    Keymaster1BeginParams begin_params(input_params);
+    if (!begin_params.is_valid())
+        return KM_ERROR_MEMORY_ALLOCATION_FAILED;
+    keymaster_key_param_t* digest = begin_params.find(KM_TAG_DIGEST);
+    if (!digest) {
         // If we reach this point with no digest given. It was verified that KM_DIGEST_NONE was
         // authorized by OperationFactory::GetAndValidateDigest. So no DIGEST given may imply
         // KM_DIGEST_NONE.
-        begin_params.push_back(TAG_DIGEST, KM_DIGEST_NONE);
+        if (!begin_params.push_back(Authorization(TAG_DIGEST, KM_DIGEST_NONE)))
+            return KM_ERROR_MEMORY_ALLOCATION_FAILED;
     } else {
-        begin_params[pos].enumerated = KM_DIGEST_NONE;
+        digest->enumerated = KM_DIGEST_NONE;
     }
 
-    pos = begin_params.find(TAG_PADDING);
-    if (pos == -1)
+    keymaster_key_param_t* padding = begin_params.find(KM_TAG_PADDING);
+    if (!padding)
         return KM_ERROR_UNSUPPORTED_PADDING_MODE;
-    switch (begin_params[pos].enumerated) {
+    switch (padding->enumerated) {
     case KM_PAD_NONE:
     case KM_PAD_RSA_PSS:
     case KM_PAD_RSA_OAEP:
         key_data->expected_openssl_padding = RSA_NO_PADDING;
-        begin_params[pos].enumerated = KM_PAD_NONE;
+        padding->enumerated = KM_PAD_NONE;
         break;
 
     case KM_PAD_RSA_PKCS1_1_5_ENCRYPT:
@@ -73,8 +76,8 @@ keymaster_error_t RsaKeymaster1WrappedOperation::Begin(EVP_PKEY* rsa_key,
         break;
     }
 
-    return engine_->device()->begin(engine_->device(), purpose_, &key_data->key_material,
-                                    &begin_params, nullptr /* out_params */, &operation_handle_);
+    return engine_->BeginOperation(purpose_, *key_data, begin_params.param_set(),
+                                   &operation_handle_);
 }
 
 keymaster_error_t
@@ -92,7 +95,7 @@ RsaKeymaster1WrappedOperation::PrepareFinish(EVP_PKEY* rsa_key,
 }
 
 keymaster_error_t RsaKeymaster1WrappedOperation::Abort() {
-    return engine_->device()->abort(engine_->device(), operation_handle_);
+    return engine_->AbortOperation(operation_handle_);
 }
 
 keymaster_error_t RsaKeymaster1WrappedOperation::GetError(EVP_PKEY* rsa_key) {
@@ -102,6 +105,12 @@ keymaster_error_t RsaKeymaster1WrappedOperation::GetError(EVP_PKEY* rsa_key) {
     return key_data->error;
 }
 
+void RsaKeymaster1WrappedOperation::CompleteFinish(EVP_PKEY* rsa_key) {
+    Keymaster1Engine::KeyData* key_data = engine_->GetData(rsa_key);
+    if (key_data && key_data->op_handle == 0)
+        device_finished_ = true;
+}
+
 static EVP_PKEY* GetEvpKey(const RsaKeymaster1Key& key, keymaster_error_t* error) {
     if (!key.key()) {
         *error = KM_ERROR_UNKNOWN_ERROR;
@@ -30,9 +30,9 @@ namespace keymaster {
 class RsaKeymaster1WrappedOperation {
   public:
     RsaKeymaster1WrappedOperation(keymaster_purpose_t purpose, const Keymaster1Engine* engine)
-        : purpose_(purpose), operation_handle_(0), engine_(engine) {}
+        : purpose_(purpose), operation_handle_(0), engine_(engine), device_finished_(false) {}
     ~RsaKeymaster1WrappedOperation() {
-        if (operation_handle_)
+        if (operation_handle_ && !device_finished_)
             Abort();
     }
 
@@ -42,11 +42,18 @@ class RsaKeymaster1WrappedOperation {
 
     keymaster_error_t GetError(EVP_PKEY* rsa_key);
 
+    /**
+     * Notes whether the engine passed the operation to the device's update and finish, which end
+     * the device operation whatever they return, so that it isn't needlessly aborted.
+     */
+    void CompleteFinish(EVP_PKEY* rsa_key);
+
     keymaster_operation_handle_t GetOperationHandle() const { return operation_handle_; }
   protected:
     keymaster_purpose_t purpose_;
     keymaster_operation_handle_t operation_handle_;
     const Keymaster1Engine* engine_;
+    bool device_finished_;
 };
 
 template <typename BaseOperation> class RsaKeymaster1Operation : public BaseOperation {
@@ -78,6 +85,7 @@ template <typename BaseOperation> class RsaKeymaster1Operation : public BaseOper
         if (error != KM_ERROR_OK)
             return error;
         error = super::Finish(input_params, input, signature, output_params, output);
+        wrapped_operation_.CompleteFinish(super::rsa_key_);
         if (wrapped_operation_.GetError(super::rsa_key_) != KM_ERROR_OK)
             error = wrapped_operation_.GetError(super::rsa_key_);
         return error;
@@ -93,6 +101,13 @@ template <typename BaseOperation> class RsaKeymaster1Operation : public BaseOper
     keymaster_operation_handle_t operation_handle() const override {
         return wrapped_operation_.GetOperationHandle();
     }
+
+    // The software state could be copied, but not the device operation behind it.
+    OperationPtr Clone(keymaster_error_t* error) const override {
+        *error = KM_ERROR_UNIMPLEMENTED;
+        return OperationPtr();
+    }
+
   private:
     RsaKeymaster1WrappedOperation wrapped_operation_;
 };
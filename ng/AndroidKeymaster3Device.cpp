@@ -225,6 +225,8 @@ AndroidKeymaster3Device::AndroidKeymaster3Device()
             [] () -> auto {
                 auto context = new PureSoftKeymasterContext();
                 context->SetSystemVersion(GetOsVersion(), GetOsPatchlevel());
+                // On failure the context is still usable, but deleteKey reports the error.
+                context->InitKeyRevocationRegistry(kSoftKeyRevocationRegistryPath);
                 return context;
             } (), kOperationTableSize)), profile_(KeymasterHardwareProfile::SW) {}
 
@@ -502,8 +504,9 @@ IKeymasterDevice* CreateKeymasterDevice(keymaster2_device_t* km2_device) {
     context->SetSystemVersion(GetOsVersion(), GetOsPatchlevel());
     return new AndroidKeymaster3Device(context, KeymasterHardwareProfile::KM2);
 }
-IKeymasterDevice* CreateKeymasterDevice(keymaster1_device_t* km1_device) {
-    auto context = new Keymaster1PassthroughContext(km1_device);
+IKeymasterDevice* CreateKeymasterDevice(keymaster1_device_t* km1_device,
+                                        size_t max_concurrent_device_calls) {
+    auto context = new Keymaster1PassthroughContext(km1_device, max_concurrent_device_calls);
     context->SetSystemVersion(GetOsVersion(), GetOsPatchlevel());
     return new AndroidKeymaster3Device(context, KeymasterHardwareProfile::KM1);
 }
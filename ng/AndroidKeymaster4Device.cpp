@@ -214,6 +214,8 @@ AndroidKeymaster4Device::AndroidKeymaster4Device(SecurityLevel securityLevel)
           []() -> auto {
               auto context = new PureSoftKeymasterContext();
               context->SetSystemVersion(GetOsVersion(), GetOsPatchlevel());
+              // On failure the context is still usable, but deleteKey reports the error.
+              context->InitKeyRevocationRegistry(kSoftKeyRevocationRegistryPath);
               return context;
           }(),
           kOperationTableSize)), securityLevel_(securityLevel) {}
@@ -98,7 +98,10 @@ class AndroidKeymaster3Device : public IKeymasterDevice {
 IKeymasterDevice* CreateKeymasterDevice();
 
 IKeymasterDevice* CreateKeymasterDevice(keymaster2_device_t* km2_device);
-IKeymasterDevice* CreateKeymasterDevice(keymaster1_device_t* km1_device);
+// max_concurrent_device_calls limits the calls that the Keymaster1Engine makes into km1_device at
+// once; see Keymaster1Engine.
+IKeymasterDevice* CreateKeymasterDevice(keymaster1_device_t* km1_device,
+                                        size_t max_concurrent_device_calls = 1);
 IKeymasterDevice* CreateKeymasterDevice(keymaster0_device_t* km0_device);
 
 }  // namespace ng
@@ -561,6 +561,108 @@ TEST(RoundTrip, AbortOperationResponse) {
     }
 }
 
+TEST(RoundTrip, CloneOperationRequest) {
+    for (int ver = 0; ver <= MAX_MESSAGE_VERSION; ++ver) {
+        CloneOperationRequest msg(ver);
+        msg.op_handle = 0xDEADBEEF;
+        msg.additional_params.push_back(Authorization(TAG_APPLICATION_ID, "foo", 3));
+
+        UniquePtr<CloneOperationRequest> deserialized(round_trip(ver, msg, 35));
+        EXPECT_EQ(0xDEADBEEF, deserialized->op_handle);
+        EXPECT_EQ(msg.additional_params, deserialized->additional_params);
+    }
+}
+
+TEST(RoundTrip, CloneOperationResponse) {
+    for (int ver = 0; ver <= MAX_MESSAGE_VERSION; ++ver) {
+        CloneOperationResponse msg(ver);
+        msg.error = KM_ERROR_OK;
+        msg.op_handle = 0xDEADBEEF;
+
+        UniquePtr<CloneOperationResponse> deserialized(round_trip(ver, msg, 12));
+        EXPECT_EQ(KM_ERROR_OK, deserialized->error);
+        EXPECT_EQ(0xDEADBEEF, deserialized->op_handle);
+    }
+}
+
+TEST(RoundTrip, BatchAeadOperationRequest) {
+    const uint8_t nonce[12] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    for (int ver = 0; ver <= MAX_MESSAGE_VERSION; ++ver) {
+        BatchAeadOperationRequest msg(ver);
+        msg.purpose = KM_PURPOSE_DECRYPT;
+        msg.key_blob = KeymasterKeyBlob(reinterpret_cast<const uint8_t*>("foo"), 3);
+        msg.additional_params.push_back(Authorization(TAG_APPLICATION_ID, "foo", 3));
+        ASSERT_TRUE(msg.SetRecordCount(2));
+        msg.records[0].nonce = KeymasterBlob(nonce);
+        msg.records[0].associated_data = KeymasterBlob(reinterpret_cast<const uint8_t*>("aad"), 3);
+        msg.records[0].input.Reinitialize("hello", 5);
+
+        UniquePtr<BatchAeadOperationRequest> deserialized(round_trip(ver, msg, 86));
+        EXPECT_EQ(KM_PURPOSE_DECRYPT, deserialized->purpose);
+        EXPECT_EQ(3U, deserialized->key_blob.key_material_size);
+        EXPECT_EQ(msg.additional_params, deserialized->additional_params);
+        ASSERT_EQ(2U, deserialized->record_count);
+        const AeadRecord& record = deserialized->records[0];
+        ASSERT_EQ(sizeof(nonce), record.nonce.data_length);
+        EXPECT_EQ(0, memcmp(nonce, record.nonce.data, sizeof(nonce)));
+        ASSERT_EQ(3U, record.associated_data.data_length);
+        EXPECT_EQ(0, memcmp("aad", record.associated_data.data, 3));
+        ASSERT_EQ(5U, record.input.available_read());
+        EXPECT_EQ(0, memcmp("hello", record.input.peek_read(), 5));
+        EXPECT_EQ(0U, deserialized->records[1].nonce.data_length);
+        EXPECT_EQ(0U, deserialized->records[1].input.available_read());
+    }
+}
+
+TEST(RoundTrip, BatchAeadOperationResponse) {
+    const uint8_t nonce[12] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    for (int ver = 0; ver <= MAX_MESSAGE_VERSION; ++ver) {
+        BatchAeadOperationResponse msg(ver);
+        msg.error = KM_ERROR_OK;
+        ASSERT_TRUE(msg.SetResultCount(2));
+        msg.results[0].nonce = KeymasterBlob(nonce);
+        msg.results[0].output.Reinitialize("hello", 5);
+        msg.results[1].error = KM_ERROR_VERIFICATION_FAILED;
+
+        UniquePtr<BatchAeadOperationResponse> deserialized(round_trip(ver, msg, 49));
+        ASSERT_EQ(2U, deserialized->result_count);
+        EXPECT_EQ(KM_ERROR_OK, deserialized->results[0].error);
+        ASSERT_EQ(sizeof(nonce), deserialized->results[0].nonce.data_length);
+        ASSERT_EQ(5U, deserialized->results[0].output.available_read());
+        EXPECT_EQ(0, memcmp("hello", deserialized->results[0].output.peek_read(), 5));
+        EXPECT_EQ(KM_ERROR_VERIFICATION_FAILED, deserialized->results[1].error);
+    }
+}
+
+TEST(RoundTrip, ProcessRecordRequest) {
+    for (int ver = 0; ver <= MAX_MESSAGE_VERSION; ++ver) {
+        ProcessRecordRequest msg(ver);
+        msg.op_handle = 0xDEADBEEF;
+        msg.input.Reinitialize("hello", 5);
+        msg.additional_params.push_back(Authorization(TAG_ASSOCIATED_DATA, "aad", 3));
+
+        UniquePtr<ProcessRecordRequest> deserialized(round_trip(ver, msg, 44));
+        EXPECT_EQ(0xDEADBEEF, deserialized->op_handle);
+        ASSERT_EQ(5U, deserialized->input.available_read());
+        EXPECT_EQ(0, memcmp("hello", deserialized->input.peek_read(), 5));
+        EXPECT_EQ(msg.additional_params, deserialized->additional_params);
+    }
+}
+
+TEST(RoundTrip, ProcessRecordResponse) {
+    for (int ver = 0; ver <= MAX_MESSAGE_VERSION; ++ver) {
+        ProcessRecordResponse msg(ver);
+        msg.error = KM_ERROR_OK;
+        msg.sequence_number = 0x0102030405060708;
+        msg.output.Reinitialize("hello", 5);
+
+        UniquePtr<ProcessRecordResponse> deserialized(round_trip(ver, msg, 21));
+        EXPECT_EQ(0x0102030405060708U, deserialized->sequence_number);
+        ASSERT_EQ(5U, deserialized->output.available_read());
+        EXPECT_EQ(0, memcmp("hello", deserialized->output.peek_read(), 5));
+    }
+}
+
 TEST(RoundTrip, AttestKeyRequest) {
     for (int ver = 0; ver <= MAX_MESSAGE_VERSION; ++ver) {
         AttestKeyRequest msg(ver);
@@ -625,6 +727,102 @@ TEST(RoundTrip, UpgradeKeyResponse) {
     }
 }
 
+TEST(Buffer, AppendGrowsGeometrically) {
+    Buffer buf;
+    uint8_t byte = 0;
+    size_t reallocations = 0;
+    size_t last_size = buf.buffer_size();
+    for (size_t i = 0; i < 4096; ++i) {
+        ASSERT_TRUE(buf.reserve(1));
+        ASSERT_TRUE(buf.write(&byte, 1));
+        if (buf.buffer_size() != last_size) {
+            ++reallocations;
+            last_size = buf.buffer_size();
+        }
+        byte++;
+    }
+    EXPECT_EQ(4096U, buf.available_read());
+    EXPECT_GE(13U, reallocations);
+    for (size_t i = 0; i < 4096; ++i)
+        EXPECT_EQ(static_cast<uint8_t>(i), buf.peek_read()[i]);
+}
+
+TEST(Buffer, ReserveReclaimsConsumedSpace) {
+    Buffer buf(8);
+    const uint8_t data[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    ASSERT_TRUE(buf.write(data, sizeof(data)));
+    uint8_t out[6];
+    ASSERT_TRUE(buf.read(out, sizeof(out)));
+
+    ASSERT_TRUE(buf.reserve(6));
+    EXPECT_EQ(8U, buf.buffer_size());
+    EXPECT_EQ(2U, buf.available_read());
+    EXPECT_EQ(7, buf.peek_read()[0]);
+    EXPECT_EQ(8, buf.peek_read()[1]);
+    EXPECT_EQ(6U, buf.available_write());
+}
+
+TEST(Buffer, GatherWrite) {
+    const uint8_t first[] = {1, 2, 3};
+    const uint8_t second[] = {4, 5};
+    Buffer buf;
+    BufferSegment segments[] = {{first, sizeof(first)}, {nullptr, 0}, {second, sizeof(second)}};
+    ASSERT_TRUE(buf.write(segments, array_length(segments)));
+
+    BufferSegment view = buf.read_segment();
+    ASSERT_EQ(5U, view.data_length);
+    const uint8_t expected[] = {1, 2, 3, 4, 5};
+    EXPECT_EQ(0, memcmp(expected, view.data, view.data_length));
+}
+
+TEST(Buffer, BorrowedIsReadOnlyView) {
+    const uint8_t data[] = {1, 2, 3, 4};
+    Buffer buf;
+    ASSERT_TRUE(buf.ReinitializeBorrowed(data, sizeof(data)));
+    EXPECT_TRUE(buf.is_borrowed());
+    EXPECT_EQ(data, buf.peek_read());
+    EXPECT_EQ(sizeof(data), buf.available_read());
+    EXPECT_EQ(0U, buf.available_write());
+    EXPECT_FALSE(buf.write(data, 1));
+
+    uint8_t out[2];
+    ASSERT_TRUE(buf.read(out, sizeof(out)));
+    EXPECT_EQ(0, memcmp(data, out, sizeof(out)));
+    buf.Clear();
+    EXPECT_FALSE(buf.is_borrowed());
+    EXPECT_EQ(1, data[0]);
+}
+
+TEST(Buffer, BorrowedCopiesOnWrite) {
+    const uint8_t data[] = {1, 2, 3, 4};
+    const uint8_t more[] = {5, 6};
+    Buffer buf;
+    ASSERT_TRUE(buf.ReinitializeBorrowed(data, sizeof(data)));
+    ASSERT_TRUE(buf.advance_read(1));
+    ASSERT_TRUE(buf.reserve(sizeof(more)));
+    EXPECT_FALSE(buf.is_borrowed());
+    ASSERT_TRUE(buf.write(more, sizeof(more)));
+
+    const uint8_t expected[] = {2, 3, 4, 5, 6};
+    ASSERT_EQ(sizeof(expected), buf.available_read());
+    EXPECT_EQ(0, memcmp(expected, buf.peek_read(), sizeof(expected)));
+    EXPECT_EQ(1, data[0]);
+    EXPECT_EQ(4, data[3]);
+}
+
+TEST(Buffer, BorrowedSerializesLikeCopy) {
+    const uint8_t data[] = {1, 2, 3, 4};
+    Buffer borrowed;
+    ASSERT_TRUE(borrowed.ReinitializeBorrowed(data, sizeof(data)));
+    Buffer copied(data, sizeof(data));
+    ASSERT_EQ(copied.SerializedSize(), borrowed.SerializedSize());
+
+    uint8_t borrowed_buf[8], copied_buf[8];
+    EXPECT_EQ(borrowed_buf + 8, borrowed.Serialize(borrowed_buf, borrowed_buf + 8));
+    EXPECT_EQ(copied_buf + 8, copied.Serialize(copied_buf, copied_buf + 8));
+    EXPECT_EQ(0, memcmp(borrowed_buf, copied_buf, 8));
+}
+
 uint8_t msgbuf[] = {
     220, 88,  183, 255, 71,  1,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
     0,   173, 0,   0,   0,   228, 174, 98,  187, 191, 135, 253, 200, 51,  230, 114, 247, 151, 109,
@@ -697,8 +895,12 @@ GARBAGE_TEST(AbortOperationRequest);
 GARBAGE_TEST(AbortOperationResponse);
 GARBAGE_TEST(AddEntropyRequest);
 GARBAGE_TEST(AddEntropyResponse);
+GARBAGE_TEST(BatchAeadOperationRequest);
+GARBAGE_TEST(BatchAeadOperationResponse);
 GARBAGE_TEST(BeginOperationRequest);
 GARBAGE_TEST(BeginOperationResponse);
+GARBAGE_TEST(CloneOperationRequest);
+GARBAGE_TEST(CloneOperationResponse);
 GARBAGE_TEST(DeleteAllKeysRequest);
 GARBAGE_TEST(DeleteAllKeysResponse);
 GARBAGE_TEST(DeleteKeyRequest);
@@ -713,6 +915,8 @@ GARBAGE_TEST(GetKeyCharacteristicsRequest);
 GARBAGE_TEST(GetKeyCharacteristicsResponse);
 GARBAGE_TEST(ImportKeyRequest);
 GARBAGE_TEST(ImportKeyResponse);
+GARBAGE_TEST(ProcessRecordRequest);
+GARBAGE_TEST(ProcessRecordResponse);
 GARBAGE_TEST(SupportedByAlgorithmAndPurposeRequest)
 GARBAGE_TEST(SupportedByAlgorithmRequest)
 GARBAGE_TEST(UpdateOperationRequest);
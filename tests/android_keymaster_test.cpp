@@ -14,28 +14,42 @@
  * limitations under the License.
  */
 
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include <openssl/ecdh.h>
 #include <openssl/evp.h>
 #include <openssl/x509.h>
 
 #include <hardware/keymaster0.h>
 
+#include <keymaster/allocation_tracker.h>
 #include <keymaster/android_keymaster.h>
 #include <keymaster/attestation_record.h>
+#include <keymaster/contexts/keymaster1_passthrough_context.h>
+#include <keymaster/contexts/keymaster2_passthrough_context.h>
 #include <keymaster/contexts/pure_soft_keymaster_context.h>
 #include <keymaster/contexts/soft_keymaster_context.h>
+#include <keymaster/key_blob_utils/integrity_assured_key_blob.h>
+#include <keymaster/key_blob_utils/software_keyblobs.h>
 #include <keymaster/key_factory.h>
+#include <keymaster/km_openssl/ec_key.h>
 #include <keymaster/km_openssl/hmac_key.h>
 #include <keymaster/km_openssl/openssl_utils.h>
+#include <keymaster/km_openssl/rsa_key.h>
 #include <keymaster/km_openssl/soft_keymaster_enforcement.h>
 #include <keymaster/legacy_support/keymaster0_engine.h>
+#include <keymaster/legacy_support/keymaster1_engine.h>
 #include <keymaster/soft_keymaster_device.h>
 
+#include "../legacy_support/ecdsa_keymaster1_operation.h"
 #include "android_keymaster_test_utils.h"
+#include "simulated_keymaster_device.h"
 
 using std::ifstream;
 using std::istreambuf_iterator;
@@ -354,6 +368,28 @@ TEST_P(NewKeyGeneration, EcdsaAllValidSizes) {
         EXPECT_EQ(4, GetParam()->keymaster0_calls());
 }
 
+TEST_P(NewKeyGeneration, Ed25519) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().Ed25519SigningKey().Digest(KM_DIGEST_NONE)));
+    CheckBaseParams();
+
+    // Ed25519 keys are always software keys.
+    EXPECT_EQ(0U, hw_enforced().size());
+    EXPECT_TRUE(contains(sw_enforced(), TAG_ALGORITHM, KM_ALGORITHM_EC));
+    EXPECT_TRUE(contains(sw_enforced(), TAG_EC_CURVE, KM_EC_CURVE_CURVE_25519));
+    EXPECT_TRUE(contains(sw_enforced(), TAG_KEY_SIZE, 256));
+
+    EXPECT_EQ(0, GetParam()->keymaster0_calls());
+}
+
+TEST_P(NewKeyGeneration, Ed25519MismatchKeySize) {
+    ASSERT_EQ(KM_ERROR_INVALID_ARGUMENT,
+              GenerateKey(AuthorizationSetBuilder()
+                              .Ed25519SigningKey()
+                              .Authorization(TAG_KEY_SIZE, 224)
+                              .Digest(KM_DIGEST_NONE)));
+}
+
 TEST_P(NewKeyGeneration, HmacSha256) {
     ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
                                            .HmacKey(128)
@@ -759,6 +795,44 @@ TEST_P(SigningOperationsTest, EcdsaAllSizesAndHashes) {
                   static_cast<size_t>(GetParam()->keymaster0_calls()));
 }
 
+TEST_P(SigningOperationsTest, Ed25519Success) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().Ed25519SigningKey().Digest(KM_DIGEST_NONE)));
+    string message(1024, 'a');
+    string signature;
+    SignMessage(message, &signature, KM_DIGEST_NONE);
+    EXPECT_EQ(64U, signature.size());
+
+    // Ed25519 signatures are deterministic.
+    string signature2;
+    SignMessage(message, &signature2, KM_DIGEST_NONE);
+    EXPECT_EQ(signature, signature2);
+
+    EXPECT_EQ(0, GetParam()->keymaster0_calls());
+}
+
+TEST_P(SigningOperationsTest, Ed25519DigestUnsupported) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
+                                           .Ed25519SigningKey()
+                                           .Digest(KM_DIGEST_NONE)
+                                           .Digest(KM_DIGEST_SHA_2_256)));
+    AuthorizationSet begin_params(client_params());
+    begin_params.push_back(TAG_DIGEST, KM_DIGEST_SHA_2_256);
+    EXPECT_EQ(KM_ERROR_UNSUPPORTED_DIGEST, BeginOperation(KM_PURPOSE_SIGN, begin_params));
+}
+
+TEST_P(SigningOperationsTest, Ed25519MessageTooLong) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().Ed25519SigningKey().Digest(KM_DIGEST_NONE)));
+    AuthorizationSet begin_params(client_params());
+    begin_params.push_back(TAG_DIGEST, KM_DIGEST_NONE);
+    ASSERT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_SIGN, begin_params));
+    string result;
+    size_t input_consumed;
+    EXPECT_EQ(KM_ERROR_INVALID_INPUT_LENGTH,
+              UpdateOperation(string(16 * 1024 + 1, 'a'), &result, &input_consumed));
+}
+
 TEST_P(SigningOperationsTest, AesEcbSign) {
     ASSERT_EQ(KM_ERROR_OK,
               GenerateKey(AuthorizationSetBuilder().AesEncryptionKey(128).Authorization(
@@ -1468,6 +1542,49 @@ TEST_P(VerificationOperationsTest, EcdsaAllDigestsAndKeySizes) {
                   GetParam()->keymaster0_calls());
 }
 
+TEST_P(VerificationOperationsTest, Ed25519Success) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().Ed25519SigningKey().Digest(KM_DIGEST_NONE)));
+    string message = "12345678901234567890123456789012";
+    string signature;
+    SignMessage(message, &signature, KM_DIGEST_NONE);
+    VerifyMessage(message, signature, KM_DIGEST_NONE);
+
+    EXPECT_EQ(0, GetParam()->keymaster0_calls());
+}
+
+TEST_P(VerificationOperationsTest, Ed25519CorruptSignature) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().Ed25519SigningKey().Digest(KM_DIGEST_NONE)));
+    string message(1024, 'a');
+    string signature;
+    SignMessage(message, &signature, KM_DIGEST_NONE);
+    ++signature[signature.size() / 2];
+
+    AuthorizationSet begin_params(client_params());
+    begin_params.push_back(TAG_DIGEST, KM_DIGEST_NONE);
+    EXPECT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_VERIFY, begin_params));
+
+    string result;
+    EXPECT_EQ(KM_ERROR_VERIFICATION_FAILED, FinishOperation(message, signature, &result));
+}
+
+TEST_P(VerificationOperationsTest, Ed25519TruncatedSignature) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().Ed25519SigningKey().Digest(KM_DIGEST_NONE)));
+    string message(1024, 'a');
+    string signature;
+    SignMessage(message, &signature, KM_DIGEST_NONE);
+    signature.resize(signature.size() - 1);
+
+    AuthorizationSet begin_params(client_params());
+    begin_params.push_back(TAG_DIGEST, KM_DIGEST_NONE);
+    EXPECT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_VERIFY, begin_params));
+
+    string result;
+    EXPECT_EQ(KM_ERROR_VERIFICATION_FAILED, FinishOperation(message, signature, &result));
+}
+
 TEST_P(VerificationOperationsTest, HmacSha1Success) {
     GenerateKey(AuthorizationSetBuilder()
                     .HmacKey(128)
@@ -1588,6 +1705,36 @@ TEST_P(ExportKeyTest, EcdsaSuccess) {
         EXPECT_EQ(2, GetParam()->keymaster0_calls());
 }
 
+TEST_P(ExportKeyTest, Ed25519Success) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().Ed25519SigningKey().Digest(KM_DIGEST_NONE)));
+    string export_data;
+    ASSERT_EQ(KM_ERROR_OK, ExportKey(KM_KEY_FORMAT_X509, &export_data));
+    // SubjectPublicKeyInfo for Ed25519 is a 12-byte header followed by the raw public key.
+    EXPECT_EQ(44U, export_data.size());
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(export_data.data());
+    EVP_PKEY_Ptr pkey(d2i_PUBKEY(nullptr /* out */, &p, export_data.size()));
+    ASSERT_TRUE(pkey.get() != nullptr);
+    EXPECT_EQ(EVP_PKEY_ED25519, EVP_PKEY_id(pkey.get()));
+}
+
+TEST_P(ExportKeyTest, RepeatedExport) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().EcdsaSigningKey(224).Digest(KM_DIGEST_NONE)));
+    string export_data;
+    ASSERT_EQ(KM_ERROR_OK, ExportKey(KM_KEY_FORMAT_X509, &export_data));
+    string second_export_data;
+    ASSERT_EQ(KM_ERROR_OK, ExportKey(KM_KEY_FORMAT_X509, &second_export_data));
+    EXPECT_EQ(export_data, second_export_data);
+
+    // A previous successful export mustn't let a caller with the wrong application ID export.
+    keymaster_blob_t wrong_client_id = {reinterpret_cast<const uint8_t*>("app_ie"), 6};
+    EXPECT_EQ(KM_ERROR_INVALID_KEY_BLOB,
+              ExportKey(KM_KEY_FORMAT_X509, wrong_client_id, &second_export_data));
+    EXPECT_EQ(KM_ERROR_UNSUPPORTED_KEY_FORMAT, ExportKey(KM_KEY_FORMAT_PKCS8, &export_data));
+}
+
 TEST_P(ExportKeyTest, RsaUnsupportedKeyFormat) {
     ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
                                            .RsaSigningKey(256, 3)
@@ -1773,6 +1920,52 @@ TEST_P(ImportKeyTest, EcdsaSizeMismatch) {
     EXPECT_EQ(0, GetParam()->keymaster0_calls());
 }
 
+// Test 1 from RFC 8032 section 7.1, wrapped in PKCS#8.
+static const string ed25519_pk8_key = hex2str(
+    "302e020100300506032b657004220420"
+    "9d61b19deffd5a60ba844af492ec2cc44449c5697b326919703bac031cae7f60");
+static const string ed25519_public_key =
+    hex2str("d75a980182b10ab7d54bfed3c964073a0ee172f3daa62325af021a68f707511a");
+static const string ed25519_empty_message_signature =
+    hex2str("e5564300c360ac729086e2cc806e828a84877f1eb8e5d974d873e06522490155"
+            "5fb8821590a33bacc61e39701cf9b46bd25bf5f0595bbe24655141438e7a100b");
+
+TEST_P(ImportKeyTest, Ed25519Success) {
+    ASSERT_EQ(KM_ERROR_OK, ImportKey(AuthorizationSetBuilder()
+                                         .Authorization(TAG_ALGORITHM, KM_ALGORITHM_EC)
+                                         .Authorization(TAG_EC_CURVE, KM_EC_CURVE_CURVE_25519)
+                                         .SigningKey()
+                                         .Digest(KM_DIGEST_NONE),
+                                     KM_KEY_FORMAT_PKCS8, ed25519_pk8_key));
+
+    EXPECT_TRUE(contains(sw_enforced(), TAG_ALGORITHM, KM_ALGORITHM_EC));
+    EXPECT_TRUE(contains(sw_enforced(), TAG_EC_CURVE, KM_EC_CURVE_CURVE_25519));
+    EXPECT_TRUE(contains(sw_enforced(), TAG_KEY_SIZE, 256));
+    EXPECT_TRUE(contains(sw_enforced(), TAG_ORIGIN, KM_ORIGIN_IMPORTED));
+
+    string signature;
+    SignMessage("", &signature, KM_DIGEST_NONE);
+    EXPECT_EQ(ed25519_empty_message_signature, signature);
+    VerifyMessage("", signature, KM_DIGEST_NONE);
+
+    string export_data;
+    ASSERT_EQ(KM_ERROR_OK, ExportKey(KM_KEY_FORMAT_X509, &export_data));
+    ASSERT_EQ(44U, export_data.size());
+    EXPECT_EQ(ed25519_public_key, export_data.substr(12));
+
+    EXPECT_EQ(0, GetParam()->keymaster0_calls());
+}
+
+TEST_P(ImportKeyTest, Ed25519CurveMismatch) {
+    ASSERT_EQ(KM_ERROR_IMPORT_PARAMETER_MISMATCH,
+              ImportKey(AuthorizationSetBuilder()
+                            .Authorization(TAG_ALGORITHM, KM_ALGORITHM_EC)
+                            .Authorization(TAG_EC_CURVE, KM_EC_CURVE_P_256)
+                            .SigningKey()
+                            .Digest(KM_DIGEST_NONE),
+                        KM_KEY_FORMAT_PKCS8, ed25519_pk8_key));
+}
+
 TEST_P(ImportKeyTest, AesKeySuccess) {
     char key_data[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     string key(key_data, sizeof(key_data));
@@ -2059,106 +2252,872 @@ TEST_F(ImportWrappedKeyTest, WrongPurpose) {
     EXPECT_EQ(response.error, KM_ERROR_INCOMPATIBLE_PURPOSE);
 }
 
-typedef Keymaster2Test EncryptionOperationsTest;
-INSTANTIATE_TEST_CASE_P(AndroidKeymasterTest, EncryptionOperationsTest, test_params);
+/**
+ * Drives a configured, pure software AndroidKeymaster directly through its request and response
+ * messages.
+ */
+class AndroidKeymasterMessageTest : public testing::Test {
+  public:
+    AndroidKeymasterMessageTest() : keymaster_(new PureSoftKeymasterContext(), 16) {}
 
-TEST_P(EncryptionOperationsTest, RsaNoPaddingSuccess) {
-    ASSERT_EQ(KM_ERROR_OK,
-              GenerateKey(AuthorizationSetBuilder().RsaEncryptionKey(256, 3).Padding(KM_PAD_NONE)));
+  protected:
+    void SetUp() override {
+        ConfigureRequest configReq;
+        configReq.os_version = kOsVersion;
+        configReq.os_patchlevel = kOsPatchLevel;
+        ConfigureResponse configRsp;
+        keymaster_.Configure(configReq, &configRsp);
+        EXPECT_EQ(KM_ERROR_OK, configRsp.error);
+    }
 
-    string message = "12345678901234567890123456789012";
-    string ciphertext1 = EncryptMessage(string(message), KM_PAD_NONE);
-    EXPECT_EQ(256U / 8, ciphertext1.size());
+    keymaster_error_t GenerateKey(const AuthorizationSetBuilder& builder) {
+        GenerateKeyRequest req;
+        req.key_description.Reinitialize(
+            AuthorizationSetBuilder(builder).Authorization(TAG_NO_AUTH_REQUIRED).build());
+        GenerateKeyResponse rsp;
+        keymaster_.GenerateKey(req, &rsp);
+        blob_ = KeymasterKeyBlob(rsp.key_blob);
+        return rsp.error;
+    }
 
-    string ciphertext2 = EncryptMessage(string(message), KM_PAD_NONE);
-    EXPECT_EQ(256U / 8, ciphertext2.size());
+    keymaster_error_t Begin(keymaster_purpose_t purpose, const AuthorizationSet& params,
+                            keymaster_operation_handle_t* op_handle) {
+        BeginOperationRequest req;
+        req.purpose = purpose;
+        req.SetKeyMaterial(blob_);
+        req.additional_params = params;
+        BeginOperationResponse rsp;
+        keymaster_.BeginOperation(req, &rsp);
+        *op_handle = rsp.op_handle;
+        return rsp.error;
+    }
 
-    // Unpadded RSA is deterministic
-    EXPECT_EQ(ciphertext1, ciphertext2);
+    keymaster_error_t Update(keymaster_operation_handle_t op_handle, const string& input) {
+        UpdateOperationRequest req;
+        req.op_handle = op_handle;
+        req.input.Reinitialize(input.data(), input.size());
+        UpdateOperationResponse rsp;
+        keymaster_.UpdateOperation(req, &rsp);
+        EXPECT_EQ(input.size(), rsp.input_consumed);
+        return rsp.error;
+    }
 
-    if (GetParam()->algorithm_in_km0_hardware(KM_ALGORITHM_RSA))
-        EXPECT_EQ(3, GetParam()->keymaster0_calls());
-}
+    keymaster_error_t Finish(keymaster_operation_handle_t op_handle, const string& input,
+                             const string& signature, string* output) {
+        FinishOperationRequest req;
+        req.op_handle = op_handle;
+        req.input.Reinitialize(input.data(), input.size());
+        req.signature.Reinitialize(signature.data(), signature.size());
+        FinishOperationResponse rsp;
+        keymaster_.FinishOperation(req, &rsp);
+        if (output)
+            *output = string(reinterpret_cast<const char*>(rsp.output.peek_read()),
+                             rsp.output.available_read());
+        return rsp.error;
+    }
 
-TEST_P(EncryptionOperationsTest, RsaNoPaddingTooShort) {
-    ASSERT_EQ(KM_ERROR_OK,
-              GenerateKey(AuthorizationSetBuilder().RsaEncryptionKey(256, 3).Padding(KM_PAD_NONE)));
+    string Sign(const AuthorizationSet& params, const string& message) {
+        keymaster_operation_handle_t op_handle;
+        EXPECT_EQ(KM_ERROR_OK, Begin(KM_PURPOSE_SIGN, params, &op_handle));
+        string signature;
+        EXPECT_EQ(KM_ERROR_OK, Finish(op_handle, message, "", &signature));
+        return signature;
+    }
 
-    string message = "1";
+    keymaster_error_t Verify(const AuthorizationSet& params, const string& message,
+                             const string& signature) {
+        keymaster_operation_handle_t op_handle;
+        keymaster_error_t error = Begin(KM_PURPOSE_VERIFY, params, &op_handle);
+        if (error != KM_ERROR_OK)
+            return error;
+        return Finish(op_handle, message, signature, nullptr /* output */);
+    }
 
-    string ciphertext = EncryptMessage(message, KM_PAD_NONE);
-    EXPECT_EQ(256U / 8, ciphertext.size());
+    AndroidKeymaster keymaster_;
+    KeymasterKeyBlob blob_;
+};
 
-    string expected_plaintext = string(256 / 8 - 1, 0) + message;
-    string plaintext = DecryptMessage(ciphertext, KM_PAD_NONE);
+class CloneOperationTest : public AndroidKeymasterMessageTest {
+  protected:
+    keymaster_error_t Clone(keymaster_operation_handle_t op_handle,
+                            keymaster_operation_handle_t* clone_handle) {
+        CloneOperationRequest req;
+        req.op_handle = op_handle;
+        CloneOperationResponse rsp;
+        keymaster_.CloneOperation(req, &rsp);
+        *clone_handle = rsp.op_handle;
+        return rsp.error;
+    }
 
-    EXPECT_EQ(expected_plaintext, plaintext);
+    // Signs |prefix| + |suffix1| and |prefix| + |suffix2| by cloning an operation that has
+    // processed |prefix|.
+    void SignWithClone(const AuthorizationSet& params, const string& prefix,
+                       const string& suffix1, const string& suffix2, string* signature1,
+                       string* signature2) {
+        keymaster_operation_handle_t op_handle, clone_handle;
+        ASSERT_EQ(KM_ERROR_OK, Begin(KM_PURPOSE_SIGN, params, &op_handle));
+        ASSERT_EQ(KM_ERROR_OK, Update(op_handle, prefix));
+        ASSERT_EQ(KM_ERROR_OK, Clone(op_handle, &clone_handle));
+        EXPECT_NE(op_handle, clone_handle);
+        EXPECT_EQ(KM_ERROR_OK, Finish(op_handle, suffix1, "", signature1));
+        EXPECT_EQ(KM_ERROR_OK, Finish(clone_handle, suffix2, "", signature2));
+    }
+};
 
-    if (GetParam()->algorithm_in_km0_hardware(KM_ALGORITHM_RSA))
-        EXPECT_EQ(4, GetParam()->keymaster0_calls());
+TEST_F(CloneOperationTest, Hmac) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
+                                           .HmacKey(128)
+                                           .Digest(KM_DIGEST_SHA_2_256)
+                                           .Authorization(TAG_MIN_MAC_LENGTH, 256)));
+    AuthorizationSet params(
+        AuthorizationSetBuilder().Digest(KM_DIGEST_SHA_2_256).Authorization(TAG_MAC_LENGTH, 256));
+
+    string prefix(1000, 'p');
+    string mac1, mac2;
+    SignWithClone(params, prefix, "first", "second", &mac1, &mac2);
+    EXPECT_EQ(Sign(params, prefix + "first"), mac1);
+    EXPECT_EQ(Sign(params, prefix + "second"), mac2);
 }
 
-TEST_P(EncryptionOperationsTest, RsaNoPaddingTooLong) {
-    ASSERT_EQ(KM_ERROR_OK,
-              GenerateKey(AuthorizationSetBuilder().RsaEncryptionKey(256, 3).Padding(KM_PAD_NONE)));
+TEST_F(CloneOperationTest, HmacVerify) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
+                                           .HmacKey(128)
+                                           .Digest(KM_DIGEST_SHA_2_256)
+                                           .Authorization(TAG_MIN_MAC_LENGTH, 256)));
+    AuthorizationSet sign_params(
+        AuthorizationSetBuilder().Digest(KM_DIGEST_SHA_2_256).Authorization(TAG_MAC_LENGTH, 256));
+    AuthorizationSet verify_params(AuthorizationSetBuilder().Digest(KM_DIGEST_SHA_2_256));
+    string prefix(1000, 'p');
+    string mac = Sign(sign_params, prefix + "suffix");
 
-    string message = "123456789012345678901234567890123";
+    keymaster_operation_handle_t op_handle, clone_handle;
+    ASSERT_EQ(KM_ERROR_OK, Begin(KM_PURPOSE_VERIFY, verify_params, &op_handle));
+    ASSERT_EQ(KM_ERROR_OK, Update(op_handle, prefix));
+    ASSERT_EQ(KM_ERROR_OK, Clone(op_handle, &clone_handle));
+    EXPECT_EQ(KM_ERROR_VERIFICATION_FAILED, Finish(op_handle, "other", mac, nullptr));
+    EXPECT_EQ(KM_ERROR_OK, Finish(clone_handle, "suffix", mac, nullptr));
+}
 
-    AuthorizationSet begin_params(client_params());
-    begin_params.push_back(TAG_PADDING, KM_PAD_NONE);
-    EXPECT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_ENCRYPT, begin_params));
+TEST_F(CloneOperationTest, Rsa) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
+                                           .RsaSigningKey(1024, 65537)
+                                           .Digest(KM_DIGEST_SHA_2_256)
+                                           .Digest(KM_DIGEST_NONE)
+                                           .Padding(KM_PAD_RSA_PSS)
+                                           .Padding(KM_PAD_NONE)));
+    AuthorizationSet params(
+        AuthorizationSetBuilder().Digest(KM_DIGEST_SHA_2_256).Padding(KM_PAD_RSA_PSS));
+    string prefix(1000, 'p');
+    string signature1, signature2;
+    SignWithClone(params, prefix, "first", "second", &signature1, &signature2);
+    EXPECT_EQ(KM_ERROR_OK, Verify(params, prefix + "first", signature1));
+    EXPECT_EQ(KM_ERROR_OK, Verify(params, prefix + "second", signature2));
+    EXPECT_EQ(KM_ERROR_VERIFICATION_FAILED, Verify(params, prefix + "first", signature2));
+
+    // Undigested operations clone their buffered input.
+    AuthorizationSet raw_params(
+        AuthorizationSetBuilder().Digest(KM_DIGEST_NONE).Padding(KM_PAD_NONE));
+    prefix = string(1024 / 8 - 1, 'p');
+    SignWithClone(raw_params, prefix, "1", "2", &signature1, &signature2);
+    EXPECT_EQ(Sign(raw_params, prefix + "1"), signature1);
+    EXPECT_EQ(Sign(raw_params, prefix + "2"), signature2);
+}
+
+TEST_F(CloneOperationTest, Ecdsa) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder().EcdsaSigningKey(256).Digest(
+                               KM_DIGEST_SHA_2_256)));
+    AuthorizationSet params(AuthorizationSetBuilder().Digest(KM_DIGEST_SHA_2_256));
+    string prefix(1000, 'p');
+    string signature1, signature2;
+    SignWithClone(params, prefix, "first", "second", &signature1, &signature2);
+    EXPECT_EQ(KM_ERROR_OK, Verify(params, prefix + "first", signature1));
+    EXPECT_EQ(KM_ERROR_OK, Verify(params, prefix + "second", signature2));
+    EXPECT_EQ(KM_ERROR_VERIFICATION_FAILED, Verify(params, prefix + "second", signature1));
+}
 
-    string result;
-    size_t input_consumed;
-    EXPECT_EQ(KM_ERROR_INVALID_INPUT_LENGTH, UpdateOperation(message, &result, &input_consumed));
+TEST_F(CloneOperationTest, CloneCountsAsUse) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
+                                           .HmacKey(128)
+                                           .Digest(KM_DIGEST_SHA_2_256)
+                                           .Authorization(TAG_MIN_MAC_LENGTH, 256)
+                                           .Authorization(TAG_MAX_USES_PER_BOOT, 2)));
+    AuthorizationSet params(
+        AuthorizationSetBuilder().Digest(KM_DIGEST_SHA_2_256).Authorization(TAG_MAC_LENGTH, 256));
 
-    if (GetParam()->algorithm_in_km0_hardware(KM_ALGORITHM_RSA))
-        EXPECT_EQ(2, GetParam()->keymaster0_calls());
+    keymaster_operation_handle_t op_handle, clone_handle;
+    ASSERT_EQ(KM_ERROR_OK, Begin(KM_PURPOSE_SIGN, params, &op_handle));
+    ASSERT_EQ(KM_ERROR_OK, Clone(op_handle, &clone_handle));
+    EXPECT_EQ(KM_ERROR_KEY_MAX_OPS_EXCEEDED, Clone(op_handle, &clone_handle));
+    EXPECT_EQ(0U, clone_handle);
+    EXPECT_EQ(KM_ERROR_KEY_MAX_OPS_EXCEEDED, Begin(KM_PURPOSE_SIGN, params, &op_handle));
 }
 
-TEST_P(EncryptionOperationsTest, RsaNoPaddingLargerThanModulus) {
+TEST_F(CloneOperationTest, Unsupported) {
+    keymaster_operation_handle_t clone_handle;
+    EXPECT_EQ(KM_ERROR_INVALID_OPERATION_HANDLE, Clone(1234, &clone_handle));
+
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
+                                           .AesEncryptionKey(128)
+                                           .EcbMode()
+                                           .Padding(KM_PAD_NONE)));
+    keymaster_operation_handle_t op_handle;
     ASSERT_EQ(KM_ERROR_OK,
-              GenerateKey(AuthorizationSetBuilder().RsaEncryptionKey(256, 3).Padding(KM_PAD_NONE)));
+              Begin(KM_PURPOSE_ENCRYPT,
+                    AuthorizationSet(
+                        AuthorizationSetBuilder().BlockMode(KM_MODE_ECB).Padding(KM_PAD_NONE)),
+                    &op_handle));
+    EXPECT_EQ(KM_ERROR_UNIMPLEMENTED, Clone(op_handle, &clone_handle));
+    // The source operation is unaffected.
+    string ciphertext;
+    EXPECT_EQ(KM_ERROR_OK, Finish(op_handle, string(16, 'a'), "", &ciphertext));
+    EXPECT_EQ(16U, ciphertext.size());
+}
 
-    string exported;
-    ASSERT_EQ(KM_ERROR_OK, ExportKey(KM_KEY_FORMAT_X509, &exported));
+class BatchAeadOperationTest : public AndroidKeymasterMessageTest {
+  protected:
+    struct Record {
+        string nonce;
+        string associated_data;
+        string input;
+    };
 
-    const uint8_t* p = reinterpret_cast<const uint8_t*>(exported.data());
-    unique_ptr<EVP_PKEY, EVP_PKEY_Delete> pkey(
-        d2i_PUBKEY(nullptr /* alloc new */, &p, exported.size()));
-    unique_ptr<RSA, RSA_Delete> rsa(EVP_PKEY_get1_RSA(pkey.get()));
+    static AuthorizationSet GcmParams() {
+        return AuthorizationSetBuilder()
+            .BlockMode(KM_MODE_GCM)
+            .Padding(KM_PAD_NONE)
+            .Authorization(TAG_MAC_LENGTH, 128)
+            .build();
+    }
 
-    size_t modulus_len = BN_num_bytes(rsa->n);
-    ASSERT_EQ(256U / 8, modulus_len);
-    unique_ptr<uint8_t[]> modulus_buf(new uint8_t[modulus_len]);
-    BN_bn2bin(rsa->n, modulus_buf.get());
+    keymaster_error_t GenerateGcmKey(const AuthorizationSetBuilder& extra_params) {
+        return GenerateKey(AuthorizationSetBuilder(extra_params)
+                               .AesEncryptionKey(128)
+                               .Authorization(TAG_BLOCK_MODE, KM_MODE_GCM)
+                               .Authorization(TAG_PADDING, KM_PAD_NONE)
+                               .Authorization(TAG_MIN_MAC_LENGTH, 128));
+    }
 
-    // The modulus is too big to encrypt.
-    string message(reinterpret_cast<const char*>(modulus_buf.get()), modulus_len);
+    keymaster_error_t Batch(keymaster_purpose_t purpose, const AuthorizationSet& params,
+                            const vector<Record>& records, BatchAeadOperationResponse* rsp) {
+        BatchAeadOperationRequest req;
+        req.purpose = purpose;
+        req.key_blob = blob_;
+        req.additional_params = params;
+        EXPECT_TRUE(req.SetRecordCount(records.size()));
+        for (size_t i = 0; i < records.size(); ++i) {
+            const Record& record = records[i];
+            req.records[i].nonce = KeymasterBlob(
+                reinterpret_cast<const uint8_t*>(record.nonce.data()), record.nonce.size());
+            req.records[i].associated_data =
+                KeymasterBlob(reinterpret_cast<const uint8_t*>(record.associated_data.data()),
+                              record.associated_data.size());
+            req.records[i].input.Reinitialize(record.input.data(), record.input.size());
+        }
+        keymaster_.BatchAeadOperation(req, rsp);
+        if (rsp->error == KM_ERROR_OK) {
+            EXPECT_EQ(records.size(), rsp->result_count);
+        }
+        return rsp->error;
+    }
 
-    AuthorizationSet begin_params(client_params());
-    begin_params.push_back(TAG_PADDING, KM_PAD_NONE);
-    EXPECT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_ENCRYPT, begin_params));
+    static string Nonce(const AeadRecordResult& result) {
+        return string(reinterpret_cast<const char*>(result.nonce.data), result.nonce.data_length);
+    }
 
-    string result;
-    size_t input_consumed;
-    EXPECT_EQ(KM_ERROR_OK, UpdateOperation(message, &result, &input_consumed));
-    EXPECT_EQ(KM_ERROR_INVALID_ARGUMENT, FinishOperation(&result));
+    static string Output(const AeadRecordResult& result) {
+        return string(reinterpret_cast<const char*>(result.output.peek_read()),
+                      result.output.available_read());
+    }
+};
 
-    // One smaller than the modulus is okay.
-    BN_sub(rsa->n, rsa->n, BN_value_one());
-    modulus_len = BN_num_bytes(rsa->n);
-    ASSERT_EQ(256U / 8, modulus_len);
-    BN_bn2bin(rsa->n, modulus_buf.get());
-    message = string(reinterpret_cast<const char*>(modulus_buf.get()), modulus_len);
-    EXPECT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_ENCRYPT, begin_params));
-    EXPECT_EQ(KM_ERROR_OK, FinishOperation(message, "", &result));
+TEST_F(BatchAeadOperationTest, SealAndOpen) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateGcmKey(AuthorizationSetBuilder()));
+
+    vector<Record> records = {
+        {"", "", "Hello World!"}, {"", "aad", ""}, {"", "more aad", string(1000, 'x')}};
+    BatchAeadOperationResponse sealed;
+    ASSERT_EQ(KM_ERROR_OK, Batch(KM_PURPOSE_ENCRYPT, GcmParams(), records, &sealed));
+    vector<Record> to_open;
+    for (size_t i = 0; i < records.size(); ++i) {
+        ASSERT_EQ(KM_ERROR_OK, sealed.results[i].error);
+        EXPECT_EQ(12U, sealed.results[i].nonce.data_length);
+        EXPECT_EQ(records[i].input.size() + 16, sealed.results[i].output.available_read());
+        to_open.push_back({Nonce(sealed.results[i]), records[i].associated_data,
+                           Output(sealed.results[i])});
+    }
+    EXPECT_NE(Nonce(sealed.results[0]), Nonce(sealed.results[1]));
 
-    if (GetParam()->algorithm_in_km0_hardware(KM_ALGORITHM_RSA))
-        EXPECT_EQ(4, GetParam()->keymaster0_calls());
-}
+    BatchAeadOperationResponse opened;
+    ASSERT_EQ(KM_ERROR_OK, Batch(KM_PURPOSE_DECRYPT, GcmParams(), to_open, &opened));
+    for (size_t i = 0; i < records.size(); ++i) {
+        EXPECT_EQ(KM_ERROR_OK, opened.results[i].error);
+        EXPECT_EQ(records[i].input, Output(opened.results[i]));
+    }
 
-TEST_P(EncryptionOperationsTest, RsaOaepSuccess) {
+    // A batch record decrypts like any other GCM ciphertext.
+    AuthorizationSet params(GcmParams());
+    params.push_back(TAG_NONCE, sealed.results[0].nonce.data, sealed.results[0].nonce.data_length);
+    keymaster_operation_handle_t op_handle;
+    ASSERT_EQ(KM_ERROR_OK, Begin(KM_PURPOSE_DECRYPT, params, &op_handle));
+    string plaintext;
+    EXPECT_EQ(KM_ERROR_OK, Finish(op_handle, to_open[0].input, "", &plaintext));
+    EXPECT_EQ(records[0].input, plaintext);
+}
+
+TEST_F(BatchAeadOperationTest, PerRecordStatus) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateGcmKey(AuthorizationSetBuilder()));
+
+    vector<Record> records = {{"", "aad", "first"}, {"", "aad", "second"}};
+    BatchAeadOperationResponse sealed;
+    ASSERT_EQ(KM_ERROR_OK, Batch(KM_PURPOSE_ENCRYPT, GcmParams(), records, &sealed));
+
+    string corrupted = Output(sealed.results[1]);
+    corrupted[corrupted.size() - 1] ^= 1;
+    vector<Record> to_open = {
+        {Nonce(sealed.results[0]), "aad", Output(sealed.results[0])},
+        {Nonce(sealed.results[1]), "aad", corrupted},
+        {Nonce(sealed.results[1]), "aad", "short"},
+        {"", "aad", Output(sealed.results[1])},
+        {Nonce(sealed.results[0]), "other aad", Output(sealed.results[0])},
+        {Nonce(sealed.results[1]), "aad", Output(sealed.results[1])},
+    };
+    BatchAeadOperationResponse opened;
+    ASSERT_EQ(KM_ERROR_OK, Batch(KM_PURPOSE_DECRYPT, GcmParams(), to_open, &opened));
+    EXPECT_EQ(KM_ERROR_OK, opened.results[0].error);
+    EXPECT_EQ("first", Output(opened.results[0]));
+    EXPECT_EQ(KM_ERROR_VERIFICATION_FAILED, opened.results[1].error);
+    EXPECT_EQ(0U, opened.results[1].output.available_read());
+    EXPECT_EQ(KM_ERROR_INVALID_INPUT_LENGTH, opened.results[2].error);
+    EXPECT_EQ(KM_ERROR_INVALID_ARGUMENT, opened.results[3].error);
+    EXPECT_EQ(KM_ERROR_VERIFICATION_FAILED, opened.results[4].error);
+    EXPECT_EQ(0U, opened.results[4].output.available_read());
+    // Failures don't disturb the records after them.
+    EXPECT_EQ(KM_ERROR_OK, opened.results[5].error);
+    EXPECT_EQ("second", Output(opened.results[5]));
+}
+
+TEST_F(BatchAeadOperationTest, CallerNonce) {
+    string nonce(12, 'n');
+    ASSERT_EQ(KM_ERROR_OK, GenerateGcmKey(AuthorizationSetBuilder()));
+    BatchAeadOperationResponse rsp;
+    ASSERT_EQ(KM_ERROR_OK, Batch(KM_PURPOSE_ENCRYPT, GcmParams(), {{nonce, "", "data"}}, &rsp));
+    EXPECT_EQ(KM_ERROR_CALLER_NONCE_PROHIBITED, rsp.results[0].error);
+
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateGcmKey(AuthorizationSetBuilder().Authorization(TAG_CALLER_NONCE)));
+    ASSERT_EQ(KM_ERROR_OK, Batch(KM_PURPOSE_ENCRYPT, GcmParams(),
+                                 {{nonce, "", "data"}, {"short nonce", "", "data"}}, &rsp));
+    EXPECT_EQ(KM_ERROR_OK, rsp.results[0].error);
+    EXPECT_EQ(nonce, Nonce(rsp.results[0]));
+    EXPECT_EQ(KM_ERROR_INVALID_NONCE, rsp.results[1].error);
+}
+
+TEST_F(BatchAeadOperationTest, CountsAsOneUse) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateGcmKey(AuthorizationSetBuilder().Authorization(TAG_MAX_USES_PER_BOOT, 1)));
+    BatchAeadOperationResponse rsp;
+    EXPECT_EQ(KM_ERROR_OK, Batch(KM_PURPOSE_ENCRYPT, GcmParams(),
+                                 {{"", "", "one"}, {"", "", "two"}, {"", "", "three"}}, &rsp));
+    EXPECT_EQ(KM_ERROR_KEY_MAX_OPS_EXCEEDED,
+              Batch(KM_PURPOSE_ENCRYPT, GcmParams(), {{"", "", "four"}}, &rsp));
+}
+
+TEST_F(BatchAeadOperationTest, Unsupported) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
+                                           .AesEncryptionKey(128)
+                                           .EcbMode()
+                                           .Padding(KM_PAD_NONE)));
+    BatchAeadOperationResponse rsp;
+    EXPECT_EQ(KM_ERROR_UNIMPLEMENTED,
+              Batch(KM_PURPOSE_ENCRYPT,
+                    AuthorizationSet(
+                        AuthorizationSetBuilder().BlockMode(KM_MODE_ECB).Padding(KM_PAD_NONE)),
+                    {{"", "", string(16, 'a')}}, &rsp));
+}
+
+// Reports the time to seal records with one BATCH_AEAD_OPERATION per batch and with one
+// BeginOperation and FinishOperation per record.
+TEST_F(BatchAeadOperationTest, DISABLED_BatchVersusPerRecord) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateGcmKey(AuthorizationSetBuilder()));
+    AuthorizationSet params(GcmParams());
+    const size_t batch_size = 100;
+    const size_t batches = 20;
+    for (size_t record_size : {16, 256, 4096}) {
+        vector<Record> records(batch_size, Record{"", "", string(record_size, 'r')});
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < batches; ++i) {
+            BatchAeadOperationResponse rsp;
+            ASSERT_EQ(KM_ERROR_OK, Batch(KM_PURPOSE_ENCRYPT, params, records, &rsp));
+        }
+        std::chrono::duration<double, std::micro> batched =
+            std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < batches * batch_size; ++i) {
+            keymaster_operation_handle_t op_handle;
+            ASSERT_EQ(KM_ERROR_OK, Begin(KM_PURPOSE_ENCRYPT, params, &op_handle));
+            string ciphertext;
+            ASSERT_EQ(KM_ERROR_OK, Finish(op_handle, records[0].input, "", &ciphertext));
+        }
+        std::chrono::duration<double, std::micro> per_record =
+            std::chrono::steady_clock::now() - start;
+
+        std::cout << record_size << "-byte records: " << batched.count() / (batches * batch_size)
+                  << " us/record batched, " << per_record.count() / (batches * batch_size)
+                  << " us/record one operation each" << std::endl;
+    }
+}
+
+class RecordStreamTest : public BatchAeadOperationTest {
+  protected:
+    keymaster_error_t BeginStream(keymaster_purpose_t purpose, const AuthorizationSet& params,
+                                  keymaster_operation_handle_t* op_handle, string* nonce) {
+        BeginOperationRequest req;
+        req.purpose = purpose;
+        req.SetKeyMaterial(blob_);
+        req.additional_params = params;
+        BeginOperationResponse rsp;
+        keymaster_.BeginOperation(req, &rsp);
+        *op_handle = rsp.op_handle;
+        keymaster_blob_t nonce_blob;
+        if (nonce && rsp.output_params.GetTagValue(TAG_NONCE, &nonce_blob))
+            *nonce = string(reinterpret_cast<const char*>(nonce_blob.data), nonce_blob.data_length);
+        return rsp.error;
+    }
+
+    keymaster_error_t SealOrOpen(keymaster_purpose_t purpose,
+                                 keymaster_operation_handle_t op_handle,
+                                 const string& associated_data, const string& input,
+                                 string* output, uint64_t* sequence_number = nullptr) {
+        ProcessRecordRequest req;
+        req.op_handle = op_handle;
+        req.input.Reinitialize(input.data(), input.size());
+        if (!associated_data.empty())
+            req.additional_params.push_back(TAG_ASSOCIATED_DATA, associated_data.data(),
+                                            associated_data.size());
+        ProcessRecordResponse rsp;
+        if (purpose == KM_PURPOSE_ENCRYPT)
+            keymaster_.SealRecord(req, &rsp);
+        else
+            keymaster_.OpenRecord(req, &rsp);
+        if (output)
+            *output = string(reinterpret_cast<const char*>(rsp.output.peek_read()),
+                             rsp.output.available_read());
+        if (sequence_number)
+            *sequence_number = rsp.sequence_number;
+        return rsp.error;
+    }
+
+    AuthorizationSet StreamParams(const string& nonce) {
+        AuthorizationSet params(GcmParams());
+        params.push_back(TAG_NONCE, nonce.data(), nonce.size());
+        return params;
+    }
+};
+
+TEST_F(RecordStreamTest, SealAndOpen) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateGcmKey(AuthorizationSetBuilder()));
+
+    keymaster_operation_handle_t op_handle;
+    string nonce;
+    ASSERT_EQ(KM_ERROR_OK, BeginStream(KM_PURPOSE_ENCRYPT, GcmParams(), &op_handle, &nonce));
+    ASSERT_EQ(12U, nonce.size());
+
+    vector<Record> records = {
+        {"", "aad", "Hello World!"}, {"", "aad", "Hello World!"}, {"", "", string(1000, 'x')}};
+    vector<string> sealed(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        uint64_t sequence_number;
+        ASSERT_EQ(KM_ERROR_OK,
+                  SealOrOpen(KM_PURPOSE_ENCRYPT, op_handle, records[i].associated_data,
+                             records[i].input, &sealed[i], &sequence_number));
+        EXPECT_EQ(i, sequence_number);
+        EXPECT_EQ(records[i].input.size() + 16, sealed[i].size());
+    }
+    // Same key, plaintext and AAD, but a different nonce.
+    EXPECT_NE(sealed[0], sealed[1]);
+    EXPECT_EQ(KM_ERROR_OK, Finish(op_handle, "", "", nullptr /* output */));
+    EXPECT_FALSE(keymaster_.has_operation(op_handle));
+
+    ASSERT_EQ(KM_ERROR_OK, BeginStream(KM_PURPOSE_DECRYPT, StreamParams(nonce), &op_handle,
+                                       nullptr /* nonce */));
+    for (size_t i = 0; i < records.size(); ++i) {
+        string opened;
+        EXPECT_EQ(KM_ERROR_OK, SealOrOpen(KM_PURPOSE_DECRYPT, op_handle,
+                                          records[i].associated_data, sealed[i], &opened));
+        EXPECT_EQ(records[i].input, opened);
+    }
+    EXPECT_EQ(KM_ERROR_OK, Finish(op_handle, "", "", nullptr /* output */));
+
+    // Record 1 was sealed under the base nonce XORed with 1.
+    string record_nonce = nonce;
+    record_nonce[11] ^= 1;
+    AuthorizationSet params(StreamParams(record_nonce));
+    params.push_back(TAG_ASSOCIATED_DATA, "aad", 3);
+    ASSERT_EQ(KM_ERROR_OK, Begin(KM_PURPOSE_DECRYPT, params, &op_handle));
+    string plaintext;
+    EXPECT_EQ(KM_ERROR_OK, Finish(op_handle, sealed[1], "", &plaintext));
+    EXPECT_EQ("Hello World!", plaintext);
+}
+
+TEST_F(RecordStreamTest, OutOfOrderRecordEndsStream) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateGcmKey(AuthorizationSetBuilder()));
+
+    keymaster_operation_handle_t op_handle;
+    string nonce, first, second;
+    ASSERT_EQ(KM_ERROR_OK, BeginStream(KM_PURPOSE_ENCRYPT, GcmParams(), &op_handle, &nonce));
+    ASSERT_EQ(KM_ERROR_OK, SealOrOpen(KM_PURPOSE_ENCRYPT, op_handle, "", "first", &first));
+    ASSERT_EQ(KM_ERROR_OK, SealOrOpen(KM_PURPOSE_ENCRYPT, op_handle, "", "second", &second));
+
+    ASSERT_EQ(KM_ERROR_OK, BeginStream(KM_PURPOSE_DECRYPT, StreamParams(nonce), &op_handle,
+                                       nullptr /* nonce */));
+    string opened;
+    EXPECT_EQ(KM_ERROR_VERIFICATION_FAILED,
+              SealOrOpen(KM_PURPOSE_DECRYPT, op_handle, "", second, &opened));
+    EXPECT_EQ("", opened);
+    EXPECT_EQ(KM_ERROR_INVALID_OPERATION_HANDLE,
+              SealOrOpen(KM_PURPOSE_DECRYPT, op_handle, "", first, &opened));
+}
+
+TEST_F(RecordStreamTest, NoMixingWithUpdate) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateGcmKey(AuthorizationSetBuilder()));
+
+    keymaster_operation_handle_t op_handle;
+    ASSERT_EQ(KM_ERROR_OK, Begin(KM_PURPOSE_ENCRYPT, GcmParams(), &op_handle));
+    ASSERT_EQ(KM_ERROR_OK, Update(op_handle, "data"));
+    EXPECT_EQ(KM_ERROR_INVALID_ARGUMENT,
+              SealOrOpen(KM_PURPOSE_ENCRYPT, op_handle, "", "record", nullptr /* output */));
+
+    ASSERT_EQ(KM_ERROR_OK, Begin(KM_PURPOSE_ENCRYPT, GcmParams(), &op_handle));
+    ASSERT_EQ(KM_ERROR_OK,
+              SealOrOpen(KM_PURPOSE_ENCRYPT, op_handle, "", "record", nullptr /* output */));
+    EXPECT_EQ(KM_ERROR_INVALID_ARGUMENT, Update(op_handle, ""));
+
+    ASSERT_EQ(KM_ERROR_OK, Begin(KM_PURPOSE_ENCRYPT, GcmParams(), &op_handle));
+    ASSERT_EQ(KM_ERROR_OK,
+              SealOrOpen(KM_PURPOSE_ENCRYPT, op_handle, "", "record", nullptr /* output */));
+    EXPECT_EQ(KM_ERROR_INVALID_ARGUMENT, Finish(op_handle, "data", "", nullptr /* output */));
+}
+
+TEST_F(RecordStreamTest, WrongDirection) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateGcmKey(AuthorizationSetBuilder()));
+
+    keymaster_operation_handle_t op_handle;
+    ASSERT_EQ(KM_ERROR_OK, Begin(KM_PURPOSE_ENCRYPT, GcmParams(), &op_handle));
+    EXPECT_EQ(KM_ERROR_INCOMPATIBLE_PURPOSE,
+              SealOrOpen(KM_PURPOSE_DECRYPT, op_handle, "", string(32, 'a'),
+                         nullptr /* output */));
+    EXPECT_FALSE(keymaster_.has_operation(op_handle));
+}
+
+TEST_F(RecordStreamTest, Unsupported) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
+                                           .AesEncryptionKey(128)
+                                           .EcbMode()
+                                           .Padding(KM_PAD_NONE)));
+    keymaster_operation_handle_t op_handle;
+    ASSERT_EQ(KM_ERROR_OK,
+              Begin(KM_PURPOSE_ENCRYPT,
+                    AuthorizationSet(
+                        AuthorizationSetBuilder().BlockMode(KM_MODE_ECB).Padding(KM_PAD_NONE)),
+                    &op_handle));
+    EXPECT_EQ(KM_ERROR_UNIMPLEMENTED,
+              SealOrOpen(KM_PURPOSE_ENCRYPT, op_handle, "", string(16, 'a'),
+                         nullptr /* output */));
+}
+
+/**
+ * Benchmarks comparing algorithms that serve the same purpose, on a software AndroidKeymaster.
+ */
+class AlgorithmLatencyTest : public AndroidKeymasterMessageTest {
+  protected:
+    // Runs |count| operations with the current key, each given |input| in one FinishOperation,
+    // and reports the time per operation.
+    void TimeOperations(const string& label, keymaster_purpose_t purpose,
+                        const AuthorizationSet& params, const string& input,
+                        const string& signature, size_t count) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            keymaster_operation_handle_t op_handle;
+            ASSERT_EQ(KM_ERROR_OK, Begin(purpose, params, &op_handle));
+            string output;
+            ASSERT_EQ(KM_ERROR_OK, Finish(op_handle, input, signature, &output));
+        }
+        std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::steady_clock::now() - start;
+        std::cout << label << ": " << elapsed.count() / count << " us/operation" << std::endl;
+    }
+};
+
+TEST_F(AlgorithmLatencyTest, DISABLED_AesGcmVersusChaCha20Poly1305) {
+    AuthorizationSet gcm_params(AuthorizationSetBuilder()
+                                    .BlockMode(KM_MODE_GCM)
+                                    .Padding(KM_PAD_NONE)
+                                    .Authorization(TAG_MAC_LENGTH, 128));
+    AuthorizationSet chacha_params(AuthorizationSetBuilder().Authorization(TAG_MAC_LENGTH, 128));
+    for (size_t size : {64, 1024, 16384}) {
+        string message(size, 'm');
+        string suffix = ", " + std::to_string(size) + "-byte messages";
+
+        ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
+                                               .AesEncryptionKey(256)
+                                               .Authorization(TAG_BLOCK_MODE, KM_MODE_GCM)
+                                               .Padding(KM_PAD_NONE)
+                                               .Authorization(TAG_MIN_MAC_LENGTH, 128)));
+        TimeOperations("AES-256-GCM" + suffix, KM_PURPOSE_ENCRYPT, gcm_params, message, "", 1000);
+
+        ASSERT_EQ(KM_ERROR_OK,
+                  GenerateKey(AuthorizationSetBuilder().ChaCha20Poly1305EncryptionKey(128)));
+        TimeOperations("ChaCha20-Poly1305" + suffix, KM_PURPOSE_ENCRYPT, chacha_params, message,
+                       "", 1000);
+    }
+}
+
+TEST_F(AlgorithmLatencyTest, DISABLED_Ed25519VersusEcdsaP256) {
+    string message(32, 'm');
+
+    AuthorizationSet ed25519_params(AuthorizationSetBuilder().Digest(KM_DIGEST_NONE));
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().Ed25519SigningKey().Digest(KM_DIGEST_NONE)));
+    string signature = Sign(ed25519_params, message);
+    TimeOperations("Ed25519 sign", KM_PURPOSE_SIGN, ed25519_params, message, "", 1000);
+    TimeOperations("Ed25519 verify", KM_PURPOSE_VERIFY, ed25519_params, message, signature, 1000);
+
+    AuthorizationSet ecdsa_params(AuthorizationSetBuilder().Digest(KM_DIGEST_SHA_2_256));
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder().EcdsaSigningKey(256).Digest(
+                               KM_DIGEST_SHA_2_256)));
+    signature = Sign(ecdsa_params, message);
+    TimeOperations("ECDSA P-256 sign", KM_PURPOSE_SIGN, ecdsa_params, message, "", 1000);
+    TimeOperations("ECDSA P-256 verify", KM_PURPOSE_VERIFY, ecdsa_params, message, signature,
+                   1000);
+}
+
+class KeyRevocationRegistryTest : public testing::Test {
+  protected:
+    void SetUp() override {
+        path_ = testing::TempDir() + "key_revocation_" +
+                testing::UnitTest::GetInstance()->current_test_info()->name();
+        std::remove(path_.c_str());
+    }
+    void TearDown() override { std::remove(path_.c_str()); }
+
+    static KeymasterKeyBlob Blob(size_t i) {
+        string material = "key blob " + std::to_string(i);
+        return KeymasterKeyBlob(reinterpret_cast<const uint8_t*>(material.data()),
+                                material.size());
+    }
+
+    string path_;
+};
+
+TEST_F(KeyRevocationRegistryTest, RevokeAndReload) {
+    // Enough entries that the filter has to grow.
+    const size_t kRevoked = 200;
+    {
+        KeyRevocationRegistry registry;
+        ASSERT_EQ(KM_ERROR_OK, registry.Init(path_.c_str()));
+        EXPECT_EQ(0U, registry.size());
+        EXPECT_FALSE(registry.IsRevoked(Blob(0)));
+
+        for (size_t i = 0; i < kRevoked; ++i) {
+            ASSERT_EQ(KM_ERROR_OK, registry.Revoke(Blob(i)));
+            EXPECT_TRUE(registry.IsRevoked(Blob(i)));
+            EXPECT_FALSE(registry.IsRevoked(Blob(i + 1)));
+        }
+        ASSERT_EQ(KM_ERROR_OK, registry.Revoke(Blob(0)));
+        EXPECT_EQ(kRevoked, registry.size());
+    }
+
+    KeyRevocationRegistry reloaded;
+    ASSERT_EQ(KM_ERROR_OK, reloaded.Init(path_.c_str()));
+    EXPECT_EQ(kRevoked, reloaded.size());
+    for (size_t i = 0; i < kRevoked * 2; ++i)
+        EXPECT_EQ(i < kRevoked, reloaded.IsRevoked(Blob(i))) << i;
+}
+
+TEST_F(KeyRevocationRegistryTest, RejectsDamagedFile) {
+    KeyRevocationRegistry registry;
+    ofstream(path_, std::ios::binary) << string(33, '\x01');
+    EXPECT_NE(KM_ERROR_OK, registry.Init(path_.c_str()));
+
+    // Two entries, out of order.
+    ofstream(path_, std::ios::binary | std::ios::trunc) << string(32, '\x02') << string(32, '\x01');
+    EXPECT_NE(KM_ERROR_OK, registry.Init(path_.c_str()));
+}
+
+TEST_F(KeyRevocationRegistryTest, DeletedKeyStopsWorking) {
+    PureSoftKeymasterContext* context = new PureSoftKeymasterContext();
+    std::unique_ptr<KeyRevocationRegistry> registry(new KeyRevocationRegistry());
+    ASSERT_EQ(KM_ERROR_OK, registry->Init(path_.c_str()));
+    context->SetKeyRevocationRegistry(std::move(registry));
+    AndroidKeymaster keymaster(context, 16);
+
+    ConfigureRequest configure_request;
+    configure_request.os_version = kOsVersion;
+    configure_request.os_patchlevel = kOsPatchLevel;
+    ConfigureResponse configure_response;
+    keymaster.Configure(configure_request, &configure_response);
+    ASSERT_EQ(KM_ERROR_OK, configure_response.error);
+
+    GenerateKeyRequest generate_request;
+    generate_request.key_description.Reinitialize(AuthorizationSetBuilder()
+                                                      .HmacKey(128)
+                                                      .Digest(KM_DIGEST_SHA_2_256)
+                                                      .Authorization(TAG_MIN_MAC_LENGTH, 256)
+                                                      .Authorization(TAG_NO_AUTH_REQUIRED)
+                                                      .build());
+    GenerateKeyResponse generate_response;
+    keymaster.GenerateKey(generate_request, &generate_response);
+    ASSERT_EQ(KM_ERROR_OK, generate_response.error);
+    KeymasterKeyBlob blob(generate_response.key_blob);
+
+    GetKeyCharacteristicsRequest characteristics_request;
+    characteristics_request.SetKeyMaterial(blob);
+    GetKeyCharacteristicsResponse characteristics_response;
+    keymaster.GetKeyCharacteristics(characteristics_request, &characteristics_response);
+    EXPECT_EQ(KM_ERROR_OK, characteristics_response.error);
+
+    DeleteKeyRequest delete_request;
+    delete_request.SetKeyMaterial(blob);
+    DeleteKeyResponse delete_response;
+    keymaster.DeleteKey(delete_request, &delete_response);
+    ASSERT_EQ(KM_ERROR_OK, delete_response.error);
+
+    keymaster.GetKeyCharacteristics(characteristics_request, &characteristics_response);
+    EXPECT_EQ(KM_ERROR_INVALID_KEY_BLOB, characteristics_response.error);
+
+    BeginOperationRequest begin_request;
+    begin_request.purpose = KM_PURPOSE_SIGN;
+    begin_request.SetKeyMaterial(blob);
+    begin_request.additional_params.Reinitialize(AuthorizationSetBuilder()
+                                                     .Digest(KM_DIGEST_SHA_2_256)
+                                                     .Authorization(TAG_MAC_LENGTH, 256)
+                                                     .build());
+    BeginOperationResponse begin_response;
+    keymaster.BeginOperation(begin_request, &begin_response);
+    EXPECT_EQ(KM_ERROR_INVALID_KEY_BLOB, begin_response.error);
+
+    // The revocation outlives the context.
+    KeyRevocationRegistry reloaded;
+    ASSERT_EQ(KM_ERROR_OK, reloaded.Init(path_.c_str()));
+    EXPECT_TRUE(reloaded.IsRevoked(blob));
+}
+
+TEST_F(KeyRevocationRegistryTest, DeleteFailsIfRegistryDoesNotLoad) {
+    PureSoftKeymasterContext context;
+    ofstream(path_, std::ios::binary) << string(33, '\x01');
+    EXPECT_NE(KM_ERROR_OK, context.InitKeyRevocationRegistry(path_.c_str()));
+    EXPECT_NE(KM_ERROR_OK, context.DeleteKey(Blob(0)));
+
+    std::remove(path_.c_str());
+    ASSERT_EQ(KM_ERROR_OK, context.InitKeyRevocationRegistry(path_.c_str()));
+    EXPECT_EQ(KM_ERROR_OK, context.DeleteKey(Blob(0)));
+    KeyRevocationRegistry reloaded;
+    ASSERT_EQ(KM_ERROR_OK, reloaded.Init(path_.c_str()));
+    EXPECT_TRUE(reloaded.IsRevoked(Blob(0)));
+}
+
+typedef Keymaster2Test EncryptionOperationsTest;
+INSTANTIATE_TEST_CASE_P(AndroidKeymasterTest, EncryptionOperationsTest, test_params);
+
+TEST_P(EncryptionOperationsTest, RsaNoPaddingSuccess) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().RsaEncryptionKey(256, 3).Padding(KM_PAD_NONE)));
+
+    string message = "12345678901234567890123456789012";
+    string ciphertext1 = EncryptMessage(string(message), KM_PAD_NONE);
+    EXPECT_EQ(256U / 8, ciphertext1.size());
+
+    string ciphertext2 = EncryptMessage(string(message), KM_PAD_NONE);
+    EXPECT_EQ(256U / 8, ciphertext2.size());
+
+    // Unpadded RSA is deterministic
+    EXPECT_EQ(ciphertext1, ciphertext2);
+
+    if (GetParam()->algorithm_in_km0_hardware(KM_ALGORITHM_RSA))
+        EXPECT_EQ(3, GetParam()->keymaster0_calls());
+}
+
+TEST_P(EncryptionOperationsTest, RsaNoPaddingTooShort) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().RsaEncryptionKey(256, 3).Padding(KM_PAD_NONE)));
+
+    string message = "1";
+
+    string ciphertext = EncryptMessage(message, KM_PAD_NONE);
+    EXPECT_EQ(256U / 8, ciphertext.size());
+
+    string expected_plaintext = string(256 / 8 - 1, 0) + message;
+    string plaintext = DecryptMessage(ciphertext, KM_PAD_NONE);
+
+    EXPECT_EQ(expected_plaintext, plaintext);
+
+    if (GetParam()->algorithm_in_km0_hardware(KM_ALGORITHM_RSA))
+        EXPECT_EQ(4, GetParam()->keymaster0_calls());
+}
+
+TEST_P(EncryptionOperationsTest, RsaNoPaddingTooLong) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().RsaEncryptionKey(256, 3).Padding(KM_PAD_NONE)));
+
+    string message = "123456789012345678901234567890123";
+
+    AuthorizationSet begin_params(client_params());
+    begin_params.push_back(TAG_PADDING, KM_PAD_NONE);
+    EXPECT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_ENCRYPT, begin_params));
+
+    string result;
+    size_t input_consumed;
+    EXPECT_EQ(KM_ERROR_INVALID_INPUT_LENGTH, UpdateOperation(message, &result, &input_consumed));
+
+    if (GetParam()->algorithm_in_km0_hardware(KM_ALGORITHM_RSA))
+        EXPECT_EQ(2, GetParam()->keymaster0_calls());
+}
+
+TEST_P(EncryptionOperationsTest, RsaNoPaddingLargerThanModulus) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().RsaEncryptionKey(256, 3).Padding(KM_PAD_NONE)));
+
+    string exported;
+    ASSERT_EQ(KM_ERROR_OK, ExportKey(KM_KEY_FORMAT_X509, &exported));
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(exported.data());
+    unique_ptr<EVP_PKEY, EVP_PKEY_Delete> pkey(
+        d2i_PUBKEY(nullptr /* alloc new */, &p, exported.size()));
+    unique_ptr<RSA, RSA_Delete> rsa(EVP_PKEY_get1_RSA(pkey.get()));
+
+    size_t modulus_len = BN_num_bytes(rsa->n);
+    ASSERT_EQ(256U / 8, modulus_len);
+    unique_ptr<uint8_t[]> modulus_buf(new uint8_t[modulus_len]);
+    BN_bn2bin(rsa->n, modulus_buf.get());
+
+    // The modulus is too big to encrypt.
+    string message(reinterpret_cast<const char*>(modulus_buf.get()), modulus_len);
+
+    AuthorizationSet begin_params(client_params());
+    begin_params.push_back(TAG_PADDING, KM_PAD_NONE);
+    EXPECT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_ENCRYPT, begin_params));
+
+    string result;
+    size_t input_consumed;
+    EXPECT_EQ(KM_ERROR_OK, UpdateOperation(message, &result, &input_consumed));
+    EXPECT_EQ(KM_ERROR_INVALID_ARGUMENT, FinishOperation(&result));
+
+    // One smaller than the modulus is okay.
+    BN_sub(rsa->n, rsa->n, BN_value_one());
+    modulus_len = BN_num_bytes(rsa->n);
+    ASSERT_EQ(256U / 8, modulus_len);
+    BN_bn2bin(rsa->n, modulus_buf.get());
+    message = string(reinterpret_cast<const char*>(modulus_buf.get()), modulus_len);
+    EXPECT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_ENCRYPT, begin_params));
+    EXPECT_EQ(KM_ERROR_OK, FinishOperation(message, "", &result));
+
+    if (GetParam()->algorithm_in_km0_hardware(KM_ALGORITHM_RSA))
+        EXPECT_EQ(4, GetParam()->keymaster0_calls());
+}
+
+TEST_P(EncryptionOperationsTest, RsaOaepSuccess) {
     size_t key_size = 768;
     ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
                                            .RsaEncryptionKey(key_size, 3)
@@ -3376,44 +4335,290 @@ TEST_P(EncryptionOperationsTest, AesGcmCorruptTag) {
     EXPECT_EQ(0, GetParam()->keymaster0_calls());
 }
 
-TEST_P(EncryptionOperationsTest, TripleDesEcbRoundTripSuccess) {
-    auto auths = AuthorizationSetBuilder()
-                     .TripleDesEncryptionKey(112)
-                     .Authorization(TAG_BLOCK_MODE, KM_MODE_ECB)
-                     .Padding(KM_PAD_NONE);
+TEST_P(EncryptionOperationsTest, ChaCha20Poly1305RoundTripSuccess) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().ChaCha20Poly1305EncryptionKey(128)));
+    string aad = "foobar";
+    string message = "123456789012345678901234567890123456789012345678901234567890123456789012";
+    AuthorizationSet begin_params(client_params());
+    begin_params.push_back(TAG_MAC_LENGTH, 128);
 
-    ASSERT_EQ(KM_ERROR_OK, GenerateKey(auths));
-    // Two-block message.
-    string message = "1234567890123456";
-    string ciphertext1 = EncryptMessage(message, KM_MODE_ECB, KM_PAD_NONE);
-    EXPECT_EQ(message.size(), ciphertext1.size());
+    AuthorizationSet update_params;
+    update_params.push_back(TAG_ASSOCIATED_DATA, aad.data(), aad.size());
 
-    string ciphertext2 = EncryptMessage(string(message), KM_MODE_ECB, KM_PAD_NONE);
-    EXPECT_EQ(message.size(), ciphertext2.size());
+    // Encrypt
+    AuthorizationSet begin_out_params;
+    EXPECT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_ENCRYPT, begin_params, &begin_out_params));
+    string ciphertext;
+    size_t input_consumed;
+    AuthorizationSet update_out_params;
+    EXPECT_EQ(KM_ERROR_OK, UpdateOperation(update_params, message, &update_out_params, &ciphertext,
+                                           &input_consumed));
+    EXPECT_EQ(message.size(), input_consumed);
+    EXPECT_EQ(KM_ERROR_OK, FinishOperation(&ciphertext));
+    EXPECT_EQ(message.size() + 16, ciphertext.size());
 
-    // ECB is deterministic.
-    EXPECT_EQ(ciphertext1, ciphertext2);
+    // Grab nonce
+    keymaster_blob_t nonce;
+    ASSERT_TRUE(begin_out_params.GetTagValue(TAG_NONCE, &nonce));
+    EXPECT_EQ(12U, nonce.data_length);
+    begin_params.push_back(begin_out_params);
+
+    // Decrypt.
+    EXPECT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_DECRYPT, begin_params));
+    string plaintext;
+    EXPECT_EQ(KM_ERROR_OK, UpdateOperation(update_params, ciphertext, &update_out_params,
+                                           &plaintext, &input_consumed));
+    EXPECT_EQ(ciphertext.size(), input_consumed);
+    EXPECT_EQ(KM_ERROR_OK, FinishOperation(&plaintext));
 
-    string plaintext = DecryptMessage(ciphertext1, KM_MODE_ECB, KM_PAD_NONE);
     EXPECT_EQ(message, plaintext);
+    EXPECT_EQ(0, GetParam()->keymaster0_calls());
 }
 
-TEST_P(EncryptionOperationsTest, TripleDesEcbNotAuthorized) {
-    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
-                                           .TripleDesEncryptionKey(112)
-                                           .Authorization(TAG_BLOCK_MODE, KM_MODE_CBC)
-                                           .Padding(KM_PAD_NONE)));
-    // Two-block message.
-    string message = "1234567890123456";
-    AuthorizationSet begin_params(client_params());
-    begin_params.push_back(TAG_BLOCK_MODE, KM_MODE_ECB);
-    begin_params.push_back(TAG_PADDING, KM_PAD_NONE);
-    EXPECT_EQ(KM_ERROR_INCOMPATIBLE_BLOCK_MODE, BeginOperation(KM_PURPOSE_ENCRYPT, begin_params));
-}
+TEST_P(EncryptionOperationsTest, ChaCha20Poly1305Rfc8439Vector) {
+    // Test vector from RFC 8439 section 2.8.2.
+    uint8_t key[32];
+    for (size_t i = 0; i < sizeof(key); ++i)
+        key[i] = 0x80 + i;
+    uint8_t nonce[] = {
+        0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47,
+    };
+    uint8_t aad[] = {
+        0x50, 0x51, 0x52, 0x53, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7,
+    };
+    uint8_t expected_ciphertext[] = {
+        0xd3, 0x1a, 0x8d, 0x34, 0x64, 0x8e, 0x60, 0xdb, 0x7b, 0x86, 0xaf, 0xbc, 0x53, 0xef, 0x7e,
+        0xc2, 0xa4, 0xad, 0xed, 0x51, 0x29, 0x6e, 0x08, 0xfe, 0xa9, 0xe2, 0xb5, 0xa7, 0x36, 0xee,
+        0x62, 0xd6, 0x3d, 0xbe, 0xa4, 0x5e, 0x8c, 0xa9, 0x67, 0x12, 0x82, 0xfa, 0xfb, 0x69, 0xda,
+        0x92, 0x72, 0x8b, 0x1a, 0x71, 0xde, 0x0a, 0x9e, 0x06, 0x0b, 0x29, 0x05, 0xd6, 0xa5, 0xb6,
+        0x7e, 0xcd, 0x3b, 0x36, 0x92, 0xdd, 0xbd, 0x7f, 0x2d, 0x77, 0x8b, 0x8c, 0x98, 0x03, 0xae,
+        0xe3, 0x28, 0x09, 0x1b, 0x58, 0xfa, 0xb3, 0x24, 0xe4, 0xfa, 0xd6, 0x75, 0x94, 0x55, 0x85,
+        0x80, 0x8b, 0x48, 0x31, 0xd7, 0xbc, 0x3f, 0xf4, 0xde, 0xf0, 0x8e, 0x4b, 0x7a, 0x9d, 0xe5,
+        0x76, 0xd2, 0x65, 0x86, 0xce, 0xc6, 0x4b, 0x61, 0x16, 0x1a, 0xe1, 0x0b, 0x59, 0x4f, 0x09,
+        0xe2, 0x6a, 0x7e, 0x90, 0x2e, 0xcb, 0xd0, 0x60, 0x06, 0x91,
+    };
+    string message = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip "
+                     "for the future, sunscreen would be it.";
 
-TEST_P(EncryptionOperationsTest, TripleDesEcbNoPaddingWrongInputSize) {
-    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
-                                           .TripleDesEncryptionKey(112)
+    ASSERT_EQ(KM_ERROR_OK, ImportKey(AuthorizationSetBuilder()
+                                         .ChaCha20Poly1305EncryptionKey(128)
+                                         .Authorization(TAG_CALLER_NONCE),
+                                     KM_KEY_FORMAT_RAW, make_string(key)));
+
+    AuthorizationSet begin_params(client_params());
+    begin_params.push_back(TAG_MAC_LENGTH, 128);
+    begin_params.push_back(TAG_NONCE, nonce, sizeof(nonce));
+    AuthorizationSet update_params;
+    update_params.push_back(TAG_ASSOCIATED_DATA, aad, sizeof(aad));
+
+    // Encrypt in uneven pieces, to exercise keystream carry-over between updates.
+    AuthorizationSet begin_out_params;
+    EXPECT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_ENCRYPT, begin_params, &begin_out_params));
+    AuthorizationSet update_out_params;
+    AuthorizationSet empty_params;
+    string ciphertext;
+    size_t input_consumed;
+    EXPECT_EQ(KM_ERROR_OK, UpdateOperation(update_params, message.substr(0, 5), &update_out_params,
+                                           &ciphertext, &input_consumed));
+    EXPECT_EQ(KM_ERROR_OK, UpdateOperation(empty_params, message.substr(5, 70), &update_out_params,
+                                           &ciphertext, &input_consumed));
+    EXPECT_EQ(KM_ERROR_OK, UpdateOperation(empty_params, message.substr(75), &update_out_params,
+                                           &ciphertext, &input_consumed));
+    EXPECT_EQ(KM_ERROR_OK, FinishOperation(&ciphertext));
+    EXPECT_EQ(make_string(expected_ciphertext), ciphertext);
+
+    // Decrypt.
+    EXPECT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_DECRYPT, begin_params));
+    string plaintext;
+    EXPECT_EQ(KM_ERROR_OK, UpdateOperation(update_params, ciphertext, &update_out_params,
+                                           &plaintext, &input_consumed));
+    EXPECT_EQ(KM_ERROR_OK, FinishOperation(&plaintext));
+    EXPECT_EQ(message, plaintext);
+
+    EXPECT_EQ(0, GetParam()->keymaster0_calls());
+}
+
+TEST_P(EncryptionOperationsTest, ChaCha20Poly1305Incremental) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().ChaCha20Poly1305EncryptionKey(128)));
+    AuthorizationSet begin_params(client_params());
+    begin_params.push_back(TAG_MAC_LENGTH, 128);
+
+    AuthorizationSet update_params;
+    update_params.push_back(TAG_ASSOCIATED_DATA, "b", 1);
+
+    // Encrypt
+    AuthorizationSet begin_out_params;
+    EXPECT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_ENCRYPT, begin_params, &begin_out_params));
+    string ciphertext;
+    size_t input_consumed;
+    AuthorizationSet update_out_params;
+
+    // Send AAD, incrementally
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(KM_ERROR_OK, UpdateOperation(update_params, "", &update_out_params, &ciphertext,
+                                               &input_consumed));
+        EXPECT_EQ(0U, input_consumed);
+        EXPECT_EQ(0U, ciphertext.size());
+    }
+
+    // Now send data, incrementally.  Unlike GCM, every byte is processed as it arrives.
+    AuthorizationSet empty_params;
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(KM_ERROR_OK, UpdateOperation(empty_params, "a", &update_out_params, &ciphertext,
+                                               &input_consumed));
+        EXPECT_EQ(1U, input_consumed);
+        EXPECT_EQ(static_cast<size_t>(i + 1), ciphertext.size());
+    }
+
+    // AAD is not allowed once data has started.
+    EXPECT_EQ(KM_ERROR_INVALID_TAG, UpdateOperation(update_params, "", &update_out_params,
+                                                    &ciphertext, &input_consumed));
+
+    // And finish.
+    EXPECT_EQ(KM_ERROR_OK, FinishOperation(&ciphertext));
+    EXPECT_EQ(1016U, ciphertext.size());
+
+    // Grab nonce
+    EXPECT_NE(-1, begin_out_params.find(TAG_NONCE));
+    begin_params.push_back(begin_out_params);
+
+    // Decrypt.
+    EXPECT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_DECRYPT, begin_params));
+    string plaintext;
+
+    // Send AAD, incrementally, no data
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(KM_ERROR_OK, UpdateOperation(update_params, "", &update_out_params, &plaintext,
+                                               &input_consumed));
+        EXPECT_EQ(0U, input_consumed);
+        EXPECT_EQ(0U, plaintext.size());
+    }
+
+    // Now send data, incrementally.
+    for (size_t i = 0; i < ciphertext.length(); ++i) {
+        EXPECT_EQ(KM_ERROR_OK, UpdateOperation(empty_params, string(ciphertext.data() + i, 1),
+                                               &update_out_params, &plaintext, &input_consumed));
+        EXPECT_EQ(1U, input_consumed);
+    }
+    EXPECT_EQ(1000U, plaintext.size());
+    EXPECT_EQ(KM_ERROR_OK, FinishOperation(&plaintext));
+    EXPECT_EQ(string(1000, 'a'), plaintext);
+
+    EXPECT_EQ(0, GetParam()->keymaster0_calls());
+}
+
+TEST_P(EncryptionOperationsTest, ChaCha20Poly1305CorruptTag) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().ChaCha20Poly1305EncryptionKey(96)));
+    string aad = "foobar";
+    string message = "123456789012345678901234567890123456";
+    AuthorizationSet begin_params(client_params());
+    begin_params.push_back(TAG_MAC_LENGTH, 96);
+    AuthorizationSet begin_out_params;
+
+    AuthorizationSet update_params;
+    update_params.push_back(TAG_ASSOCIATED_DATA, aad.data(), aad.size());
+
+    // Encrypt
+    EXPECT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_ENCRYPT, begin_params, &begin_out_params));
+    AuthorizationSet update_out_params;
+    string ciphertext;
+    size_t input_consumed;
+    EXPECT_EQ(KM_ERROR_OK, UpdateOperation(update_params, message, &update_out_params, &ciphertext,
+                                           &input_consumed));
+    EXPECT_EQ(KM_ERROR_OK, FinishOperation(&ciphertext));
+    EXPECT_EQ(message.size() + 12, ciphertext.size());
+
+    // Corrupt tag
+    (*ciphertext.rbegin())++;
+
+    // Grab nonce.
+    EXPECT_NE(-1, begin_out_params.find(TAG_NONCE));
+    begin_params.push_back(begin_out_params);
+
+    // Decrypt.
+    EXPECT_EQ(KM_ERROR_OK, BeginOperation(KM_PURPOSE_DECRYPT, begin_params));
+    string plaintext;
+    EXPECT_EQ(KM_ERROR_OK, UpdateOperation(update_params, ciphertext, &update_out_params,
+                                           &plaintext, &input_consumed));
+    EXPECT_EQ(ciphertext.size(), input_consumed);
+    EXPECT_EQ(KM_ERROR_VERIFICATION_FAILED, FinishOperation(&plaintext));
+
+    EXPECT_EQ(message, plaintext);
+    EXPECT_EQ(0, GetParam()->keymaster0_calls());
+}
+
+TEST_P(EncryptionOperationsTest, ChaCha20Poly1305Parameters) {
+    EXPECT_EQ(KM_ERROR_MISSING_MIN_MAC_LENGTH,
+              GenerateKey(AuthorizationSetBuilder().ChaCha20Poly1305Key().EncryptionKey()));
+    EXPECT_EQ(KM_ERROR_UNSUPPORTED_KEY_SIZE,
+              GenerateKey(AuthorizationSetBuilder()
+                              .Authorization(TAG_ALGORITHM, KM_ALGORITHM_CHACHA20_POLY1305)
+                              .Authorization(TAG_KEY_SIZE, 128)
+                              .Authorization(TAG_MIN_MAC_LENGTH, 128)
+                              .EncryptionKey()));
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().ChaCha20Poly1305EncryptionKey(128)));
+
+    AuthorizationSet begin_params(client_params());
+    EXPECT_EQ(KM_ERROR_MISSING_MAC_LENGTH, BeginOperation(KM_PURPOSE_ENCRYPT, begin_params));
+    begin_params.push_back(TAG_MAC_LENGTH, 96);
+    EXPECT_EQ(KM_ERROR_INVALID_MAC_LENGTH, BeginOperation(KM_PURPOSE_ENCRYPT, begin_params));
+
+    begin_params.Reinitialize(client_params());
+    begin_params.push_back(TAG_MAC_LENGTH, 128);
+    begin_params.push_back(TAG_NONCE, "123456789012", 12);
+    EXPECT_EQ(KM_ERROR_CALLER_NONCE_PROHIBITED, BeginOperation(KM_PURPOSE_ENCRYPT, begin_params));
+
+    begin_params.Reinitialize(client_params());
+    begin_params.push_back(TAG_MAC_LENGTH, 128);
+    EXPECT_EQ(KM_ERROR_INVALID_ARGUMENT, BeginOperation(KM_PURPOSE_DECRYPT, begin_params));
+    begin_params.push_back(TAG_NONCE, "1234567890", 10);
+    EXPECT_EQ(KM_ERROR_INVALID_NONCE, BeginOperation(KM_PURPOSE_DECRYPT, begin_params));
+
+    EXPECT_EQ(0, GetParam()->keymaster0_calls());
+}
+
+TEST_P(EncryptionOperationsTest, TripleDesEcbRoundTripSuccess) {
+    auto auths = AuthorizationSetBuilder()
+                     .TripleDesEncryptionKey(112)
+                     .Authorization(TAG_BLOCK_MODE, KM_MODE_ECB)
+                     .Padding(KM_PAD_NONE);
+
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(auths));
+    // Two-block message.
+    string message = "1234567890123456";
+    string ciphertext1 = EncryptMessage(message, KM_MODE_ECB, KM_PAD_NONE);
+    EXPECT_EQ(message.size(), ciphertext1.size());
+
+    string ciphertext2 = EncryptMessage(string(message), KM_MODE_ECB, KM_PAD_NONE);
+    EXPECT_EQ(message.size(), ciphertext2.size());
+
+    // ECB is deterministic.
+    EXPECT_EQ(ciphertext1, ciphertext2);
+
+    string plaintext = DecryptMessage(ciphertext1, KM_MODE_ECB, KM_PAD_NONE);
+    EXPECT_EQ(message, plaintext);
+}
+
+TEST_P(EncryptionOperationsTest, TripleDesEcbNotAuthorized) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
+                                           .TripleDesEncryptionKey(112)
+                                           .Authorization(TAG_BLOCK_MODE, KM_MODE_CBC)
+                                           .Padding(KM_PAD_NONE)));
+    // Two-block message.
+    string message = "1234567890123456";
+    AuthorizationSet begin_params(client_params());
+    begin_params.push_back(TAG_BLOCK_MODE, KM_MODE_ECB);
+    begin_params.push_back(TAG_PADDING, KM_PAD_NONE);
+    EXPECT_EQ(KM_ERROR_INCOMPATIBLE_BLOCK_MODE, BeginOperation(KM_PURPOSE_ENCRYPT, begin_params));
+}
+
+TEST_P(EncryptionOperationsTest, TripleDesEcbNoPaddingWrongInputSize) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
+                                           .TripleDesEncryptionKey(112)
                                            .Authorization(TAG_BLOCK_MODE, KM_MODE_ECB)
                                            .Padding(KM_PAD_NONE)));
     // Message is slightly shorter than two blocks.
@@ -3870,6 +5075,204 @@ TEST_P(EncryptionOperationsTest, TripleDesCbcIncrementalNoPadding) {
     EXPECT_EQ(0, GetParam()->keymaster0_calls());
 }
 
+class KeyAgreementTest : public Keymaster2Test {
+  protected:
+    // Runs a key agreement operation over |peer_values|, passing them to update in chunks of
+    // |chunk_size| bytes, or all to finish if |chunk_size| is zero.
+    keymaster_error_t AgreeKey(const string& peer_values, string* shared_secrets,
+                               size_t chunk_size = 0) {
+        keymaster_error_t error = BeginOperation(KM_PURPOSE_AGREE_KEY);
+        if (error != KM_ERROR_OK)
+            return error;
+
+        size_t pos = 0;
+        while (chunk_size != 0 && pos < peer_values.size()) {
+            size_t input_consumed;
+            error = UpdateOperation(peer_values.substr(pos, chunk_size), shared_secrets,
+                                    &input_consumed);
+            if (error != KM_ERROR_OK) {
+                AbortOperation();
+                return error;
+            }
+            pos += input_consumed;
+        }
+        return FinishOperation(peer_values.substr(pos), "", shared_secrets);
+    }
+
+    // Returns the public half of the current key, which must be a NIST curve key.
+    EC_KEY* ExportEcKey() {
+        string export_data;
+        EXPECT_EQ(KM_ERROR_OK, ExportKey(KM_KEY_FORMAT_X509, &export_data));
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(export_data.data());
+        EVP_PKEY_Ptr pkey(d2i_PUBKEY(nullptr /* out */, &p, export_data.size()));
+        return pkey.get() ? EVP_PKEY_get1_EC_KEY(pkey.get()) : nullptr;
+    }
+
+    static string EcPublicValue(const EC_KEY* ec_key) {
+        uint8_t buf[133];
+        size_t len = EC_POINT_point2oct(EC_KEY_get0_group(ec_key), EC_KEY_get0_public_key(ec_key),
+                                        POINT_CONVERSION_UNCOMPRESSED, buf, sizeof(buf),
+                                        nullptr /* ctx */);
+        return string(reinterpret_cast<const char*>(buf), len);
+    }
+
+    static string EcdhSharedSecret(const EC_KEY* private_key, const EC_KEY* public_key) {
+        uint8_t buf[66];
+        size_t len = (EC_GROUP_get_degree(EC_KEY_get0_group(private_key)) + 7) / 8;
+        if (ECDH_compute_key(buf, len, EC_KEY_get0_public_key(public_key), private_key,
+                             nullptr /* kdf */) != static_cast<int>(len))
+            len = 0;
+        return string(reinterpret_cast<const char*>(buf), len);
+    }
+};
+INSTANTIATE_TEST_CASE_P(AndroidKeymasterTest, KeyAgreementTest, test_params);
+
+TEST_P(KeyAgreementTest, EcdhAllSizes) {
+    int nids[] = {NID_secp224r1, NID_X9_62_prime256v1, NID_secp384r1, NID_secp521r1};
+    size_t key_sizes[] = {224, 256, 384, 521};
+    for (size_t i = 0; i < array_length(key_sizes); ++i) {
+        ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder().EcdhKey(key_sizes[i])))
+            << "Failed to generate key size " << key_sizes[i];
+        EXPECT_TRUE(contains(sw_enforced(), TAG_PURPOSE, KM_PURPOSE_AGREE_KEY));
+        EC_KEY_Ptr public_key(ExportEcKey());
+        ASSERT_TRUE(public_key.get() != nullptr);
+
+        EC_KEY_Ptr peer(EC_KEY_new_by_curve_name(nids[i]));
+        ASSERT_TRUE(EC_KEY_generate_key(peer.get()));
+        string shared_secret;
+        ASSERT_EQ(KM_ERROR_OK, AgreeKey(EcPublicValue(peer.get()), &shared_secret));
+        EXPECT_EQ(EcdhSharedSecret(peer.get(), public_key.get()), shared_secret);
+    }
+
+    EXPECT_EQ(0, GetParam()->keymaster0_calls());
+}
+
+TEST_P(KeyAgreementTest, EcdhBatchAndStream) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder().EcdhKey(256)));
+    EC_KEY_Ptr public_key(ExportEcKey());
+    ASSERT_TRUE(public_key.get() != nullptr);
+
+    // Peers repeat, so some agreements use cached peer points.
+    string peer_values, expected;
+    EC_KEY_Ptr peers[3];
+    for (size_t i = 0; i < 8; ++i) {
+        EC_KEY_Ptr& peer = peers[i % 3];
+        if (!peer.get()) {
+            peer.reset(EC_KEY_new_by_curve_name(NID_X9_62_prime256v1));
+            ASSERT_TRUE(EC_KEY_generate_key(peer.get()));
+        }
+        peer_values += EcPublicValue(peer.get());
+        expected += EcdhSharedSecret(peer.get(), public_key.get());
+    }
+
+    string shared_secrets;
+    ASSERT_EQ(KM_ERROR_OK, AgreeKey(peer_values, &shared_secrets));
+    EXPECT_EQ(expected, shared_secrets);
+
+    for (size_t chunk_size : {1, 7, 65, 100}) {
+        shared_secrets.clear();
+        ASSERT_EQ(KM_ERROR_OK, AgreeKey(peer_values, &shared_secrets, chunk_size));
+        EXPECT_EQ(expected, shared_secrets) << "Chunk size " << chunk_size;
+    }
+}
+
+TEST_P(KeyAgreementTest, EcdhInvalidPeerValue) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder().EcdhKey(256)));
+    EC_KEY_Ptr peer(EC_KEY_new_by_curve_name(NID_X9_62_prime256v1));
+    ASSERT_TRUE(EC_KEY_generate_key(peer.get()));
+    string peer_value = EcPublicValue(peer.get());
+
+    // Not on the curve.
+    string shared_secret;
+    string off_curve = peer_value;
+    ++off_curve[off_curve.size() - 1];
+    EXPECT_EQ(KM_ERROR_INVALID_ARGUMENT, AgreeKey(off_curve, &shared_secret));
+
+    // Input must be a whole number of peer values, and at least one.
+    EXPECT_EQ(KM_ERROR_INVALID_INPUT_LENGTH,
+              AgreeKey(peer_value + peer_value.substr(1), &shared_secret));
+    EXPECT_EQ(KM_ERROR_INVALID_INPUT_LENGTH, AgreeKey("", &shared_secret));
+}
+
+TEST_P(KeyAgreementTest, EcdsaKeyUnauthorized) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().EcdsaSigningKey(256).Digest(KM_DIGEST_NONE)));
+    EXPECT_EQ(KM_ERROR_INCOMPATIBLE_PURPOSE, BeginOperation(KM_PURPOSE_AGREE_KEY));
+}
+
+// Section 6.1 of RFC 7748.  Alice's private key is wrapped in PKCS#8.
+static const string x25519_alice_pk8_key = hex2str(
+    "302e020100300506032b656e04220420"
+    "77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a");
+static const string x25519_alice_public_key =
+    hex2str("8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a");
+static const string x25519_bob_public_key =
+    hex2str("de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f");
+static const string x25519_shared_secret =
+    hex2str("4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742");
+
+TEST_P(KeyAgreementTest, X25519Import) {
+    ASSERT_EQ(KM_ERROR_OK, ImportKey(AuthorizationSetBuilder().X25519Key(), KM_KEY_FORMAT_PKCS8,
+                                     x25519_alice_pk8_key));
+    EXPECT_TRUE(contains(sw_enforced(), TAG_EC_CURVE, KM_EC_CURVE_CURVE_25519));
+    EXPECT_TRUE(contains(sw_enforced(), TAG_KEY_SIZE, 256));
+
+    string shared_secret;
+    ASSERT_EQ(KM_ERROR_OK, AgreeKey(x25519_bob_public_key, &shared_secret));
+    EXPECT_EQ(x25519_shared_secret, shared_secret);
+
+    string export_data;
+    ASSERT_EQ(KM_ERROR_OK, ExportKey(KM_KEY_FORMAT_X509, &export_data));
+    ASSERT_EQ(44U, export_data.size());
+    EXPECT_EQ(x25519_alice_public_key, export_data.substr(12));
+
+    EXPECT_EQ(0, GetParam()->keymaster0_calls());
+}
+
+TEST_P(KeyAgreementTest, X25519BatchAndStream) {
+    ASSERT_EQ(KM_ERROR_OK, ImportKey(AuthorizationSetBuilder().X25519Key(), KM_KEY_FORMAT_PKCS8,
+                                     x25519_alice_pk8_key));
+    string peer_values = x25519_bob_public_key + x25519_bob_public_key + x25519_bob_public_key;
+    string expected = x25519_shared_secret + x25519_shared_secret + x25519_shared_secret;
+
+    for (size_t chunk_size : {0, 1, 5, 32, 40}) {
+        string shared_secrets;
+        ASSERT_EQ(KM_ERROR_OK, AgreeKey(peer_values, &shared_secrets, chunk_size));
+        EXPECT_EQ(expected, shared_secrets) << "Chunk size " << chunk_size;
+    }
+}
+
+TEST_P(KeyAgreementTest, X25519Generate) {
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder().X25519Key()));
+    EXPECT_EQ(0U, hw_enforced().size());
+    EXPECT_TRUE(contains(sw_enforced(), TAG_EC_CURVE, KM_EC_CURVE_CURVE_25519));
+
+    string shared_secret;
+    ASSERT_EQ(KM_ERROR_OK, AgreeKey(x25519_bob_public_key, &shared_secret));
+    EXPECT_EQ(32U, shared_secret.size());
+
+    // A low-order peer point gives an all-zero shared secret, which is rejected.
+    EXPECT_EQ(KM_ERROR_INVALID_ARGUMENT, AgreeKey(string(32, '\0'), &shared_secret));
+}
+
+TEST_P(KeyAgreementTest, Curve25519PurposesExclusive) {
+    EXPECT_EQ(KM_ERROR_INCOMPATIBLE_PURPOSE,
+              GenerateKey(AuthorizationSetBuilder().X25519Key().SigningKey()));
+    EXPECT_EQ(KM_ERROR_INCOMPATIBLE_PURPOSE,
+              ImportKey(AuthorizationSetBuilder().X25519Key().SigningKey(), KM_KEY_FORMAT_PKCS8,
+                        x25519_alice_pk8_key));
+    EXPECT_EQ(KM_ERROR_INCOMPATIBLE_PURPOSE,
+              ImportKey(AuthorizationSetBuilder()
+                            .Authorization(TAG_ALGORITHM, KM_ALGORITHM_EC)
+                            .Authorization(TAG_EC_CURVE, KM_EC_CURVE_CURVE_25519)
+                            .SigningKey(),
+                        KM_KEY_FORMAT_PKCS8, x25519_alice_pk8_key));
+
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().Ed25519SigningKey().Digest(KM_DIGEST_NONE)));
+    EXPECT_EQ(KM_ERROR_INCOMPATIBLE_PURPOSE, BeginOperation(KM_PURPOSE_AGREE_KEY));
+}
+
 typedef Keymaster2Test MaxOperationsTest;
 INSTANTIATE_TEST_CASE_P(AndroidKeymasterTest, MaxOperationsTest, test_params);
 
@@ -4109,6 +5512,21 @@ TEST_P(AttestationTest, EcAttestation) {
     keymaster_free_cert_chain(&cert_chain);
 }
 
+TEST_P(AttestationTest, Ed25519Attestation) {
+    ASSERT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().Ed25519SigningKey().Digest(KM_DIGEST_NONE)));
+
+    keymaster_cert_chain_t cert_chain;
+    EXPECT_EQ(KM_ERROR_OK, AttestKey("challenge", "attest_app_id", &cert_chain));
+    ASSERT_EQ(3U, cert_chain.entry_count);
+    EXPECT_TRUE(verify_chain(cert_chain));
+    EXPECT_TRUE(verify_attestation_record("challenge", "attest_app_id", sw_enforced(),
+                                          hw_enforced(), 3 /* keymaster version */,
+                                          KM_SECURITY_LEVEL_SOFTWARE, cert_chain.entries[0]));
+
+    keymaster_free_cert_chain(&cert_chain);
+}
+
 typedef Keymaster2Test KeyUpgradeTest;
 INSTANTIATE_TEST_CASE_P(AndroidKeymasterTest, KeyUpgradeTest, test_params);
 
@@ -4253,6 +5671,281 @@ TEST_P(KeyUpgradeTest, EcVersionUpgrade) {
         EXPECT_EQ(7, GetParam()->keymaster0_calls());
 }
 
+// Reports the time to upgrade a key blob, which parses and re-serializes its authorization sets.
+TEST_P(KeyUpgradeTest, DISABLED_UpgradeLatency) {
+    if (GetParam()->is_keymaster1_hw())
+        return;  // No version binding, so nothing to upgrade.
+
+    GetParam()->keymaster_context()->SetSystemVersion(1, 1);
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder()
+                                           .EcdsaSigningKey(256)
+                                           .Digest(KM_DIGEST_SHA_2_256)
+                                           .Authorization(TAG_APPLICATION_ID, "app_id", 6)
+                                           .Authorization(TAG_NO_AUTH_REQUIRED)));
+
+    // Raise the patch level before each upgrade, so every call does the full parse and rewrite.
+    const size_t count = 1000;
+    AuthorizationSet upgrade_params(client_params());
+    AllocationTracker::Reset();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        GetParam()->keymaster_context()->SetSystemVersion(1, 2 + i);
+        ASSERT_EQ(KM_ERROR_OK, UpgradeKey(upgrade_params));
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "UpgradeKey: " << elapsed.count() / count << " us/upgrade";
+#ifdef KEYMASTER_TRACK_ALLOCATIONS
+    AllocationStats allocations = AllocationTracker::command_stats(UPGRADE_KEY);
+    std::cout << ", " << static_cast<double>(allocations.allocations) / count
+              << " allocations/upgrade, " << static_cast<double>(allocations.bytes) / count
+              << " bytes/upgrade";
+#endif
+    std::cout << std::endl;
+}
+
+static void CheckDecodedKeyMaterialRoundTrip(const string& pk8_file,
+                                             keymaster_algorithm_t algorithm) {
+    string pk8_key = read_file(pk8_file);
+    ASSERT_FALSE(pk8_key.empty());
+
+    EVP_PKEY_Ptr pkey;
+    ASSERT_EQ(KM_ERROR_OK,
+              KeyMaterialToEvpKey(KM_KEY_FORMAT_PKCS8,
+                                  KeymasterKeyBlob(reinterpret_cast<const uint8_t*>(pk8_key.data()),
+                                                   pk8_key.size()),
+                                  algorithm, &pkey));
+
+    KeymasterKeyBlob der_material;
+    ASSERT_EQ(KM_ERROR_OK, EvpKeyToKeyMaterial(pkey.get(), &der_material));
+    EXPECT_FALSE(IsDecodedKeyMaterial(der_material));
+
+    KeymasterKeyBlob decoded_material;
+    ASSERT_EQ(KM_ERROR_OK, EvpKeyToDecodedKeyMaterial(pkey.get(), &decoded_material));
+    EXPECT_TRUE(IsDecodedKeyMaterial(decoded_material));
+
+    EVP_PKEY_Ptr loaded;
+    ASSERT_EQ(KM_ERROR_OK, DecodedKeyMaterialToEvpKey(decoded_material, algorithm, &loaded));
+    KeymasterKeyBlob reencoded;
+    ASSERT_EQ(KM_ERROR_OK, EvpKeyToKeyMaterial(loaded.get(), &reencoded));
+    ASSERT_EQ(der_material.key_material_size, reencoded.key_material_size);
+    EXPECT_EQ(0, memcmp(der_material.key_material, reencoded.key_material,
+                        reencoded.key_material_size));
+
+    keymaster_algorithm_t other_algorithm =
+        (algorithm == KM_ALGORITHM_RSA) ? KM_ALGORITHM_EC : KM_ALGORITHM_RSA;
+    EXPECT_EQ(KM_ERROR_INVALID_KEY_BLOB,
+              DecodedKeyMaterialToEvpKey(decoded_material, other_algorithm, &loaded));
+
+    // Every truncation must be rejected.
+    for (size_t len = 0; len < decoded_material.key_material_size; ++len) {
+        KeymasterKeyBlob truncated(decoded_material.key_material, len);
+        EXPECT_NE(KM_ERROR_OK, DecodedKeyMaterialToEvpKey(truncated, algorithm, &loaded));
+    }
+}
+
+TEST(DecodedKeyMaterialTest, RsaRoundTrip) {
+    CheckDecodedKeyMaterialRoundTrip("rsa_privkey_pk8.der", KM_ALGORITHM_RSA);
+}
+
+TEST(DecodedKeyMaterialTest, EcRoundTrip) {
+    CheckDecodedKeyMaterialRoundTrip("ec_privkey_pk8.der", KM_ALGORITHM_EC);
+}
+
+TEST(DecodedKeyMaterialTest, LegacyKeyMaterialUpgrade) {
+    PureSoftKeymasterContext context;
+    const KeyFactory* factory = context.GetKeyFactory(KM_ALGORITHM_RSA);
+    ASSERT_TRUE(factory != nullptr);
+
+    string pk8_key = read_file("rsa_privkey_pk8.der");
+    EVP_PKEY_Ptr pkey;
+    ASSERT_EQ(KM_ERROR_OK,
+              KeyMaterialToEvpKey(KM_KEY_FORMAT_PKCS8,
+                                  KeymasterKeyBlob(reinterpret_cast<const uint8_t*>(pk8_key.data()),
+                                                   pk8_key.size()),
+                                  KM_ALGORITHM_RSA, &pkey));
+    KeymasterKeyBlob der_material;
+    ASSERT_EQ(KM_ERROR_OK, EvpKeyToKeyMaterial(pkey.get(), &der_material));
+
+    AuthorizationSet sw_enforced(AuthorizationSetBuilder()
+                                     .RsaSigningKey(1024, 65537)
+                                     .Digest(KM_DIGEST_NONE)
+                                     .Padding(KM_PAD_NONE)
+                                     .Authorization(TAG_OS_VERSION, 0)
+                                     .Authorization(TAG_OS_PATCHLEVEL, 0));
+
+    // A key with DER key material still loads.
+    UniquePtr<Key> key;
+    ASSERT_EQ(KM_ERROR_OK, factory->LoadKey(KeymasterKeyBlob(der_material), AuthorizationSet(),
+                                            AuthorizationSet(), AuthorizationSet(sw_enforced),
+                                            &key));
+
+    // Upgrading re-encodes the key material even though the versions are current.
+    AuthorizationSet upgrade_params;
+    KeymasterKeyBlob upgraded_blob;
+    ASSERT_EQ(KM_ERROR_OK, UpgradeSoftKeyBlob(key, 0, 0, upgrade_params, &upgraded_blob));
+    ASSERT_GT(upgraded_blob.key_material_size, 0U);
+
+    AuthorizationSet hidden;
+    ASSERT_EQ(KM_ERROR_OK,
+              BuildHiddenAuthorizations(upgrade_params, &hidden, softwareRootOfTrust));
+    KeymasterKeyBlob upgraded_material;
+    AuthorizationSet hw_enforced;
+    AuthorizationSet upgraded_sw_enforced;
+    ASSERT_EQ(KM_ERROR_OK, DeserializeIntegrityAssuredBlob(upgraded_blob, hidden,
+                                                           &upgraded_material, &hw_enforced,
+                                                           &upgraded_sw_enforced));
+    EXPECT_TRUE(IsDecodedKeyMaterial(upgraded_material));
+    EXPECT_EQ(sw_enforced, upgraded_sw_enforced);
+
+    UniquePtr<Key> upgraded_key;
+    ASSERT_EQ(KM_ERROR_OK,
+              factory->LoadKey(move(upgraded_material), AuthorizationSet(), move(hw_enforced),
+                               move(upgraded_sw_enforced), &upgraded_key));
+
+    // Nothing left to upgrade.
+    KeymasterKeyBlob second_upgrade;
+    EXPECT_EQ(KM_ERROR_OK, UpgradeSoftKeyBlob(upgraded_key, 0, 0, upgrade_params, &second_upgrade));
+    EXPECT_EQ(0U, second_upgrade.key_material_size);
+}
+
+static void LoadDecodedKeyMaterial(const string& pk8_file, keymaster_algorithm_t algorithm,
+                                   const PureSoftKeymasterContext& context,
+                                   UniquePtr<Key>* key) {
+    string pk8_key = read_file(pk8_file);
+    EVP_PKEY_Ptr pkey;
+    ASSERT_EQ(KM_ERROR_OK,
+              KeyMaterialToEvpKey(KM_KEY_FORMAT_PKCS8,
+                                  KeymasterKeyBlob(reinterpret_cast<const uint8_t*>(pk8_key.data()),
+                                                   pk8_key.size()),
+                                  algorithm, &pkey));
+    KeymasterKeyBlob decoded_material;
+    ASSERT_EQ(KM_ERROR_OK, EvpKeyToDecodedKeyMaterial(pkey.get(), &decoded_material));
+
+    const KeyFactory* factory = context.GetKeyFactory(algorithm);
+    ASSERT_TRUE(factory != nullptr);
+    ASSERT_EQ(KM_ERROR_OK,
+              factory->LoadKey(move(decoded_material), AuthorizationSet(), AuthorizationSet(),
+                               AuthorizationSet(AuthorizationSetBuilder()
+                                                    .Authorization(TAG_ALGORITHM, algorithm)
+                                                    .Authorization(TAG_OS_VERSION, 0)
+                                                    .Authorization(TAG_OS_PATCHLEVEL, 0)),
+                               key));
+}
+
+TEST(DecodedKeyMaterialTest, RsaPublicKeyOnlyLoad) {
+    PureSoftKeymasterContext context;
+    UniquePtr<Key> key;
+    LoadDecodedKeyMaterial("rsa_privkey_pk8.der", KM_ALGORITHM_RSA, context, &key);
+    ASSERT_TRUE(key.get() != nullptr);
+
+    RsaKey& rsa_key = static_cast<RsaKey&>(*key);
+    EXPECT_TRUE(rsa_key.public_key_only());
+    ASSERT_TRUE(rsa_key.key() != nullptr);
+    EXPECT_TRUE(rsa_key.key()->n != nullptr);
+    EXPECT_TRUE(rsa_key.key()->e != nullptr);
+    EXPECT_TRUE(rsa_key.key()->d == nullptr);
+    EXPECT_TRUE(rsa_key.key()->p == nullptr);
+
+    ASSERT_EQ(KM_ERROR_OK, rsa_key.LoadPrivateKey());
+    EXPECT_FALSE(rsa_key.public_key_only());
+    EXPECT_TRUE(rsa_key.key()->d != nullptr);
+    EXPECT_TRUE(rsa_key.key()->iqmp != nullptr);
+    EXPECT_EQ(1, RSA_check_key(rsa_key.key()));
+
+    // Loading it again is harmless.
+    EXPECT_EQ(KM_ERROR_OK, rsa_key.LoadPrivateKey());
+}
+
+TEST(DecodedKeyMaterialTest, EcPublicKeyOnlyLoad) {
+    PureSoftKeymasterContext context;
+    UniquePtr<Key> key;
+    LoadDecodedKeyMaterial("ec_privkey_pk8.der", KM_ALGORITHM_EC, context, &key);
+    ASSERT_TRUE(key.get() != nullptr);
+
+    EcKey& ec_key = static_cast<EcKey&>(*key);
+    EXPECT_TRUE(ec_key.public_key_only());
+    ASSERT_TRUE(ec_key.key() != nullptr);
+    EXPECT_TRUE(EC_KEY_get0_public_key(ec_key.key()) != nullptr);
+    EXPECT_TRUE(EC_KEY_get0_private_key(ec_key.key()) == nullptr);
+
+    ASSERT_EQ(KM_ERROR_OK, ec_key.LoadPrivateKey());
+    EXPECT_FALSE(ec_key.public_key_only());
+    EXPECT_TRUE(EC_KEY_get0_private_key(ec_key.key()) != nullptr);
+    EXPECT_EQ(1, EC_KEY_check_key(ec_key.key()));
+}
+
+// Reads the PKCS#8 key in |pk8_file| into key material, decoded or DER.
+static void ReadKeyMaterial(const string& pk8_file, keymaster_algorithm_t algorithm, bool decoded,
+                            KeymasterKeyBlob* material) {
+    string pk8_key = read_file(pk8_file);
+    EVP_PKEY_Ptr pkey;
+    ASSERT_EQ(KM_ERROR_OK,
+              KeyMaterialToEvpKey(KM_KEY_FORMAT_PKCS8,
+                                  KeymasterKeyBlob(reinterpret_cast<const uint8_t*>(pk8_key.data()),
+                                                   pk8_key.size()),
+                                  algorithm, &pkey));
+    if (decoded)
+        ASSERT_EQ(KM_ERROR_OK, EvpKeyToDecodedKeyMaterial(pkey.get(), material));
+    else
+        ASSERT_EQ(KM_ERROR_OK, EvpKeyToKeyMaterial(pkey.get(), material));
+}
+
+// Loads |material| |count| times and reports the time per load.  With |load_private_key| each key
+// also decodes its private components, as it does before signing or decrypting.
+static void TimeLoadKey(const string& label, const KeymasterKeyBlob& material,
+                        keymaster_algorithm_t algorithm, bool load_private_key, size_t count) {
+    PureSoftKeymasterContext context;
+    const KeyFactory* factory = context.GetKeyFactory(algorithm);
+    ASSERT_TRUE(factory != nullptr);
+    AuthorizationSet sw_enforced(AuthorizationSetBuilder()
+                                     .Authorization(TAG_ALGORITHM, algorithm)
+                                     .Authorization(TAG_OS_VERSION, 0)
+                                     .Authorization(TAG_OS_PATCHLEVEL, 0));
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        UniquePtr<Key> key;
+        ASSERT_EQ(KM_ERROR_OK,
+                  factory->LoadKey(KeymasterKeyBlob(material), AuthorizationSet(),
+                                   AuthorizationSet(), AuthorizationSet(sw_enforced), &key));
+        if (load_private_key)
+            ASSERT_EQ(KM_ERROR_OK, static_cast<AsymmetricKey&>(*key).LoadPrivateKey());
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << label << ": " << elapsed.count() / count << " us/load" << std::endl;
+}
+
+TEST(DecodedKeyMaterialTest, DISABLED_PublicKeyOnlyLoadLatency) {
+    KeymasterKeyBlob rsa_material, ec_material;
+    ReadKeyMaterial("rsa_privkey_pk8.der", KM_ALGORITHM_RSA, true /* decoded */, &rsa_material);
+    ReadKeyMaterial("ec_privkey_pk8.der", KM_ALGORITHM_EC, true /* decoded */, &ec_material);
+
+    TimeLoadKey("RSA, public key only", rsa_material, KM_ALGORITHM_RSA, false, 1000);
+    TimeLoadKey("RSA, full decode", rsa_material, KM_ALGORITHM_RSA, true, 1000);
+    TimeLoadKey("EC, public key only", ec_material, KM_ALGORITHM_EC, false, 1000);
+    TimeLoadKey("EC, full decode", ec_material, KM_ALGORITHM_EC, true, 1000);
+}
+
+// Reports, for each algorithm whose key material may be stored decoded, the time to load a key
+// from DER and from decoded key material.  Both loads decode the private key too.
+TEST(DecodedKeyMaterialTest, DISABLED_LoadKeyLatency) {
+    struct {
+        const char* name;
+        const char* pk8_file;
+        keymaster_algorithm_t algorithm;
+    } keys[] = {
+        {"RSA", "rsa_privkey_pk8.der", KM_ALGORITHM_RSA},
+        {"EC", "ec_privkey_pk8.der", KM_ALGORITHM_EC},
+    };
+    for (auto& key : keys) {
+        KeymasterKeyBlob der_material, decoded_material;
+        ReadKeyMaterial(key.pk8_file, key.algorithm, false /* decoded */, &der_material);
+        ReadKeyMaterial(key.pk8_file, key.algorithm, true /* decoded */, &decoded_material);
+        TimeLoadKey(string(key.name) + ", DER", der_material, key.algorithm, true, 1000);
+        TimeLoadKey(string(key.name) + ", decoded", decoded_material, key.algorithm, true, 1000);
+    }
+}
+
 TEST(SoftKeymasterWrapperTest, CheckKeymaster2Device) {
     // Make a good fake device, and wrap it.
     SoftKeymasterDevice* good_fake(new SoftKeymasterDevice(new TestKeymasterContext));
@@ -4280,6 +5973,693 @@ TEST(SoftKeymasterWrapperTest, CheckKeymaster2Device) {
         sha256_only_fake_wrapper->hw_device());
 }
 
+typedef std::map<std::pair<keymaster_algorithm_t, keymaster_purpose_t>,
+                 std::vector<keymaster_digest_t>>
+    SupportedDigestMap;
+
+// Reference for the software-digesting decision: search the digests the wrapped device reports
+// for the algorithm/purpose pair.
+static bool ReferenceRequiresSoftwareDigesting(const SupportedDigestMap& supported,
+                                               keymaster_algorithm_t algorithm,
+                                               keymaster_purpose_t purpose,
+                                               const AuthorizationSet& params) {
+    auto digests = supported.find(std::make_pair(algorithm, purpose));
+    if (digests == supported.end())
+        return false;
+    for (auto& entry : params)
+        if (entry.tag == TAG_DIGEST && std::find(digests->second.begin(), digests->second.end(),
+                                                 entry.enumerated) == digests->second.end())
+            return true;
+    return false;
+}
+
+TEST(SoftKeymasterWrapperTest, SoftwareDigestingRoutingParity) {
+    keymaster1_device_t* fakes[] = {
+        (new SoftKeymasterDevice(new TestKeymasterContext("PseudoHW")))->keymaster_device(),
+        make_device_sha256_only(
+            (new SoftKeymasterDevice(new TestKeymasterContext("256")))->keymaster_device()),
+    };
+    keymaster_algorithm_t algorithms[] = {KM_ALGORITHM_RSA, KM_ALGORITHM_EC, KM_ALGORITHM_AES,
+                                          KM_ALGORITHM_TRIPLE_DES, KM_ALGORITHM_HMAC};
+    keymaster_purpose_t purposes[] = {KM_PURPOSE_ENCRYPT, KM_PURPOSE_DECRYPT,
+                                      KM_PURPOSE_SIGN,    KM_PURPOSE_VERIFY,
+                                      KM_PURPOSE_DERIVE_KEY, KM_PURPOSE_WRAP};
+    // All defined digests, plus one that no device supports.
+    uint32_t digests[] = {KM_DIGEST_NONE,      KM_DIGEST_MD5,       KM_DIGEST_SHA1,
+                          KM_DIGEST_SHA_2_224, KM_DIGEST_SHA_2_256, KM_DIGEST_SHA_2_384,
+                          KM_DIGEST_SHA_2_512, 40};
+
+    for (auto fake : fakes) {
+        // The pairs the wrapper queries the device for; any other pair is passed through.
+        SupportedDigestMap supported;
+        for (auto algorithm : {KM_ALGORITHM_RSA, KM_ALGORITHM_EC, KM_ALGORITHM_HMAC})
+            for (auto purpose : {KM_PURPOSE_SIGN, KM_PURPOSE_VERIFY})
+                supported[std::make_pair(algorithm, purpose)];
+        supported[std::make_pair(KM_ALGORITHM_RSA, KM_PURPOSE_ENCRYPT)];
+        supported[std::make_pair(KM_ALGORITHM_RSA, KM_PURPOSE_DECRYPT)];
+        for (auto& entry : supported) {
+            keymaster_digest_t* list;
+            size_t list_length;
+            ASSERT_EQ(KM_ERROR_OK, fake->get_supported_digests(fake, entry.first.first,
+                                                               entry.first.second, &list,
+                                                               &list_length));
+            entry.second.assign(list, list + list_length);
+            free(list);
+        }
+
+        SoftKeymasterDevice* wrapper(new SoftKeymasterDevice(new TestKeymasterContext));
+        ASSERT_EQ(KM_ERROR_OK, wrapper->SetHardwareDevice(fake));
+
+        for (auto algorithm : algorithms) {
+            for (uint32_t digest_subset = 0; digest_subset < (1u << array_length(digests));
+                 ++digest_subset) {
+                AuthorizationSet params;
+                for (size_t i = 0; i < array_length(digests); ++i)
+                    if (digest_subset & (1u << i))
+                        params.push_back(TAG_DIGEST, static_cast<keymaster_digest_t>(digests[i]));
+
+                for (auto purpose : purposes)
+                    EXPECT_EQ(
+                        ReferenceRequiresSoftwareDigesting(supported, algorithm, purpose, params),
+                        wrapper->RequiresSoftwareDigesting(algorithm, purpose, params))
+                        << "algorithm " << algorithm << " purpose " << purpose << " digests "
+                        << digest_subset;
+
+                for (uint32_t purpose_subset = 0; purpose_subset < (1u << array_length(purposes));
+                     ++purpose_subset) {
+                    AuthorizationSet key_description(params);
+                    key_description.push_back(TAG_ALGORITHM, algorithm);
+                    bool expected = false;
+                    for (size_t i = 0; i < array_length(purposes); ++i)
+                        if (purpose_subset & (1u << i)) {
+                            key_description.push_back(TAG_PURPOSE, purposes[i]);
+                            expected |= ReferenceRequiresSoftwareDigesting(supported, algorithm,
+                                                                           purposes[i], params);
+                        }
+                    EXPECT_EQ(expected, wrapper->KeyRequiresSoftwareDigesting(key_description))
+                        << "algorithm " << algorithm << " purposes " << purpose_subset
+                        << " digests " << digest_subset;
+                }
+            }
+        }
+
+        // Without an algorithm the hardware module is left to report the error.
+        EXPECT_FALSE(wrapper->KeyRequiresSoftwareDigesting(
+            AuthorizationSet(AuthorizationSetBuilder()
+                                 .Authorization(TAG_PURPOSE, KM_PURPOSE_SIGN)
+                                 .Authorization(TAG_DIGEST, static_cast<keymaster_digest_t>(40)))));
+
+        wrapper->keymaster_device()->common.close(wrapper->hw_device());
+    }
+}
+
+TEST(AllocationTrackerTest, ChargesOutermostScope) {
+    AllocationTracker::Reset();
+    {
+        AllocationScope scope(BEGIN_OPERATION);
+        scope.set_purpose(KM_PURPOSE_SIGN);
+        AllocationTracker::RecordAllocation(100);
+        {
+            AllocationScope inner(GENERATE_KEY);
+            AllocationTracker::RecordAllocation(50);
+            AllocationTracker::RecordFree(50);
+        }
+        AllocationTracker::RecordFree(100);
+        AllocationTracker::RecordFree(30);  // Allocated before the scope.
+    }
+    {
+        AllocationScope scope(BEGIN_OPERATION);
+        AllocationTracker::RecordAllocation(10);
+    }
+
+#ifndef KEYMASTER_TRACK_ALLOCATIONS
+    // Scopes do nothing.
+    EXPECT_EQ(0U, AllocationTracker::command_stats(BEGIN_OPERATION).calls);
+    EXPECT_EQ(0U, AllocationTracker::purpose_stats(KM_PURPOSE_SIGN).calls);
+#else
+    AllocationStats begin = AllocationTracker::command_stats(BEGIN_OPERATION);
+    EXPECT_EQ(2U, begin.calls);
+    EXPECT_EQ(3U, begin.allocations);
+    EXPECT_EQ(160U, begin.bytes);
+    EXPECT_EQ(150U, begin.peak_live_bytes);
+    EXPECT_EQ(0U, AllocationTracker::command_stats(GENERATE_KEY).calls);
+
+    AllocationStats sign = AllocationTracker::purpose_stats(KM_PURPOSE_SIGN);
+    EXPECT_EQ(1U, sign.calls);
+    EXPECT_EQ(150U, sign.bytes);
+    EXPECT_EQ(0U, AllocationTracker::purpose_stats(KM_PURPOSE_VERIFY).calls);
+
+    AllocationTracker::Reset();
+    EXPECT_EQ(0U, AllocationTracker::command_stats(BEGIN_OPERATION).calls);
+#endif  // KEYMASTER_TRACK_ALLOCATIONS
+}
+
+#ifdef KEYMASTER_TRACK_ALLOCATIONS
+TEST(AllocationTrackerTest, ChargesOwnThreadOnly) {
+    AllocationTracker::Reset();
+    // Creating and joining the thread allocates, so only the steps in between run in scopes.
+    std::atomic<int> step(0);
+    std::thread other([&step] {
+        while (step.load() != 1) {
+        }
+        AllocationTracker::RecordAllocation(500);  // Outside any scope on this thread.
+        {
+            AllocationScope scope(GENERATE_KEY);
+            AllocationTracker::RecordAllocation(1000);
+        }
+        step.store(2);
+    });
+    {
+        AllocationScope scope(BEGIN_OPERATION);
+        AllocationTracker::RecordAllocation(10);
+        step.store(1);
+        while (step.load() != 2) {
+        }
+    }
+    other.join();
+
+    AllocationStats begin = AllocationTracker::command_stats(BEGIN_OPERATION);
+    EXPECT_EQ(1U, begin.calls);
+    EXPECT_EQ(1U, begin.allocations);
+    EXPECT_EQ(10U, begin.bytes);
+    AllocationStats generate = AllocationTracker::command_stats(GENERATE_KEY);
+    EXPECT_EQ(1U, generate.calls);
+    EXPECT_EQ(1U, generate.allocations);
+    EXPECT_EQ(1000U, generate.bytes);
+}
+#endif  // KEYMASTER_TRACK_ALLOCATIONS
+
+/**
+ * Runs SoftKeymasterDevice over simulated keymaster0 and keymaster1 devices.  The benchmarks are
+ * disabled, so they only run with --gtest_also_run_disabled_tests, and print their timings, and
+ * their allocations when built with KEYMASTER_TRACK_ALLOCATIONS.
+ */
+class SimulatedDeviceTest : public testing::Test {
+  protected:
+    ~SimulatedDeviceTest() {
+        free(const_cast<uint8_t*>(blob_.key_material));
+        if (device_)
+            device_->keymaster_device()->common.close(device_->hw_device());
+    }
+
+    void UseSoftwareDevice() {
+        device_ = new SoftKeymasterDevice(new TestKeymasterContext);
+        Configure();
+    }
+
+    void UseKeymaster0Device() {
+        // The simulated device takes ownership of the software device, and device_ of it.
+        keymaster0_device_t* hw_device = make_simulated_keymaster0_device(
+            (new SoftKeymasterDevice(new TestKeymasterContext("PseudoHW")))->keymaster_device(),
+            &simulator_);
+        device_ = new SoftKeymasterDevice(new TestKeymasterContext);
+        ASSERT_EQ(KM_ERROR_OK, device_->SetHardwareDevice(hw_device));
+        Configure();
+    }
+
+    void UseKeymaster1Device() {
+        device_ = new SoftKeymasterDevice(new TestKeymasterContext);
+        ASSERT_EQ(KM_ERROR_OK, device_->SetHardwareDevice(MakeKeymaster1Device()));
+        Configure();
+    }
+
+    keymaster1_device_t* MakeKeymaster1Device() {
+        return make_simulated_keymaster1_device(
+            (new SoftKeymasterDevice(new TestKeymasterContext("PseudoHW")))->keymaster_device(),
+            &simulator_);
+    }
+
+    // A software device standing in for secure hardware, configured with the test's system
+    // version so that its keys load in a passthrough context configured with it too.
+    SoftKeymasterDevice* MakeConfiguredPseudoHwDevice() {
+        SoftKeymasterDevice* device = new SoftKeymasterDevice(new TestKeymasterContext("PseudoHW"));
+        AuthorizationSet version_info(AuthorizationSetBuilder()
+                                          .Authorization(TAG_OS_VERSION, kOsVersion)
+                                          .Authorization(TAG_OS_PATCHLEVEL, kOsPatchLevel));
+        keymaster2_device_t* km2_device = device->keymaster2_device();
+        EXPECT_EQ(KM_ERROR_OK, km2_device->configure(km2_device, &version_info));
+        return device;
+    }
+
+    // Begins and aborts an ECDSA signing operation with |blob| and returns the number of device
+    // calls that took.
+    size_t BeginCalls(AndroidKeymaster* keymaster, const keymaster_key_blob_t& blob) {
+        size_t calls = simulator_.stats().calls;
+        BeginOperationRequest begin_request;
+        begin_request.purpose = KM_PURPOSE_SIGN;
+        begin_request.SetKeyMaterial(blob);
+        begin_request.additional_params.push_back(TAG_DIGEST, KM_DIGEST_NONE);
+        BeginOperationResponse begin_response;
+        keymaster->BeginOperation(begin_request, &begin_response);
+        EXPECT_EQ(KM_ERROR_OK, begin_response.error);
+        if (begin_response.error == KM_ERROR_OK) {
+            AbortOperationRequest abort_request;
+            abort_request.op_handle = begin_response.op_handle;
+            AbortOperationResponse abort_response;
+            keymaster->AbortOperation(abort_request, &abort_response);
+            EXPECT_EQ(KM_ERROR_OK, abort_response.error);
+        }
+        return simulator_.stats().calls - calls;
+    }
+
+    // Checks that |keymaster|, which wraps a simulated device in a passthrough context, only asks
+    // the device for the characteristics of |blob|, one of the device's keys, when they may have
+    // changed.  The device doesn't revoke deleted or upgraded blobs, so |blob| keeps loading.
+    void CheckCharacteristicsCache(AndroidKeymaster* keymaster, const keymaster_key_blob_t& blob) {
+        ConfigureRequest configure_request;
+        configure_request.os_version = kOsVersion;
+        configure_request.os_patchlevel = kOsPatchLevel;
+        ConfigureResponse configure_response;
+        keymaster->Configure(configure_request, &configure_response);
+        ASSERT_EQ(KM_ERROR_OK, configure_response.error);
+
+        // The first Begin also sets up the context's key factories.
+        BeginCalls(keymaster, blob);
+        size_t cached = BeginCalls(keymaster, blob);
+        for (size_t i = 0; i < 5; ++i)
+            EXPECT_EQ(cached, BeginCalls(keymaster, blob));
+
+        // Configuring drops the cache, even with an unchanged version.
+        keymaster->Configure(configure_request, &configure_response);
+        ASSERT_EQ(KM_ERROR_OK, configure_response.error);
+        size_t uncached = BeginCalls(keymaster, blob);
+        EXPECT_GT(uncached, cached);
+        EXPECT_EQ(cached, BeginCalls(keymaster, blob));
+
+        DeleteKeyRequest delete_request;
+        delete_request.SetKeyMaterial(blob);
+        DeleteKeyResponse delete_response;
+        keymaster->DeleteKey(delete_request, &delete_response);
+        EXPECT_EQ(KM_ERROR_OK, delete_response.error);
+        EXPECT_EQ(uncached, BeginCalls(keymaster, blob));
+        EXPECT_EQ(cached, BeginCalls(keymaster, blob));
+
+        // Whether or not the upgrade succeeds, the caller may replace the blob.
+        UpgradeKeyRequest upgrade_request;
+        upgrade_request.SetKeyMaterial(blob);
+        UpgradeKeyResponse upgrade_response;
+        keymaster->UpgradeKey(upgrade_request, &upgrade_response);
+        EXPECT_EQ(uncached, BeginCalls(keymaster, blob));
+        EXPECT_EQ(cached, BeginCalls(keymaster, blob));
+
+        DeleteAllKeysRequest delete_all_request;
+        DeleteAllKeysResponse delete_all_response;
+        keymaster->DeleteAllKeys(delete_all_request, &delete_all_response);
+        EXPECT_EQ(uncached, BeginCalls(keymaster, blob));
+        EXPECT_EQ(cached, BeginCalls(keymaster, blob));
+    }
+
+    void Configure() {
+        AuthorizationSet version_info(AuthorizationSetBuilder()
+                                          .Authorization(TAG_OS_VERSION, kOsVersion)
+                                          .Authorization(TAG_OS_PATCHLEVEL, kOsPatchLevel));
+        ASSERT_EQ(KM_ERROR_OK, dev()->configure(dev(), &version_info));
+    }
+
+    keymaster2_device_t* dev() { return device_->keymaster2_device(); }
+
+    keymaster_error_t GenerateKey(AuthorizationSetBuilder builder) {
+        AuthorizationSet description(builder.Authorization(TAG_NO_AUTH_REQUIRED));
+        free(const_cast<uint8_t*>(blob_.key_material));
+        blob_ = {};
+        return dev()->generate_key(dev(), &description, &blob_, nullptr /* characteristics */);
+    }
+
+    keymaster_error_t Sign(const AuthorizationSet& params, const string& message,
+                           string* signature) {
+        keymaster_operation_handle_t handle;
+        keymaster_error_t error = dev()->begin(dev(), KM_PURPOSE_SIGN, &blob_, &params,
+                                               nullptr /* out_params */, &handle);
+        if (error != KM_ERROR_OK)
+            return error;
+
+        keymaster_blob_t input = {reinterpret_cast<const uint8_t*>(message.data()),
+                                  message.size()};
+        keymaster_blob_t output = {};
+        error = dev()->finish(dev(), handle, nullptr /* in_params */, &input,
+                              nullptr /* signature */, nullptr /* out_params */, &output);
+        if (error == KM_ERROR_OK)
+            signature->assign(reinterpret_cast<const char*>(output.data), output.data_length);
+        free(const_cast<uint8_t*>(output.data));
+        return error;
+    }
+
+    keymaster_error_t Verify(const AuthorizationSet& params, const string& message,
+                             const string& signature) {
+        keymaster_operation_handle_t handle;
+        keymaster_error_t error = dev()->begin(dev(), KM_PURPOSE_VERIFY, &blob_, &params,
+                                               nullptr /* out_params */, &handle);
+        if (error != KM_ERROR_OK)
+            return error;
+
+        keymaster_blob_t input = {reinterpret_cast<const uint8_t*>(message.data()),
+                                  message.size()};
+        keymaster_blob_t signature_blob = {reinterpret_cast<const uint8_t*>(signature.data()),
+                                           signature.size()};
+        return dev()->finish(dev(), handle, nullptr /* in_params */, &input, &signature_blob,
+                             nullptr /* out_params */, nullptr /* output */);
+    }
+
+    // Signs |count| messages and reports the time and the device calls per signature.
+    void TimeSigning(const string& label, const AuthorizationSet& params, size_t count) {
+        string message(32, 'a');
+        string signature;
+        simulator_.ResetStats();
+        AllocationTracker::Reset();
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i)
+            ASSERT_EQ(KM_ERROR_OK, Sign(params, message, &signature));
+        std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::steady_clock::now() - start;
+        std::cout << label << ": " << elapsed.count() / count << " us/signature, "
+                  << static_cast<double>(simulator_.stats().calls) / count
+                  << " device calls/signature";
+#ifdef KEYMASTER_TRACK_ALLOCATIONS
+        AllocationStats allocations = AllocationTracker::purpose_stats(KM_PURPOSE_SIGN);
+        std::cout << ", " << static_cast<double>(allocations.allocations) / count
+                  << " allocations/signature, " << static_cast<double>(allocations.bytes) / count
+                  << " bytes/signature, " << allocations.peak_live_bytes << " peak live bytes";
+#endif
+        std::cout << std::endl;
+    }
+
+    // Signs |count| messages on each of |threads| threads with wrapped keymaster1 ECDSA operations,
+    // which make their device calls through |engine|.
+    static void SignOnThreads(const Keymaster1Engine& engine, const KeymasterKeyBlob& blob,
+                              size_t threads, size_t count) {
+        std::vector<std::thread> signers;
+        for (size_t i = 0; i < threads; ++i)
+            signers.emplace_back([&] {
+                AuthorizationSet begin_params(AuthorizationSetBuilder().Digest(KM_DIGEST_NONE));
+                string message(32, 'a');
+                for (size_t j = 0; j < count; ++j) {
+                    keymaster_error_t error;
+                    unique_ptr<EC_KEY, EC_KEY_Delete> ec_key(
+                        engine.BuildEcKey(blob, AuthorizationSet(), &error));
+                    ASSERT_EQ(KM_ERROR_OK, error);
+                    unique_ptr<EVP_PKEY, EVP_PKEY_Delete> pkey(EVP_PKEY_new());
+                    ASSERT_EQ(1, EVP_PKEY_set1_EC_KEY(pkey.get(), ec_key.get()));
+
+                    EcdsaKeymaster1Operation<EcdsaSignOperation> op(
+                        AuthorizationSet(), AuthorizationSet(), KM_DIGEST_NONE, pkey.release(),
+                        &engine);
+                    AuthorizationSet output_params;
+                    ASSERT_EQ(KM_ERROR_OK, op.Begin(begin_params, &output_params));
+                    Buffer signature;
+                    ASSERT_EQ(KM_ERROR_OK,
+                              op.Finish(AuthorizationSet(), Buffer(message.data(), message.size()),
+                                        Buffer(), &output_params, &signature));
+                    EXPECT_GT(signature.available_read(), 0U);
+                }
+            });
+        for (auto& signer : signers)
+            signer.join();
+    }
+
+    DeviceSimulator simulator_;
+    SoftKeymasterDevice* device_ = nullptr;
+    keymaster_key_blob_t blob_ = {};
+};
+
+TEST_F(SimulatedDeviceTest, Keymaster0Signing) {
+    UseKeymaster0Device();
+
+    struct {
+        AuthorizationSetBuilder key;
+        AuthorizationSet params;
+    } cases[] = {
+        {AuthorizationSetBuilder().RsaSigningKey(1024, 65537).Digest(KM_DIGEST_SHA_2_256).Padding(
+             KM_PAD_RSA_PKCS1_1_5_SIGN),
+         AuthorizationSet(AuthorizationSetBuilder()
+                              .Digest(KM_DIGEST_SHA_2_256)
+                              .Padding(KM_PAD_RSA_PKCS1_1_5_SIGN))},
+        {AuthorizationSetBuilder().EcdsaSigningKey(256).Digest(KM_DIGEST_SHA_2_256),
+         AuthorizationSet(AuthorizationSetBuilder().Digest(KM_DIGEST_SHA_2_256))},
+    };
+    for (auto& test_case : cases) {
+        ASSERT_EQ(KM_ERROR_OK, GenerateKey(test_case.key));
+
+        // The private key operation is the keymaster0 device's.
+        string message = "Hello World!";
+        string signature;
+        simulator_.ResetStats();
+        ASSERT_EQ(KM_ERROR_OK, Sign(test_case.params, message, &signature));
+        EXPECT_GT(simulator_.stats().calls, 0U);
+        EXPECT_EQ(KM_ERROR_OK, Verify(test_case.params, message, signature));
+        ++signature[signature.size() / 2];
+        EXPECT_EQ(KM_ERROR_VERIFICATION_FAILED, Verify(test_case.params, message, signature));
+    }
+}
+
+TEST_F(SimulatedDeviceTest, InjectedFailuresReachCaller) {
+    UseKeymaster1Device();
+
+    DeviceSimulationParams params;
+    params.failure_rate = 1;
+    simulator_.set_params(params);
+    EXPECT_EQ(KM_ERROR_SECURE_HW_COMMUNICATION_FAILED,
+              GenerateKey(AuthorizationSetBuilder().EcdsaSigningKey(256).Digest(KM_DIGEST_NONE)));
+    EXPECT_GT(simulator_.stats().injected_failures, 0U);
+
+    simulator_.set_params(DeviceSimulationParams());
+    EXPECT_EQ(KM_ERROR_OK,
+              GenerateKey(AuthorizationSetBuilder().EcdsaSigningKey(256).Digest(KM_DIGEST_NONE)));
+}
+
+TEST_F(SimulatedDeviceTest, ConcurrencyLimit) {
+    DeviceSimulationParams params;
+    params.call_latency = std::chrono::milliseconds(2);
+    params.max_concurrent_calls = 2;
+    simulator_.set_params(params);
+    keymaster1_device_t* hw_device = MakeKeymaster1Device();
+
+    auto call_on_threads = [hw_device] {
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < 4; ++i)
+            threads.emplace_back([hw_device] {
+                for (size_t j = 0; j < 5; ++j) {
+                    keymaster_algorithm_t* algorithms;
+                    size_t algorithms_length;
+                    EXPECT_EQ(KM_ERROR_OK, hw_device->get_supported_algorithms(
+                                               hw_device, &algorithms, &algorithms_length));
+                    free(algorithms);
+                }
+            });
+        for (auto& thread : threads)
+            thread.join();
+    };
+
+    // However the threads are scheduled, no more than two calls are in the device at once.
+    call_on_threads();
+    EXPECT_EQ(20U, simulator_.stats().calls);
+    EXPECT_LE(simulator_.stats().max_concurrent_calls, 2U);
+
+    // When the first calls wait for each other, two get in together.
+    params.rendezvous_calls = 2;
+    simulator_.set_params(params);
+    simulator_.ResetStats();
+    call_on_threads();
+    EXPECT_EQ(20U, simulator_.stats().calls);
+    EXPECT_EQ(2U, simulator_.stats().max_concurrent_calls);
+    hw_device->common.close(&hw_device->common);
+}
+
+TEST_F(SimulatedDeviceTest, Keymaster1PassthroughCachesCharacteristics) {
+    keymaster1_device_t* hw_device = make_simulated_keymaster1_device(
+        MakeConfiguredPseudoHwDevice()->keymaster_device(), &simulator_);
+    AuthorizationSet description(
+        AuthorizationSetBuilder().EcdsaSigningKey(256).Digest(KM_DIGEST_NONE).Authorization(
+            TAG_NO_AUTH_REQUIRED));
+    keymaster_key_blob_t blob;
+    ASSERT_EQ(KM_ERROR_OK, hw_device->generate_key(hw_device, &description, &blob,
+                                                   nullptr /* characteristics */));
+
+    // The context's engine closes hw_device.
+    AndroidKeymaster keymaster(new Keymaster1PassthroughContext(hw_device), 16);
+    CheckCharacteristicsCache(&keymaster, blob);
+    free(const_cast<uint8_t*>(blob.key_material));
+}
+
+TEST_F(SimulatedDeviceTest, Keymaster2PassthroughCachesCharacteristics) {
+    keymaster2_device_t* hw_device = make_simulated_keymaster2_device(
+        MakeConfiguredPseudoHwDevice()->keymaster2_device(), &simulator_);
+    AuthorizationSet description(
+        AuthorizationSetBuilder().EcdsaSigningKey(256).Digest(KM_DIGEST_NONE).Authorization(
+            TAG_NO_AUTH_REQUIRED));
+    keymaster_key_blob_t blob;
+    ASSERT_EQ(KM_ERROR_OK, hw_device->generate_key(hw_device, &description, &blob,
+                                                   nullptr /* characteristics */));
+
+    {
+        AndroidKeymaster keymaster(new Keymaster2PassthroughContext(hw_device), 16);
+        CheckCharacteristicsCache(&keymaster, blob);
+    }
+    free(const_cast<uint8_t*>(blob.key_material));
+    hw_device->common.close(&hw_device->common);
+}
+
+TEST_F(SimulatedDeviceTest, DISABLED_Keymaster1ShimOverhead) {
+    AuthorizationSet params(AuthorizationSetBuilder().Digest(KM_DIGEST_SHA_2_256));
+    UseSoftwareDevice();
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder().EcdsaSigningKey(256).Digest(
+                               KM_DIGEST_SHA_2_256)));
+    TimeSigning("Software ECDSA", params, 500);
+
+    device_->keymaster_device()->common.close(device_->hw_device());
+    UseKeymaster1Device();
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder().EcdsaSigningKey(256).Digest(
+                               KM_DIGEST_SHA_2_256)));
+    TimeSigning("Keymaster1 ECDSA", params, 500);
+}
+
+TEST_F(SimulatedDeviceTest, DISABLED_Keymaster0ShimOverhead) {
+    AuthorizationSet params(
+        AuthorizationSetBuilder().Digest(KM_DIGEST_SHA_2_256).Padding(KM_PAD_RSA_PKCS1_1_5_SIGN));
+    AuthorizationSetBuilder key = AuthorizationSetBuilder()
+                                      .RsaSigningKey(2048, 65537)
+                                      .Digest(KM_DIGEST_SHA_2_256)
+                                      .Padding(KM_PAD_RSA_PKCS1_1_5_SIGN);
+    UseSoftwareDevice();
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(key));
+    TimeSigning("Software RSA", params, 100);
+
+    device_->keymaster_device()->common.close(device_->hw_device());
+    UseKeymaster0Device();
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(key));
+    TimeSigning("Keymaster0 RSA", params, 100);
+}
+
+TEST_F(SimulatedDeviceTest, DISABLED_SlowKeymaster1Device) {
+    AuthorizationSet params(AuthorizationSetBuilder().Digest(KM_DIGEST_SHA_2_256));
+    UseKeymaster1Device();
+    ASSERT_EQ(KM_ERROR_OK, GenerateKey(AuthorizationSetBuilder().EcdsaSigningKey(256).Digest(
+                               KM_DIGEST_SHA_2_256)));
+
+    for (auto latency_us : {0, 100, 1000, 5000}) {
+        DeviceSimulationParams simulation;
+        simulation.call_latency = std::chrono::microseconds(latency_us);
+        simulator_.set_params(simulation);
+        TimeSigning("Keymaster1 ECDSA, " + std::to_string(latency_us) + " us/call", params, 100);
+    }
+}
+
+TEST_F(SimulatedDeviceTest, DISABLED_SlowDeviceConcurrency) {
+    keymaster1_device_t* hw_device = MakeKeymaster1Device();
+    AuthorizationSet description(
+        AuthorizationSetBuilder().EcdsaSigningKey(256).Digest(KM_DIGEST_NONE).Authorization(
+            TAG_NO_AUTH_REQUIRED));
+    keymaster_key_blob_t blob;
+    ASSERT_EQ(KM_ERROR_OK, hw_device->generate_key(hw_device, &description, &blob,
+                                                   nullptr /* characteristics */));
+    AuthorizationSet begin_params(AuthorizationSetBuilder().Digest(KM_DIGEST_NONE));
+
+    const size_t kThreads = 8;
+    const size_t kSignaturesPerThread = 25;
+    for (size_t slots : {1, 2, 4, 8}) {
+        DeviceSimulationParams simulation;
+        simulation.call_latency = std::chrono::microseconds(200);
+        simulation.crypto_latency = std::chrono::microseconds(800);
+        simulation.max_concurrent_calls = slots;
+        simulator_.set_params(simulation);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < kThreads; ++i)
+            threads.emplace_back([&] {
+                string message(32, 'a');
+                for (size_t j = 0; j < kSignaturesPerThread; ++j) {
+                    keymaster_operation_handle_t handle;
+                    ASSERT_EQ(KM_ERROR_OK,
+                              hw_device->begin(hw_device, KM_PURPOSE_SIGN, &blob, &begin_params,
+                                               nullptr /* out_params */, &handle));
+                    keymaster_blob_t input = {reinterpret_cast<const uint8_t*>(message.data()),
+                                              message.size()};
+                    size_t consumed;
+                    keymaster_blob_t output = {};
+                    ASSERT_EQ(KM_ERROR_OK, hw_device->update(hw_device, handle,
+                                                             nullptr /* in_params */, &input,
+                                                             &consumed, nullptr /* out_params */,
+                                                             &output));
+                    free(const_cast<uint8_t*>(output.data));
+                    ASSERT_EQ(KM_ERROR_OK, hw_device->finish(hw_device, handle,
+                                                             nullptr /* in_params */,
+                                                             nullptr /* signature */,
+                                                             nullptr /* out_params */, &output));
+                    free(const_cast<uint8_t*>(output.data));
+                }
+            });
+        for (auto& thread : threads)
+            thread.join();
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << kThreads << " threads, " << slots << " device slots: "
+                  << kThreads * kSignaturesPerThread / elapsed.count() << " signatures/s"
+                  << std::endl;
+    }
+
+    free(const_cast<uint8_t*>(blob.key_material));
+    hw_device->common.close(&hw_device->common);
+}
+
+TEST_F(SimulatedDeviceTest, Keymaster1EngineCallLimit) {
+    DeviceSimulationParams params;
+    params.call_latency = std::chrono::milliseconds(2);
+    simulator_.set_params(params);
+
+    for (size_t limit : {1, 3}) {
+        Keymaster1Engine engine(MakeKeymaster1Device(), limit);
+        AuthorizationSet description(
+            AuthorizationSetBuilder().EcdsaSigningKey(256).Digest(KM_DIGEST_NONE).Authorization(
+                TAG_NO_AUTH_REQUIRED));
+        KeymasterKeyBlob blob;
+        ASSERT_EQ(KM_ERROR_OK, engine.GenerateKey(description, &blob, nullptr /* hw_enforced */,
+                                                  nullptr /* sw_enforced */));
+
+        // However the threads are scheduled, the engine keeps to its limit.
+        simulator_.ResetStats();
+        SignOnThreads(engine, blob, 6 /* threads */, 3 /* signatures per thread */);
+        // Each signature takes an export, a begin, an update and a finish.
+        EXPECT_EQ(6U * 3 * 4, simulator_.stats().calls);
+        EXPECT_LE(simulator_.stats().max_concurrent_calls, limit);
+
+        // When the first calls wait for each other, the engine lets the limit's worth in.
+        DeviceSimulationParams rendezvous_params = params;
+        rendezvous_params.rendezvous_calls = limit;
+        simulator_.set_params(rendezvous_params);
+        simulator_.ResetStats();
+        SignOnThreads(engine, blob, 6 /* threads */, 3 /* signatures per thread */);
+        EXPECT_EQ(6U * 3 * 4, simulator_.stats().calls);
+        EXPECT_EQ(limit, simulator_.stats().max_concurrent_calls);
+        simulator_.set_params(params);
+    }
+}
+
+TEST_F(SimulatedDeviceTest, DISABLED_Keymaster1EngineConcurrency) {
+    DeviceSimulationParams params;
+    params.call_latency = std::chrono::microseconds(500);
+    params.crypto_latency = std::chrono::microseconds(500);
+    simulator_.set_params(params);
+
+    const size_t kThreads = 8;
+    const size_t kSignaturesPerThread = 10;
+    for (size_t limit : {1, 2, 4, 8}) {
+        Keymaster1Engine engine(MakeKeymaster1Device(), limit);
+        AuthorizationSet description(
+            AuthorizationSetBuilder().EcdsaSigningKey(256).Digest(KM_DIGEST_NONE).Authorization(
+                TAG_NO_AUTH_REQUIRED));
+        KeymasterKeyBlob blob;
+        ASSERT_EQ(KM_ERROR_OK, engine.GenerateKey(description, &blob, nullptr /* hw_enforced */,
+                                                  nullptr /* sw_enforced */));
+
+        auto start = std::chrono::steady_clock::now();
+        SignOnThreads(engine, blob, kThreads, kSignaturesPerThread);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << kThreads << " threads, " << limit << " concurrent device calls: "
+                  << kThreads * kSignaturesPerThread / elapsed.count() << " signatures/s"
+                  << std::endl;
+    }
+}
+
 class HmacKeySharingTest : public ::testing::Test {
   protected:
     using KeymasterVec = std::vector<std::unique_ptr<AndroidKeymaster>>;
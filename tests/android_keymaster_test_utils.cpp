@@ -613,8 +613,14 @@ keymaster_error_t Keymaster2Test::GetCharacteristics() {
 }
 
 keymaster_error_t Keymaster2Test::ExportKey(keymaster_key_format_t format, string* export_data) {
+    return ExportKey(format, client_id_, export_data);
+}
+
+keymaster_error_t Keymaster2Test::ExportKey(keymaster_key_format_t format,
+                                            const keymaster_blob_t& client_id,
+                                            string* export_data) {
     keymaster_blob_t export_tmp;
-    keymaster_error_t error = device()->export_key(device(), format, &blob_, &client_id_,
+    keymaster_error_t error = device()->export_key(device(), format, &blob_, &client_id,
                                                    nullptr /* app_data */, &export_tmp);
 
     if (error != KM_ERROR_OK)
@@ -191,6 +191,8 @@ class Keymaster2Test : public testing::TestWithParam<InstanceCreatorPtr> {
                                 keymaster_key_format_t format, const std::string& key_material);
 
     keymaster_error_t ExportKey(keymaster_key_format_t format, std::string* export_data);
+    keymaster_error_t ExportKey(keymaster_key_format_t format, const keymaster_blob_t& client_id,
+                                std::string* export_data);
 
     keymaster_error_t GetCharacteristics();
 
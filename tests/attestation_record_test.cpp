@@ -140,5 +140,65 @@ TEST(AttestTest, Simple) {
     delete[] verified_boot_key.data;
 }
 
+TEST(AttestTest, AllAttestedTagsRoundTrip) {
+    TestContext context;
+    AuthorizationSet hw_set(AuthorizationSetBuilder()
+                                .HmacKey(256)
+                                .Digest(KM_DIGEST_SHA_2_256)
+                                .Authorization(TAG_MIN_MAC_LENGTH, 128)
+                                .Authorization(TAG_KDF, KM_KDF_RFC5869_SHA256)
+                                .Authorization(TAG_CALLER_NONCE)
+                                .Authorization(TAG_ALLOW_WHILE_ON_BODY)
+                                .Authorization(TAG_UNLOCKED_DEVICE_REQUIRED)
+                                .Authorization(TAG_USER_AUTH_TYPE, HW_AUTH_PASSWORD)
+                                .Authorization(TAG_AUTH_TIMEOUT, 300)
+                                .Authorization(TAG_OS_VERSION, 60000));
+    AuthorizationSet sw_set(AuthorizationSetBuilder()
+                                .Authorization(TAG_USAGE_EXPIRE_DATETIME, 20)
+                                .Authorization(TAG_CREATION_DATETIME, 10)
+                                .Authorization(TAG_ALL_APPLICATIONS)
+                                // Not attested.
+                                .Authorization(TAG_APPLICATION_DATA, "app_data", 8)
+                                .Authorization(TAG_USER_ID, 7)
+                                .Authorization(TAG_TRUSTED_CONFIRMATION_REQUIRED));
+
+    UniquePtr<uint8_t[]> asn1;
+    size_t asn1_len = 0;
+    AuthorizationSet attest_params(
+        AuthorizationSetBuilder()
+            .Authorization(TAG_ATTESTATION_CHALLENGE, "fake_challenge", 14)
+            .Authorization(TAG_ATTESTATION_APPLICATION_ID, "fake_attest_app_id", 18));
+    ASSERT_EQ(KM_ERROR_OK,
+              build_attestation_record(attest_params, sw_set, hw_set, context, &asn1, &asn1_len));
+
+    AuthorizationSet parsed_hw_set;
+    AuthorizationSet parsed_sw_set;
+    uint32_t attestation_version;
+    uint32_t keymaster_version;
+    keymaster_security_level_t attestation_security_level;
+    keymaster_security_level_t keymaster_security_level;
+    keymaster_blob_t attestation_challenge = {};
+    keymaster_blob_t unique_id = {};
+    ASSERT_EQ(KM_ERROR_OK,
+              parse_attestation_record(asn1.get(), asn1_len, &attestation_version,
+                                       &attestation_security_level, &keymaster_version,
+                                       &keymaster_security_level, &attestation_challenge,
+                                       &parsed_sw_set, &parsed_hw_set, &unique_id));
+    delete[] attestation_challenge.data;
+    delete[] unique_id.data;
+
+    sw_set.push_back(TAG_ATTESTATION_APPLICATION_ID, "fake_attest_app_id", 18);
+    sw_set.erase(sw_set.find(TAG_APPLICATION_DATA));
+    sw_set.erase(sw_set.find(TAG_USER_ID));
+    sw_set.erase(sw_set.find(TAG_TRUSTED_CONFIRMATION_REQUIRED));
+
+    hw_set.Sort();
+    sw_set.Sort();
+    parsed_hw_set.Sort();
+    parsed_sw_set.Sort();
+    EXPECT_EQ(hw_set, parsed_hw_set);
+    EXPECT_EQ(sw_set, parsed_sw_set);
+}
+
 }  // namespace test
 }  // namespace keymaster
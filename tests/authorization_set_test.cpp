@@ -750,5 +750,315 @@ TEST(Difference, NullSet) {
     EXPECT_EQ(expected, set1);
 }
 
+TEST(Union, ManyRepeatedTags) {
+    // Unsorted sets with lots of repeated tags and values, and blobs on both sides.
+    AuthorizationSet set1, set2;
+    for (uint32_t i = 0; i < 200; ++i) {
+        set1.push_back(TAG_USER_SECURE_ID, (i * 7) % 50);
+        set2.push_back(TAG_USER_SECURE_ID, (i * 11) % 80);
+        if (i % 10 == 0) set1.push_back(TAG_APPLICATION_DATA, "data", 4 - i % 3);
+        if (i % 15 == 0) set2.push_back(TAG_APPLICATION_DATA, "data", 4 - i % 4);
+    }
+
+    set1.Union(set2);
+    EXPECT_EQ(80U + 4U, set1.size());
+    // Sorted without dups, so the secure IDs must be 0 to 79, in order.
+    for (size_t i = 1; i < set1.size(); ++i)
+        EXPECT_LT(keymaster_param_compare(&set1[i - 1], &set1[i]), 0);
+    for (size_t i = 0; i < 80; ++i) {
+        uint64_t id;
+        EXPECT_TRUE(set1.GetTagValue(TAG_USER_SECURE_ID, i, &id));
+        EXPECT_EQ(i, id);
+    }
+}
+
+TEST(Difference, ManyRepeatedTags) {
+    AuthorizationSet set1, set2;
+    for (uint32_t i = 0; i < 200; ++i) {
+        set1.push_back(TAG_USER_SECURE_ID, (i * 7) % 100);
+        set2.push_back(TAG_USER_SECURE_ID, (i * 13) % 100 * 2);
+    }
+    set1.push_back(TAG_APPLICATION_DATA, "data", 4);
+    set2.push_back(TAG_APPLICATION_DATA, "data", 4);
+
+    set1.Difference(set2);
+    ASSERT_EQ(50U, set1.size());
+    for (size_t i = 0; i < set1.size(); ++i) {
+        EXPECT_EQ(KM_TAG_USER_SECURE_ID, set1[i].tag);
+        EXPECT_EQ(1U, set1[i].long_integer % 2);
+    }
+}
+
+TEST(Deduplication, RemembersSortedSets) {
+    AuthorizationSet set(AuthorizationSetBuilder()
+                             .Authorization(TAG_PURPOSE, KM_PURPOSE_VERIFY)
+                             .Authorization(TAG_PURPOSE, KM_PURPOSE_SIGN)
+                             .Authorization(TAG_KEY_SIZE, 256));
+    set.Deduplicate();
+    ASSERT_EQ(3U, set.size());
+
+    // Adding in order keeps the set deduplicated; adding a dup or out of order doesn't.
+    EXPECT_TRUE(set.push_back(TAG_ACTIVE_DATETIME, 10));
+    set.Deduplicate();
+    EXPECT_EQ(4U, set.size());
+    EXPECT_TRUE(set.push_back(TAG_KEY_SIZE, 256));
+    EXPECT_TRUE(set.push_back(TAG_ALGORITHM, KM_ALGORITHM_AES));
+    set.Deduplicate();
+    EXPECT_EQ(5U, set.size());
+    for (size_t i = 1; i < set.size(); ++i)
+        EXPECT_LT(keymaster_param_compare(&set[i - 1], &set[i]), 0);
+}
+
+TEST(Serialization, SizeTracksChanges) {
+    AuthorizationSet set(AuthorizationSetBuilder()
+                             .Authorization(TAG_KEY_SIZE, 256)
+                             .Authorization(TAG_APPLICATION_ID, "my_app", 6)
+                             .Authorization(TAG_KEY_SIZE, 256));
+    size_t size = set.SerializedSize();
+
+    // Deserializing picks up the size of the elements from the data.
+    UniquePtr<uint8_t[]> buf(new uint8_t[size]);
+    EXPECT_EQ(buf.get() + size, set.Serialize(buf.get(), buf.get() + size));
+    AuthorizationSet deserialized(buf.get(), size);
+    EXPECT_EQ(size, deserialized.SerializedSize());
+
+    EXPECT_TRUE(set.push_back(TAG_ALGORITHM, KM_ALGORITHM_AES));
+    EXPECT_EQ(size + 2 * sizeof(uint32_t), set.SerializedSize());
+    set.Deduplicate();
+    EXPECT_EQ(size, set.SerializedSize());
+    EXPECT_TRUE(set.erase(set.find(TAG_KEY_SIZE)));
+    size -= 2 * sizeof(uint32_t);
+    EXPECT_EQ(size, set.SerializedSize());
+    set[0].tag = KM_TAG_ACTIVE_DATETIME;  // From an enum to a date.
+    EXPECT_EQ(size + sizeof(uint64_t) - sizeof(uint32_t), set.SerializedSize());
+    set.Clear();
+    EXPECT_EQ(AuthorizationSet().SerializedSize(), set.SerializedSize());
+}
+
+TEST(Serialization, SizeSeesWritesThroughHeldReferences) {
+    AuthorizationSet set(AuthorizationSetBuilder()
+                             .Authorization(TAG_PURPOSE, KM_PURPOSE_SIGN)
+                             .Authorization(TAG_KEY_SIZE, 256));
+    keymaster_key_param_t& param = set[1];
+    size_t size = set.SerializedSize();
+
+    // The size was computed after the reference was taken, but must still see the write.
+    param.tag = KM_TAG_ACTIVE_DATETIME;  // From an int to a date.
+    param.date_time = 10;
+    EXPECT_EQ(size + sizeof(uint64_t) - sizeof(uint32_t), set.SerializedSize());
+    UniquePtr<uint8_t[]> buf(new uint8_t[set.SerializedSize()]);
+    EXPECT_EQ(buf.get() + set.SerializedSize(),
+              set.Serialize(buf.get(), buf.get() + set.SerializedSize()));
+    AuthorizationSet deserialized(buf.get(), set.SerializedSize());
+    EXPECT_EQ(set, deserialized);
+
+    // Nor may a deduplicated set stay deduplicated.
+    set.Deduplicate();
+    param.tag = KM_TAG_PURPOSE;
+    param.enumerated = KM_PURPOSE_SIGN;
+    set.Deduplicate();
+    EXPECT_EQ(1U, set.size());
+}
+
+TEST(Borrowed, ReadsCallerData) {
+    keymaster_key_param_t params[] = {
+        Authorization(TAG_PURPOSE, KM_PURPOSE_SIGN),
+        Authorization(TAG_APPLICATION_ID, "my_app", 6),
+        Authorization(TAG_KEY_SIZE, 256),
+    };
+    AuthorizationSet set;
+    set.ReinitializeBorrowed(params, array_length(params));
+    EXPECT_TRUE(set.is_borrowed());
+    EXPECT_EQ(params, set.data());
+    EXPECT_EQ(3U, set.size());
+    EXPECT_EQ(6U, set.indirect_size());
+
+    keymaster_blob_t blob;
+    EXPECT_TRUE(set.GetTagValue(TAG_APPLICATION_ID, &blob));
+    EXPECT_EQ(params[1].blob.data, blob.data);
+    EXPECT_EQ(AuthorizationSet(params, array_length(params)), set);
+}
+
+TEST(Borrowed, CopiesOnWrite) {
+    keymaster_key_param_t params[] = {
+        Authorization(TAG_KEY_SIZE, 256),
+        Authorization(TAG_APPLICATION_ID, "my_app", 6),
+        Authorization(TAG_PURPOSE, KM_PURPOSE_SIGN),
+    };
+    keymaster_key_param_t original[array_length(params)];
+    memcpy(original, params, sizeof(params));
+
+    AuthorizationSet set;
+    set.ReinitializeBorrowed(params, array_length(params));
+    EXPECT_TRUE(set.push_back(TAG_ALGORITHM, KM_ALGORITHM_RSA));
+    EXPECT_FALSE(set.is_borrowed());
+    EXPECT_NE(params, set.data());
+    EXPECT_EQ(4U, set.size());
+    set.Sort();
+    EXPECT_TRUE(set.erase(0));
+
+    // The caller's array, and the blob it points at, are untouched.
+    EXPECT_EQ(0, memcmp(original, params, sizeof(params)));
+    int pos = set.find(TAG_APPLICATION_ID);
+    ASSERT_NE(-1, pos);
+    EXPECT_NE(params[1].blob.data, set[pos].blob.data);
+    EXPECT_EQ(0, memcmp(set[pos].blob.data, "my_app", 6));
+}
+
+TEST(Borrowed, ClearLeavesCallerData) {
+    keymaster_key_param_t params[] = {
+        Authorization(TAG_PURPOSE, KM_PURPOSE_SIGN),
+    };
+    {
+        AuthorizationSet set;
+        set.ReinitializeBorrowed(params, array_length(params));
+        set.Clear();
+        EXPECT_FALSE(set.is_borrowed());
+        EXPECT_EQ(0U, set.size());
+        set.ReinitializeBorrowed(params, array_length(params));
+    }
+    EXPECT_EQ(KM_TAG_PURPOSE, params[0].tag);
+    EXPECT_EQ(KM_PURPOSE_SIGN, static_cast<keymaster_purpose_t>(params[0].enumerated));
+}
+
+TEST(Borrowed, SerializesLikeCopy) {
+    keymaster_key_param_t params[] = {
+        Authorization(TAG_APPLICATION_DATA, "app_data", 8),
+        Authorization(TAG_PURPOSE, KM_PURPOSE_SIGN),
+        Authorization(TAG_APPLICATION_ID, "my_app", 6),
+        Authorization(TAG_KEY_SIZE, 256),
+    };
+    AuthorizationSet borrowed;
+    borrowed.ReinitializeBorrowed(params, array_length(params));
+    AuthorizationSet copied(params, array_length(params));
+
+    size_t size = borrowed.SerializedSize();
+    ASSERT_EQ(copied.SerializedSize(), size);
+    UniquePtr<uint8_t[]> borrowed_buf(new uint8_t[size]);
+    UniquePtr<uint8_t[]> copied_buf(new uint8_t[size]);
+    EXPECT_EQ(borrowed_buf.get() + size,
+              borrowed.Serialize(borrowed_buf.get(), borrowed_buf.get() + size));
+    EXPECT_EQ(copied_buf.get() + size, copied.Serialize(copied_buf.get(), copied_buf.get() + size));
+    EXPECT_EQ(0, memcmp(borrowed_buf.get(), copied_buf.get(), size));
+
+    AuthorizationSet deserialized(borrowed_buf.get(), size);
+    EXPECT_EQ(AuthorizationSet::OK, deserialized.is_valid());
+    EXPECT_EQ(copied, deserialized);
+}
+
+TEST(Interner, SharesIdenticalSets) {
+    AuthorizationSetInterner interner;
+    AuthorizationSet set1(AuthorizationSetBuilder()
+                              .Authorization(TAG_APPLICATION_ID, "my_app", 6)
+                              .Authorization(TAG_KEY_SIZE, 256));
+    AuthorizationSet set2(set1);
+    AuthorizationSet other(AuthorizationSetBuilder()
+                               .Authorization(TAG_APPLICATION_ID, "my_app", 6)
+                               .Authorization(TAG_KEY_SIZE, 128));
+
+    ASSERT_TRUE(interner.Intern(&set1));
+    ASSERT_TRUE(interner.Intern(&set2));
+    ASSERT_TRUE(interner.Intern(&other));
+    EXPECT_TRUE(set1.is_shared());
+    EXPECT_EQ(set1.data(), set2.data());
+    EXPECT_NE(set1.data(), other.data());
+    EXPECT_EQ(2U, interner.size());
+
+    // Copies share too, and serialize like the original.
+    AuthorizationSet copy(set1);
+    EXPECT_TRUE(copy.is_shared());
+    EXPECT_EQ(set1.data(), copy.data());
+    AuthorizationSet assigned;
+    assigned = other;
+    EXPECT_EQ(other.data(), assigned.data());
+
+    size_t size = copy.SerializedSize();
+    UniquePtr<uint8_t[]> buf(new uint8_t[size]);
+    EXPECT_EQ(buf.get() + size, copy.Serialize(buf.get(), buf.get() + size));
+    EXPECT_EQ(set2, AuthorizationSet(buf.get(), size));
+}
+
+TEST(Interner, CopiesOnWrite) {
+    AuthorizationSetInterner interner;
+    AuthorizationSet set1(AuthorizationSetBuilder()
+                              .Authorization(TAG_APPLICATION_ID, "my_app", 6)
+                              .Authorization(TAG_KEY_SIZE, 256));
+    ASSERT_TRUE(interner.Intern(&set1));
+    AuthorizationSet set2(set1);
+
+    EXPECT_TRUE(set2.push_back(TAG_ALGORITHM, KM_ALGORITHM_AES));
+    EXPECT_FALSE(set2.is_shared());
+    EXPECT_EQ(3U, set2.size());
+    EXPECT_EQ(2U, set1.size());
+    EXPECT_TRUE(set1.is_shared());
+
+    set1.Sort();
+    EXPECT_FALSE(set1.is_shared());
+    AuthorizationSet shared(set1);
+    ASSERT_TRUE(interner.Intern(&shared));
+    EXPECT_EQ(2U, interner.size());
+    keymaster_blob_t blob;
+    EXPECT_TRUE(shared.GetTagValue(TAG_APPLICATION_ID, &blob));
+    EXPECT_EQ(0, memcmp(blob.data, "my_app", 6));
+}
+
+TEST(Interner, PurgeReleasesUnusedSets) {
+    AuthorizationSetInterner interner;
+    AuthorizationSet kept(AuthorizationSetBuilder().Authorization(TAG_KEY_SIZE, 256));
+    ASSERT_TRUE(interner.Intern(&kept));
+    {
+        AuthorizationSet dropped(AuthorizationSetBuilder().Authorization(TAG_KEY_SIZE, 128));
+        ASSERT_TRUE(interner.Intern(&dropped));
+    }
+    EXPECT_EQ(2U, interner.size());
+    interner.Purge();
+    EXPECT_EQ(1U, interner.size());
+
+    // Interned storage outlives the interner while it's in use.
+    AuthorizationSet survivor;
+    {
+        AuthorizationSetInterner scoped;
+        survivor = kept;
+        ASSERT_TRUE(scoped.Intern(&survivor));
+    }
+    EXPECT_TRUE(survivor.is_shared());
+    EXPECT_EQ(kept, survivor);
+
+    // Enough distinct sets to grow the table a few times.
+    for (uint32_t i = 0; i < 100; ++i) {
+        AuthorizationSet set(AuthorizationSetBuilder().Authorization(TAG_KEY_SIZE, i));
+        ASSERT_TRUE(interner.Intern(&set));
+    }
+    interner.Purge();
+    EXPECT_EQ(1U, interner.size());
+}
+
+static_assert(TagIndex(KM_TAG_INVALID) == 0, "KM_TAG_INVALID is first in kTagInfo");
+static_assert(kTagInfo[TagIndex(KM_TAG_ATTESTATION_ID_MODEL)].tag == KM_TAG_ATTESTATION_ID_MODEL,
+              "TagIndex must be usable in constant expressions");
+
+TEST(TagInfo, LookupFindsEveryTag) {
+    for (size_t i = 0; i < kTagCount; ++i) {
+        keymaster_tag_t tag = kTagInfo[i].tag;
+        EXPECT_EQ(i, LookupTagIndex(tag));
+        const TagInfo* info = GetTagInfo(tag);
+        ASSERT_TRUE(info != nullptr);
+        EXPECT_EQ(tag, info->tag);
+    }
+}
+
+TEST(TagInfo, UnknownTags) {
+    // Same tag number as KM_TAG_PURPOSE, different type.
+    keymaster_tag_t wrong_type = static_cast<keymaster_tag_t>(KM_BOOL | 1);
+    keymaster_tag_t unknown = static_cast<keymaster_tag_t>(KM_UINT | 9999);
+    EXPECT_EQ(kTagCount, LookupTagIndex(wrong_type));
+    EXPECT_EQ(kTagCount, LookupTagIndex(unknown));
+    EXPECT_TRUE(GetTagInfo(unknown) == nullptr);
+#ifdef KEYMASTER_NAME_TAGS
+    EXPECT_STREQ("KM_TAG_PURPOSE", StringifyTag(KM_TAG_PURPOSE));
+    EXPECT_STREQ("<Unknown>", StringifyTag(unknown));
+#endif
+}
+
 }  // namespace test
 }  // namespace keymaster
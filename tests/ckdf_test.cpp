@@ -99,5 +99,53 @@ TEST(CkdfTest, Ckdf) {
     }
 }
 
+TEST(CkdfTest, PreparedAndBatch) {
+    auto& test = kCkdfTests[0];
+    auto key = hex2key(test.key);
+    auto label = hex2blob(test.label);
+    auto context = hex2blob(test.context);
+    auto expected = hex2blob(test.output);
+
+    Ckdf prepared;
+    EXPECT_FALSE(prepared.is_initialized());
+    ASSERT_EQ(KM_ERROR_OK, prepared.Init(key));
+    ASSERT_TRUE(prepared.is_initialized());
+
+    // Repeated derivations from one prepared key give the reference output.
+    for (int i = 0; i < 2; ++i) {
+        KeymasterKeyBlob output;
+        output.Reset(expected.data_length);
+        ASSERT_EQ(KM_ERROR_OK, prepared.Derive(label, &context, 1 /* num_chunks */, &output));
+        EXPECT_TRUE(std::equal(output.begin(), output.end(), expected.begin()));
+    }
+
+    // A batch matches the one-shot function, entry by entry.
+    KeymasterBlob other_label(reinterpret_cast<const uint8_t*>("other"), 5);
+    KeymasterKeyBlob outputs[3];
+    outputs[0].Reset(expected.data_length);
+    outputs[1].Reset(17);
+    outputs[2].Reset(32);
+    Ckdf::Derivation derivations[] = {
+        {label, &context, 1, &outputs[0]},
+        {other_label, &context, 1, &outputs[1]},
+        {label, nullptr, 0, &outputs[2]},
+    };
+    ASSERT_EQ(KM_ERROR_OK, prepared.Derive(derivations, array_length(derivations)));
+
+    for (auto& derivation : derivations) {
+        KeymasterKeyBlob reference;
+        reference.Reset(derivation.output->key_material_size);
+        ASSERT_EQ(KM_ERROR_OK, ckdf(key, KeymasterBlob(derivation.label),
+                                    derivation.context_chunks, derivation.num_chunks, &reference));
+        EXPECT_TRUE(std::equal(reference.begin(), reference.end(), derivation.output->begin()));
+    }
+}
+
+TEST(CkdfTest, PreparedRejectsBadKeySize) {
+    Ckdf prepared;
+    EXPECT_EQ(KM_ERROR_UNSUPPORTED_KEY_SIZE, prepared.Init(KeymasterKeyBlob(24)));
+    EXPECT_FALSE(prepared.is_initialized());
+}
+
 }  // namespace test
 }  // namespace keymaster
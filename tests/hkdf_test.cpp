@@ -74,5 +74,37 @@ TEST(HkdfTest, Hkdf) {
     }
 }
 
+TEST(HkdfTest, RepeatedAndBatchExpansion) {
+    const string key = hex2str(kHkdfTests[0].key_hex);
+    const string salt = hex2str(kHkdfTests[0].salt_hex);
+    const string expected = hex2str(kHkdfTests[0].output_hex);
+    const size_t output_len = expected.size();
+
+    Rfc5869Sha256Kdf hkdf;
+    ASSERT_TRUE(hkdf.Init(reinterpret_cast<const uint8_t*>(key.data()), key.size(),
+                          reinterpret_cast<const uint8_t*>(salt.data()), salt.size()));
+
+    const string infos[] = {hex2str(kHkdfTests[0].info_hex), "", "other info"};
+    keymaster_blob_t info_blobs[array_length(infos)];
+    for (size_t i = 0; i < array_length(infos); ++i) {
+        info_blobs[i].data = reinterpret_cast<const uint8_t*>(infos[i].data());
+        info_blobs[i].data_length = infos[i].size();
+    }
+
+    uint8_t batch_output[array_length(infos) * output_len];
+    ASSERT_TRUE(hkdf.GenerateKeys(info_blobs, array_length(infos), batch_output, output_len));
+    EXPECT_EQ(0, memcmp(batch_output, expected.data(), output_len));
+
+    // Each batch entry matches a single expansion with the same info, and expansions can be
+    // repeated on one instance.
+    for (size_t i = 0; i < array_length(infos); ++i) {
+        uint8_t output[output_len];
+        ASSERT_TRUE(hkdf.GenerateKey(info_blobs[i].data, info_blobs[i].data_length, output,
+                                     output_len));
+        EXPECT_EQ(0, memcmp(output, batch_output + i * output_len, output_len));
+    }
+    EXPECT_NE(0, memcmp(batch_output, batch_output + output_len, output_len));
+}
+
 }  // namespace test
 }  // namespace keymaster
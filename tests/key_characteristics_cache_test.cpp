@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <keymaster/legacy_support/key_characteristics_cache.h>
+
+#include "android_keymaster_test_utils.h"
+
+namespace keymaster {
+namespace test {
+
+class KeyCharacteristicsCacheTest : public testing::Test {
+  protected:
+    KeyCharacteristicsCacheTest()
+        : hw_enforced_(AuthorizationSetBuilder().EcdsaSigningKey(256).Digest(KM_DIGEST_NONE)),
+          sw_enforced_(AuthorizationSetBuilder().Authorization(TAG_CREATION_DATETIME, 10)) {}
+
+    static keymaster_key_blob_t Blob(const char* material) {
+        return {reinterpret_cast<const uint8_t*>(material), strlen(material)};
+    }
+
+    void Add(KeyCharacteristicsCache* cache, const char* blob,
+             const AuthorizationSet& additional_params = AuthorizationSet()) {
+        keymaster_key_characteristics_t characteristics = {hw_enforced_, sw_enforced_};
+        cache->Add(Blob(blob), additional_params, characteristics);
+    }
+
+    bool Find(KeyCharacteristicsCache* cache, const char* blob,
+              const AuthorizationSet& additional_params = AuthorizationSet()) {
+        AuthorizationSet hw_enforced, sw_enforced;
+        if (!cache->Find(Blob(blob), additional_params, &hw_enforced, &sw_enforced))
+            return false;
+        EXPECT_EQ(hw_enforced_, hw_enforced);
+        EXPECT_EQ(sw_enforced_, sw_enforced);
+        return true;
+    }
+
+    AuthorizationSet hw_enforced_;
+    AuthorizationSet sw_enforced_;
+};
+
+TEST_F(KeyCharacteristicsCacheTest, HitAndMiss) {
+    KeyCharacteristicsCache cache(kKeyCharacteristicsCacheSize);
+    EXPECT_FALSE(Find(&cache, "key1"));
+
+    Add(&cache, "key1");
+    EXPECT_TRUE(Find(&cache, "key1"));
+    EXPECT_TRUE(Find(&cache, "key1"));
+    EXPECT_FALSE(Find(&cache, "key2"));
+    EXPECT_FALSE(Find(&cache, "key"));
+}
+
+TEST_F(KeyCharacteristicsCacheTest, ZeroSize) {
+    KeyCharacteristicsCache cache(0);
+    Add(&cache, "key1");
+    EXPECT_FALSE(Find(&cache, "key1"));
+}
+
+TEST_F(KeyCharacteristicsCacheTest, KeyedByApplicationIdAndData) {
+    KeyCharacteristicsCache cache(kKeyCharacteristicsCacheSize);
+    AuthorizationSet both(AuthorizationSetBuilder()
+                              .Authorization(TAG_APPLICATION_ID, "id", 2)
+                              .Authorization(TAG_APPLICATION_DATA, "data", 4));
+    Add(&cache, "key1", both);
+
+    EXPECT_TRUE(Find(&cache, "key1", both));
+    // Other tags don't matter.
+    AuthorizationSet with_padding(both);
+    with_padding.push_back(TAG_PADDING, KM_PAD_NONE);
+    EXPECT_TRUE(Find(&cache, "key1", with_padding));
+
+    EXPECT_FALSE(Find(&cache, "key1"));
+    EXPECT_FALSE(Find(&cache, "key1",
+                      AuthorizationSet(AuthorizationSetBuilder()
+                                           .Authorization(TAG_APPLICATION_ID, "id", 2)
+                                           .Authorization(TAG_APPLICATION_DATA, "other", 5))));
+    EXPECT_FALSE(Find(&cache, "key1",
+                      AuthorizationSet(AuthorizationSetBuilder()
+                                           .Authorization(TAG_APPLICATION_ID, "other", 5)
+                                           .Authorization(TAG_APPLICATION_DATA, "data", 4))));
+    // Neither the boundary between the values nor which tag holds which may be moved.
+    EXPECT_FALSE(Find(&cache, "key1",
+                      AuthorizationSet(AuthorizationSetBuilder()
+                                           .Authorization(TAG_APPLICATION_ID, "idd", 3)
+                                           .Authorization(TAG_APPLICATION_DATA, "ata", 3))));
+    EXPECT_FALSE(Find(&cache, "key1",
+                      AuthorizationSet(AuthorizationSetBuilder()
+                                           .Authorization(TAG_APPLICATION_ID, "data", 4)
+                                           .Authorization(TAG_APPLICATION_DATA, "id", 2))));
+
+    // An empty value isn't the same as no value.
+    AuthorizationSet empty_id(AuthorizationSetBuilder().Authorization(TAG_APPLICATION_ID, "", 0));
+    Add(&cache, "key2");
+    EXPECT_FALSE(Find(&cache, "key2", empty_id));
+    Add(&cache, "key2", empty_id);
+    EXPECT_TRUE(Find(&cache, "key2", empty_id));
+    EXPECT_TRUE(Find(&cache, "key2"));
+}
+
+TEST_F(KeyCharacteristicsCacheTest, EvictsLeastRecentlyUsed) {
+    KeyCharacteristicsCache cache(3);
+    Add(&cache, "key1");
+    Add(&cache, "key2");
+    Add(&cache, "key3");
+
+    // key1 is older, but key2 was used less recently.
+    EXPECT_TRUE(Find(&cache, "key1"));
+    Add(&cache, "key4");
+    EXPECT_FALSE(Find(&cache, "key2"));
+    EXPECT_TRUE(Find(&cache, "key1"));
+    EXPECT_TRUE(Find(&cache, "key3"));
+    EXPECT_TRUE(Find(&cache, "key4"));
+
+    // Now key1 is the least recently used.
+    Add(&cache, "key5");
+    EXPECT_FALSE(Find(&cache, "key1"));
+    EXPECT_TRUE(Find(&cache, "key3"));
+    EXPECT_TRUE(Find(&cache, "key4"));
+    EXPECT_TRUE(Find(&cache, "key5"));
+}
+
+TEST_F(KeyCharacteristicsCacheTest, InvalidateAndClear) {
+    KeyCharacteristicsCache cache(3);
+    AuthorizationSet app_id(AuthorizationSetBuilder().Authorization(TAG_APPLICATION_ID, "id", 2));
+    Add(&cache, "key1");
+    Add(&cache, "key1", app_id);
+    Add(&cache, "key2");
+
+    cache.Invalidate(Blob("key1"));
+    EXPECT_FALSE(Find(&cache, "key1"));
+    EXPECT_FALSE(Find(&cache, "key1", app_id));
+    EXPECT_TRUE(Find(&cache, "key2"));
+
+    // Invalidated entries are reused before any valid one is evicted.
+    Add(&cache, "key3");
+    Add(&cache, "key4");
+    EXPECT_TRUE(Find(&cache, "key2"));
+    EXPECT_TRUE(Find(&cache, "key3"));
+    EXPECT_TRUE(Find(&cache, "key4"));
+
+    cache.Clear();
+    EXPECT_FALSE(Find(&cache, "key2"));
+    EXPECT_FALSE(Find(&cache, "key3"));
+    EXPECT_FALSE(Find(&cache, "key4"));
+    Add(&cache, "key2");
+    EXPECT_TRUE(Find(&cache, "key2"));
+}
+
+TEST_F(KeyCharacteristicsCacheTest, SharesInternedCharacteristics) {
+    KeyCharacteristicsCache cache(kKeyCharacteristicsCacheSize);
+    Add(&cache, "key1");
+    Add(&cache, "key2");
+
+    AuthorizationSet hw_enforced1, sw_enforced1, hw_enforced2, sw_enforced2;
+    ASSERT_TRUE(cache.Find(Blob("key1"), AuthorizationSet(), &hw_enforced1, &sw_enforced1));
+    ASSERT_TRUE(cache.Find(Blob("key2"), AuthorizationSet(), &hw_enforced2, &sw_enforced2));
+    EXPECT_TRUE(hw_enforced1.is_shared());
+    EXPECT_TRUE(sw_enforced1.is_shared());
+    // Both keys' characteristics are the same interned sets.
+    EXPECT_EQ(hw_enforced1.begin(), hw_enforced2.begin());
+    EXPECT_EQ(sw_enforced1.begin(), sw_enforced2.begin());
+
+    // Changing a found set doesn't change the cached one.
+    hw_enforced1.push_back(TAG_PADDING, KM_PAD_NONE);
+    EXPECT_FALSE(hw_enforced1.is_shared());
+    EXPECT_TRUE(Find(&cache, "key1"));
+
+    // The found sets stay valid after their entries are dropped.
+    cache.Clear();
+    EXPECT_EQ(hw_enforced_, hw_enforced2);
+    EXPECT_EQ(sw_enforced_, sw_enforced2);
+}
+
+}  // namespace test
+}  // namespace keymaster
@@ -0,0 +1,528 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simulated_keymaster_device.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+#include <keymaster/android_keymaster_utils.h>
+#include <keymaster/authorization_set.h>
+
+namespace keymaster {
+namespace test {
+
+DeviceSimulator::DeviceSimulator(const DeviceSimulationParams& params)
+    : params_(params), random_(params.random_seed) {}
+
+void DeviceSimulator::set_params(const DeviceSimulationParams& params) {
+    std::lock_guard<std::mutex> lock(lock_);
+    params_ = params;
+    random_.seed(params.random_seed);
+    slot_freed_.notify_all();
+    rendezvous_reached_.notify_all();
+}
+
+DeviceSimulationStats DeviceSimulator::stats() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return stats_;
+}
+
+void DeviceSimulator::ResetStats() {
+    std::lock_guard<std::mutex> lock(lock_);
+    stats_ = DeviceSimulationStats();
+}
+
+bool DeviceSimulator::BeginCall(bool crypto) {
+    std::unique_lock<std::mutex> lock(lock_);
+    slot_freed_.wait(lock, [this] {
+        return params_.max_concurrent_calls == 0 || active_calls_ < params_.max_concurrent_calls;
+    });
+    ++active_calls_;
+    ++stats_.calls;
+    stats_.max_concurrent_calls = std::max(stats_.max_concurrent_calls, active_calls_);
+    if (stats_.max_concurrent_calls >= params_.rendezvous_calls)
+        rendezvous_reached_.notify_all();
+    rendezvous_reached_.wait(
+        lock, [this] { return stats_.max_concurrent_calls >= params_.rendezvous_calls; });
+
+    bool fail = params_.failure_rate > 0 &&
+                std::uniform_real_distribution<double>()(random_) < params_.failure_rate;
+    if (fail)
+        ++stats_.injected_failures;
+
+    std::chrono::microseconds latency = params_.call_latency;
+    if (crypto)
+        latency += params_.crypto_latency;
+    stats_.injected_latency += latency;
+    lock.unlock();
+
+    // A failed call still costs the round trip.
+    if (latency.count() > 0)
+        std::this_thread::sleep_for(latency);
+    return !fail;
+}
+
+void DeviceSimulator::EndCall() {
+    std::lock_guard<std::mutex> lock(lock_);
+    --active_calls_;
+    slot_freed_.notify_one();
+}
+
+namespace {
+
+const bool kCrypto = true;
+const bool kNoCrypto = false;
+
+// Scopes one call into a simulated device.
+class SimulatedCall {
+  public:
+    SimulatedCall(DeviceSimulator* simulator, bool crypto)
+        : simulator_(simulator), admitted_(simulator->BeginCall(crypto)) {}
+    ~SimulatedCall() { simulator_->EndCall(); }
+
+    bool failed() const { return !admitted_; }
+
+  private:
+    DeviceSimulator* simulator_;
+    bool admitted_;
+};
+
+/**
+ * A keymaster1 or keymaster2 device that forwards every call to the device it wraps, through a
+ * DeviceSimulator.
+ */
+template <typename Device> class SimulatedDevice {
+  public:
+    SimulatedDevice(Device* wrapped, DeviceSimulator* simulator)
+        : wrapped_(wrapped), simulator_(simulator) {
+        module_ = *wrapped_->common.module;
+        module_name_ = std::string("Simulated ") + wrapped_->common.module->name;
+        module_.name = module_name_.c_str();
+
+        memset(&device_, 0, sizeof(device_));
+        device_.common = wrapped_->common;
+        device_.common.module = &module_;
+        device_.common.close = close_device;
+        device_.context = this;
+        device_.flags = wrapped_->flags;
+    }
+
+    Device* device() { return &device_; }
+
+    template <typename Function, typename... Args>
+    static keymaster_error_t Forward(const Device* dev, Function Device::*function, bool crypto,
+                                     Args... args) {
+        SimulatedDevice* self = reinterpret_cast<SimulatedDevice*>(dev->context);
+        SimulatedCall call(self->simulator_, crypto);
+        if (call.failed())
+            return KM_ERROR_SECURE_HW_COMMUNICATION_FAILED;
+        std::lock_guard<std::mutex> lock(self->simulator_->backing_device_lock());
+        return (self->wrapped_->*function)(self->wrapped_, args...);
+    }
+
+  private:
+    static int close_device(hw_device_t* dev) {
+        SimulatedDevice* self =
+            reinterpret_cast<SimulatedDevice*>(reinterpret_cast<Device*>(dev)->context);
+        Device* wrapped = self->wrapped_;
+        delete self;
+        return wrapped->common.close(&wrapped->common);
+    }
+
+    // Must be first, so the device can be cast to hw_device_t.
+    Device device_;
+    Device* wrapped_;
+    DeviceSimulator* simulator_;
+    hw_module_t module_;
+    std::string module_name_;
+};
+
+// The entries below are generic lambdas, each converted to the function pointer type of the entry
+// it's assigned to; the parameters after the device are forwarded unchanged.
+#define SIMULATE(Device, dev, entry, crypto)                                                       \
+    (dev).entry = [](const Device* d, auto... args) {                                              \
+        return SimulatedDevice<Device>::Forward(d, &Device::entry, crypto, args...);               \
+    }
+
+/**
+ * A keymaster0 device that keeps its RSA and EC keys in a keymaster1 device.  keymaster0 blobs
+ * are the keymaster1 blobs, prefixed with the key's algorithm so that signing knows which
+ * parameters to use.
+ */
+class SimulatedKeymaster0Device {
+  public:
+    SimulatedKeymaster0Device(keymaster1_device_t* backing, DeviceSimulator* simulator)
+        : backing_(backing), simulator_(simulator) {
+        module_ = *backing_->common.module;
+        module_name_ = std::string("Simulated keymaster0 on ") + backing_->common.module->name;
+        module_.name = module_name_.c_str();
+        module_.module_api_version = KEYMASTER_MODULE_API_VERSION_0_3;
+
+        memset(&device_, 0, sizeof(device_));
+        device_.common.tag = HARDWARE_DEVICE_TAG;
+        device_.common.version = 1;
+        device_.common.module = &module_;
+        device_.common.close = close_device;
+        device_.context = this;
+        device_.client_version = 1;
+        device_.flags = KEYMASTER_BLOBS_ARE_STANDALONE | KEYMASTER_SUPPORTS_EC;
+
+        device_.generate_keypair = generate_keypair;
+        device_.import_keypair = import_keypair;
+        device_.get_keypair_public = get_keypair_public;
+        device_.delete_keypair = delete_keypair;
+        device_.delete_all = delete_all;
+        device_.sign_data = sign_data;
+        device_.verify_data = verify_data;
+    }
+
+    keymaster0_device_t* device() { return &device_; }
+
+  private:
+    static SimulatedKeymaster0Device* self(const keymaster0_device_t* dev) {
+        return reinterpret_cast<SimulatedKeymaster0Device*>(dev->context);
+    }
+
+    static int close_device(hw_device_t* dev) {
+        SimulatedKeymaster0Device* device =
+            self(reinterpret_cast<const keymaster0_device_t*>(dev));
+        keymaster1_device_t* backing = device->backing_;
+        delete device;
+        return backing->common.close(&backing->common);
+    }
+
+    static AuthorizationSet SigningKey(keymaster_algorithm_t algorithm) {
+        AuthorizationSet description(AuthorizationSetBuilder()
+                                         .Authorization(TAG_ALGORITHM, algorithm)
+                                         .SigningKey()
+                                         .Authorization(TAG_PURPOSE, KM_PURPOSE_VERIFY)
+                                         .Digest(KM_DIGEST_NONE)
+                                         .Authorization(TAG_NO_AUTH_REQUIRED));
+        if (algorithm == KM_ALGORITHM_RSA)
+            description.push_back(TAG_PADDING, KM_PAD_NONE);
+        return description;
+    }
+
+    // Splits a keymaster0 blob into the key's algorithm and its keymaster1 blob.
+    static bool ParseBlob(const uint8_t* key_blob, size_t key_blob_length,
+                          keymaster_algorithm_t* algorithm, keymaster_key_blob_t* km1_blob) {
+        if (!key_blob || key_blob_length < 2)
+            return false;
+        *algorithm = static_cast<keymaster_algorithm_t>(key_blob[0]);
+        if (*algorithm != KM_ALGORITHM_RSA && *algorithm != KM_ALGORITHM_EC)
+            return false;
+        km1_blob->key_material = key_blob + 1;
+        km1_blob->key_material_size = key_blob_length - 1;
+        return true;
+    }
+
+    static int MakeBlob(keymaster_algorithm_t algorithm, const keymaster_key_blob_t& km1_blob,
+                        uint8_t** key_blob, size_t* key_blob_length) {
+        *key_blob = reinterpret_cast<uint8_t*>(malloc(km1_blob.key_material_size + 1));
+        if (!*key_blob)
+            return -1;
+        (*key_blob)[0] = static_cast<uint8_t>(algorithm);
+        memcpy(*key_blob + 1, km1_blob.key_material, km1_blob.key_material_size);
+        *key_blob_length = km1_blob.key_material_size + 1;
+        return 0;
+    }
+
+    int Generate(keymaster_algorithm_t algorithm, const AuthorizationSet& description,
+                 uint8_t** key_blob, size_t* key_blob_length) {
+        keymaster_key_blob_t km1_blob;
+        if (backing_->generate_key(backing_, &description, &km1_blob, nullptr /* chars */) !=
+            KM_ERROR_OK)
+            return -1;
+        int result = MakeBlob(algorithm, km1_blob, key_blob, key_blob_length);
+        free(const_cast<uint8_t*>(km1_blob.key_material));
+        return result;
+    }
+
+    // Runs a keymaster1 signing or verification operation over all of |data|.
+    keymaster_error_t RunOperation(keymaster_purpose_t purpose, keymaster_algorithm_t algorithm,
+                                   const keymaster_key_blob_t& km1_blob, const uint8_t* data,
+                                   size_t data_length, const keymaster_blob_t* signature,
+                                   keymaster_blob_t* output) {
+        AuthorizationSet begin_params(AuthorizationSetBuilder().Digest(KM_DIGEST_NONE));
+        if (algorithm == KM_ALGORITHM_RSA)
+            begin_params.push_back(TAG_PADDING, KM_PAD_NONE);
+
+        keymaster_operation_handle_t handle;
+        keymaster_error_t error = backing_->begin(backing_, purpose, &km1_blob, &begin_params,
+                                                  nullptr /* out_params */, &handle);
+        if (error != KM_ERROR_OK)
+            return error;
+
+        keymaster_blob_t input = {data, data_length};
+        while (input.data_length > 0) {
+            size_t consumed = 0;
+            keymaster_blob_t update_output = {nullptr, 0};
+            error = backing_->update(backing_, handle, nullptr /* in_params */, &input, &consumed,
+                                     nullptr /* out_params */, &update_output);
+            free(const_cast<uint8_t*>(update_output.data));
+            if (error == KM_ERROR_OK && consumed == 0)
+                error = KM_ERROR_INVALID_INPUT_LENGTH;
+            if (error != KM_ERROR_OK) {
+                backing_->abort(backing_, handle);
+                return error;
+            }
+            input.data += consumed;
+            input.data_length -= consumed;
+        }
+
+        keymaster_blob_t finish_output = {nullptr, 0};
+        error = backing_->finish(backing_, handle, nullptr /* in_params */, signature,
+                                 nullptr /* out_params */, output ? output : &finish_output);
+        free(const_cast<uint8_t*>(finish_output.data));
+        return error;
+    }
+
+    static int generate_keypair(const keymaster0_device_t* dev, const keymaster_keypair_t key_type,
+                                const void* key_params, uint8_t** key_blob,
+                                size_t* key_blob_length) {
+        SimulatedCall call(self(dev)->simulator_, kCrypto);
+        if (call.failed() || !key_params || !key_blob || !key_blob_length)
+            return -1;
+        std::lock_guard<std::mutex> lock(self(dev)->simulator_->backing_device_lock());
+
+        switch (key_type) {
+        case TYPE_RSA: {
+            auto params = reinterpret_cast<const keymaster_rsa_keygen_params_t*>(key_params);
+            AuthorizationSet description = SigningKey(KM_ALGORITHM_RSA);
+            description.push_back(TAG_KEY_SIZE, params->modulus_size);
+            description.push_back(TAG_RSA_PUBLIC_EXPONENT, params->public_exponent);
+            return self(dev)->Generate(KM_ALGORITHM_RSA, description, key_blob, key_blob_length);
+        }
+        case TYPE_EC: {
+            auto params = reinterpret_cast<const keymaster_ec_keygen_params_t*>(key_params);
+            AuthorizationSet description = SigningKey(KM_ALGORITHM_EC);
+            description.push_back(TAG_KEY_SIZE, params->field_size);
+            return self(dev)->Generate(KM_ALGORITHM_EC, description, key_blob, key_blob_length);
+        }
+        default:
+            return -1;
+        }
+    }
+
+    static int import_keypair(const keymaster0_device_t* dev, const uint8_t* key,
+                              const size_t key_length, uint8_t** key_blob,
+                              size_t* key_blob_length) {
+        SimulatedCall call(self(dev)->simulator_, kCrypto);
+        if (call.failed() || !key || !key_blob || !key_blob_length)
+            return -1;
+
+        const uint8_t* p = key;
+        std::unique_ptr<PKCS8_PRIV_KEY_INFO, void (*)(PKCS8_PRIV_KEY_INFO*)> pkcs8(
+            d2i_PKCS8_PRIV_KEY_INFO(nullptr, &p, key_length), PKCS8_PRIV_KEY_INFO_free);
+        if (!pkcs8)
+            return -1;
+        std::unique_ptr<EVP_PKEY, void (*)(EVP_PKEY*)> pkey(EVP_PKCS82PKEY(pkcs8.get()),
+                                                             EVP_PKEY_free);
+        if (!pkey)
+            return -1;
+
+        keymaster_algorithm_t algorithm;
+        switch (EVP_PKEY_type(pkey->type)) {
+        case EVP_PKEY_RSA:
+            algorithm = KM_ALGORITHM_RSA;
+            break;
+        case EVP_PKEY_EC:
+            algorithm = KM_ALGORITHM_EC;
+            break;
+        default:
+            return -1;
+        }
+
+        std::lock_guard<std::mutex> lock(self(dev)->simulator_->backing_device_lock());
+        keymaster1_device_t* backing = self(dev)->backing_;
+        AuthorizationSet description = SigningKey(algorithm);
+        keymaster_blob_t key_data = {key, key_length};
+        keymaster_key_blob_t km1_blob;
+        if (backing->import_key(backing, &description, KM_KEY_FORMAT_PKCS8, &key_data, &km1_blob,
+                                nullptr /* characteristics */) != KM_ERROR_OK)
+            return -1;
+        int result = MakeBlob(algorithm, km1_blob, key_blob, key_blob_length);
+        free(const_cast<uint8_t*>(km1_blob.key_material));
+        return result;
+    }
+
+    static int get_keypair_public(const keymaster0_device_t* dev, const uint8_t* key_blob,
+                                  const size_t key_blob_length, uint8_t** x509_data,
+                                  size_t* x509_data_length) {
+        SimulatedCall call(self(dev)->simulator_, kNoCrypto);
+        keymaster_algorithm_t algorithm;
+        keymaster_key_blob_t km1_blob;
+        if (call.failed() || !x509_data || !x509_data_length ||
+            !ParseBlob(key_blob, key_blob_length, &algorithm, &km1_blob))
+            return -1;
+        std::lock_guard<std::mutex> lock(self(dev)->simulator_->backing_device_lock());
+
+        keymaster1_device_t* backing = self(dev)->backing_;
+        keymaster_blob_t export_data;
+        if (backing->export_key(backing, KM_KEY_FORMAT_X509, &km1_blob, nullptr /* client_id */,
+                                nullptr /* app_data */, &export_data) != KM_ERROR_OK)
+            return -1;
+        *x509_data = const_cast<uint8_t*>(export_data.data);
+        *x509_data_length = export_data.data_length;
+        return 0;
+    }
+
+    static int delete_keypair(const keymaster0_device_t* dev, const uint8_t* key_blob,
+                              const size_t key_blob_length) {
+        SimulatedCall call(self(dev)->simulator_, kNoCrypto);
+        keymaster_algorithm_t algorithm;
+        keymaster_key_blob_t km1_blob;
+        if (call.failed() || !ParseBlob(key_blob, key_blob_length, &algorithm, &km1_blob))
+            return -1;
+        std::lock_guard<std::mutex> lock(self(dev)->simulator_->backing_device_lock());
+
+        keymaster1_device_t* backing = self(dev)->backing_;
+        if (!backing->delete_key)
+            return 0;
+        return backing->delete_key(backing, &km1_blob) == KM_ERROR_OK ? 0 : -1;
+    }
+
+    static int delete_all(const keymaster0_device_t* dev) {
+        SimulatedCall call(self(dev)->simulator_, kNoCrypto);
+        if (call.failed())
+            return -1;
+        std::lock_guard<std::mutex> lock(self(dev)->simulator_->backing_device_lock());
+
+        keymaster1_device_t* backing = self(dev)->backing_;
+        if (!backing->delete_all_keys)
+            return 0;
+        return backing->delete_all_keys(backing) == KM_ERROR_OK ? 0 : -1;
+    }
+
+    static int sign_data(const keymaster0_device_t* dev, const void* /* signing_params */,
+                         const uint8_t* key_blob, const size_t key_blob_length,
+                         const uint8_t* data, const size_t data_length, uint8_t** signed_data,
+                         size_t* signed_data_length) {
+        SimulatedCall call(self(dev)->simulator_, kCrypto);
+        keymaster_algorithm_t algorithm;
+        keymaster_key_blob_t km1_blob;
+        if (call.failed() || !signed_data || !signed_data_length ||
+            !ParseBlob(key_blob, key_blob_length, &algorithm, &km1_blob))
+            return -1;
+        std::lock_guard<std::mutex> lock(self(dev)->simulator_->backing_device_lock());
+
+        keymaster_blob_t signature = {nullptr, 0};
+        if (self(dev)->RunOperation(KM_PURPOSE_SIGN, algorithm, km1_blob, data, data_length,
+                                    nullptr /* signature */, &signature) != KM_ERROR_OK) {
+            free(const_cast<uint8_t*>(signature.data));
+            return -1;
+        }
+        *signed_data = const_cast<uint8_t*>(signature.data);
+        *signed_data_length = signature.data_length;
+        return 0;
+    }
+
+    static int verify_data(const keymaster0_device_t* dev, const void* /* signing_params */,
+                           const uint8_t* key_blob, const size_t key_blob_length,
+                           const uint8_t* signed_data, const size_t signed_data_length,
+                           const uint8_t* signature, const size_t signature_length) {
+        SimulatedCall call(self(dev)->simulator_, kCrypto);
+        keymaster_algorithm_t algorithm;
+        keymaster_key_blob_t km1_blob;
+        if (call.failed() || !ParseBlob(key_blob, key_blob_length, &algorithm, &km1_blob))
+            return -1;
+        std::lock_guard<std::mutex> lock(self(dev)->simulator_->backing_device_lock());
+
+        keymaster_blob_t signature_blob = {signature, signature_length};
+        return self(dev)->RunOperation(KM_PURPOSE_VERIFY, algorithm, km1_blob, signed_data,
+                                       signed_data_length, &signature_blob,
+                                       nullptr /* output */) == KM_ERROR_OK
+                   ? 0
+                   : -1;
+    }
+
+    // Must be first, so the device can be cast to hw_device_t.
+    keymaster0_device_t device_;
+    keymaster1_device_t* backing_;
+    DeviceSimulator* simulator_;
+    hw_module_t module_;
+    std::string module_name_;
+};
+
+}  // anonymous namespace
+
+keymaster1_device_t* make_simulated_keymaster1_device(keymaster1_device_t* device,
+                                                      DeviceSimulator* simulator) {
+    auto wrapper = new SimulatedDevice<keymaster1_device_t>(device, simulator);
+    keymaster1_device_t& dev = *wrapper->device();
+    dev.client_version = device->client_version;
+
+    SIMULATE(keymaster1_device_t, dev, get_supported_algorithms, kNoCrypto);
+    SIMULATE(keymaster1_device_t, dev, get_supported_block_modes, kNoCrypto);
+    SIMULATE(keymaster1_device_t, dev, get_supported_padding_modes, kNoCrypto);
+    SIMULATE(keymaster1_device_t, dev, get_supported_digests, kNoCrypto);
+    SIMULATE(keymaster1_device_t, dev, get_supported_import_formats, kNoCrypto);
+    SIMULATE(keymaster1_device_t, dev, get_supported_export_formats, kNoCrypto);
+    SIMULATE(keymaster1_device_t, dev, add_rng_entropy, kNoCrypto);
+    SIMULATE(keymaster1_device_t, dev, generate_key, kCrypto);
+    SIMULATE(keymaster1_device_t, dev, get_key_characteristics, kNoCrypto);
+    SIMULATE(keymaster1_device_t, dev, import_key, kCrypto);
+    SIMULATE(keymaster1_device_t, dev, export_key, kNoCrypto);
+    if (device->delete_key)
+        SIMULATE(keymaster1_device_t, dev, delete_key, kNoCrypto);
+    if (device->delete_all_keys)
+        SIMULATE(keymaster1_device_t, dev, delete_all_keys, kNoCrypto);
+    SIMULATE(keymaster1_device_t, dev, begin, kCrypto);
+    SIMULATE(keymaster1_device_t, dev, update, kCrypto);
+    SIMULATE(keymaster1_device_t, dev, finish, kCrypto);
+    SIMULATE(keymaster1_device_t, dev, abort, kNoCrypto);
+    return &dev;
+}
+
+keymaster2_device_t* make_simulated_keymaster2_device(keymaster2_device_t* device,
+                                                      DeviceSimulator* simulator) {
+    auto wrapper = new SimulatedDevice<keymaster2_device_t>(device, simulator);
+    keymaster2_device_t& dev = *wrapper->device();
+
+    SIMULATE(keymaster2_device_t, dev, configure, kNoCrypto);
+    SIMULATE(keymaster2_device_t, dev, add_rng_entropy, kNoCrypto);
+    SIMULATE(keymaster2_device_t, dev, generate_key, kCrypto);
+    SIMULATE(keymaster2_device_t, dev, get_key_characteristics, kNoCrypto);
+    SIMULATE(keymaster2_device_t, dev, import_key, kCrypto);
+    SIMULATE(keymaster2_device_t, dev, export_key, kNoCrypto);
+    SIMULATE(keymaster2_device_t, dev, attest_key, kCrypto);
+    SIMULATE(keymaster2_device_t, dev, upgrade_key, kCrypto);
+    if (device->delete_key)
+        SIMULATE(keymaster2_device_t, dev, delete_key, kNoCrypto);
+    if (device->delete_all_keys)
+        SIMULATE(keymaster2_device_t, dev, delete_all_keys, kNoCrypto);
+    SIMULATE(keymaster2_device_t, dev, begin, kCrypto);
+    SIMULATE(keymaster2_device_t, dev, update, kCrypto);
+    SIMULATE(keymaster2_device_t, dev, finish, kCrypto);
+    SIMULATE(keymaster2_device_t, dev, abort, kNoCrypto);
+    return &dev;
+}
+
+keymaster0_device_t* make_simulated_keymaster0_device(keymaster1_device_t* device,
+                                                      DeviceSimulator* simulator) {
+    return (new SimulatedKeymaster0Device(device, simulator))->device();
+}
+
+}  // namespace test
+}  // namespace keymaster
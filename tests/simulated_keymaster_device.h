@@ -0,0 +1,130 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYSTEM_KEYMASTER_SIMULATED_KEYMASTER_DEVICE_H_
+#define SYSTEM_KEYMASTER_SIMULATED_KEYMASTER_DEVICE_H_
+
+/*
+ * Simulated legacy keymaster devices, for exercising and timing the keymaster0/1/2 shims on a
+ * host.  Not used in production code.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+
+#include <hardware/keymaster0.h>
+#include <hardware/keymaster1.h>
+#include <hardware/keymaster2.h>
+
+namespace keymaster {
+namespace test {
+
+/**
+ * How a simulated device behaves.  The defaults describe an ideal device: no added latency, no
+ * limit on concurrent calls and no failures.
+ */
+struct DeviceSimulationParams {
+    // Added to every call, modelling the round trip into the secure world.
+    std::chrono::microseconds call_latency{0};
+    // Added on top of call_latency for calls that do cryptographic work: key generation and
+    // import, begin, update and finish, and keymaster0 signing and verification.
+    std::chrono::microseconds crypto_latency{0};
+    // The number of calls the device services at once.  Further calls wait for one to finish.
+    // Zero means no limit.
+    size_t max_concurrent_calls = 0;
+    // If non-zero, calls wait in the device, after being admitted, until this many have been in it
+    // at once since the params were set or the stats reset; from then on calls don't wait.  Lets a
+    // test rely on reaching that concurrency rather than on thread timing.  It mustn't exceed
+    // max_concurrent_calls, any limit the caller imposes, or the number of calling threads.
+    size_t rendezvous_calls = 0;
+    // The fraction of calls, from 0 to 1, that fail as though the secure world couldn't be
+    // reached, without reaching the backing device.  keymaster0 calls fail with -1, the others
+    // with KM_ERROR_SECURE_HW_COMMUNICATION_FAILED.
+    double failure_rate = 0;
+    uint32_t random_seed = 1;
+};
+
+struct DeviceSimulationStats {
+    size_t calls = 0;
+    size_t injected_failures = 0;
+    // The most calls that were in the device at once.
+    size_t max_concurrent_calls = 0;
+    std::chrono::microseconds injected_latency{0};
+};
+
+/**
+ * Applies DeviceSimulationParams to the calls made into one or more simulated devices, and counts
+ * them.  The backing devices aren't thread-safe, so calls into them are serialized; only the
+ * injected latency overlaps, up to max_concurrent_calls at a time.  A DeviceSimulator must outlive
+ * the devices that use it.
+ */
+class DeviceSimulator {
+  public:
+    explicit DeviceSimulator(const DeviceSimulationParams& params = DeviceSimulationParams());
+
+    // Takes effect from the next call.
+    void set_params(const DeviceSimulationParams& params);
+    DeviceSimulationStats stats() const;
+    void ResetStats();
+
+    /**
+     * Admits a call into the device, waiting for a free slot and then for the injected latency.
+     * Returns false if the call is to fail.  Every BeginCall must be matched by an EndCall.
+     */
+    bool BeginCall(bool crypto);
+    void EndCall();
+
+    std::mutex& backing_device_lock() { return backing_device_lock_; }
+
+  private:
+    mutable std::mutex lock_;
+    std::condition_variable slot_freed_;
+    std::condition_variable rendezvous_reached_;
+    std::mutex backing_device_lock_;
+    DeviceSimulationParams params_;
+    DeviceSimulationStats stats_;
+    size_t active_calls_ = 0;
+    std::mt19937 random_;
+};
+
+/**
+ * Wraps \p device, which it takes ownership of, in a keymaster1 device whose calls go through
+ * \p simulator.
+ */
+keymaster1_device_t* make_simulated_keymaster1_device(keymaster1_device_t* device,
+                                                      DeviceSimulator* simulator);
+
+/**
+ * Wraps \p device, which it takes ownership of, in a keymaster2 device whose calls go through
+ * \p simulator.
+ */
+keymaster2_device_t* make_simulated_keymaster2_device(keymaster2_device_t* device,
+                                                      DeviceSimulator* simulator);
+
+/**
+ * Makes a keymaster0 device, supporting RSA and EC, out of \p device, which it takes ownership of.
+ * Key pairs are generated and imported as unpadded, undigested signing keys of \p device, and the
+ * keymaster0 blobs are its key blobs.  Calls go through \p simulator.
+ */
+keymaster0_device_t* make_simulated_keymaster0_device(keymaster1_device_t* device,
+                                                      DeviceSimulator* simulator);
+
+}  // namespace test
+}  // namespace keymaster
+
+#endif  // SYSTEM_KEYMASTER_SIMULATED_KEYMASTER_DEVICE_H_